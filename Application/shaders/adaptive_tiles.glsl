@@ -0,0 +1,38 @@
+// adaptive sampling work of Luxel::AdaptiveSampler::GetGpuWork, include after defining
+// ADAPTIVE_TILES_SET and ADAPTIVE_TILES_BINDING. dispatch indirectly from the same buffer at offset 0
+// with local_size 16x16: workgroup i traces work item i, one invocation per pixel of the tile.
+
+#ifndef ADAPTIVE_TILES_SET
+#define ADAPTIVE_TILES_SET 0
+#endif
+#ifndef ADAPTIVE_TILES_BINDING
+#define ADAPTIVE_TILES_BINDING 0
+#endif
+
+layout (std430, set = ADAPTIVE_TILES_SET, binding = ADAPTIVE_TILES_BINDING) readonly buffer AdaptiveTiles {
+    // VkDispatchIndirectCommand
+    uvec3 groupCount;
+    uint workCount;
+    // tile size, width, height, 0
+    uvec4 info;
+    // tileX, tileY, samples, firstSample
+    uvec4 work[];
+} adaptiveTiles;
+
+struct TileSamples {
+    bool valid;
+    uvec2 pixel;
+    uint samples;
+    uint firstSample;
+};
+
+// the pixel this invocation traces and its sample range, invalid past the image edge.
+TileSamples adaptiveTileSamples() {
+    uvec4 item = adaptiveTiles.work[gl_WorkGroupID.x];
+    TileSamples result;
+    result.pixel = item.xy * adaptiveTiles.info.x + gl_LocalInvocationID.xy;
+    result.valid = all(lessThan(result.pixel, adaptiveTiles.info.yz));
+    result.samples = item.z;
+    result.firstSample = item.w;
+    return result;
+}
@@ -0,0 +1,64 @@
+// baked block light of Luxel::VoxelBlockLight, include after defining BLOCK_LIGHT_SET and BLOCK_LIGHT_BINDING.
+// binding BLOCK_LIGHT_BINDING + 0 holds GetChunkTable as it is, + 1 the GetSlotLight arrays of every slot
+// one after the other, CHUNK_VOLUME words per slot uploaded again when GetModifiedSlots lists them.
+
+#ifndef BLOCK_LIGHT_SET
+#define BLOCK_LIGHT_SET 0
+#endif
+#ifndef BLOCK_LIGHT_BINDING
+#define BLOCK_LIGHT_BINDING 0
+#endif
+
+#define BLOCK_LIGHT_INVALID 0xFFFFFFFFu
+#define BLOCK_LIGHT_MAX 15.0
+#define BLOCK_LIGHT_CHUNK_VOLUME 32768u
+
+layout (std430, set = BLOCK_LIGHT_SET, binding = BLOCK_LIGHT_BINDING) readonly buffer BlockLightTable {
+    // header.x is the table mask
+    ivec4 header;
+    ivec4 entries[];
+} blockLightTable;
+
+layout (std430, set = BLOCK_LIGHT_SET, binding = BLOCK_LIGHT_BINDING + 1) readonly buffer BlockLightLevels {
+    // red | green << 8 | blue << 16 per voxel, Morton order inside a chunk like Chunk voxels
+    uint levels[];
+} blockLightLevels;
+
+uint blockLightHash(ivec3 coord) {
+    return (uint(coord.x) * 73856093u) ^ (uint(coord.y) * 19349663u) ^ (uint(coord.z) * 83492791u);
+}
+
+uint blockLightFindSlot(ivec3 coord) {
+    uint mask = uint(blockLightTable.header.x);
+    uint index = blockLightHash(coord) & mask;
+    for (uint probe = 0u; probe <= mask; probe++) {
+        ivec4 entry = blockLightTable.entries[index];
+        if (uint(entry.w) == BLOCK_LIGHT_INVALID) {
+            return BLOCK_LIGHT_INVALID;
+        }
+        if (entry.xyz == coord) {
+            return uint(entry.w);
+        }
+        index = (index + 1u) & mask;
+    }
+    return BLOCK_LIGHT_INVALID;
+}
+
+// Morton code of a position inside a 32^3 chunk, same order as Chunk storage.
+uint blockLightMorton(ivec3 p) {
+    uvec3 u = uvec3(p);
+    u = (u | (u << 8)) & 0x0300F00Fu;
+    u = (u | (u << 4)) & 0x030C30C3u;
+    u = (u | (u << 2)) & 0x09249249u;
+    return u.x | (u.y << 1) | (u.z << 2);
+}
+
+// light levels of the voxel at position in [0, 1] per channel.
+vec3 blockLightGet(ivec3 position) {
+    uint slot = blockLightFindSlot(position >> 5);
+    if (slot == BLOCK_LIGHT_INVALID) {
+        return vec3(0.0);
+    }
+    uint word = blockLightLevels.levels[slot * BLOCK_LIGHT_CHUNK_VOLUME + blockLightMorton(position & 31)];
+    return vec3(uvec3(word, word >> 8, word >> 16) & 0xFFu) / BLOCK_LIGHT_MAX;
+}
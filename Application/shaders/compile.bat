@@ -0,0 +1,3 @@
+@echo off
+rem compiles every shader in this folder to SPIR-V, requires glslc from the Vulkan SDK
+for %%f in (*.vert *.frag *.comp) do glslc %%f -o %%f.spv
@@ -0,0 +1,59 @@
+// G-buffer texel written by the primary visibility pass, must match Luxel::GBufferTexel.
+// pixel (x, y) covers [x, x + 1) x [y, y + 1), distance 0 marks rays that hit nothing.
+
+// sky texels are reprojected as points this far along their ray
+#define GBUFFER_SKY_DISTANCE 1e6
+
+struct GBufferTexel {
+    vec3 normal;
+    float distance;
+    vec3 albedo;
+    uint material;
+};
+
+struct InvalidationBox {
+    vec4 boxMin;
+    vec4 boxMax;
+};
+
+vec3 gbufferRayDirection(mat4 inverseViewProjection, vec3 position, vec2 pixel, uvec2 extent) {
+    vec2 ndc = pixel / vec2(extent) * 2.0 - 1.0;
+    vec4 farPoint = inverseViewProjection * vec4(ndc, 1.0, 1.0);
+    return normalize(farPoint.xyz / farPoint.w - position);
+}
+
+// returns false when p is behind the camera.
+bool gbufferProject(mat4 viewProjection, vec3 p, uvec2 extent, out vec2 pixel) {
+    vec4 clip = viewProjection * vec4(p, 1.0);
+    pixel = vec2(0.0);
+    if (clip.w <= 0.0) {
+        return false;
+    }
+    pixel = (clip.xy / clip.w * 0.5 + 0.5) * vec2(extent);
+    return true;
+}
+
+bool gbufferInsideBox(vec3 p, InvalidationBox box) {
+    return all(greaterThanEqual(p, box.boxMin.xyz)) && all(lessThanEqual(p, box.boxMax.xyz));
+}
+
+// bilinear footprint over the previous pixel centers, tap i sits at base + ivec2(i & 1, i >> 1).
+void gbufferFootprint(vec2 previousPixel, out ivec2 base, out vec2 fraction) {
+    vec2 corner = floor(previousPixel - 0.5);
+    base = ivec2(corner);
+    fraction = previousPixel - 0.5 - corner;
+}
+
+float gbufferTapWeight(uint tap, vec2 fraction) {
+    return ((tap & 1u) != 0u ? fraction.x : 1.0 - fraction.x) * ((tap >> 1u) != 0u ? fraction.y : 1.0 - fraction.y);
+}
+
+// the rejection of Luxel::Reproject, expected is the distance of the point from the previous camera.
+bool gbufferTapMatches(GBufferTexel previous, GBufferTexel texel, float expected, float distanceTolerance, float normalTolerance) {
+    bool sky = texel.distance <= 0.0;
+    if (sky != (previous.distance <= 0.0)) {
+        return false;
+    }
+    return sky || (abs(previous.distance - expected) <= distanceTolerance * expected &&
+        dot(previous.normal, texel.normal) >= normalTolerance);
+}
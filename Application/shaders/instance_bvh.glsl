@@ -0,0 +1,77 @@
+// flattened Luxel::InstanceBvh, include after defining INSTANCE_BVH_SET and INSTANCE_BVH_BINDING.
+// bindings INSTANCE_BVH_BINDING + 0, 1 hold Flatten and GetIndices as they are.
+// define BVH_INTERSECT(instance, origin, direction, tMax) returning the hit distance, or tMax and
+// beyond for a miss, to get bvhTrace.
+
+#ifndef INSTANCE_BVH_SET
+#define INSTANCE_BVH_SET 0
+#endif
+#ifndef INSTANCE_BVH_BINDING
+#define INSTANCE_BVH_BINDING 0
+#endif
+
+#define BVH_INVALID 0xFFFFFFFFu
+#define BVH_LEAF_FIRST_BITS 24
+
+struct GpuBvhNode {
+    vec3 boundsMin;
+    // 0 for inner nodes, count << BVH_LEAF_FIRST_BITS | first for leaves
+    uint leaf;
+    vec3 boundsMax;
+    // next node once this subtree is done
+    uint miss;
+};
+
+layout (std430, set = INSTANCE_BVH_SET, binding = INSTANCE_BVH_BINDING) readonly buffer InstanceBvhNodes {
+    GpuBvhNode nodes[];
+} bvhNodes;
+
+layout (std430, set = INSTANCE_BVH_SET, binding = INSTANCE_BVH_BINDING + 1) readonly buffer InstanceBvhIndices {
+    uint indices[];
+} bvhIndices;
+
+// mirrors Luxel::InstanceBvh::IntersectBox.
+bool bvhIntersectBox(vec3 boundsMin, vec3 boundsMax, vec3 origin, vec3 invDirection, float tMax, out float entry) {
+    vec3 t0 = (boundsMin - origin) * invDirection;
+    vec3 t1 = (boundsMax - origin) * invDirection;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    entry = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float exit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+    return entry <= exit;
+}
+
+#ifdef BVH_INTERSECT
+// closest instance along the ray before tMax, BVH_INVALID for none. tMax ends at its distance.
+// stackless: nodes are depth first, so a hit steps to the next node and a miss skips the subtree.
+uint bvhTrace(vec3 origin, vec3 direction, inout float tMax) {
+    vec3 invDirection = 1.0 / direction;
+    uint closest = BVH_INVALID;
+    uint nodeCount = uint(bvhNodes.nodes.length());
+    uint node = 0u;
+    while (node < nodeCount) {
+        GpuBvhNode current = bvhNodes.nodes[node];
+        float entry;
+        if (!bvhIntersectBox(current.boundsMin, current.boundsMax, origin, invDirection, tMax, entry)) {
+            node = current.miss;
+            continue;
+        }
+        if (current.leaf == 0u) {
+            node++;
+            continue;
+        }
+        uint first = current.leaf & ((1u << BVH_LEAF_FIRST_BITS) - 1u);
+        uint count = current.leaf >> BVH_LEAF_FIRST_BITS;
+        for (uint i = 0u; i < count; i++) {
+            uint instance = bvhIndices.indices[first + i];
+            float t = BVH_INTERSECT(instance, origin, direction, tMax);
+            if (t < tMax) {
+                tMax = t;
+                closest = instance;
+            }
+        }
+        node = current.miss;
+    }
+    return closest;
+}
+#endif
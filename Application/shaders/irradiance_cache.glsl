@@ -0,0 +1,144 @@
+// world space radiance cache of Luxel::IrradianceCachePass, include after defining IRRADIANCE_CACHE_SET
+// and IRRADIANCE_CACHE_BINDING; bindings + 0, 1, 2 are the constants, entry and stats buffers.
+// keys, hashes and probing mirror Luxel::IrradianceCache, so both sides find the same slots.
+
+#ifndef IRRADIANCE_CACHE_SET
+#define IRRADIANCE_CACHE_SET 0
+#endif
+#ifndef IRRADIANCE_CACHE_BINDING
+#define IRRADIANCE_CACHE_BINDING 0
+#endif
+
+#define IRRADIANCE_CACHE_LEVELS 16u
+#define IRRADIANCE_CACHE_INVALID 0xFFFFFFFFu
+#define IRRADIANCE_CACHE_SALT 0x2545F491u
+
+struct IrradianceCacheEntry {
+    // second hash of the key, 0 for a free slot
+    uint checksum;
+    // frames since the last sample
+    uint age;
+    uvec2 padding;
+    // samples of the current frame: fixed point radiance sum in rgb, count in a
+    uvec4 accumulation;
+    // resolved radiance in rgb, history length in a
+    vec4 radiance;
+};
+
+layout (std430, set = IRRADIANCE_CACHE_SET, binding = IRRADIANCE_CACHE_BINDING) readonly buffer IrradianceCacheConstants {
+    // xyz camera position, w cell size
+    vec4 camera;
+    // levelDistance, fixed point scale, maxRadiance, maxSamples
+    vec4 params;
+    // capacity - 1, probes, minSamples, maxAge
+    uvec4 info;
+} cacheConstants;
+
+layout (std430, set = IRRADIANCE_CACHE_SET, binding = IRRADIANCE_CACHE_BINDING + 1) buffer IrradianceCacheEntries {
+    IrradianceCacheEntry entries[];
+} cacheEntries;
+
+layout (std430, set = IRRADIANCE_CACHE_SET, binding = IRRADIANCE_CACHE_BINDING + 2) buffer IrradianceCacheStats {
+    uint lookups;
+    uint hits;
+    uint inserts;
+    uint failedInserts;
+    uint usedEntries;
+} cacheStats;
+
+uint cacheHash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint cacheHashCombine(uint seed, uint v) {
+    return seed ^ (cacheHash(v) + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+}
+
+// index in x, checksum in y.
+uvec2 cacheKey(vec3 position, vec3 normal) {
+    float distance = length(position - cacheConstants.camera.xyz);
+    uint level = 0u;
+    if (distance > cacheConstants.params.x) {
+        level = min(uint(log2(distance / cacheConstants.params.x)) + 1u, IRRADIANCE_CACHE_LEVELS - 1u);
+    }
+    float size = cacheConstants.camera.w * float(1u << level);
+    ivec3 cell = ivec3(floor((position - normal * (size * 1e-3)) / size));
+
+    vec3 magnitude = abs(normal);
+    uint axis = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0u : (magnitude.y >= magnitude.z ? 1u : 2u);
+    uint face = axis * 2u + (normal[axis] < 0.0 ? 1u : 0u);
+
+    uint hash = cacheHashCombine(cacheHashCombine(cacheHash(uint(cell.x)), uint(cell.y)), uint(cell.z));
+    hash = cacheHashCombine(hash, face | (level << 3));
+    return uvec2(hash & cacheConstants.info.x, max(cacheHash(hash ^ IRRADIANCE_CACHE_SALT), 1u));
+}
+
+uint cacheFind(uvec2 key) {
+    // every probe is looked at, evictions leave holes in the middle of a run
+    for (uint probe = 0u; probe < cacheConstants.info.y; probe++) {
+        uint slot = (key.x + probe) & cacheConstants.info.x;
+        if (cacheEntries.entries[slot].checksum == key.y) {
+            return slot;
+        }
+    }
+    return IRRADIANCE_CACHE_INVALID;
+}
+
+// radiance leaving the surface at position, false when the cell has too few samples.
+bool cacheLookup(vec3 position, vec3 normal, out vec3 radiance) {
+    radiance = vec3(0.0);
+    atomicAdd(cacheStats.lookups, 1u);
+    uint slot = cacheFind(cacheKey(position, normal));
+    if (slot == IRRADIANCE_CACHE_INVALID || cacheEntries.entries[slot].radiance.w < float(cacheConstants.info.z)) {
+        return false;
+    }
+    atomicAdd(cacheStats.hits, 1u);
+    radiance = cacheEntries.entries[slot].radiance.rgb;
+    return true;
+}
+
+// adds one sample, inserting the cell when it is new. false when the table is full around the key.
+bool cacheAccumulate(vec3 position, vec3 normal, vec3 radiance) {
+    uvec2 key = cacheKey(position, normal);
+    // mirrors IrradianceCache::Accumulate: a hole is only claimed when the whole run holds no match,
+    // and the run is scanned again after a lost claim
+    uint slot = IRRADIANCE_CACHE_INVALID;
+    for (uint attempt = 0u; attempt < cacheConstants.info.y && slot == IRRADIANCE_CACHE_INVALID; attempt++) {
+        uint empty = IRRADIANCE_CACHE_INVALID;
+        for (uint probe = 0u; probe < cacheConstants.info.y && slot == IRRADIANCE_CACHE_INVALID; probe++) {
+            uint candidate = (key.x + probe) & cacheConstants.info.x;
+            uint checksum = cacheEntries.entries[candidate].checksum;
+            if (checksum == key.y) {
+                slot = candidate;
+            } else if (checksum == 0u && empty == IRRADIANCE_CACHE_INVALID) {
+                empty = candidate;
+            }
+        }
+        if (slot != IRRADIANCE_CACHE_INVALID || empty == IRRADIANCE_CACHE_INVALID) {
+            break;
+        }
+        uint previous = atomicCompSwap(cacheEntries.entries[empty].checksum, 0u, key.y);
+        if (previous == 0u) {
+            atomicAdd(cacheStats.inserts, 1u);
+            slot = empty;
+        } else if (previous == key.y) {
+            slot = empty;
+        }
+    }
+    if (slot == IRRADIANCE_CACHE_INVALID) {
+        atomicAdd(cacheStats.failedInserts, 1u);
+        return false;
+    }
+
+    uvec3 fixedPoint = uvec3(clamp(radiance, 0.0, cacheConstants.params.z) * cacheConstants.params.y + 0.5);
+    atomicAdd(cacheEntries.entries[slot].accumulation.x, fixedPoint.x);
+    atomicAdd(cacheEntries.entries[slot].accumulation.y, fixedPoint.y);
+    atomicAdd(cacheEntries.entries[slot].accumulation.z, fixedPoint.z);
+    atomicAdd(cacheEntries.entries[slot].accumulation.w, 1u);
+    return true;
+}
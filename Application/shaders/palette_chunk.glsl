@@ -0,0 +1,53 @@
+// palette compressed chunks as stored by Luxel::Chunk, include after defining PALETTE_CHUNK_SET and PALETTE_CHUNK_BINDING.
+// bindings PALETTE_CHUNK_BINDING + 0, 1, 2 hold Luxel::VoxelGpuScene's palette header, word and entry buffers:
+// a GpuPaletteChunk per chunk node pointing at the chunk's GetIndexWords and GetPalette, copied as they are.
+// voxel_scene.glsl includes this with VOXEL_SCENE_PALETTE defined.
+
+#ifndef PALETTE_CHUNK_SET
+#define PALETTE_CHUNK_SET 0
+#endif
+#ifndef PALETTE_CHUNK_BINDING
+#define PALETTE_CHUNK_BINDING 0
+#endif
+
+struct GpuPaletteChunk {
+    uint firstWord;
+    uint firstEntry;
+    // indices are 1 << bitsLog2 bits wide, 5 for chunks storing packed voxels directly
+    uint bitsLog2;
+    uint entries;
+};
+
+layout (std430, set = PALETTE_CHUNK_SET, binding = PALETTE_CHUNK_BINDING) readonly buffer PaletteChunkHeaders {
+    GpuPaletteChunk chunks[];
+} paletteChunks;
+
+layout (std430, set = PALETTE_CHUNK_SET, binding = PALETTE_CHUNK_BINDING + 1) readonly buffer PaletteChunkWords {
+    uint words[];
+} paletteChunkWords;
+
+layout (std430, set = PALETTE_CHUNK_SET, binding = PALETTE_CHUNK_BINDING + 2) readonly buffer PaletteChunkPalettes {
+    uint entries[];
+} paletteChunkPalettes;
+
+// Morton code of a position inside a 32^3 chunk, same order as Chunk storage.
+uint paletteChunkMorton(ivec3 p) {
+    uvec3 u = uvec3(p);
+    u = (u | (u << 8)) & 0x0300F00Fu;
+    u = (u | (u << 4)) & 0x030C30C3u;
+    u = (u | (u << 2)) & 0x09249249u;
+    return u.x | (u.y << 1) | (u.z << 2);
+}
+
+// packed voxel (material | color << 16) at a local position of chunk.
+uint paletteChunkGet(uint chunk, ivec3 local) {
+    GpuPaletteChunk header = paletteChunks.chunks[chunk];
+    uint bit = paletteChunkMorton(local) << header.bitsLog2;
+    uint width = 1u << header.bitsLog2;
+    uint word = paletteChunkWords.words[header.firstWord + (bit >> 5)];
+    if (header.bitsLog2 == 5u) {
+        return word;
+    }
+    uint entry = bitfieldExtract(word, int(bit & 31u), int(width));
+    return paletteChunkPalettes.entries[header.firstEntry + entry];
+}
@@ -0,0 +1,80 @@
+// sample streams of Luxel::Sampler, include after defining SAMPLER_SET and SAMPLER_BINDING.
+// the buffer is Luxel::Sampler::GetGpuData, the seed is Luxel::Sampler::GetFrameSeed,
+// so shaders and the CPU draw bit identical samples.
+
+#ifndef SAMPLER_SET
+#define SAMPLER_SET 0
+#endif
+#ifndef SAMPLER_BINDING
+#define SAMPLER_BINDING 0
+#endif
+
+#define SOBOL_DIMENSIONS 4u
+#define SOBOL_BITS 32u
+
+layout (std430, set = SAMPLER_SET, binding = SAMPLER_BINDING) readonly buffer SamplerData {
+    // tile size, sobol dimensions, sobol bits, 0
+    uvec4 info;
+    uint sobolMatrices[SOBOL_DIMENSIONS * SOBOL_BITS];
+    uint ranks[];
+} samplerData;
+
+uint samplerHash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint samplerHashCombine(uint seed, uint v) {
+    return seed ^ (samplerHash(v) + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+}
+
+uint samplerLaineKarras(uint x, uint seed) {
+    x += seed;
+    x ^= x * 0x6C50B47Cu;
+    x ^= x * 0xB82F1E52u;
+    x ^= x * 0xC7AFE638u;
+    x ^= x * 0x8D22F6E6u;
+    return x;
+}
+
+uint samplerNestedUniformScramble(uint x, uint seed) {
+    return bitfieldReverse(samplerLaineKarras(bitfieldReverse(x), seed));
+}
+
+uint samplerSobol(uint index, uint dimension) {
+    uint result = 0u;
+    for (uint k = 0u; index != 0u; index >>= 1, k++) {
+        if ((index & 1u) != 0u) {
+            result ^= samplerData.sobolMatrices[dimension * SOBOL_BITS + k];
+        }
+    }
+    return result;
+}
+
+uint samplerSobolOwen(uint index, uint dimension, uint seed) {
+    uint group = dimension / SOBOL_DIMENSIONS;
+    uint shuffled = samplerNestedUniformScramble(index, samplerHashCombine(seed, 0xA511E9B3u ^ group));
+    return samplerNestedUniformScramble(samplerSobol(shuffled, dimension % SOBOL_DIMENSIONS), samplerHashCombine(seed, dimension));
+}
+
+float samplerToFloat(uint v) {
+    return float(v >> 8) * (1.0 / 16777216.0);
+}
+
+uint samplerPixelRank(uvec2 pixel) {
+    uint mask = samplerData.info.x - 1u;
+    return samplerData.ranks[(pixel.x & mask) + (pixel.y & mask) * samplerData.info.x];
+}
+
+float samplerGet1D(uvec2 pixel, uint sampleIndex, uint dimension, uint seed) {
+    return samplerToFloat(samplerSobolOwen(sampleIndex ^ samplerPixelRank(pixel), dimension, seed));
+}
+
+vec2 samplerGet2D(uvec2 pixel, uint sampleIndex, uint dimension, uint seed) {
+    uint index = sampleIndex ^ samplerPixelRank(pixel);
+    return vec2(samplerToFloat(samplerSobolOwen(index, dimension, seed)), samplerToFloat(samplerSobolOwen(index, dimension + 1u, seed)));
+}
@@ -0,0 +1,60 @@
+// shared by the svgf_*.comp passes of Luxel::SvgfPass, Luxel::SvgfDenoiser is the CPU reference.
+// illumination buffers hold demodulated radiance in rgb and its variance in a,
+// moment buffers hold the luminance mean, the luminance squared mean and the history length.
+
+#include "gbuffer.glsl"
+
+layout (std430, binding = 0) readonly buffer Frame {
+    mat4 inverseViewProjection;
+    mat4 previousViewProjection;
+    vec4 position;
+    vec4 previousPosition;
+    // width, height, box count, 1 when the history is valid
+    uvec4 extent;
+    // colorAlpha, momentsAlpha, distanceTolerance, normalTolerance
+    vec4 temporal;
+    // phiColor, phiNormal, phiDepth, phiAlbedo
+    vec4 phi;
+    InvalidationBox boxes[];
+} frame;
+
+layout (std430, binding = 1) readonly buffer Current {
+    GBufferTexel texels[];
+} gbuffer;
+
+const float ALBEDO_EPSILON = 1e-3;
+const float WEIGHT_EPSILON = 1e-6;
+
+float svgfLuminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 svgfAlbedo(GBufferTexel texel) {
+    return texel.distance <= 0.0 ? vec3(1.0) : max(texel.albedo, vec3(ALBEDO_EPSILON));
+}
+
+bool svgfInside(ivec2 p) {
+    return all(greaterThanEqual(p, ivec2(0))) && all(lessThan(p, ivec2(frame.extent.xy)));
+}
+
+uint svgfIndex(ivec2 p) {
+    return uint(p.y) * frame.extent.x + uint(p.x);
+}
+
+float svgfDepth(ivec2 p) {
+    return svgfInside(p) ? max(gbuffer.texels[svgfIndex(p)].distance, 0.0) : 0.0;
+}
+
+// smallest depth step to a neighbor per axis, so silhouettes do not widen the depth edge stop
+float svgfDepthGradient(ivec2 p, float d) {
+    const float FAR = 3.402823e38;
+    float left = svgfDepth(p - ivec2(1, 0));
+    float right = svgfDepth(p + ivec2(1, 0));
+    float down = svgfDepth(p - ivec2(0, 1));
+    float up = svgfDepth(p + ivec2(0, 1));
+    float gx = min(left > 0.0 ? abs(left - d) : FAR, right > 0.0 ? abs(right - d) : FAR);
+    float gy = min(down > 0.0 ? abs(down - d) : FAR, up > 0.0 ? abs(up - d) : FAR);
+    gx = gx == FAR ? 0.0 : gx;
+    gy = gy == FAR ? 0.0 : gy;
+    return max(max(gx, gy), d * 1e-3);
+}
@@ -0,0 +1,175 @@
+// emissive voxels of Luxel::VoxelLights, include after defining VOXEL_LIGHTS_SET and VOXEL_LIGHTS_BINDING.
+// bindings VOXEL_LIGHTS_BINDING + 0, 1, 2 hold GetLights, GetAliasTable and GetTree as they are.
+// also holds the reservoir of Luxel::RestirDirect.
+
+#ifndef VOXEL_LIGHTS_SET
+#define VOXEL_LIGHTS_SET 0
+#endif
+#ifndef VOXEL_LIGHTS_BINDING
+#define VOXEL_LIGHTS_BINDING 0
+#endif
+
+#define LIGHT_TREE_LEAF 0x80000000u
+#define LIGHT_INVALID 0xFFFFFFFFu
+#define LIGHTS_PI 3.14159265
+
+struct VoxelLight {
+    vec3 position;
+    float power;
+    vec3 radiance;
+    // exposed faces, bit 2 * axis for the positive side and 2 * axis + 1 for the negative side
+    uint faces;
+};
+
+struct LightTreeNode {
+    vec3 boundsMin;
+    float power;
+    vec3 boundsMax;
+    // first child, or the light index | LIGHT_TREE_LEAF
+    uint child;
+};
+
+layout (std430, set = VOXEL_LIGHTS_SET, binding = VOXEL_LIGHTS_BINDING) readonly buffer VoxelLightList {
+    VoxelLight lights[];
+} lightList;
+
+layout (std430, set = VOXEL_LIGHTS_SET, binding = VOXEL_LIGHTS_BINDING + 1) readonly buffer VoxelLightAlias {
+    // probability, alias
+    uvec2 entries[];
+} lightAlias;
+
+layout (std430, set = VOXEL_LIGHTS_SET, binding = VOXEL_LIGHTS_BINDING + 2) readonly buffer VoxelLightTree {
+    LightTreeNode nodes[];
+} lightTree;
+
+struct LightSample {
+    uint light;
+    float pdf;
+};
+
+uint lightCount() {
+    return uint(lightList.lights.length());
+}
+
+float lightPowerPdf(uint light) {
+    return lightList.lights[light].power / lightTree.nodes[0].power;
+}
+
+// mirrors Luxel::VoxelLights::SamplePower.
+LightSample lightSamplePower(float u) {
+    LightSample result;
+    result.light = LIGHT_INVALID;
+    result.pdf = 0.0;
+    uint count = lightCount();
+    if (count == 0u) {
+        return result;
+    }
+    float scaled = u * float(count);
+    uint bucket = min(uint(scaled), count - 1u);
+    uvec2 entry = lightAlias.entries[bucket];
+    result.light = scaled - float(bucket) < uintBitsToFloat(entry.x) ? bucket : entry.y;
+    result.pdf = lightPowerPdf(result.light);
+    return result;
+}
+
+float lightImportance(LightTreeNode node, vec3 position, vec3 normal) {
+    vec3 support = mix(node.boundsMin, node.boundsMax, greaterThan(normal, vec3(0.0)));
+    if (dot(normal, normal) > 0.0 && dot(normal, support - position) <= 0.0) {
+        return 0.0;
+    }
+    vec3 extent = node.boundsMax - node.boundsMin;
+    vec3 offset = (node.boundsMin + node.boundsMax) * 0.5 - position;
+    return node.power / max(dot(offset, offset), dot(extent, extent) * 0.25);
+}
+
+// mirrors Luxel::VoxelLights::SampleTree, normal may be zero for points in volumes.
+LightSample lightSampleTree(vec3 position, vec3 normal, float u) {
+    LightSample result;
+    result.light = LIGHT_INVALID;
+    result.pdf = 0.0;
+    if (lightCount() == 0u) {
+        return result;
+    }
+    uint node = 0u;
+    float pdf = 1.0;
+    while ((lightTree.nodes[node].child & LIGHT_TREE_LEAF) == 0u) {
+        uint left = lightTree.nodes[node].child;
+        float importanceLeft = lightImportance(lightTree.nodes[left], position, normal);
+        float importanceRight = lightImportance(lightTree.nodes[left + 1u], position, normal);
+        float total = importanceLeft + importanceRight;
+        if (total <= 0.0) {
+            return result;
+        }
+        float probabilityLeft = importanceLeft / total;
+        if (u < probabilityLeft) {
+            u = min(u / probabilityLeft, 0.99999994);
+            node = left;
+            pdf *= probabilityLeft;
+        } else {
+            u = min((u - probabilityLeft) / (1.0 - probabilityLeft), 0.99999994);
+            node = left + 1u;
+            pdf *= 1.0 - probabilityLeft;
+        }
+    }
+    result.light = lightTree.nodes[node].child & ~LIGHT_TREE_LEAF;
+    result.pdf = pdf;
+    return result;
+}
+
+// mirrors Luxel::VoxelLights::Irradiance: unshadowed irradiance onto a surface with normal.
+vec3 lightIrradiance(VoxelLight light, vec3 position, vec3 normal) {
+    vec3 offset = light.position - position;
+    float distanceSquared = dot(offset, offset);
+    if (distanceSquared <= 0.0) {
+        return vec3(0.0);
+    }
+    vec3 direction = offset * inversesqrt(distanceSquared);
+    float cosine = dot(normal, direction);
+    if (cosine <= 0.0) {
+        return vec3(0.0);
+    }
+    float area = 0.0;
+    for (int axis = 0; axis < 3; axis++) {
+        float facing = -direction[axis];
+        uint face = uint(axis * 2) + (facing > 0.0 ? 0u : 1u);
+        if (((light.faces >> face) & 1u) != 0u) {
+            area += abs(facing);
+        }
+    }
+    return light.radiance * (area * cosine / max(distanceSquared, 0.25));
+}
+
+struct Reservoir {
+    uint light;
+    float weightSum;
+    // candidates seen, M
+    float count;
+    // unbiased contribution weight W of light
+    float weight;
+};
+
+Reservoir reservoirEmpty() {
+    return Reservoir(LIGHT_INVALID, 0.0, 0.0, 0.0);
+}
+
+bool reservoirUpdate(inout Reservoir reservoir, uint candidate, float candidateWeight, float u) {
+    reservoir.weightSum += candidateWeight;
+    reservoir.count += 1.0;
+    if (candidateWeight > 0.0 && u * reservoir.weightSum < candidateWeight) {
+        reservoir.light = candidate;
+        return true;
+    }
+    return false;
+}
+
+// targetPdf is the target of other's light at the receiving pixel.
+bool reservoirMerge(inout Reservoir reservoir, Reservoir other, float targetPdf, float u) {
+    float previousCount = reservoir.count;
+    bool chosen = reservoirUpdate(reservoir, other.light, targetPdf * other.weight * other.count, u);
+    reservoir.count = previousCount + other.count;
+    return chosen;
+}
+
+void reservoirFinalize(inout Reservoir reservoir, float targetPdf) {
+    reservoir.weight = targetPdf > 0.0 && reservoir.count > 0.0 ? reservoir.weightSum / (reservoir.count * targetPdf) : 0.0;
+}
@@ -0,0 +1,150 @@
+// shared voxel models of Luxel::VoxelModelLibrary, include after defining VOXEL_MODELS_SET and VOXEL_MODELS_BINDING.
+// bindings VOXEL_MODELS_BINDING + 0 to 3 hold GetModels, GetBrickRefs, GetBrickPool and GetPalettes as they are,
+// + 4 the placements from VoxelModelLibrary::MakeGpuInstance.
+// modelIntersect fits BVH_INTERSECT of instance_bvh.glsl, modelTrace fetches the hit details of the closest one.
+
+#ifndef VOXEL_MODELS_SET
+#define VOXEL_MODELS_SET 0
+#endif
+#ifndef VOXEL_MODELS_BINDING
+#define VOXEL_MODELS_BINDING 0
+#endif
+
+#define MODEL_INVALID 0xFFFFFFFFu
+#define MODEL_PALETTE_SIZE 256u
+#define MODEL_MAX_STEPS 4096u
+
+struct GpuVoxelModel {
+    // zero for removed models
+    ivec3 size;
+    uint firstBrick;
+    ivec3 bricks;
+    uint solidBricks;
+};
+
+struct GpuModelInstance {
+    // world to model space, the rotation divided by the scale
+    vec4 rows[3];
+    uint model;
+    uint palette;
+    float scale;
+    uint padding;
+};
+
+layout (std430, set = VOXEL_MODELS_SET, binding = VOXEL_MODELS_BINDING) readonly buffer VoxelModels {
+    GpuVoxelModel models[];
+} voxelModels;
+
+layout (std430, set = VOXEL_MODELS_SET, binding = VOXEL_MODELS_BINDING + 1) readonly buffer VoxelModelBrickRefs {
+    uint refs[];
+} modelBrickRefs;
+
+layout (std430, set = VOXEL_MODELS_SET, binding = VOXEL_MODELS_BINDING + 2) readonly buffer VoxelModelBricks {
+    uint voxels[];
+} modelBricks;
+
+layout (std430, set = VOXEL_MODELS_SET, binding = VOXEL_MODELS_BINDING + 3) readonly buffer VoxelModelPalettes {
+    uint entries[];
+} modelPalettes;
+
+layout (std430, set = VOXEL_MODELS_SET, binding = VOXEL_MODELS_BINDING + 4) readonly buffer VoxelModelInstances {
+    GpuModelInstance instances[];
+} modelInstances;
+
+// Morton code of a position inside a brick, same order as Chunk voxels.
+uint modelBrickMorton(ivec3 p) {
+    uvec3 u = uvec3(p);
+    uvec3 s = (u & 1u) | ((u & 2u) << 2) | ((u & 4u) << 4);
+    return s.x | (s.y << 1) | (s.z << 2);
+}
+
+// mirrors Luxel::VoxelModelLibrary::Remap on packed voxels.
+uint modelRemap(uint palette, uint voxel) {
+    uint material = voxel & 0xFFFFu;
+    uint index = palette * MODEL_PALETTE_SIZE + material;
+    if (material >= MODEL_PALETTE_SIZE || index >= uint(modelPalettes.entries.length())) {
+        return voxel;
+    }
+    uint entry = modelPalettes.entries[index];
+    return entry != 0u ? entry : voxel;
+}
+
+// mirrors Luxel::VoxelModelLibrary::Trace in model space. returns the hit distance or tMax and beyond,
+// with the packed voxel before the remap and the model space normal.
+float modelTraceLocal(uint model, vec3 origin, vec3 direction, float tMax, out uint voxel, out ivec3 cell, out vec3 normal) {
+    voxel = 0u;
+    cell = ivec3(0);
+    normal = vec3(0.0);
+    GpuVoxelModel m = voxelModels.models[model];
+    vec3 invDirection = 1.0 / direction;
+    vec3 t0 = (vec3(0.0) - origin) * invDirection;
+    vec3 t1 = (vec3(m.size) - origin) * invDirection;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float tExit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+    if (m.size.x == 0 || tEnter > tExit) {
+        return tMax;
+    }
+
+    int entryAxis = tEnter > 0.0 ? (tEnter == tNear.x ? 0 : (tEnter == tNear.y ? 1 : 2)) : -1;
+    float t = tEnter;
+    float entry = tEnter;
+    for (uint step = 0u; step < MODEL_MAX_STEPS && t <= tExit; step++) {
+        ivec3 p = clamp(ivec3(floor(origin + direction * t)), ivec3(0), m.size - 1);
+        ivec3 brick = p >> 3;
+        uint slot = modelBrickRefs.refs[m.firstBrick + uint(brick.x + m.bricks.x * (brick.y + m.bricks.y * brick.z))];
+        ivec3 boxMin, boxMax;
+        if (slot == MODEL_INVALID) {
+            boxMin = brick * 8;
+            boxMax = boxMin + 8;
+        } else {
+            uint packed = modelBricks.voxels[slot * 512u + modelBrickMorton(p & 7)];
+            if (packed != 0u) {
+                voxel = packed;
+                cell = p;
+                if (entryAxis >= 0) {
+                    normal[entryAxis] = direction[entryAxis] > 0.0 ? -1.0 : 1.0;
+                }
+                return entry;
+            }
+            boxMin = p;
+            boxMax = p + 1;
+        }
+        vec3 bounds = mix(vec3(boxMin), vec3(boxMax), greaterThan(direction, vec3(0.0)));
+        // axes the ray runs parallel to never exit
+        vec3 exits = mix((bounds - origin) * invDirection, vec3(1e30), equal(direction, vec3(0.0)));
+        entry = min(min(exits.x, exits.y), exits.z);
+        entryAxis = entry == exits.x ? 0 : (entry == exits.y ? 1 : 2);
+        t = entry + 1e-4 * max(1.0, entry);
+    }
+    return tMax;
+}
+
+vec3 modelToLocal(GpuModelInstance instance, vec4 p) {
+    return vec3(dot(instance.rows[0], p), dot(instance.rows[1], p), dot(instance.rows[2], p));
+}
+
+// world space ray against a placement, distances stay in world units.
+float modelIntersect(uint instance, vec3 origin, vec3 direction, float tMax) {
+    GpuModelInstance placement = modelInstances.instances[instance];
+    uint voxel;
+    ivec3 cell;
+    vec3 normal;
+    return modelTraceLocal(placement.model, modelToLocal(placement, vec4(origin, 1.0)),
+        modelToLocal(placement, vec4(direction, 0.0)), tMax, voxel, cell, normal);
+}
+
+// as modelIntersect, with the remapped packed voxel and the world space normal.
+float modelTrace(uint instance, vec3 origin, vec3 direction, float tMax, out uint voxel, out vec3 normal) {
+    GpuModelInstance placement = modelInstances.instances[instance];
+    ivec3 cell;
+    vec3 localNormal;
+    float t = modelTraceLocal(placement.model, modelToLocal(placement, vec4(origin, 1.0)),
+        modelToLocal(placement, vec4(direction, 0.0)), tMax, voxel, cell, localNormal);
+    voxel = modelRemap(placement.palette, voxel);
+    // the rows are the columns of R divided by the scale
+    normal = (placement.rows[0].xyz * localNormal.x + placement.rows[1].xyz * localNormal.y
+        + placement.rows[2].xyz * localNormal.z) * placement.scale;
+    return t;
+}
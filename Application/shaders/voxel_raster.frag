@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragNormal;
+layout (location = 2) in float fragAO;
+
+layout (location = 0) out vec4 outColor;
+
+const vec3 lightDirection = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+    float diffuse = max(dot(fragNormal, lightDirection), 0.0);
+    float occlusion = mix(0.35, 1.0, fragAO);
+    vec3 color = fragColor * (0.3 + 0.7 * diffuse) * occlusion;
+    outColor = vec4(color, 1.0);
+}
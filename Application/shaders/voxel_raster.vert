@@ -0,0 +1,45 @@
+#version 450
+
+layout (location = 0) in uint inPosition;
+layout (location = 1) in uint inAttributes;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragNormal;
+layout (location = 2) out float fragAO;
+
+layout (push_constant) uniform Push {
+    mat4 viewProjection;
+    ivec4 chunkOrigin;
+} push;
+
+const vec3 normals[6] = vec3[](
+    vec3(1.0, 0.0, 0.0),
+    vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 0.0, -1.0)
+);
+
+vec3 unpackColor(uint color) {
+    return vec3(
+        float((color >> 11) & 31u) / 31.0,
+        float((color >> 5) & 63u) / 63.0,
+        float(color & 31u) / 31.0
+    );
+}
+
+void main() {
+    vec3 position = vec3(
+        float(inPosition & 63u),
+        float((inPosition >> 6) & 63u),
+        float((inPosition >> 12) & 63u)
+    );
+    uint normal = (inPosition >> 18) & 7u;
+    uint ao = (inPosition >> 21) & 3u;
+
+    gl_Position = push.viewProjection * vec4(position + vec3(push.chunkOrigin.xyz), 1.0);
+    fragColor = unpackColor(inAttributes >> 16);
+    fragNormal = normals[normal];
+    fragAO = float(ao) / 3.0;
+}
@@ -0,0 +1,189 @@
+// GPU voxel scene written by Luxel::VoxelGpuScene, include after defining VOXEL_SCENE_SET
+// (and VOXEL_SCENE_MANHATTAN when the distance field uses manhattan distance).
+// chunks are 32^3 voxels split into 4^3 bricks of 8^3, voxels are packed as material | color << 16.
+// define VOXEL_SCENE_PALETTE for scenes with paletteChunks set: bindings 2, 3 and 4 then hold the
+// palette headers, words and entries of palette_chunk.glsl instead of the brick pool.
+
+#ifndef VOXEL_SCENE_SET
+#define VOXEL_SCENE_SET 0
+#endif
+
+#define VOXEL_SCENE_INVALID 0xFFFFFFFFu
+
+struct ChunkNode {
+    ivec4 coord;
+    uvec4 info;
+    uint brickSlots[64];
+    // 8 bit distances to the nearest solid brick, 4 per word
+    uint brickDistances[16];
+};
+
+layout (std430, set = VOXEL_SCENE_SET, binding = 0) readonly buffer VoxelSceneHash {
+    // header.x is the table mask
+    ivec4 header;
+    ivec4 entries[];
+} sceneHash;
+
+layout (std430, set = VOXEL_SCENE_SET, binding = 1) readonly buffer VoxelSceneNodes {
+    ChunkNode nodes[];
+} sceneNodes;
+
+#ifdef VOXEL_SCENE_PALETTE
+#define PALETTE_CHUNK_SET VOXEL_SCENE_SET
+#define PALETTE_CHUNK_BINDING 2
+#include "palette_chunk.glsl"
+#else
+layout (std430, set = VOXEL_SCENE_SET, binding = 2) readonly buffer VoxelSceneBricks {
+    uint voxels[];
+} sceneBricks;
+#endif
+
+uint sceneHashChunk(ivec3 coord) {
+    return (uint(coord.x) * 73856093u) ^ (uint(coord.y) * 19349663u) ^ (uint(coord.z) * 83492791u);
+}
+
+// Morton code of a position inside a brick, bricks are stored in the same order as Chunk voxels.
+uint sceneBrickMorton(ivec3 p) {
+    uvec3 u = uvec3(p);
+    uvec3 s = (u & 1u) | ((u & 2u) << 2) | ((u & 4u) << 4);
+    return s.x | (s.y << 1) | (s.z << 2);
+}
+
+uint sceneFindChunk(ivec3 coord) {
+    uint mask = uint(sceneHash.header.x);
+    uint index = sceneHashChunk(coord) & mask;
+    for (uint probe = 0u; probe <= mask; probe++) {
+        ivec4 entry = sceneHash.entries[index];
+        if (uint(entry.w) == VOXEL_SCENE_INVALID) {
+            return VOXEL_SCENE_INVALID;
+        }
+        if (entry.xyz == coord) {
+            return uint(entry.w);
+        }
+        index = (index + 1u) & mask;
+    }
+    return VOXEL_SCENE_INVALID;
+}
+
+bool sceneBrickSolid(uint node, uint brick) {
+    uint bits = brick < 32u ? sceneNodes.nodes[node].info.x : sceneNodes.nodes[node].info.y;
+    return ((bits >> (brick & 31u)) & 1u) != 0u;
+}
+
+// packed voxel at a local position of a solid brick.
+uint sceneBrickVoxel(uint node, uint brick, ivec3 local) {
+#ifdef VOXEL_SCENE_PALETTE
+    return paletteChunkGet(node, local);
+#else
+    return sceneBricks.voxels[sceneNodes.nodes[node].brickSlots[brick] * 512u + sceneBrickMorton(local & 7)];
+#endif
+}
+
+// returns the packed voxel at a world voxel position, 0 for air.
+uint sceneGetVoxel(ivec3 position) {
+    uint node = sceneFindChunk(position >> 5);
+    if (node == VOXEL_SCENE_INVALID) {
+        return 0u;
+    }
+    ivec3 local = position & 31;
+    ivec3 brick = local >> 3;
+    uint index = uint(brick.x + brick.y * 4 + brick.z * 16);
+    if (!sceneBrickSolid(node, index)) {
+        return 0u;
+    }
+    return sceneBrickVoxel(node, index, local);
+}
+
+uint sceneBrickDistance(uint node, uint brick) {
+    return (sceneNodes.nodes[node].brickDistances[brick >> 2] >> ((brick & 3u) * 8u)) & 0xFFu;
+}
+
+uint sceneBoxRadius(uint distance) {
+#ifdef VOXEL_SCENE_MANHATTAN
+    return (distance - 1u) / 3u;
+#else
+    return distance - 1u;
+#endif
+}
+
+struct SceneHit {
+    bool hit;
+    ivec3 voxel;
+    ivec3 normal;
+    float distance;
+    uint value;
+    uint steps;
+};
+
+// mirrors Luxel::VoxelRaycast::Trace: absent chunks, empty bricks and the distance field boxes
+// are crossed in one step each, voxels are only visited inside solid bricks.
+SceneHit sceneTrace(vec3 origin, vec3 direction, float maxDistance) {
+    SceneHit result;
+    result.hit = false;
+    result.voxel = ivec3(0);
+    result.normal = ivec3(0);
+    result.distance = 0.0;
+    result.value = 0u;
+    result.steps = 0u;
+
+    vec3 invDirection = vec3(
+        direction.x != 0.0 ? 1.0 / direction.x : 0.0,
+        direction.y != 0.0 ? 1.0 / direction.y : 0.0,
+        direction.z != 0.0 ? 1.0 / direction.z : 0.0);
+
+    float t = 0.0;
+    float entry = 0.0;
+    int entryAxis = -1;
+    // the cell is judged by where the ray enters it, t is only nudged past that to look it up
+    while (entry <= maxDistance && result.steps < 4096u) {
+        ivec3 voxel = ivec3(floor(origin + direction * t));
+        ivec3 boxMin;
+        ivec3 boxMax;
+
+        uint node = sceneFindChunk(voxel >> 5);
+        if (node == VOXEL_SCENE_INVALID) {
+            boxMin = (voxel >> 5) * 32;
+            boxMax = boxMin + 32;
+        } else {
+            ivec3 local = voxel & 31;
+            ivec3 brickCoord = local >> 3;
+            uint brick = uint(brickCoord.x + brickCoord.y * 4 + brickCoord.z * 16);
+            if (sceneBrickSolid(node, brick)) {
+                uint value = sceneBrickVoxel(node, brick, local);
+                if ((value & 0xFFFFu) != 0u) {
+                    result.hit = true;
+                    result.voxel = voxel;
+                    result.distance = entry;
+                    result.value = value;
+                    if (entryAxis >= 0) {
+                        result.normal[entryAxis] = direction[entryAxis] > 0.0 ? -1 : 1;
+                    }
+                    return result;
+                }
+                boxMin = voxel;
+                boxMax = voxel + 1;
+            } else {
+                uint distance = sceneBrickDistance(node, brick);
+                int radius = distance > 0u ? int(sceneBoxRadius(distance)) : 0;
+                boxMin = ((voxel >> 3) - radius) * 8;
+                boxMax = ((voxel >> 3) + radius + 1) * 8;
+            }
+        }
+
+        entry = 3.402823e38;
+        for (int i = 0; i < 3; i++) {
+            if (direction[i] == 0.0) {
+                continue;
+            }
+            float bound = float(direction[i] > 0.0 ? boxMax[i] : boxMin[i]);
+            float exitT = (bound - origin[i]) * invDirection[i];
+            if (exitT < entry) {
+                entry = exitT;
+                entryAxis = i;
+            }
+        }
+        t = entry + 1e-4 * max(1.0, entry);
+        result.steps++;
+    }
+    return result;
+}
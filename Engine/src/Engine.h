@@ -1,10 +1,57 @@
 #pragma once
 
 #include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "EngineCore/Epoch.h"
 
 #include "EngineCore/Device.h"
 #include "EngineCore/SwapChain.h"
 #include "EngineCore/RenderPipeline.h"
+#include "EngineCore/Buffer.h"
+#include "EngineCore/ComputePipeline.h"
+#include "EngineCore/RadixSort.h"
+
+#include "Voxel/Voxel.h"
+#include "Voxel/Morton.h"
+#include "Voxel/Chunk.h"
+#include "Voxel/ChunkMap.h"
+#include "Voxel/VoxelWorld.h"
+#include "Voxel/MeshLoader.h"
+#include "Voxel/Voxelizer.h"
+#include "Voxel/GreedyMesher.h"
+#include "Voxel/VoxelEditor.h"
+#include "Voxel/VoxelLod.h"
+#include "Voxel/VoxelDistanceField.h"
+#include "Voxel/VoxelRaycast.h"
+#include "Voxel/VoxelQuery.h"
+#include "Voxel/ColumnChunk.h"
+#include "Voxel/VoxelColdStorage.h"
+#include "Voxel/VoxelSnapshots.h"
+#include "Voxel/Noise.h"
+#include "Voxel/TerrainGenerator.h"
+#include "Voxel/VoxelConnectivity.h"
+
+#include "Renderer/VoxelRasterizer.h"
+#include "Renderer/VoxelGpuScene.h"
+#include "Renderer/GBuffer.h"
+#include "Renderer/HistoryInvalidator.h"
+#include "Renderer/TemporalAccumulator.h"
+#include "Renderer/TemporalAccumulationPass.h"
+#include "Renderer/SvgfDenoiser.h"
+#include "Renderer/SvgfPass.h"
+#include "Renderer/Sampler.h"
+#include "Renderer/AdaptiveSampler.h"
+#include "Renderer/VoxelLights.h"
+#include "Renderer/Restir.h"
+#include "Renderer/IrradianceCache.h"
+#include "Renderer/IrradianceCachePass.h"
+#include "Renderer/VoxelMedium.h"
+#include "Renderer/RaySorter.h"
+#include "Renderer/InstanceBvh.h"
+#include "Renderer/VoxelModels.h"
+#include "Renderer/VoxelBlockLight.h"
+
+#include "Scene/Scene.h"
 
 #include "EngineCore/Application.h"
 
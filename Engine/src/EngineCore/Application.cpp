@@ -30,6 +30,9 @@ namespace Luxel
 		// destory device
 		delete device;
 
+		// stop worker threads
+		JobSystem::Shutdown();
+
 		// destory glfw window
 		Info("Destory GLFW Window and Terminate.");
 		glfwDestroyWindow(window);
@@ -49,6 +52,9 @@ namespace Luxel
 			Debug("avaliable extension:", extension.extensionName);
 		}
 
+		// start worker threads
+		JobSystem::Init();
+
 		// glfw init.
 		Info("Init GLFW window.");
 		glfwInit();
@@ -5,6 +5,7 @@
 #include "Core.h"
 
 #include "log.h"
+#include "JobSystem.h"
 #include "RenderPipeline.h"
 #include "Device.h"
 #include "SwapChain.h"
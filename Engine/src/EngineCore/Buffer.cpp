@@ -0,0 +1,85 @@
+#include "pch.h"
+
+#include "Buffer.h"
+
+namespace Luxel
+{
+	Buffer::Buffer(Device* const d, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) :
+		device{ d }, buffer{ VK_NULL_HANDLE }, memory{ VK_NULL_HANDLE }, size{ size }, memoryProperties{ properties }, mapped{ nullptr }
+	{
+		if (size == 0) {
+			Error("Cannot create buffer: size is zero.");
+			throw std::runtime_error("Cannot create buffer: size is zero.");
+		}
+		device->CreateBuffer(size, usage, properties, buffer, memory);
+	}
+
+	Buffer::~Buffer()
+	{
+		Unmap();
+		vkDestroyBuffer(device->GetDevice(), buffer, nullptr);
+		vkFreeMemory(device->GetDevice(), memory, nullptr);
+	}
+
+	void* Buffer::Map()
+	{
+		if (mapped != nullptr) {
+			return mapped;
+		}
+		if ((memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) {
+			Error("Cannot map buffer: memory is not host visible.");
+			throw std::runtime_error("Cannot map buffer: memory is not host visible.");
+		}
+		if (vkMapMemory(device->GetDevice(), memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+			Error("Failed to map buffer memory.");
+			throw std::runtime_error("Failed to map buffer memory.");
+		}
+		return mapped;
+	}
+
+	void Buffer::Unmap()
+	{
+		if (mapped != nullptr) {
+			vkUnmapMemory(device->GetDevice(), memory);
+			mapped = nullptr;
+		}
+	}
+
+	void Buffer::WriteToBuffer(const void* data, VkDeviceSize writeSize, VkDeviceSize offset)
+	{
+		if (offset + writeSize > size) {
+			Error("Buffer write out of range.");
+			throw std::runtime_error("Buffer write out of range.");
+		}
+		std::memcpy(static_cast<char*>(Map()) + offset, data, static_cast<size_t>(writeSize));
+	}
+
+	void Buffer::Upload(const void* data, VkDeviceSize uploadSize, VkDeviceSize offset)
+	{
+		if (offset + uploadSize > size) {
+			Error("Buffer upload out of range.");
+			throw std::runtime_error("Buffer upload out of range.");
+		}
+
+		Buffer staging{
+			device,
+			uploadSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		};
+		staging.WriteToBuffer(data, uploadSize);
+		staging.Unmap();
+
+		device->CopyBuffer(staging.GetBuffer(), buffer, uploadSize, 0, offset);
+	}
+
+	VkBuffer Buffer::GetBuffer() const
+	{
+		return buffer;
+	}
+
+	VkDeviceSize Buffer::GetSize() const
+	{
+		return size;
+	}
+}
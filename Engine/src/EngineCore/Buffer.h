@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core.h"
+
+#include "log.h"
+#include "Device.h"
+
+namespace Luxel
+{
+	class LUXEL_API Buffer
+	{
+	public:
+		Buffer(Device* const d, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		~Buffer();
+		Buffer(const Buffer&) = delete;
+		void operator=(const Buffer&) = delete;
+
+		// host visible buffers only.
+		void* Map();
+		void Unmap();
+		void WriteToBuffer(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+		// device local buffers: copies through a temporary staging buffer and waits for completion.
+		void Upload(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+		VkBuffer GetBuffer() const;
+		VkDeviceSize GetSize() const;
+
+	private:
+		Device* const device;
+
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		VkMemoryPropertyFlags memoryProperties;
+		void* mapped;
+	};
+}
@@ -0,0 +1,190 @@
+#include "pch.h"
+
+#include "ComputePipeline.h"
+
+namespace Luxel
+{
+	ComputePipeline::ComputePipeline(Device* const d, const std::string& compPath, ui32 storageBufferCount, ui32 pushConstantSize, ui32 maxSets) :
+		device{ d }, storageBufferCount{ storageBufferCount }, pushConstantSize{ pushConstantSize }
+	{
+		CreateDescriptorSetLayout();
+		CreatePipelineLayout();
+		CreateDescriptorPool(maxSets);
+		CreateComputePipeline(compPath);
+	}
+
+	ComputePipeline::~ComputePipeline()
+	{
+		Info("Destroy compute pipeline.");
+		vkDestroyPipeline(device->GetDevice(), computePipeline, nullptr);
+		vkDestroyShaderModule(device->GetDevice(), compShaderModule, nullptr);
+		vkDestroyDescriptorPool(device->GetDevice(), descriptorPool, nullptr);
+		vkDestroyPipelineLayout(device->GetDevice(), pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->GetDevice(), descriptorSetLayout, nullptr);
+	}
+
+	VkDescriptorSet ComputePipeline::AllocateDescriptorSet()
+	{
+		VkDescriptorSetAllocateInfo allocateInfo{};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocateInfo.descriptorPool = descriptorPool;
+		allocateInfo.descriptorSetCount = 1;
+		allocateInfo.pSetLayouts = &descriptorSetLayout;
+
+		VkDescriptorSet descriptorSet;
+		if (vkAllocateDescriptorSets(device->GetDevice(), &allocateInfo, &descriptorSet) != VK_SUCCESS) {
+			Error("Failed to allocate compute descriptor set.");
+			throw std::runtime_error("Failed to allocate compute descriptor set.");
+		}
+		return descriptorSet;
+	}
+
+	void ComputePipeline::UpdateDescriptorSet(VkDescriptorSet descriptorSet, const std::vector<VkBuffer>& buffers)
+	{
+		if (buffers.size() != storageBufferCount) {
+			Error("Compute descriptor set expects", storageBufferCount, "buffers, got", buffers.size());
+			throw std::runtime_error("Compute descriptor set buffer count mismatch.");
+		}
+
+		std::vector<VkDescriptorBufferInfo> bufferInfos(buffers.size());
+		std::vector<VkWriteDescriptorSet> writes(buffers.size());
+		for (size_t i = 0;i < buffers.size();i++) {
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			writes[i] = VkWriteDescriptorSet{};
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSet;
+			writes[i].dstBinding = static_cast<ui32>(i);
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device->GetDevice(), static_cast<ui32>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void ComputePipeline::Bind(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	}
+
+	void ComputePipeline::PushConstants(VkCommandBuffer commandBuffer, const void* data)
+	{
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize, data);
+	}
+
+	void ComputePipeline::Dispatch(VkCommandBuffer commandBuffer, ui32 groupCountX, ui32 groupCountY, ui32 groupCountZ)
+	{
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+	}
+
+	void ComputePipeline::MemoryBarrier(VkCommandBuffer commandBuffer)
+	{
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	VkPipelineLayout ComputePipeline::GetPipelineLayout() const
+	{
+		return pipelineLayout;
+	}
+
+	void ComputePipeline::CreateDescriptorSetLayout()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(storageBufferCount);
+		for (ui32 i = 0;i < storageBufferCount;i++) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = storageBufferCount;
+		layoutInfo.pBindings = bindings.empty() ? nullptr : bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device->GetDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+			Error("Failed to create compute descriptor set layout.");
+			throw std::runtime_error("Failed to create compute descriptor set layout.");
+		}
+	}
+
+	void ComputePipeline::CreatePipelineLayout()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantSize > 0 ? &pushConstantRange : nullptr;
+
+		if (vkCreatePipelineLayout(device->GetDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			Error("Failed to create compute pipeline layout.");
+			throw std::runtime_error("Failed to create compute pipeline layout.");
+		}
+	}
+
+	void ComputePipeline::CreateDescriptorPool(ui32 maxSets)
+	{
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = std::max(storageBufferCount, 1u) * maxSets;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = maxSets;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		if (vkCreateDescriptorPool(device->GetDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			Error("Failed to create compute descriptor pool.");
+			throw std::runtime_error("Failed to create compute descriptor pool.");
+		}
+	}
+
+	void ComputePipeline::CreateComputePipeline(const std::string& compPath)
+	{
+		Info("Create compute pipeline:", compPath);
+		auto comp = RenderPipeline::readFile(compPath);
+
+		VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+		shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shaderModuleCreateInfo.codeSize = comp.size();
+		shaderModuleCreateInfo.pCode = reinterpret_cast<const ui32*>(comp.data());
+		if (vkCreateShaderModule(device->GetDevice(), &shaderModuleCreateInfo, nullptr, &compShaderModule) != VK_SUCCESS) {
+			Error("Failed to create shader module.");
+			throw std::runtime_error("Failed to create shader module.");
+		}
+
+		VkComputePipelineCreateInfo pipelineCreateInfo{};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCreateInfo.stage.module = compShaderModule;
+		pipelineCreateInfo.stage.pName = "main";
+		pipelineCreateInfo.layout = pipelineLayout;
+		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineCreateInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(device->GetDevice(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			Error("Failed to create compute pipeline.");
+			throw std::runtime_error("Failed to create compute pipeline.");
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core.h"
+
+#include "log.h"
+#include "Device.h"
+#include "RenderPipeline.h"
+
+namespace Luxel
+{
+	// a compute shader whose set 0 holds storage buffers at bindings 0..storageBufferCount-1,
+	// plus one optional push constant block.
+	class LUXEL_API ComputePipeline
+	{
+	public:
+		ComputePipeline(Device* const d, const std::string& compPath, ui32 storageBufferCount, ui32 pushConstantSize, ui32 maxSets = MAX_FRAMES_IN_FLIGHT);
+		~ComputePipeline();
+		ComputePipeline(const ComputePipeline&) = delete;
+		void operator=(const ComputePipeline&) = delete;
+
+		VkDescriptorSet AllocateDescriptorSet();
+		// buffers[i] is bound whole at binding i.
+		void UpdateDescriptorSet(VkDescriptorSet descriptorSet, const std::vector<VkBuffer>& buffers);
+
+		void Bind(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet);
+		void PushConstants(VkCommandBuffer commandBuffer, const void* data);
+		void Dispatch(VkCommandBuffer commandBuffer, ui32 groupCountX, ui32 groupCountY, ui32 groupCountZ = 1);
+
+		// makes shader and transfer writes visible to the shader and transfer reads that follow.
+		static void MemoryBarrier(VkCommandBuffer commandBuffer);
+
+		VkPipelineLayout GetPipelineLayout() const;
+
+	private:
+		void CreateDescriptorSetLayout();
+		void CreatePipelineLayout();
+		void CreateDescriptorPool(ui32 maxSets);
+		void CreateComputePipeline(const std::string& compPath);
+
+		Device* const device;
+		ui32 storageBufferCount;
+		ui32 pushConstantSize;
+
+		VkShaderModule compShaderModule;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkDescriptorPool descriptorPool;
+		VkPipeline computePipeline;
+	};
+}
@@ -13,8 +13,19 @@
 
 #define MAX_FRAMES_IN_FLIGHT 2
 
+#ifdef __AVX2__
+	#define LUXEL_SIMD_AVX2
+#endif
+
+// msvc has no __BMI2__, every /arch:AVX2 target has BMI2 as well.
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+	#define LUXEL_SIMD_BMI2
+#endif
+
 #define ui32 uint32_t
 #define ui16 uint16_t
+#define ui64 uint64_t
+#define ui8 uint8_t
 
 #define Debug(...) Luxel::LogSystem::DEBUG(__VA_ARGS__)
 #define Info(...) Luxel::LogSystem::INFO(__VA_ARGS__)
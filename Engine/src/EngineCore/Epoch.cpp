@@ -0,0 +1,150 @@
+#include "pch.h"
+
+#include "Epoch.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui64 IDLE_EPOCH = ~0ull;
+		constexpr ui32 NO_SLOT = ~0u;
+
+		// one cache line per thread so announcing never touches another thread's line.
+		struct alignas(64) EpochSlot
+		{
+			std::atomic<ui64> epoch{ IDLE_EPOCH };
+			std::atomic<bool> used{ false };
+		};
+
+		struct Retired
+		{
+			void* object;
+			void (*destroy)(void*);
+			ui64 epoch;
+		};
+
+		EpochSlot slots[EPOCH_MAX_THREADS];
+		std::atomic<ui32> slotCount{ 0 };
+		std::atomic<ui64> globalEpoch{ 0 };
+		std::mutex retiredMutex;
+		std::vector<Retired> retired;
+
+		// the slot is handed back when the thread exits.
+		struct ThreadEpoch
+		{
+			ui32 slot = NO_SLOT;
+			ui32 depth = 0;
+
+			~ThreadEpoch()
+			{
+				if (slot != NO_SLOT) {
+					slots[slot].epoch.store(IDLE_EPOCH, std::memory_order_release);
+					slots[slot].used.store(false, std::memory_order_release);
+				}
+			}
+		};
+
+		thread_local ThreadEpoch threadEpoch;
+
+		ui32 AcquireSlot()
+		{
+			for (ui32 i = 0;i < EPOCH_MAX_THREADS;i++) {
+				bool expected = false;
+				if (!slots[i].used.load(std::memory_order_relaxed) && slots[i].used.compare_exchange_strong(expected, true)) {
+					ui32 count = slotCount.load();
+					while (count < i + 1 && !slotCount.compare_exchange_weak(count, i + 1)) {
+					}
+					return i;
+				}
+			}
+			Error("More than", EPOCH_MAX_THREADS, "threads entered an epoch.");
+			throw std::runtime_error("Out of epoch slots.");
+		}
+	}
+
+	Epoch::Epoch()
+	{
+
+	}
+
+	Epoch::~Epoch()
+	{
+
+	}
+
+	void Epoch::Enter()
+	{
+		ThreadEpoch& thread = threadEpoch;
+		if (thread.depth++ != 0) {
+			return;
+		}
+		if (thread.slot == NO_SLOT) {
+			thread.slot = AcquireSlot();
+		}
+		// a stale epoch is harmless, anything retired after this store is unreachable for the loads anyway.
+		slots[thread.slot].epoch.store(globalEpoch.load(std::memory_order_relaxed));
+		// orders the announcement before every load made inside the guard, pairs with the fence in Collect
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	void Epoch::Exit()
+	{
+		ThreadEpoch& thread = threadEpoch;
+		if (--thread.depth == 0) {
+			slots[thread.slot].epoch.store(IDLE_EPOCH, std::memory_order_release);
+		}
+	}
+
+	bool Epoch::IsPinned()
+	{
+		return threadEpoch.depth != 0;
+	}
+
+	void Epoch::Retire(void* object, void (*destroy)(void*))
+	{
+		// threads announced at or before this epoch may still hold object.
+		ui64 epoch = globalEpoch.fetch_add(1);
+		bool collect;
+		{
+			std::lock_guard<std::mutex> lock(retiredMutex);
+			retired.push_back({ object, destroy, epoch });
+			collect = retired.size() >= EPOCH_COLLECT_THRESHOLD;
+		}
+		if (collect) {
+			Collect();
+		}
+	}
+
+	size_t Epoch::Collect()
+	{
+		// unlinking came before this, so a reader the scan misses loads only the new pointers
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		ui64 oldest = IDLE_EPOCH;
+		ui32 count = slotCount.load();
+		for (ui32 i = 0;i < count;i++) {
+			oldest = std::min(oldest, slots[i].epoch.load());
+		}
+
+		std::vector<Retired> ready;
+		size_t pending;
+		{
+			std::lock_guard<std::mutex> lock(retiredMutex);
+			auto split = std::partition(retired.begin(), retired.end(), [oldest](const Retired& r) { return r.epoch >= oldest; });
+			ready.assign(split, retired.end());
+			retired.erase(split, retired.end());
+			pending = retired.size();
+		}
+
+		// destructors run outside the lock, they may retire objects of their own.
+		for (const Retired& r : ready) {
+			r.destroy(r.object);
+		}
+		return pending;
+	}
+
+	size_t Epoch::GetPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(retiredMutex);
+		return retired.size();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core.h"
+
+#include "log.h"
+
+#define EPOCH_MAX_THREADS 256
+// retired objects gathered before a Retire tries to free them.
+#define EPOCH_COLLECT_THRESHOLD 64
+
+namespace Luxel
+{
+	// epoch based reclamation for structures read without locks. readers stay inside an EpochGuard
+	// while they hold pointers loaded from the structure; writers unlink an object and Retire it, and
+	// it is destroyed once every thread that could have loaded it has left its guard.
+	class LUXEL_API Epoch
+	{
+	public:
+
+		Epoch(const Epoch&) = delete;
+		Epoch(Epoch&&) = delete;
+		void operator=(const Epoch&) = delete;
+
+		// guards nest, only the outermost one announces the thread.
+		static void Enter();
+		static void Exit();
+		static bool IsPinned();
+
+		// object must already be unreachable for threads entering from now on.
+		static void Retire(void* object, void (*destroy)(void*));
+		template<typename T>
+		static void Retire(T* object)
+		{
+			Retire(object, [](void* p) { delete static_cast<T*>(p); });
+		}
+
+		// destroys what no pinned thread can still see, returns how many objects are left waiting.
+		static size_t Collect();
+		static size_t GetPendingCount();
+
+	private:
+		Epoch();
+		~Epoch();
+	};
+
+	class EpochGuard
+	{
+	public:
+		EpochGuard() { Epoch::Enter(); }
+		~EpochGuard() { Epoch::Exit(); }
+		EpochGuard(const EpochGuard&) = delete;
+		void operator=(const EpochGuard&) = delete;
+	};
+}
@@ -0,0 +1,168 @@
+#include "pch.h"
+
+#include "JobSystem.h"
+
+namespace Luxel
+{
+	struct Job
+	{
+		std::function<void()> task;
+		JobCounter* counter;
+	};
+
+	static std::vector<std::thread> workers;
+	static std::deque<Job> jobQueue;
+	static std::mutex queueMutex;
+	static std::condition_variable queueCondition;
+	static std::atomic<bool> running{ false };
+	static thread_local ui32 threadIndex = 0;
+
+	JobSystem::JobSystem()
+	{
+
+	}
+
+	JobSystem::~JobSystem()
+	{
+
+	}
+
+	void JobSystem::Init(ui32 threadCount)
+	{
+		if (running) {
+			Warning("Job system already initialized.");
+			return;
+		}
+
+		if (threadCount == 0) {
+			ui32 hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		Info("Init job system with", threadCount, "worker threads.");
+		running = true;
+		workers.reserve(threadCount);
+		for (ui32 i = 0;i < threadCount;i++) {
+			workers.emplace_back(&JobSystem::WorkerLoop, i + 1);
+		}
+	}
+
+	void JobSystem::Shutdown()
+	{
+		if (!running) {
+			return;
+		}
+
+		Info("Shutdown job system.");
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			running = false;
+		}
+		queueCondition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+	}
+
+	bool JobSystem::IsInitialized()
+	{
+		return running;
+	}
+
+	ui32 JobSystem::GetThreadCount()
+	{
+		return static_cast<ui32>(workers.size());
+	}
+
+	ui32 JobSystem::GetThreadIndex()
+	{
+		return threadIndex;
+	}
+
+	void JobSystem::Execute(JobCounter& counter, std::function<void()> job)
+	{
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+		// without workers the job runs inline.
+		if (!running) {
+			job();
+			counter.pending.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			jobQueue.push_back({ std::move(job), &counter });
+		}
+		queueCondition.notify_one();
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		while (!counter.IsDone()) {
+			if (!RunPendingJob()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::ParallelFor(ui32 count, ui32 groupSize, const std::function<void(ui32 begin, ui32 end)>& job)
+	{
+		if (count == 0) {
+			return;
+		}
+		groupSize = std::max(groupSize, 1u);
+
+		ui32 groupCount = (count + groupSize - 1) / groupSize;
+		if (groupCount == 1 || !running) {
+			job(0, count);
+			return;
+		}
+
+		JobCounter counter;
+		for (ui32 group = 0;group < groupCount;group++) {
+			ui32 begin = group * groupSize;
+			ui32 end = std::min(begin + groupSize, count);
+			Execute(counter, [&job, begin, end]() { job(begin, end); });
+		}
+		Wait(counter);
+	}
+
+	bool JobSystem::RunPendingJob()
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (jobQueue.empty()) {
+				return false;
+			}
+			job = std::move(jobQueue.front());
+			jobQueue.pop_front();
+		}
+
+		job.task();
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	void JobSystem::WorkerLoop(ui32 index)
+	{
+		threadIndex = index;
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, []() { return !jobQueue.empty() || !running; });
+				if (jobQueue.empty()) {
+					return;
+				}
+				job = std::move(jobQueue.front());
+				jobQueue.pop_front();
+			}
+
+			job.task();
+			job.counter->pending.fetch_sub(1, std::memory_order_release);
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core.h"
+
+#include "log.h"
+
+namespace Luxel
+{
+	// counts the jobs of one batch that are still running.
+	struct JobCounter
+	{
+		std::atomic<ui32> pending{ 0 };
+
+		bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	class LUXEL_API JobSystem
+	{
+	public:
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) = delete;
+		void operator=(const JobSystem&) = delete;
+
+		// threadCount == 0 uses all hardware threads except the calling one.
+		static void Init(ui32 threadCount = 0);
+		static void Shutdown();
+
+		static bool IsInitialized();
+		static ui32 GetThreadCount();
+
+		// 0 for the main (or any non-worker) thread, 1..GetThreadCount() for workers.
+		static ui32 GetThreadIndex();
+
+		static void Execute(JobCounter& counter, std::function<void()> job);
+
+		// blocks until the counter reaches zero, running queued jobs meanwhile.
+		static void Wait(JobCounter& counter);
+
+		// splits [0, count) into groups of groupSize and blocks until every group is done.
+		static void ParallelFor(ui32 count, ui32 groupSize, const std::function<void(ui32 begin, ui32 end)>& job);
+
+	private:
+		static bool RunPendingJob();
+		static void WorkerLoop(ui32 threadIndex);
+
+		JobSystem();
+		~JobSystem();
+	};
+}
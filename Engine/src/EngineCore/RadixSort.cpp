@@ -0,0 +1,79 @@
+#include "pch.h"
+
+#include "RadixSort.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 DIGIT_BITS = 8;
+		constexpr ui32 BUCKETS = 1 << DIGIT_BITS;
+		// below this a single block on the calling thread is faster than the workers
+		constexpr ui32 MIN_BLOCK_SIZE = 1 << 14;
+	}
+
+	void RadixSort::SortPairs(std::vector<ui64>& keys, std::vector<ui32>& values, ui32 keyBits)
+	{
+		if (keys.size() != values.size()) {
+			Error("Radix sort got", keys.size(), "keys and", values.size(), "values.");
+			throw std::runtime_error("Radix sort key and value counts differ.");
+		}
+		ui32 count = static_cast<ui32>(keys.size());
+		if (count < 2) {
+			return;
+		}
+
+		// one block per job, each keeps a histogram per pass so scattering stays stable
+		ui32 blockSize = std::max(MIN_BLOCK_SIZE, count / std::max(JobSystem::GetThreadCount() * 4, 1u) + 1);
+		ui32 blockCount = (count + blockSize - 1) / blockSize;
+		std::vector<std::array<ui32, BUCKETS>> histograms(blockCount);
+		std::vector<ui64> keyScratch(count);
+		std::vector<ui32> valueScratch(count);
+
+		ui32 passes = (std::min(keyBits, 64u) + DIGIT_BITS - 1) / DIGIT_BITS;
+		for (ui32 pass = 0;pass < passes;pass++) {
+			ui32 shift = pass * DIGIT_BITS;
+			JobSystem::ParallelFor(blockCount, 1, [&](ui32 begin, ui32 end) {
+				for (ui32 block = begin;block < end;block++) {
+					std::array<ui32, BUCKETS>& histogram = histograms[block];
+					histogram.fill(0);
+					ui32 last = std::min(count, (block + 1) * blockSize);
+					for (ui32 i = block * blockSize;i < last;i++) {
+						histogram[(keys[i] >> shift) & (BUCKETS - 1)]++;
+					}
+				}
+			});
+
+			// bucket major, block minor: the offset where each block writes each digit
+			ui32 offset = 0;
+			bool single = false;
+			for (ui32 digit = 0;digit < BUCKETS;digit++) {
+				ui32 digitCount = 0;
+				for (ui32 block = 0;block < blockCount;block++) {
+					ui32 blockDigitCount = histograms[block][digit];
+					histograms[block][digit] = offset;
+					offset += blockDigitCount;
+					digitCount += blockDigitCount;
+				}
+				single |= digitCount == count;
+			}
+			if (single) {
+				continue;
+			}
+
+			JobSystem::ParallelFor(blockCount, 1, [&](ui32 begin, ui32 end) {
+				for (ui32 block = begin;block < end;block++) {
+					std::array<ui32, BUCKETS>& offsets = histograms[block];
+					ui32 last = std::min(count, (block + 1) * blockSize);
+					for (ui32 i = block * blockSize;i < last;i++) {
+						ui32 target = offsets[(keys[i] >> shift) & (BUCKETS - 1)]++;
+						keyScratch[target] = keys[i];
+						valueScratch[target] = values[i];
+					}
+				}
+			});
+			keys.swap(keyScratch);
+			values.swap(valueScratch);
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "pch.h"
+
+#include "Core.h"
+
+#include "log.h"
+#include "JobSystem.h"
+
+namespace Luxel
+{
+	// least significant digit first radix sort over 8 bit digits on the job system workers.
+	class LUXEL_API RadixSort
+	{
+	public:
+		// sorts keys ascending and moves values along, stable. only the low keyBits bits take part,
+		// and digits on which every key agrees are skipped without a pass.
+		static void SortPairs(std::vector<ui64>& keys, std::vector<ui32>& values, ui32 keyBits = 64);
+	};
+}
@@ -168,10 +168,10 @@ namespace Luxel
 
 		VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
 		vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
-		vertexInputCreateInfo.pVertexAttributeDescriptions = nullptr;
-		vertexInputCreateInfo.pVertexBindingDescriptions = nullptr;
+		vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<ui32>(configInfo.attributeDescriptions.size());
+		vertexInputCreateInfo.vertexBindingDescriptionCount = static_cast<ui32>(configInfo.bindingDescriptions.size());
+		vertexInputCreateInfo.pVertexAttributeDescriptions = configInfo.attributeDescriptions.empty() ? nullptr : configInfo.attributeDescriptions.data();
+		vertexInputCreateInfo.pVertexBindingDescriptions = configInfo.bindingDescriptions.empty() ? nullptr : configInfo.bindingDescriptions.data();
 
 		VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
 		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
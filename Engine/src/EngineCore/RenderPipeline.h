@@ -20,6 +20,8 @@ namespace Luxel
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		ui32 subpass = 0;
@@ -37,11 +39,11 @@ namespace Luxel
 
 		void Bind(VkCommandBuffer commandBuffer);
 
+		static std::vector<char> readFile(const std::string& filePath);
+
 		VkPipeline graphicsPipeline;
 
 	private:
-		static std::vector<char> readFile(const std::string& filePath);
-		
 		void CreateGraphicsPipeline(const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo);
 		void CreateShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
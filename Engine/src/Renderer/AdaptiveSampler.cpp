@@ -0,0 +1,224 @@
+#include "pch.h"
+
+#include "AdaptiveSampler.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// keeps the relative error of black tiles finite
+		constexpr float LUMINANCE_FLOOR = 1e-2f;
+		// relative error that tiles without trusted statistics are weighted with
+		constexpr float UNKNOWN_ERROR = 1.f;
+	}
+
+	AdaptiveSampler::AdaptiveSampler(ui32 width, ui32 height, const AdaptiveSamplingSettings& s) :
+		width{ 0 }, height{ 0 }, tilesX{ 0 }, tilesY{ 0 }, settings{ s }, converged{ false }
+	{
+		Resize(width, height);
+	}
+
+	AdaptiveSampler::~AdaptiveSampler()
+	{
+
+	}
+
+	void AdaptiveSampler::Resize(ui32 w, ui32 h)
+	{
+		width = w;
+		height = h;
+		tilesX = (w + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+		tilesY = (h + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+		Reset();
+	}
+
+	void AdaptiveSampler::Reset()
+	{
+		size_t pixelCount = static_cast<size_t>(width) * height;
+		size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+		mean.assign(pixelCount, 0.f);
+		deviation.assign(pixelCount, 0.f);
+		tiles.assign(tileCount, TileStats{});
+		errors.assign(tileCount, std::numeric_limits<float>::infinity());
+		allocation.assign(tileCount, 0);
+		converged = false;
+		Allocate();
+	}
+
+	const std::vector<ui32>& AdaptiveSampler::GetAllocation() const
+	{
+		return allocation;
+	}
+
+	std::vector<TileWork> AdaptiveSampler::BuildWork() const
+	{
+		std::vector<TileWork> work;
+		for (ui32 tile = 0;tile < allocation.size();tile++) {
+			if (allocation[tile] > 0) {
+				work.push_back(TileWork{ tile % tilesX, tile / tilesX, allocation[tile], tiles[tile].totalSamples });
+			}
+		}
+		std::sort(work.begin(), work.end(), [&](const TileWork& a, const TileWork& b) {
+			return a.samples * TilePixels(a.tileX + a.tileY * tilesX) > b.samples * TilePixels(b.tileX + b.tileY * tilesX);
+		});
+		return work;
+	}
+
+	std::vector<ui32> AdaptiveSampler::GetGpuWork() const
+	{
+		std::vector<TileWork> work = BuildWork();
+		GpuTileWorkHeader header{};
+		header.groupCountX = static_cast<ui32>(work.size());
+		header.groupCountY = 1;
+		header.groupCountZ = 1;
+		header.workCount = static_cast<ui32>(work.size());
+		header.info = glm::uvec4(ADAPTIVE_TILE_SIZE, width, height, 0);
+
+		std::vector<ui32> data(sizeof(GpuTileWorkHeader) / sizeof(ui32));
+		std::memcpy(data.data(), &header, sizeof(header));
+		for (const auto& item : work) {
+			data.insert(data.end(), { item.tileX, item.tileY, item.samples, item.firstSample });
+		}
+		return data;
+	}
+
+	void AdaptiveSampler::Update(const glm::vec4* radiance)
+	{
+		float decay = settings.offline ? 1.f : settings.decay;
+		JobSystem::ParallelFor(static_cast<ui32>(tiles.size()), 4, [&](ui32 begin, ui32 end) {
+			for (ui32 tile = begin;tile < end;tile++) {
+				ui32 samples = allocation[tile];
+				if (samples == 0) {
+					continue;
+				}
+				TileStats& stats = tiles[tile];
+				float weight = static_cast<float>(samples);
+				float total = stats.samples * decay + weight;
+
+				ui32 x0 = tile % tilesX * ADAPTIVE_TILE_SIZE, y0 = tile / tilesX * ADAPTIVE_TILE_SIZE;
+				ui32 x1 = std::min(x0 + ADAPTIVE_TILE_SIZE, width), y1 = std::min(y0 + ADAPTIVE_TILE_SIZE, height);
+				for (ui32 y = y0;y < y1;y++) {
+					for (ui32 x = x0;x < x1;x++) {
+						size_t index = static_cast<size_t>(y) * width + x;
+						const glm::vec4& c = radiance[index];
+						float luminance = c.x * 0.2126f + c.y * 0.7152f + c.z * 0.0722f;
+						float delta = luminance - mean[index];
+						mean[index] += delta * weight / total;
+						deviation[index] = deviation[index] * decay + weight * delta * (luminance - mean[index]);
+					}
+				}
+				stats.samples = total;
+				stats.frames = stats.frames * decay + 1.f;
+				stats.totalSamples += samples;
+
+				if (stats.frames < static_cast<float>(std::max(settings.minFrames, 2u))) {
+					errors[tile] = std::numeric_limits<float>::infinity();
+					continue;
+				}
+				// frame means of s samples scatter by variance / s, so deviation / (frames - 1) estimates
+				// the per sample variance; the error of the pixel mean is that over the sample count
+				float squaredError = 0.f, luminanceSum = 0.f;
+				for (ui32 y = y0;y < y1;y++) {
+					for (ui32 x = x0;x < x1;x++) {
+						size_t index = static_cast<size_t>(y) * width + x;
+						squaredError += std::max(deviation[index], 0.f) / ((stats.frames - 1.f) * stats.samples);
+						luminanceSum += mean[index];
+					}
+				}
+				float pixels = static_cast<float>((x1 - x0) * (y1 - y0));
+				errors[tile] = std::sqrt(squaredError / pixels) / (std::abs(luminanceSum) / pixels + LUMINANCE_FLOOR);
+			}
+		});
+		Allocate();
+	}
+
+	const std::vector<float>& AdaptiveSampler::GetTileErrors() const
+	{
+		return errors;
+	}
+
+	bool AdaptiveSampler::IsConverged() const
+	{
+		return converged;
+	}
+
+	ui32 AdaptiveSampler::GetTilesX() const
+	{
+		return tilesX;
+	}
+
+	ui32 AdaptiveSampler::GetTilesY() const
+	{
+		return tilesY;
+	}
+
+	const AdaptiveSamplingSettings& AdaptiveSampler::GetSettings() const
+	{
+		return settings;
+	}
+
+	void AdaptiveSampler::SetSettings(const AdaptiveSamplingSettings& s)
+	{
+		settings = s;
+		Allocate();
+	}
+
+	void AdaptiveSampler::Allocate()
+	{
+		ui64 budget = settings.rayBudget > 0 ? settings.rayBudget : static_cast<ui64>(width) * height;
+		ui32 maxSamples = std::max(settings.maxSamples, settings.minSamples);
+
+		// every running tile gets minSamples, the rest of the budget goes by error times area
+		ui64 spent = 0;
+		double weightSum = 0.0;
+		std::vector<double> weights(tiles.size(), 0.0);
+		converged = settings.offline;
+		for (ui32 tile = 0;tile < tiles.size();tile++) {
+			bool trusted = tiles[tile].frames >= static_cast<float>(std::max(settings.minFrames, 2u));
+			bool done = trusted && errors[tile] <= settings.targetError;
+			if (settings.offline && done) {
+				allocation[tile] = 0;
+				continue;
+			}
+			if (!done) {
+				converged = false;
+				weights[tile] = static_cast<double>(trusted ? std::min(errors[tile], UNKNOWN_ERROR) : UNKNOWN_ERROR) * TilePixels(tile);
+				weightSum += weights[tile];
+			}
+			allocation[tile] = settings.minSamples;
+			spent += static_cast<ui64>(settings.minSamples) * TilePixels(tile);
+		}
+		if (weightSum <= 0.0 || spent >= budget) {
+			return;
+		}
+
+		ui64 remaining = budget - spent;
+		std::vector<std::pair<double, ui32>> remainders;
+		for (ui32 tile = 0;tile < tiles.size();tile++) {
+			if (weights[tile] <= 0.0) {
+				continue;
+			}
+			double share = static_cast<double>(remaining) * weights[tile] / weightSum / TilePixels(tile);
+			ui32 extra = std::min(static_cast<ui32>(share), maxSamples - allocation[tile]);
+			allocation[tile] += extra;
+			spent += static_cast<ui64>(extra) * TilePixels(tile);
+			if (allocation[tile] < maxSamples) {
+				remainders.emplace_back(share - extra, tile);
+			}
+		}
+		// hand what rounding left over to the largest remainders
+		std::sort(remainders.begin(), remainders.end(), std::greater<>());
+		for (const auto& [fraction, tile] : remainders) {
+			if (spent + TilePixels(tile) <= budget) {
+				allocation[tile]++;
+				spent += TilePixels(tile);
+			}
+		}
+	}
+
+	ui32 AdaptiveSampler::TilePixels(ui32 tile) const
+	{
+		ui32 x0 = tile % tilesX * ADAPTIVE_TILE_SIZE, y0 = tile / tilesX * ADAPTIVE_TILE_SIZE;
+		return (std::min(x0 + ADAPTIVE_TILE_SIZE, width) - x0) * (std::min(y0 + ADAPTIVE_TILE_SIZE, height) - y0);
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+
+#define ADAPTIVE_TILE_SIZE 16
+
+namespace Luxel
+{
+	struct AdaptiveSamplingSettings
+	{
+		// samples per frame over the whole image, 0 for one per pixel on average.
+		ui32 rayBudget = 0;
+		// samples per pixel of a tile that is still running, and the cap.
+		ui32 minSamples = 1;
+		ui32 maxSamples = 16;
+		// relative standard error of a pixel mean under which a tile counts as converged.
+		float targetError = 0.01f;
+		// frames a tile is sampled before its error is trusted.
+		ui32 minFrames = 4;
+		// offline: statistics never fade and converged tiles get no samples at all.
+		// realtime: statistics fade by decay per frame and every tile gets minSamples.
+		bool offline = false;
+		float decay = 0.9f;
+	};
+
+	// one tile of a frame's work, sample indices continue where the tile's previous frames stopped.
+	struct TileWork
+	{
+		ui32 tileX, tileY;
+		ui32 samples;
+		ui32 firstSample;
+	};
+
+	// layout of the GPU work buffer, must match shaders/adaptive_tiles.glsl; followed by one uvec4
+	// (tileX, tileY, samples, firstSample) per work item. the first three words are a
+	// VkDispatchIndirectCommand launching one workgroup per tile.
+	struct GpuTileWorkHeader
+	{
+		ui32 groupCountX, groupCountY, groupCountZ;
+		ui32 workCount;
+		// tile size, width, height, 0
+		glm::uvec4 info;
+	};
+
+	// per tile sample counts from the variance of every pixel's frame estimates. one allocation map feeds
+	// both the CPU tile list and the GPU indirect dispatch, so both trace the same samples.
+	class LUXEL_API AdaptiveSampler
+	{
+	public:
+		AdaptiveSampler(ui32 width, ui32 height, const AdaptiveSamplingSettings& s = AdaptiveSamplingSettings{});
+		~AdaptiveSampler();
+		AdaptiveSampler(const AdaptiveSampler&) = delete;
+		void operator=(const AdaptiveSampler&) = delete;
+
+		void Resize(ui32 w, ui32 h);
+		// forget all statistics, after camera cuts or edits.
+		void Reset();
+
+		// samples per pixel per tile for the coming frame, row major over tiles.
+		const std::vector<ui32>& GetAllocation() const;
+		// tiles with samples, the most expensive first so workers balance.
+		std::vector<TileWork> BuildWork() const;
+		// GpuTileWorkHeader followed by the work items.
+		std::vector<ui32> GetGpuWork() const;
+
+		// radiance holds every pixel's mean over the samples it got this frame under GetAllocation.
+		// updates the statistics and allocates the next frame.
+		void Update(const glm::vec4* radiance);
+
+		// relative standard error per tile, infinity before minFrames.
+		const std::vector<float>& GetTileErrors() const;
+		// offline only: every tile reached targetError.
+		bool IsConverged() const;
+
+		ui32 GetTilesX() const;
+		ui32 GetTilesY() const;
+		const AdaptiveSamplingSettings& GetSettings() const;
+		void SetSettings(const AdaptiveSamplingSettings& s);
+
+	private:
+		struct TileStats
+		{
+			// weighted sample and frame counts, faded in realtime mode
+			float samples = 0.f;
+			float frames = 0.f;
+			ui32 totalSamples = 0;
+		};
+
+		void Allocate();
+		ui32 TilePixels(ui32 tile) const;
+
+		ui32 width, height;
+		ui32 tilesX, tilesY;
+		AdaptiveSamplingSettings settings;
+
+		// weighted Welford mean and squared deviation of every pixel's luminance
+		std::vector<float> mean, deviation;
+		std::vector<TileStats> tiles;
+		std::vector<float> errors;
+		std::vector<ui32> allocation;
+		bool converged;
+	};
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+// sky texels are reprojected as points this far along their ray.
+#define GBUFFER_SKY_DISTANCE 1e6f
+
+namespace Luxel
+{
+	// one texel written by the primary visibility pass, std430 compatible (two vec4).
+	// layout must match shaders/gbuffer.glsl.
+	struct GBufferTexel
+	{
+		glm::vec3 normal;
+		// distance from the camera along the view ray, 0 for rays that hit nothing.
+		float distance;
+		glm::vec3 albedo;
+		ui32 material;
+	};
+
+	// per frame camera data, row y = 0 is the top of the image.
+	struct ViewInfo
+	{
+		glm::mat4 viewProjection;
+		glm::mat4 inverseViewProjection;
+		glm::vec4 position;
+	};
+
+	// world space box whose pixels drop their history, see HistoryInvalidator.
+	struct InvalidationBox
+	{
+		glm::vec4 min;
+		glm::vec4 max;
+	};
+
+	// pixel coordinates are continuous, pixel (x, y) covers [x, x + 1) x [y, y + 1).
+	inline glm::vec3 PixelRayDirection(const ViewInfo& view, const glm::vec2& pixel, ui32 width, ui32 height)
+	{
+		glm::vec2 ndc(pixel.x / static_cast<float>(width) * 2.f - 1.f, pixel.y / static_cast<float>(height) * 2.f - 1.f);
+		glm::vec4 farPoint = view.inverseViewProjection * glm::vec4(ndc.x, ndc.y, 1.f, 1.f);
+		return glm::normalize(glm::vec3(farPoint) / farPoint.w - glm::vec3(view.position));
+	}
+
+	// returns false when p is behind the camera.
+	inline bool ProjectToPixel(const ViewInfo& view, const glm::vec3& p, ui32 width, ui32 height, glm::vec2& pixel)
+	{
+		glm::vec4 clip = view.viewProjection * glm::vec4(p, 1.f);
+		if (clip.w <= 0.f) {
+			return false;
+		}
+		pixel = glm::vec2((clip.x / clip.w * 0.5f + 0.5f) * static_cast<float>(width), (clip.y / clip.w * 0.5f + 0.5f) * static_cast<float>(height));
+		return true;
+	}
+
+	// world position a texel was shaded at.
+	inline glm::vec3 TexelPosition(const ViewInfo& view, const GBufferTexel& texel, ui32 x, ui32 y, ui32 width, ui32 height)
+	{
+		glm::vec3 direction = PixelRayDirection(view, glm::vec2(x + 0.5f, y + 0.5f), width, height);
+		return glm::vec3(view.position) + direction * (texel.distance > 0.f ? texel.distance : GBUFFER_SKY_DISTANCE);
+	}
+
+	inline bool InsideAnyBox(const glm::vec3& p, const std::vector<InvalidationBox>& boxes)
+	{
+		for (const auto& box : boxes) {
+			if (p.x >= box.min.x && p.y >= box.min.y && p.z >= box.min.z &&
+				p.x <= box.max.x && p.y <= box.max.y && p.z <= box.max.z) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	struct Reprojection
+	{
+		std::array<size_t, 4> index;
+		std::array<float, 4> weight;
+		ui32 count = 0;
+		float weightSum = 0.f;
+	};
+
+	// bilinear footprint of position over the previous pixel centers. taps whose texel disagrees with
+	// texel in sky state, distance or normal are dropped; returns false when nothing usable is left.
+	inline bool Reproject(const ViewInfo& previousView, const GBufferTexel* previousGBuffer, ui32 width, ui32 height,
+		const glm::vec3& position, const GBufferTexel& texel, float distanceTolerance, float normalTolerance, Reprojection& result)
+	{
+		result.count = 0;
+		result.weightSum = 0.f;
+		glm::vec2 previousPixel;
+		if (!ProjectToPixel(previousView, position, width, height, previousPixel)) {
+			return false;
+		}
+
+		bool sky = texel.distance <= 0.f;
+		float expected = glm::length(position - glm::vec3(previousView.position));
+		glm::vec2 base = glm::floor(previousPixel - glm::vec2(0.5f));
+		glm::vec2 frac = previousPixel - glm::vec2(0.5f) - base;
+		for (ui32 tap = 0;tap < 4;tap++) {
+			int tx = static_cast<int>(base.x) + static_cast<int>(tap & 1);
+			int ty = static_cast<int>(base.y) + static_cast<int>(tap >> 1);
+			if (tx < 0 || ty < 0 || tx >= static_cast<int>(width) || ty >= static_cast<int>(height)) {
+				continue;
+			}
+			size_t tapIndex = static_cast<size_t>(ty) * width + tx;
+			const GBufferTexel& previous = previousGBuffer[tapIndex];
+			if (sky != (previous.distance <= 0.f)) {
+				continue;
+			}
+			if (!sky) {
+				if (std::abs(previous.distance - expected) > distanceTolerance * expected ||
+					glm::dot(previous.normal, texel.normal) < normalTolerance) {
+					continue;
+				}
+			}
+			float weight = ((tap & 1) ? frac.x : 1.f - frac.x) * ((tap >> 1) ? frac.y : 1.f - frac.y);
+			result.index[result.count] = tapIndex;
+			result.weight[result.count] = weight;
+			result.count++;
+			result.weightSum += weight;
+		}
+		return result.weightSum >= 1e-3f;
+	}
+}
@@ -0,0 +1,85 @@
+#include "pch.h"
+
+#include "HistoryInvalidator.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		void Expand(InvalidationBox& box, const InvalidationBox& other)
+		{
+			box.min = glm::min(box.min, other.min);
+			box.max = glm::max(box.max, other.max);
+		}
+	}
+
+	HistoryInvalidator::HistoryInvalidator(VoxelWorld* const w, ui32 maxBoxes, float margin) :
+		world{ w }, maxBoxes{ std::max(maxBoxes, 1u) }, margin{ margin }, syncedRevision{ w->GetRevision() }
+	{
+
+	}
+
+	HistoryInvalidator::~HistoryInvalidator()
+	{
+
+	}
+
+	const std::vector<InvalidationBox>& HistoryInvalidator::Update()
+	{
+		boxes.clear();
+		ui64 revision = world->GetRevision();
+		if (revision == syncedRevision) {
+			return boxes;
+		}
+
+		// one box per edited brick, falling back to one per chunk and finally a single box
+		EpochGuard guard;
+		std::vector<InvalidationBox> chunkBoxes;
+		for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk == nullptr) {
+				continue;
+			}
+			// emptied bricks need no box, reprojection rejects them by distance
+			ui64 bricks = chunk->GetModifiedBricks(syncedRevision) & chunk->GetBrickMask();
+			InvalidationBox chunkBox{ glm::vec4(std::numeric_limits<float>::max()), glm::vec4(-std::numeric_limits<float>::max()) };
+			while (bricks != 0) {
+				ui32 brick = static_cast<ui32>(std::countr_zero(bricks));
+				bricks &= bricks - 1;
+				glm::ivec3 brickMin = ChunkOrigin(coord) + glm::ivec3(
+					brick % BRICKS_PER_AXIS, brick / BRICKS_PER_AXIS % BRICKS_PER_AXIS, brick / (BRICKS_PER_AXIS * BRICKS_PER_AXIS)) * BRICK_SIZE;
+				InvalidationBox box{
+					glm::vec4(glm::vec3(brickMin) - glm::vec3(margin), 0.f),
+					glm::vec4(glm::vec3(brickMin + glm::ivec3(BRICK_SIZE)) + glm::vec3(margin), 0.f) };
+				boxes.push_back(box);
+				Expand(chunkBox, box);
+			}
+			if (chunkBox.min.x <= chunkBox.max.x) {
+				chunkBoxes.push_back(chunkBox);
+			}
+		}
+		syncedRevision = revision;
+
+		if (boxes.size() > maxBoxes) {
+			boxes = std::move(chunkBoxes);
+		}
+		if (boxes.size() > maxBoxes) {
+			InvalidationBox all = boxes[0];
+			for (const auto& box : boxes) {
+				Expand(all, box);
+			}
+			boxes.assign(1, all);
+		}
+		return boxes;
+	}
+
+	const std::vector<InvalidationBox>& HistoryInvalidator::GetBoxes() const
+	{
+		return boxes;
+	}
+
+	ui32 HistoryInvalidator::GetMaxBoxes() const
+	{
+		return maxBoxes;
+	}
+}
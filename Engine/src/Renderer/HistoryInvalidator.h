@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "Voxel/VoxelWorld.h"
+#include "GBuffer.h"
+
+namespace Luxel
+{
+	// turns voxel edits into world space boxes, so temporal passes reset history only around them.
+	// removed geometry needs no box: reprojection rejects it by distance.
+	class LUXEL_API HistoryInvalidator
+	{
+	public:
+		// margin in voxels is added around every edited brick to cover nearby indirect light.
+		HistoryInvalidator(VoxelWorld* const w, ui32 maxBoxes = 64, float margin = 2.f);
+		~HistoryInvalidator();
+		HistoryInvalidator(const HistoryInvalidator&) = delete;
+		void operator=(const HistoryInvalidator&) = delete;
+
+		// boxes of everything edited since the previous call, merged down to at most maxBoxes.
+		const std::vector<InvalidationBox>& Update();
+		const std::vector<InvalidationBox>& GetBoxes() const;
+		ui32 GetMaxBoxes() const;
+
+	private:
+		VoxelWorld* const world;
+		ui32 maxBoxes;
+		float margin;
+		ui64 syncedRevision;
+		std::vector<InvalidationBox> boxes;
+	};
+}
@@ -0,0 +1,367 @@
+#include "pch.h"
+
+#include "InstanceBvh.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// past this depth nodes split at the median, which keeps the tree within the traversal stack
+		constexpr ui32 MEDIAN_DEPTH = 32;
+		constexpr ui32 BINNING_GROUP_SIZE = 4096;
+
+		// plain members, so arrays of bins cost nothing until Reset touches the ones a node uses
+		struct Bin
+		{
+			glm::vec3 boundsMin, boundsMax;
+			glm::vec3 centroidMin, centroidMax;
+			ui32 count;
+
+			void Reset()
+			{
+				boundsMin = centroidMin = glm::vec3(std::numeric_limits<float>::max());
+				boundsMax = centroidMax = glm::vec3(-std::numeric_limits<float>::max());
+				count = 0;
+			}
+
+			void Add(const glm::vec3& min, const glm::vec3& max, const glm::vec3& centroid)
+			{
+				boundsMin = glm::min(boundsMin, min);
+				boundsMax = glm::max(boundsMax, max);
+				centroidMin = glm::min(centroidMin, centroid);
+				centroidMax = glm::max(centroidMax, centroid);
+				count++;
+			}
+
+			void Merge(const Bin& other)
+			{
+				boundsMin = glm::min(boundsMin, other.boundsMin);
+				boundsMax = glm::max(boundsMax, other.boundsMax);
+				centroidMin = glm::min(centroidMin, other.centroidMin);
+				centroidMax = glm::max(centroidMax, other.centroidMax);
+				count += other.count;
+			}
+
+			BvhBounds Bounds() const { return BvhBounds{ boundsMin, boundsMax }; }
+			BvhBounds CentroidBounds() const { return BvhBounds{ centroidMin, centroidMax }; }
+		};
+
+		using Bins = Bin[BVH_BINS];
+
+		inline ui32 BinIndex(float centroid, float minimum, float scale, ui32 binCount)
+		{
+			return std::min(static_cast<ui32>(std::max((centroid - minimum) * scale, 0.f)), binCount - 1);
+		}
+	}
+
+	InstanceBvh::InstanceBvh(const BvhSettings& s) : settings{ s }, nodeCount{ 0 }, depth{ 0 }
+	{
+
+	}
+
+	InstanceBvh::~InstanceBvh()
+	{
+
+	}
+
+	void InstanceBvh::Build(const BvhBounds* bounds, ui32 count)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		settings.maxLeafSize = std::clamp(settings.maxLeafSize, 1u, static_cast<ui32>(BVH_MAX_LEAF_SIZE));
+		if (count >= (1u << BVH_LEAF_FIRST_BITS)) {
+			Error("Instance BVH got", count, "instances, flattened leaves address", 1u << BVH_LEAF_FIRST_BITS, ".");
+			throw std::runtime_error("Too many instances for the BVH.");
+		}
+
+		indices.resize(count);
+		entries.resize(count);
+		// a binary tree with at least one instance per leaf
+		nodes.resize(count > 0 ? count * 2 - 1 : 0);
+		std::vector<Bin> groups((count + BINNING_GROUP_SIZE - 1) / BINNING_GROUP_SIZE);
+		JobSystem::ParallelFor(count, BINNING_GROUP_SIZE, [&](ui32 begin, ui32 end) {
+			Bin& group = groups[begin / BINNING_GROUP_SIZE];
+			group.Reset();
+			for (ui32 i = begin;i < end;i++) {
+				entries[i] = BuildEntry{ bounds[i].min, i, bounds[i].max, 0.f };
+				group.Add(bounds[i].min, bounds[i].max, bounds[i].Center());
+			}
+		});
+		Bin root;
+		root.Reset();
+		for (const Bin& group : groups) {
+			root.Merge(group);
+		}
+
+		nodeCount = count > 0 ? 1 : 0;
+		depth = 0;
+		if (count > 0) {
+			BuildNode(0, 0, count, 1, root.Bounds(), root.CentroidBounds());
+		}
+		nodes.resize(nodeCount);
+		JobSystem::ParallelFor(count, BINNING_GROUP_SIZE, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				indices[i] = entries[i].index;
+			}
+		});
+
+		stats.instanceCount = count;
+		stats.nodeCount = nodeCount;
+		stats.depth = depth;
+		UpdateCost();
+		stats.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void InstanceBvh::BuildNode(ui32 node, ui32 begin, ui32 end, ui32 nodeDepth, const BvhBounds& box, const BvhBounds& centroidBox)
+	{
+		ui32 count = end - begin;
+		ui32 previousDepth = depth.load(std::memory_order_relaxed);
+		while (previousDepth < nodeDepth && !depth.compare_exchange_weak(previousDepth, nodeDepth, std::memory_order_relaxed)) {
+		}
+
+		BvhNode& current = nodes[node];
+		current.boundsMin = box.min;
+		current.boundsMax = box.max;
+		if (count == 1) {
+			current.first = begin;
+			current.count = 1;
+			return;
+		}
+
+		// bins along the longest centroid extent, which is nearly always where the best split lies
+		glm::vec3 extent = centroidBox.max - centroidBox.min;
+		ui32 axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		// small nodes can not fill many bins, fewer keep the sweep short
+		ui32 binCount = std::min(count, static_cast<ui32>(BVH_BINS));
+		float minimum = centroidBox.min[axis];
+		float scale = extent[axis] > 0.f ? binCount / extent[axis] : 0.f;
+		bool parallel = count > settings.parallelThreshold;
+
+		float bestCost = std::numeric_limits<float>::max();
+		ui32 bestSplit = 0;
+		Bin bestLeft, bestRight;
+		if (nodeDepth < MEDIAN_DEPTH && scale > 0.f) {
+			auto bin = [&](ui32 first, ui32 last, Bin* b) {
+				for (ui32 i = 0;i < binCount;i++) {
+					b[i].Reset();
+				}
+				for (ui32 i = first;i < last;i++) {
+					const BuildEntry& entry = entries[i];
+					glm::vec3 c = entry.Center();
+					b[BinIndex(c[axis], minimum, scale, binCount)].Add(entry.min, entry.max, c);
+				}
+			};
+			Bins bins;
+			if (parallel) {
+				std::vector<std::array<Bin, BVH_BINS>> groups((count + BINNING_GROUP_SIZE - 1) / BINNING_GROUP_SIZE);
+				JobSystem::ParallelFor(count, BINNING_GROUP_SIZE, [&](ui32 first, ui32 last) {
+					bin(begin + first, begin + last, groups[first / BINNING_GROUP_SIZE].data());
+				});
+				bin(0, 0, bins);
+				for (const std::array<Bin, BVH_BINS>& group : groups) {
+					for (ui32 i = 0;i < binCount;i++) {
+						bins[i].Merge(group[i]);
+					}
+				}
+			}
+			else {
+				bin(begin, end, bins);
+			}
+
+			// right side sums, then the left sweep
+			Bins right;
+			right[binCount - 1] = bins[binCount - 1];
+			for (ui32 i = binCount - 1;i-- > 1;) {
+				right[i] = bins[i];
+				right[i].Merge(right[i + 1]);
+			}
+			float parentArea = box.HalfArea();
+			float inverseArea = parentArea > 0.f ? 1.f / parentArea : 0.f;
+			Bin left;
+			left.Reset();
+			for (ui32 split = 1;split < binCount;split++) {
+				left.Merge(bins[split - 1]);
+				if (left.count == 0 || right[split].count == 0) {
+					continue;
+				}
+				float cost = settings.traversalCost +
+					(left.Bounds().HalfArea() * left.count + right[split].Bounds().HalfArea() * right[split].count) * inverseArea;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestSplit = split;
+					bestLeft = left;
+					bestRight = right[split];
+				}
+			}
+		}
+
+		if (count <= settings.maxLeafSize && static_cast<float>(count) <= bestCost) {
+			current.first = begin;
+			current.count = count;
+			return;
+		}
+
+		ui32 middle;
+		if (bestSplit > 0) {
+			middle = static_cast<ui32>(std::partition(entries.begin() + begin, entries.begin() + end, [&](const BuildEntry& entry) {
+				return BinIndex(entry.Center()[axis], minimum, scale, binCount) < bestSplit;
+			}) - entries.begin());
+		}
+		else {
+			// every centroid in one spot, or too deep: halve along the longest extent
+			middle = begin + count / 2;
+			std::nth_element(entries.begin() + begin, entries.begin() + middle, entries.begin() + end, [&](const BuildEntry& a, const BuildEntry& b) {
+				return a.min[axis] + a.max[axis] < b.min[axis] + b.max[axis];
+			});
+			bestLeft.Reset();
+			bestRight.Reset();
+			for (ui32 i = begin;i < end;i++) {
+				(i < middle ? bestLeft : bestRight).Add(entries[i].min, entries[i].max, entries[i].Center());
+			}
+		}
+
+		// children are placed after their parent, so reverse node order visits children first
+		ui32 left = nodeCount.fetch_add(2, std::memory_order_relaxed);
+		current.first = left;
+		current.count = 0;
+		if (parallel) {
+			JobCounter counter;
+			JobSystem::Execute(counter, [&]() {
+				BuildNode(left, begin, middle, nodeDepth + 1, bestLeft.Bounds(), bestLeft.CentroidBounds());
+			});
+			BuildNode(left + 1, middle, end, nodeDepth + 1, bestRight.Bounds(), bestRight.CentroidBounds());
+			JobSystem::Wait(counter);
+		}
+		else {
+			BuildNode(left, begin, middle, nodeDepth + 1, bestLeft.Bounds(), bestLeft.CentroidBounds());
+			BuildNode(left + 1, middle, end, nodeDepth + 1, bestRight.Bounds(), bestRight.CentroidBounds());
+		}
+	}
+
+	void InstanceBvh::Refit(const BvhBounds* bounds)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = nodes.size();i-- > 0;) {
+			BvhNode& node = nodes[i];
+			BvhBounds box;
+			if (node.count > 0) {
+				for (ui32 j = 0;j < node.count;j++) {
+					box.Grow(bounds[indices[node.first + j]]);
+				}
+			}
+			else {
+				const BvhNode& left = nodes[node.first];
+				const BvhNode& right = nodes[node.first + 1];
+				box.min = glm::min(left.boundsMin, right.boundsMin);
+				box.max = glm::max(left.boundsMax, right.boundsMax);
+			}
+			node.boundsMin = box.min;
+			node.boundsMax = box.max;
+		}
+		UpdateCost();
+		stats.refitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void InstanceBvh::Flatten(std::vector<GpuBvhNode>& flattened) const
+	{
+		flattened.resize(nodes.size());
+		if (nodes.empty()) {
+			return;
+		}
+		// children come after their parent, so reverse order sizes every subtree before its parent
+		std::vector<ui32> subtreeSize(nodes.size(), 1);
+		for (size_t i = nodes.size();i-- > 0;) {
+			if (nodes[i].count == 0) {
+				subtreeSize[i] += subtreeSize[nodes[i].first] + subtreeSize[nodes[i].first + 1];
+			}
+		}
+
+		// pre-order: a node, its left subtree, then its right subtree, which is where the left child misses to
+		struct Entry
+		{
+			ui32 node;
+			ui32 miss;
+		};
+		std::vector<Entry> stack;
+		stack.reserve(2 * stats.depth + 1);
+		stack.push_back(Entry{ 0, static_cast<ui32>(nodes.size()) });
+		ui32 next = 0;
+		while (!stack.empty()) {
+			Entry entry = stack.back();
+			stack.pop_back();
+			const BvhNode& node = nodes[entry.node];
+			GpuBvhNode& target = flattened[next++];
+			target.boundsMin = node.boundsMin;
+			target.boundsMax = node.boundsMax;
+			target.miss = entry.miss;
+			if (node.count > 0) {
+				target.leaf = (node.count << BVH_LEAF_FIRST_BITS) | node.first;
+				continue;
+			}
+			target.leaf = 0;
+			stack.push_back(Entry{ node.first + 1, entry.miss });
+			stack.push_back(Entry{ node.first, next + subtreeSize[node.first] });
+		}
+	}
+
+	const std::vector<BvhNode>& InstanceBvh::GetNodes() const
+	{
+		return nodes;
+	}
+
+	const std::vector<ui32>& InstanceBvh::GetIndices() const
+	{
+		return indices;
+	}
+
+	const BvhStats& InstanceBvh::GetStats() const
+	{
+		return stats;
+	}
+
+	const BvhSettings& InstanceBvh::GetSettings() const
+	{
+		return settings;
+	}
+
+	void InstanceBvh::SetSettings(const BvhSettings& s)
+	{
+		settings = s;
+	}
+
+	bool InstanceBvh::IntersectBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& entry)
+	{
+		glm::vec3 t0 = (node.boundsMin - origin) * invDirection;
+		glm::vec3 t1 = (node.boundsMax - origin) * invDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return entry <= exit;
+	}
+
+	void InstanceBvh::UpdateCost()
+	{
+		stats.leafCount = 0;
+		stats.sahCost = 0.f;
+		if (nodes.empty()) {
+			return;
+		}
+		auto area = [](const BvhNode& node) {
+			BvhBounds b{ node.boundsMin, node.boundsMax };
+			return b.HalfArea();
+		};
+		float rootArea = area(nodes[0]);
+		float inverseArea = rootArea > 0.f ? 1.f / rootArea : 0.f;
+		float cost = 0.f;
+		for (const BvhNode& node : nodes) {
+			if (node.count > 0) {
+				stats.leafCount++;
+				cost += area(node) * node.count;
+			}
+			else {
+				cost += area(node) * settings.traversalCost;
+			}
+		}
+		stats.sahCost = cost * inverseArea;
+	}
+}
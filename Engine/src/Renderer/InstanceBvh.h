@@ -0,0 +1,183 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+
+// centroid bins per axis tried by the SAH builder.
+#define BVH_BINS 16
+#define BVH_INVALID 0xFFFFFFFFu
+// flattened leaves pack the first index in the low 24 bits and the count in the high 8.
+#define BVH_LEAF_FIRST_BITS 24
+#define BVH_MAX_LEAF_SIZE 255
+
+namespace Luxel
+{
+	struct BvhBounds
+	{
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		void Grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+		void Grow(const BvhBounds& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+		glm::vec3 Center() const { return (min + max) * 0.5f; }
+		float HalfArea() const
+		{
+			glm::vec3 e = glm::max(max - min, glm::vec3(0.f));
+			return e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+	};
+
+	// 32 bytes. children of an inner node are adjacent and come after it.
+	struct BvhNode
+	{
+		glm::vec3 boundsMin;
+		// first child for inner nodes, first entry of GetIndices for leaves
+		ui32 first;
+		glm::vec3 boundsMax;
+		// instances in the leaf, 0 for inner nodes
+		ui32 count;
+	};
+
+	// depth first node for stackless traversal, layout must match shaders/instance_bvh.glsl.
+	// a hit goes on to the next node, a miss or a finished leaf jumps to miss.
+	struct GpuBvhNode
+	{
+		glm::vec3 boundsMin;
+		// 0 for inner nodes, count << BVH_LEAF_FIRST_BITS | first for leaves
+		ui32 leaf;
+		glm::vec3 boundsMax;
+		// next node once this subtree is done, the node count at the end
+		ui32 miss;
+	};
+
+	struct BvhSettings
+	{
+		// at most BVH_MAX_LEAF_SIZE.
+		ui32 maxLeafSize = 4;
+		// SAH cost of visiting a node relative to testing one instance.
+		float traversalCost = 1.f;
+		// nodes above this many instances bin and build their children on the workers.
+		ui32 parallelThreshold = 4096;
+	};
+
+	struct BvhStats
+	{
+		ui32 instanceCount = 0;
+		ui32 nodeCount = 0;
+		ui32 leafCount = 0;
+		ui32 depth = 0;
+		// expected node visits plus instance tests per ray through the root, grows as refits loosen the tree.
+		float sahCost = 0.f;
+		double buildMilliseconds = 0.0;
+		double refitMilliseconds = 0.0;
+	};
+
+	// top level hierarchy over instance bounds: vehicles, characters and other moving models.
+	// Build sorts the instances with a binned SAH on the workers; Refit keeps the topology and only
+	// grows the boxes again, for instances that moved but did not come or go.
+	class LUXEL_API InstanceBvh
+	{
+	public:
+		InstanceBvh(const BvhSettings& s = BvhSettings{});
+		~InstanceBvh();
+		InstanceBvh(const InstanceBvh&) = delete;
+		void operator=(const InstanceBvh&) = delete;
+
+		void Build(const BvhBounds* bounds, ui32 count);
+		// bounds of the same instances as the last Build, in the same order.
+		void Refit(const BvhBounds* bounds);
+
+		// depth first with miss links, leaves index GetIndices like the nodes do.
+		void Flatten(std::vector<GpuBvhNode>& flattened) const;
+
+		// closest first walk of the leaves the ray enters: func(instance, maxDistance&) may shorten the ray.
+		template<typename Func>
+		void Traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Func&& func) const
+		{
+			if (nodes.empty()) {
+				return;
+			}
+			glm::vec3 invDirection(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+			float entry = 0.f;
+			if (!IntersectBox(nodes[0], origin, invDirection, maxDistance, entry)) {
+				return;
+			}
+			ui32 stack[64];
+			float stackEntry[64];
+			ui32 size = 0;
+			ui32 node = 0;
+			while (true) {
+				const BvhNode& current = nodes[node];
+				if (current.count > 0) {
+					for (ui32 i = 0;i < current.count;i++) {
+						func(indices[current.first + i], maxDistance);
+					}
+				}
+				else {
+					float entryLeft = 0.f, entryRight = 0.f;
+					bool hitLeft = IntersectBox(nodes[current.first], origin, invDirection, maxDistance, entryLeft);
+					bool hitRight = IntersectBox(nodes[current.first + 1], origin, invDirection, maxDistance, entryRight);
+					if (hitLeft && hitRight) {
+						bool leftFirst = entryLeft <= entryRight;
+						stack[size] = leftFirst ? current.first + 1 : current.first;
+						stackEntry[size++] = leftFirst ? entryRight : entryLeft;
+						node = leftFirst ? current.first : current.first + 1;
+						continue;
+					}
+					if (hitLeft || hitRight) {
+						node = hitLeft ? current.first : current.first + 1;
+						continue;
+					}
+				}
+				// pop, skipping subtrees the ray has been shortened past
+				bool found = false;
+				while (size > 0 && !found) {
+					size--;
+					found = stackEntry[size] <= maxDistance;
+					node = stack[size];
+				}
+				if (!found) {
+					return;
+				}
+			}
+		}
+
+		const std::vector<BvhNode>& GetNodes() const;
+		const std::vector<ui32>& GetIndices() const;
+		const BvhStats& GetStats() const;
+
+		const BvhSettings& GetSettings() const;
+		void SetSettings(const BvhSettings& s);
+
+		static bool IntersectBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& entry);
+
+	private:
+		// instance box with its index, moved around by the partitions so the builder reads them in order
+		struct BuildEntry
+		{
+			glm::vec3 min;
+			ui32 index;
+			glm::vec3 max;
+			float padding;
+
+			glm::vec3 Center() const { return (min + max) * 0.5f; }
+		};
+
+		// box and centroidBox bound the entries in [begin, end) and their centers.
+		void BuildNode(ui32 node, ui32 begin, ui32 end, ui32 depth, const BvhBounds& box, const BvhBounds& centroidBox);
+		// SAH cost and leaf count of the current boxes, nodes in reverse order are children before parents.
+		void UpdateCost();
+
+		BvhSettings settings;
+		std::vector<BvhNode> nodes;
+		std::vector<ui32> indices;
+		std::vector<BuildEntry> entries;
+		std::atomic<ui32> nodeCount;
+		std::atomic<ui32> depth;
+		BvhStats stats;
+	};
+}
@@ -0,0 +1,207 @@
+#include "pch.h"
+
+#include "IrradianceCache.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// radiance units per fixed point step
+		constexpr float FIXED_POINT_SCALE = 1024.f;
+		constexpr ui32 CHECKSUM_SALT = 0x2545F491u;
+	}
+
+	IrradianceCache::IrradianceCache(const IrradianceCacheSettings& s) :
+		settings{ s }, constants{}, lookups{ 0 }, hits{ 0 }, inserts{ 0 }, failedInserts{ 0 }, usedEntries{ 0 }
+	{
+		constants = MakeConstants(settings);
+		settings.capacity = constants.info.x + 1;
+		entries.resize(settings.capacity);
+		Clear();
+	}
+
+	IrradianceCache::~IrradianceCache()
+	{
+
+	}
+
+	void IrradianceCache::SetCamera(const glm::vec3& position)
+	{
+		constants.camera = glm::vec4(position, settings.cellSize);
+	}
+
+	void IrradianceCache::Clear()
+	{
+		std::fill(entries.begin(), entries.end(), IrradianceCacheEntry{});
+		usedEntries = 0;
+	}
+
+	IrradianceCacheConstants IrradianceCache::MakeConstants(const IrradianceCacheSettings& s)
+	{
+		ui32 capacity = std::bit_ceil(std::max(s.capacity, static_cast<ui32>(IRRADIANCE_CACHE_PROBES)));
+		IrradianceCacheConstants result;
+		result.camera = glm::vec4(0.f, 0.f, 0.f, s.cellSize);
+		result.params = glm::vec4(s.levelDistance, FIXED_POINT_SCALE, s.maxRadiance, static_cast<float>(s.maxSamples));
+		result.info = glm::uvec4(capacity - 1, IRRADIANCE_CACHE_PROBES, s.minSamples, s.maxAge);
+		return result;
+	}
+
+	IrradianceCacheKey IrradianceCache::MakeKey(const IrradianceCacheConstants& constants, const glm::vec3& position, const glm::vec3& normal)
+	{
+		float distance = glm::length(position - glm::vec3(constants.camera));
+		ui32 level = 0;
+		if (distance > constants.params.x) {
+			level = std::min(static_cast<ui32>(std::log2(distance / constants.params.x)) + 1, static_cast<ui32>(IRRADIANCE_CACHE_LEVELS - 1));
+		}
+		float size = constants.camera.w * static_cast<float>(1u << level);
+		// nudged into the surface, so points on a voxel face fall into one cell
+		glm::ivec3 cell = glm::ivec3(glm::floor((position - normal * (size * 1e-3f)) / size));
+
+		glm::vec3 magnitude = glm::abs(normal);
+		ui32 axis = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0 : (magnitude.y >= magnitude.z ? 1 : 2);
+		ui32 face = axis * 2 + (normal[axis] < 0.f ? 1 : 0);
+
+		ui32 hash = HashCombine(HashCombine(HashU32(static_cast<ui32>(cell.x)), static_cast<ui32>(cell.y)), static_cast<ui32>(cell.z));
+		hash = HashCombine(hash, face | (level << 3));
+		IrradianceCacheKey key;
+		key.index = hash & constants.info.x;
+		key.checksum = std::max(HashU32(hash ^ CHECKSUM_SALT), 1u);
+		return key;
+	}
+
+	ui32 IrradianceCache::Find(const IrradianceCacheKey& key) const
+	{
+		// every probe is looked at, evictions leave holes in the middle of a run
+		for (ui32 probe = 0;probe < IRRADIANCE_CACHE_PROBES;probe++) {
+			ui32 slot = (key.index + probe) & constants.info.x;
+			ui32 checksum = std::atomic_ref<ui32>(const_cast<ui32&>(entries[slot].checksum)).load(std::memory_order_relaxed);
+			if (checksum == key.checksum) {
+				return slot;
+			}
+		}
+		return settings.capacity;
+	}
+
+	bool IrradianceCache::Lookup(const glm::vec3& position, const glm::vec3& normal, glm::vec3& radiance) const
+	{
+		lookups.fetch_add(1, std::memory_order_relaxed);
+		ui32 slot = Find(MakeKey(constants, position, normal));
+		if (slot == settings.capacity || entries[slot].radiance.w < static_cast<float>(settings.minSamples)) {
+			return false;
+		}
+		hits.fetch_add(1, std::memory_order_relaxed);
+		radiance = glm::vec3(entries[slot].radiance);
+		return true;
+	}
+
+	bool IrradianceCache::Accumulate(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& radiance)
+	{
+		IrradianceCacheKey key = MakeKey(constants, position, normal);
+		// the key may sit behind a hole an eviction left, so a hole is only claimed when the whole run holds
+		// no match. a thread that claimed the first hole meanwhile is found by the next scan, or makes the
+		// claim fail; either way the key ends up in one entry
+		ui32 slot = settings.capacity;
+		for (ui32 attempt = 0;attempt < IRRADIANCE_CACHE_PROBES && slot == settings.capacity;attempt++) {
+			ui32 empty = settings.capacity;
+			for (ui32 probe = 0;probe < IRRADIANCE_CACHE_PROBES && slot == settings.capacity;probe++) {
+				ui32 candidate = (key.index + probe) & constants.info.x;
+				ui32 checksum = std::atomic_ref<ui32>(entries[candidate].checksum).load(std::memory_order_relaxed);
+				if (checksum == key.checksum) {
+					slot = candidate;
+				}
+				else if (checksum == 0 && empty == settings.capacity) {
+					empty = candidate;
+				}
+			}
+			if (slot != settings.capacity || empty == settings.capacity) {
+				break;
+			}
+			ui32 expected = 0;
+			if (std::atomic_ref<ui32>(entries[empty].checksum).compare_exchange_strong(expected, key.checksum, std::memory_order_relaxed)) {
+				inserts.fetch_add(1, std::memory_order_relaxed);
+				slot = empty;
+			}
+			else if (expected == key.checksum) {
+				slot = empty;
+			}
+		}
+		if (slot == settings.capacity) {
+			failedInserts.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		glm::uvec3 fixed = glm::uvec3(glm::clamp(radiance, 0.f, settings.maxRadiance) * FIXED_POINT_SCALE + glm::vec3(0.5f));
+		IrradianceCacheEntry& entry = entries[slot];
+		std::atomic_ref<ui32>(entry.accumulation.x).fetch_add(fixed.x, std::memory_order_relaxed);
+		std::atomic_ref<ui32>(entry.accumulation.y).fetch_add(fixed.y, std::memory_order_relaxed);
+		std::atomic_ref<ui32>(entry.accumulation.z).fetch_add(fixed.z, std::memory_order_relaxed);
+		std::atomic_ref<ui32>(entry.accumulation.w).fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void IrradianceCache::Resolve()
+	{
+		std::atomic<ui32> used{ 0 };
+		JobSystem::ParallelFor(settings.capacity, 4096, [&](ui32 begin, ui32 end) {
+			ui32 count = 0;
+			for (ui32 i = begin;i < end;i++) {
+				IrradianceCacheEntry& entry = entries[i];
+				if (entry.checksum == 0) {
+					continue;
+				}
+				ui32 samples = entry.accumulation.w;
+				if (samples > 0) {
+					glm::vec3 mean = glm::vec3(entry.accumulation) / (FIXED_POINT_SCALE * static_cast<float>(samples));
+					// a frame with more than maxSamples samples replaces the history
+					float length = std::max(std::min(entry.radiance.w + static_cast<float>(samples), static_cast<float>(settings.maxSamples)),
+						static_cast<float>(samples));
+					entry.radiance = glm::vec4(glm::mix(glm::vec3(entry.radiance), mean, static_cast<float>(samples) / length), length);
+					entry.accumulation = glm::uvec4(0);
+					entry.age = 0;
+				}
+				else if (++entry.age > settings.maxAge) {
+					entry = IrradianceCacheEntry{};
+					continue;
+				}
+				count++;
+			}
+			used.fetch_add(count, std::memory_order_relaxed);
+		});
+		usedEntries = used.load();
+	}
+
+	const std::vector<IrradianceCacheEntry>& IrradianceCache::GetEntries() const
+	{
+		return entries;
+	}
+
+	IrradianceCacheConstants IrradianceCache::GetConstants() const
+	{
+		return constants;
+	}
+
+	IrradianceCacheStats IrradianceCache::GetStats() const
+	{
+		IrradianceCacheStats stats;
+		stats.lookups = lookups.load();
+		stats.hits = hits.load();
+		stats.inserts = inserts.load();
+		stats.failedInserts = failedInserts.load();
+		stats.usedEntries = usedEntries;
+		stats.memoryBytes = entries.size() * sizeof(IrradianceCacheEntry);
+		return stats;
+	}
+
+	void IrradianceCache::ResetStats()
+	{
+		lookups = 0;
+		hits = 0;
+		inserts = 0;
+		failedInserts = 0;
+	}
+
+	const IrradianceCacheSettings& IrradianceCache::GetSettings() const
+	{
+		return settings;
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Sampler.h"
+
+// linear probes per key before an insert gives up.
+#define IRRADIANCE_CACHE_PROBES 8
+// cells double in size per level, up to this many levels.
+#define IRRADIANCE_CACHE_LEVELS 16
+
+namespace Luxel
+{
+	struct IrradianceCacheSettings
+	{
+		// entries, rounded up to a power of two.
+		ui32 capacity = 1 << 20;
+		// cell edge in voxels near the camera.
+		float cellSize = 1.f;
+		// cells double in size every time the camera distance doubles past this.
+		float levelDistance = 32.f;
+		// history length cap, the cache forgets with weight 1 / maxSamples per sample after it.
+		ui32 maxSamples = 64;
+		// samples an entry needs before lookups return it.
+		ui32 minSamples = 4;
+		// frames without a new sample before an entry is evicted.
+		ui32 maxAge = 32;
+		// samples are clamped to this before the fixed point sum.
+		float maxRadiance = 256.f;
+	};
+
+	// one hash table slot, layout must match shaders/irradiance_cache.glsl.
+	struct IrradianceCacheEntry
+	{
+		// second hash of the key, 0 for a free slot
+		ui32 checksum;
+		// frames since the last sample
+		ui32 age;
+		ui32 padding[2];
+		// samples of the current frame: fixed point radiance sum in rgb, count in a
+		glm::uvec4 accumulation;
+		// resolved radiance in rgb, history length in a
+		glm::vec4 radiance;
+	};
+
+	// binding 0 of the cache in shaders/irradiance_cache.glsl.
+	struct IrradianceCacheConstants
+	{
+		// xyz camera position, w cell size
+		glm::vec4 camera;
+		// levelDistance, fixed point scale, maxRadiance, maxSamples
+		glm::vec4 params;
+		// capacity - 1, probes, minSamples, maxAge
+		glm::uvec4 info;
+	};
+
+	// counters written by lookups and inserts, and by the resolve for the entries in use.
+	struct IrradianceCacheStats
+	{
+		ui64 lookups = 0;
+		ui64 hits = 0;
+		ui64 inserts = 0;
+		// keys that found no free slot within the probe range
+		ui64 failedInserts = 0;
+		ui32 usedEntries = 0;
+		size_t memoryBytes = 0;
+
+		float HitRate() const { return lookups > 0 ? static_cast<float>(hits) / static_cast<float>(lookups) : 0.f; }
+	};
+
+	// key of a world position: cell coordinates at a level picked by camera distance, and the
+	// axis aligned face the normal points along. index and checksum are two hashes of the key.
+	struct IrradianceCacheKey
+	{
+		ui32 index;
+		ui32 checksum;
+	};
+
+	// world space radiance cache in a hash grid: path samples are summed into the entry of the cell
+	// they hit and folded into a running mean once per frame, so later bounces can stop at a lookup.
+	// Lookup and Accumulate may run on many threads at once, Resolve runs alone.
+	// the same slots, hashes and resolve run on the GPU, see IrradianceCachePass.
+	class LUXEL_API IrradianceCache
+	{
+	public:
+		IrradianceCache(const IrradianceCacheSettings& s = IrradianceCacheSettings{});
+		~IrradianceCache();
+		IrradianceCache(const IrradianceCache&) = delete;
+		void operator=(const IrradianceCache&) = delete;
+
+		// cell sizes grow with the distance to this point.
+		void SetCamera(const glm::vec3& position);
+		void Clear();
+
+		// radiance leaving the surface at position, false when the cell has too few samples.
+		bool Lookup(const glm::vec3& position, const glm::vec3& normal, glm::vec3& radiance) const;
+		// adds one sample, inserting the cell when it is new. false when the table is full around the key.
+		bool Accumulate(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& radiance);
+
+		// folds this frame's samples into the entries, ages and evicts the rest.
+		void Resolve();
+
+		const std::vector<IrradianceCacheEntry>& GetEntries() const;
+		IrradianceCacheConstants GetConstants() const;
+		IrradianceCacheStats GetStats() const;
+		void ResetStats();
+
+		const IrradianceCacheSettings& GetSettings() const;
+
+		// capacity rounded up, camera at the origin.
+		static IrradianceCacheConstants MakeConstants(const IrradianceCacheSettings& s);
+		static IrradianceCacheKey MakeKey(const IrradianceCacheConstants& constants, const glm::vec3& position, const glm::vec3& normal);
+
+	private:
+		// slot holding key, the capacity when it is absent.
+		ui32 Find(const IrradianceCacheKey& key) const;
+
+		IrradianceCacheSettings settings;
+		IrradianceCacheConstants constants;
+		// accessed through std::atomic_ref while lookups and inserts run
+		std::vector<IrradianceCacheEntry> entries;
+
+		mutable std::atomic<ui64> lookups;
+		mutable std::atomic<ui64> hits;
+		std::atomic<ui64> inserts;
+		std::atomic<ui64> failedInserts;
+		ui32 usedEntries;
+	};
+}
@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#include "IrradianceCachePass.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 GROUP_SIZE = 64;
+		constexpr ui32 BINDING_COUNT = 3;
+	}
+
+	IrradianceCachePass::IrradianceCachePass(Device* const d, const std::string& shaderPath, const IrradianceCacheSettings& s) :
+		device{ d }, settings{ s }, constants{}, frameIndex{ 0 }, clearPending{ true }
+	{
+		constants = IrradianceCache::MakeConstants(settings);
+		settings.capacity = constants.info.x + 1;
+
+		pipeline = std::make_unique<ComputePipeline>(device, shaderPath, BINDING_COUNT, 0, MAX_FRAMES_IN_FLIGHT);
+		entryBuffer = std::make_unique<Buffer>(device, static_cast<VkDeviceSize>(settings.capacity) * sizeof(IrradianceCacheEntry),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT;i++) {
+			constantBuffers[i] = std::make_unique<Buffer>(device, sizeof(IrradianceCacheConstants), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			constantMapped[i] = constantBuffers[i]->Map();
+			statsBuffers[i] = std::make_unique<Buffer>(device, sizeof(GpuIrradianceCacheStats),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			statsMapped[i] = statsBuffers[i]->Map();
+			statsPending[i] = false;
+
+			descriptorSets.push_back(pipeline->AllocateDescriptorSet());
+			pipeline->UpdateDescriptorSet(descriptorSets[i], {
+				constantBuffers[i]->GetBuffer(), entryBuffer->GetBuffer(), statsBuffers[i]->GetBuffer() });
+		}
+		stats.memoryBytes = static_cast<size_t>(settings.capacity) * sizeof(IrradianceCacheEntry);
+	}
+
+	IrradianceCachePass::~IrradianceCachePass()
+	{
+		Info("Destroy irradiance cache pass.");
+		vkQueueWaitIdle(device->GetGraphicsQueue());
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT;i++) {
+			constantBuffers[i]->Unmap();
+			statsBuffers[i]->Unmap();
+		}
+		pipeline.reset();
+	}
+
+	void IrradianceCachePass::SetCamera(const glm::vec3& position)
+	{
+		constants.camera = glm::vec4(position, settings.cellSize);
+	}
+
+	void IrradianceCachePass::Clear()
+	{
+		clearPending = true;
+	}
+
+	void IrradianceCachePass::Begin(VkCommandBuffer commandBuffer)
+	{
+		frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+		if (statsPending[frameIndex]) {
+			GpuIrradianceCacheStats frameStats;
+			std::memcpy(&frameStats, statsMapped[frameIndex], sizeof(frameStats));
+			stats.lookups += frameStats.lookups;
+			stats.hits += frameStats.hits;
+			stats.inserts += frameStats.inserts;
+			stats.failedInserts += frameStats.failedInserts;
+			stats.usedEntries = frameStats.usedEntries;
+			statsPending[frameIndex] = false;
+		}
+		std::memcpy(constantMapped[frameIndex], &constants, sizeof(constants));
+
+		if (clearPending) {
+			vkCmdFillBuffer(commandBuffer, entryBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+			clearPending = false;
+		}
+		vkCmdFillBuffer(commandBuffer, statsBuffers[frameIndex]->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+		ComputePipeline::MemoryBarrier(commandBuffer);
+	}
+
+	void IrradianceCachePass::Resolve(VkCommandBuffer commandBuffer)
+	{
+		ComputePipeline::MemoryBarrier(commandBuffer);
+		pipeline->Bind(commandBuffer, descriptorSets[frameIndex]);
+		pipeline->Dispatch(commandBuffer, (settings.capacity + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+		ComputePipeline::MemoryBarrier(commandBuffer);
+		statsPending[frameIndex] = true;
+	}
+
+	VkBuffer IrradianceCachePass::GetConstantsBuffer() const
+	{
+		return constantBuffers[frameIndex]->GetBuffer();
+	}
+
+	VkBuffer IrradianceCachePass::GetEntryBuffer() const
+	{
+		return entryBuffer->GetBuffer();
+	}
+
+	VkBuffer IrradianceCachePass::GetStatsBuffer() const
+	{
+		return statsBuffers[frameIndex]->GetBuffer();
+	}
+
+	IrradianceCacheStats IrradianceCachePass::GetStats() const
+	{
+		return stats;
+	}
+
+	void IrradianceCachePass::ResetStats()
+	{
+		size_t memoryBytes = stats.memoryBytes;
+		stats = IrradianceCacheStats{};
+		stats.memoryBytes = memoryBytes;
+	}
+
+	const IrradianceCacheSettings& IrradianceCachePass::GetSettings() const
+	{
+		return settings;
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Device.h"
+#include "EngineCore/Buffer.h"
+#include "EngineCore/ComputePipeline.h"
+#include "IrradianceCache.h"
+
+namespace Luxel
+{
+	// counters of one frame, layout must match shaders/irradiance_cache.glsl.
+	struct GpuIrradianceCacheStats
+	{
+		ui32 lookups;
+		ui32 hits;
+		ui32 inserts;
+		ui32 failedInserts;
+		ui32 usedEntries;
+		ui32 padding[3];
+	};
+
+	// GPU copy of IrradianceCache: the same entries, keys and resolve, filled by whatever shader
+	// includes shaders/irradiance_cache.glsl between Begin and Resolve.
+	class LUXEL_API IrradianceCachePass
+	{
+	public:
+		IrradianceCachePass(Device* const d, const std::string& shaderPath, const IrradianceCacheSettings& s = IrradianceCacheSettings{});
+		~IrradianceCachePass();
+		IrradianceCachePass(const IrradianceCachePass&) = delete;
+		void operator=(const IrradianceCachePass&) = delete;
+
+		void SetCamera(const glm::vec3& position);
+		// empties the table at the next Begin.
+		void Clear();
+
+		// writes this frame's constants and zeroes its counters, before the shaders that use the cache.
+		// the caller must have waited for the frame that last used this frame slot.
+		void Begin(VkCommandBuffer commandBuffer);
+		// records the resolve of the samples written since Begin.
+		void Resolve(VkCommandBuffer commandBuffer);
+
+		// bindings 0, 1 and 2 of shaders/irradiance_cache.glsl for the frame since the last Begin.
+		VkBuffer GetConstantsBuffer() const;
+		VkBuffer GetEntryBuffer() const;
+		VkBuffer GetStatsBuffer() const;
+
+		// totals up to the last completed frame, MAX_FRAMES_IN_FLIGHT frames behind.
+		IrradianceCacheStats GetStats() const;
+		void ResetStats();
+
+		const IrradianceCacheSettings& GetSettings() const;
+
+	private:
+		Device* const device;
+		IrradianceCacheSettings settings;
+		IrradianceCacheConstants constants;
+
+		std::unique_ptr<ComputePipeline> pipeline;
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		std::unique_ptr<Buffer> entryBuffer;
+		std::array<std::unique_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> constantBuffers;
+		std::array<void*, MAX_FRAMES_IN_FLIGHT> constantMapped;
+		std::array<std::unique_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> statsBuffers;
+		std::array<void*, MAX_FRAMES_IN_FLIGHT> statsMapped;
+		// frames whose counters were not read back yet
+		std::array<bool, MAX_FRAMES_IN_FLIGHT> statsPending;
+
+		ui32 frameIndex;
+		bool clearPending;
+		IrradianceCacheStats stats;
+	};
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+
+#include "RaySorter.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 KEY_GROUP_SIZE = 4096;
+		// 21 bits per axis is all MortonEncode64 interleaves
+		constexpr ui32 MAX_AXIS_BITS = 21;
+
+		inline ui32 Octant(const glm::vec3& direction)
+		{
+			return (direction.x < 0.f ? 1 : 0) | (direction.y < 0.f ? 2 : 0) | (direction.z < 0.f ? 4 : 0);
+		}
+
+		inline glm::ivec3 OriginCell(const glm::vec3& origin, float cellSize)
+		{
+			return glm::ivec3(glm::floor(origin / cellSize));
+		}
+	}
+
+	RaySorter::RaySorter(const RaySortSettings& s) : settings{ s }
+	{
+
+	}
+
+	RaySorter::~RaySorter()
+	{
+
+	}
+
+	ui32 RaySorter::DirectionBin(const glm::vec3& direction, RayBinning binning, ui32 directionBits)
+	{
+		if (binning == RayBinning::Octant) {
+			return Octant(direction);
+		}
+		// zero, infinite and NaN directions all land in bin 0
+		float norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+		if (!(norm > 0.f) || !std::isfinite(norm)) {
+			return 0;
+		}
+		// octahedral map: the unit sphere onto [-1, 1]^2 with bins of similar solid angle
+		glm::vec3 d = direction / norm;
+		glm::vec2 uv(d.x, d.y);
+		if (d.z < 0.f) {
+			uv = glm::vec2((1.f - std::abs(d.y)) * (d.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(d.x)) * (d.y >= 0.f ? 1.f : -1.f));
+		}
+		ui32 resolution = 1u << directionBits;
+		ui32 u = std::min(static_cast<ui32>((uv.x * 0.5f + 0.5f) * resolution), resolution - 1);
+		ui32 v = std::min(static_cast<ui32>((uv.y * 0.5f + 0.5f) * resolution), resolution - 1);
+		return u | (v << directionBits);
+	}
+
+	const std::vector<ui32>& RaySorter::Sort(const TraceRay* rays, ui32 count)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		stats.rayCount = count;
+		keys.resize(count);
+		order.resize(count);
+		if (count == 0) {
+			return order;
+		}
+
+		// origin cells relative to the batch bounds, so the key only spends bits on the occupied extent
+		ui32 groupCount = (count + KEY_GROUP_SIZE - 1) / KEY_GROUP_SIZE;
+		std::vector<glm::ivec3> groupMin(groupCount, glm::ivec3(std::numeric_limits<int>::max()));
+		std::vector<glm::ivec3> groupMax(groupCount, glm::ivec3(std::numeric_limits<int>::min()));
+		JobSystem::ParallelFor(count, KEY_GROUP_SIZE, [&](ui32 begin, ui32 end) {
+			ui32 group = begin / KEY_GROUP_SIZE;
+			for (ui32 i = begin;i < end;i++) {
+				glm::ivec3 cell = OriginCell(rays[i].origin, settings.cellSize);
+				groupMin[group] = glm::min(groupMin[group], cell);
+				groupMax[group] = glm::max(groupMax[group], cell);
+			}
+		});
+		glm::ivec3 cellMin = groupMin[0], cellMax = groupMax[0];
+		for (ui32 group = 1;group < groupCount;group++) {
+			cellMin = glm::min(cellMin, groupMin[group]);
+			cellMax = glm::max(cellMax, groupMax[group]);
+		}
+
+		ui32 directionBits = settings.binning == RayBinning::Octant ? 3 : settings.directionBits * 2;
+		glm::ivec3 extent = cellMax - cellMin;
+		ui32 extentBits = static_cast<ui32>(std::bit_width(static_cast<ui32>(std::max(extent.x, std::max(extent.y, extent.z)))));
+		ui32 axisBits = std::min(extentBits, std::min(MAX_AXIS_BITS, (64 - directionBits) / 3));
+		// cells past what the key can hold share the coarser cell of their top bits
+		ui32 dropBits = extentBits - axisBits;
+
+		JobSystem::ParallelFor(count, KEY_GROUP_SIZE, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				glm::uvec3 cell = glm::uvec3(OriginCell(rays[i].origin, settings.cellSize) - cellMin) >> dropBits;
+				ui64 morton = MortonEncode64(cell.x, cell.y, cell.z);
+				keys[i] = (morton << directionBits) | DirectionBin(rays[i].direction, settings.binning, settings.directionBits);
+				order[i] = i;
+			}
+		});
+		RadixSort::SortPairs(keys, order, axisBits * 3 + directionBits);
+
+		stats.binCount = 1;
+		for (ui32 i = 1;i < count;i++) {
+			stats.binCount += keys[i] != keys[i - 1] ? 1 : 0;
+		}
+		stats.sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		stats.coherenceBefore = Coherence(rays, nullptr, count, settings.cellSize);
+		stats.coherenceAfter = Coherence(rays, order.data(), count, settings.cellSize);
+		return order;
+	}
+
+	void RaySorter::Trace(const VoxelWorld& world, const VoxelDistanceField* field, const TraceRay* rays, ui32 count, RayHit* hits)
+	{
+		Sort(rays, count);
+		auto start = std::chrono::high_resolution_clock::now();
+		JobSystem::ParallelFor(count, settings.batchSize, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				const TraceRay& ray = rays[order[i]];
+				hits[order[i]] = VoxelRaycast::Trace(world, field, ray.origin, ray.direction, ray.maxDistance);
+			}
+		});
+		stats.traceMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	const std::vector<ui32>& RaySorter::GetOrder() const
+	{
+		return order;
+	}
+
+	const RaySortStats& RaySorter::GetStats() const
+	{
+		return stats;
+	}
+
+	const RaySortSettings& RaySorter::GetSettings() const
+	{
+		return settings;
+	}
+
+	void RaySorter::SetSettings(const RaySortSettings& s)
+	{
+		settings = s;
+	}
+
+	float RaySorter::Coherence(const TraceRay* rays, const ui32* order, ui32 count, float cellSize)
+	{
+		if (count < 2) {
+			return 1.f;
+		}
+		ui32 same = 0;
+		for (ui32 i = 1;i < count;i++) {
+			const TraceRay& a = rays[order != nullptr ? order[i - 1] : i - 1];
+			const TraceRay& b = rays[order != nullptr ? order[i] : i];
+			if (OriginCell(a.origin, cellSize) == OriginCell(b.origin, cellSize) && Octant(a.direction) == Octant(b.direction)) {
+				same++;
+			}
+		}
+		return static_cast<float>(same) / static_cast<float>(count - 1);
+	}
+}
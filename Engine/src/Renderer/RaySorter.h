@@ -0,0 +1,90 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "EngineCore/RadixSort.h"
+#include "Voxel/Morton.h"
+#include "Voxel/VoxelWorld.h"
+#include "Voxel/VoxelDistanceField.h"
+#include "Voxel/VoxelRaycast.h"
+
+namespace Luxel
+{
+	struct TraceRay
+	{
+		glm::vec3 origin;
+		float maxDistance;
+		// normalized
+		glm::vec3 direction;
+		ui32 padding;
+	};
+
+	enum class RayBinning
+	{
+		// the sign of each direction component, 8 bins
+		Octant,
+		// octahedral direction map quantized to directionBits per axis
+		Direction
+	};
+
+	struct RaySortSettings
+	{
+		RayBinning binning = RayBinning::Direction;
+		// edge of an origin cell in voxels, a brick by default.
+		float cellSize = 8.f;
+		// 2 * directionBits direction bits in the key for RayBinning::Direction.
+		ui32 directionBits = 3;
+		// rays per job when tracing.
+		ui32 batchSize = 256;
+	};
+
+	struct RaySortStats
+	{
+		ui32 rayCount = 0;
+		// distinct keys among the rays
+		ui32 binCount = 0;
+		// fraction of neighboring rays in the same origin cell and octant, before and after sorting.
+		float coherenceBefore = 0.f;
+		float coherenceAfter = 0.f;
+		double sortMilliseconds = 0.0;
+		double traceMilliseconds = 0.0;
+	};
+
+	// reorders incoherent secondary rays so that neighbors in the trace order start in the same cell
+	// and head the same way: keys are the Morton code of the origin cell above the direction bin,
+	// sorted with a parallel radix sort. tracing walks the sorted order in batches and writes every
+	// hit back to the ray's submission slot.
+	class LUXEL_API RaySorter
+	{
+	public:
+		RaySorter(const RaySortSettings& s = RaySortSettings{});
+		~RaySorter();
+		RaySorter(const RaySorter&) = delete;
+		void operator=(const RaySorter&) = delete;
+
+		// submission indices in trace order.
+		const std::vector<ui32>& Sort(const TraceRay* rays, ui32 count);
+		// sorts, traces on the workers and writes hits[i] for rays[i].
+		void Trace(const VoxelWorld& world, const VoxelDistanceField* field, const TraceRay* rays, ui32 count, RayHit* hits);
+
+		const std::vector<ui32>& GetOrder() const;
+		const RaySortStats& GetStats() const;
+
+		const RaySortSettings& GetSettings() const;
+		void SetSettings(const RaySortSettings& s);
+
+		// order may be nullptr for submission order.
+		static float Coherence(const TraceRay* rays, const ui32* order, ui32 count, float cellSize);
+		static ui32 DirectionBin(const glm::vec3& direction, RayBinning binning, ui32 directionBits);
+
+	private:
+		RaySortSettings settings;
+		std::vector<ui64> keys;
+		std::vector<ui32> order;
+		RaySortStats stats;
+	};
+}
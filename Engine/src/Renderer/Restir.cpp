@@ -0,0 +1,238 @@
+#include "pch.h"
+
+#include "Restir.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr float INV_PI = 0.31830989f;
+		// shadow rays start this far off the surface
+		constexpr float SURFACE_OFFSET = 1e-3f;
+
+		inline float Luminance(const glm::vec3& c)
+		{
+			return c.x * 0.2126f + c.y * 0.7152f + c.z * 0.0722f;
+		}
+
+		// per pixel stream of uniform numbers
+		struct Random
+		{
+			ui32 state;
+
+			float Next()
+			{
+				return SampleToFloat(HashU32(state++));
+			}
+		};
+	}
+
+	RestirDirect::RestirDirect(VoxelWorld* const w, const VoxelLights* const l, ui32 width, ui32 height, const RestirSettings& s) :
+		world{ w }, lights{ l }, distanceField{ nullptr }, width{ 0 }, height{ 0 }, settings{ s }, previousView{},
+		previousLightRevision{ 0 }, current{ 0 }, hasHistory{ false }, frame{ 0 }
+	{
+		Resize(width, height);
+	}
+
+	RestirDirect::~RestirDirect()
+	{
+
+	}
+
+	void RestirDirect::SetDistanceField(const VoxelDistanceField* field)
+	{
+		distanceField = field;
+	}
+
+	void RestirDirect::Resize(ui32 w, ui32 h)
+	{
+		width = w;
+		height = h;
+		size_t count = static_cast<size_t>(w) * h;
+		history[0].assign(count, Reservoir{});
+		history[1].assign(count, Reservoir{});
+		reservoirs.assign(count, Reservoir{});
+		output.assign(count, glm::vec4(0.f));
+		previousGBuffer.assign(count, GBufferTexel{});
+		Reset();
+	}
+
+	void RestirDirect::Reset()
+	{
+		hasHistory = false;
+	}
+
+	const glm::vec4* RestirDirect::Render(const GBufferTexel* gbuffer, const ViewInfo& view)
+	{
+		// indices change whenever the light tables are rebuilt
+		bool reuseHistory = hasHistory && settings.temporalReuse && previousLightRevision == lights->GetRevision();
+		bool hasLights = !lights->GetLights().empty();
+
+		const std::vector<Reservoir>& source = history[current];
+		std::vector<Reservoir>& temporal = history[current ^ 1];
+
+		// initial candidates and temporal reuse, kept as the next frame's history
+		JobSystem::ParallelFor(height, 4, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				for (ui32 x = 0;x < width;x++) {
+					size_t index = static_cast<size_t>(y) * width + x;
+					const GBufferTexel& texel = gbuffer[index];
+					Reservoir reservoir;
+					if (texel.distance <= 0.f || !hasLights) {
+						temporal[index] = reservoir;
+						continue;
+					}
+					Random random{ HashCombine(HashCombine(frame, 0x52u), static_cast<ui32>(index)) };
+					glm::vec3 position = TexelPosition(view, texel, x, y, width, height);
+
+					for (ui32 i = 0;i < settings.initialCandidates;i++) {
+						LightSample sample;
+						if (!lights->SampleTree(position, texel.normal, random.Next(), sample)) {
+							// nothing in front of the surface
+							break;
+						}
+						reservoir.Update(sample.light, TargetPdf(sample.light, position, texel) / sample.pdf, random.Next());
+					}
+					// candidates that were never drawn still count toward M
+					reservoir.count = static_cast<float>(settings.initialCandidates);
+					if (reservoir.light != LIGHT_INVALID) {
+						reservoir.Finalize(TargetPdf(reservoir.light, position, texel));
+						if (settings.visibilityReuse && !Visible(reservoir.light, position, texel.normal)) {
+							reservoir.weight = 0.f;
+						}
+					}
+
+					Reprojection reprojection;
+					if (reuseHistory && Reproject(previousView, previousGBuffer.data(), width, height, position, texel,
+						settings.distanceTolerance, settings.normalTolerance, reprojection)) {
+						// the closest tap, reservoirs can not be blended
+						ui32 best = 0;
+						for (ui32 tap = 1;tap < reprojection.count;tap++) {
+							if (reprojection.weight[tap] > reprojection.weight[best]) {
+								best = tap;
+							}
+						}
+						Reservoir previous = source[reprojection.index[best]];
+						if (previous.light != LIGHT_INVALID) {
+							previous.count = std::min(previous.count, settings.maxHistory * reservoir.count);
+							float weightSum = reservoir.light != LIGHT_INVALID ? reservoir.weight * reservoir.count * TargetPdf(reservoir.light, position, texel) : 0.f;
+							Reservoir merged;
+							merged.Update(reservoir.light, weightSum, random.Next());
+							merged.count = reservoir.count;
+							merged.Merge(previous, TargetPdf(previous.light, position, texel), random.Next());
+							merged.Finalize(merged.light != LIGHT_INVALID ? TargetPdf(merged.light, position, texel) : 0.f);
+							reservoir = merged;
+						}
+					}
+					temporal[index] = reservoir;
+				}
+			}
+		});
+
+		// spatial reuse and shading. the history keeps the reservoirs from before this pass,
+		// feeding the biased spatial result back would darken it further every frame
+		JobSystem::ParallelFor(height, 4, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				for (ui32 x = 0;x < width;x++) {
+					size_t index = static_cast<size_t>(y) * width + x;
+					const GBufferTexel& texel = gbuffer[index];
+					Reservoir reservoir = temporal[index];
+					if (texel.distance <= 0.f || !hasLights) {
+						reservoirs[index] = reservoir;
+						output[index] = glm::vec4(0.f);
+						continue;
+					}
+					Random random{ HashCombine(HashCombine(frame, 0x53u), static_cast<ui32>(index)) };
+					glm::vec3 position = TexelPosition(view, texel, x, y, width, height);
+
+					if (settings.spatialReuse) {
+						Reservoir merged;
+						merged.Merge(reservoir, reservoir.light != LIGHT_INVALID ? TargetPdf(reservoir.light, position, texel) : 0.f, random.Next());
+						for (ui32 i = 0;i < settings.spatialNeighbors;i++) {
+							float radius = settings.spatialRadius * std::sqrt(random.Next());
+							float angle = 6.28318531f * random.Next();
+							int nx = static_cast<int>(x) + static_cast<int>(std::round(radius * std::cos(angle)));
+							int ny = static_cast<int>(y) + static_cast<int>(std::round(radius * std::sin(angle)));
+							if (nx < 0 || ny < 0 || nx >= static_cast<int>(width) || ny >= static_cast<int>(height)) {
+								continue;
+							}
+							size_t neighborIndex = static_cast<size_t>(ny) * width + nx;
+							const GBufferTexel& neighborTexel = gbuffer[neighborIndex];
+							const Reservoir& neighbor = temporal[neighborIndex];
+							if (neighborIndex == index || neighborTexel.distance <= 0.f || neighbor.light == LIGHT_INVALID ||
+								std::abs(neighborTexel.distance - texel.distance) > settings.distanceTolerance * texel.distance ||
+								glm::dot(neighborTexel.normal, texel.normal) < settings.normalTolerance) {
+								continue;
+							}
+							merged.Merge(neighbor, TargetPdf(neighbor.light, position, texel), random.Next());
+						}
+						merged.Finalize(merged.light != LIGHT_INVALID ? TargetPdf(merged.light, position, texel) : 0.f);
+						reservoir = merged;
+					}
+
+					glm::vec3 radiance(0.f);
+					if (reservoir.light != LIGHT_INVALID && reservoir.weight > 0.f && Visible(reservoir.light, position, texel.normal)) {
+						glm::vec3 irradiance = VoxelLights::Irradiance(lights->GetLights()[reservoir.light], position, texel.normal);
+						radiance = irradiance * texel.albedo * INV_PI * reservoir.weight;
+					}
+					reservoirs[index] = reservoir;
+					output[index] = glm::vec4(radiance, reservoir.count);
+				}
+			}
+		});
+
+		std::copy(gbuffer, gbuffer + previousGBuffer.size(), previousGBuffer.begin());
+		previousView = view;
+		previousLightRevision = lights->GetRevision();
+		hasHistory = true;
+		current ^= 1;
+		frame++;
+		return output.data();
+	}
+
+	const std::vector<Reservoir>& RestirDirect::GetReservoirs() const
+	{
+		return reservoirs;
+	}
+
+	const RestirSettings& RestirDirect::GetSettings() const
+	{
+		return settings;
+	}
+
+	void RestirDirect::SetSettings(const RestirSettings& s)
+	{
+		settings = s;
+	}
+
+	ui32 RestirDirect::GetWidth() const
+	{
+		return width;
+	}
+
+	ui32 RestirDirect::GetHeight() const
+	{
+		return height;
+	}
+
+	float RestirDirect::TargetPdf(ui32 light, const glm::vec3& position, const GBufferTexel& texel) const
+	{
+		// unshadowed reflected luminance
+		glm::vec3 irradiance = VoxelLights::Irradiance(lights->GetLights()[light], position, texel.normal);
+		return Luminance(irradiance * texel.albedo) * INV_PI;
+	}
+
+	bool RestirDirect::Visible(ui32 light, const glm::vec3& position, const glm::vec3& normal) const
+	{
+		glm::vec3 target = lights->GetLights()[light].position;
+		glm::vec3 origin = position + normal * SURFACE_OFFSET;
+		glm::vec3 offset = target - origin;
+		float distance = glm::length(offset);
+		if (distance <= 0.f) {
+			return true;
+		}
+		// the light voxel itself is the expected hit
+		RayHit hit = VoxelRaycast::Trace(*world, distanceField, origin, offset / distance, distance);
+		return !hit.hit || glm::vec3(hit.voxel) + glm::vec3(0.5f) == target;
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel/VoxelWorld.h"
+#include "Voxel/VoxelDistanceField.h"
+#include "Voxel/VoxelRaycast.h"
+#include "GBuffer.h"
+#include "Sampler.h"
+#include "VoxelLights.h"
+
+namespace Luxel
+{
+	// weighted reservoir holding one light, std430 compatible, layout must match shaders/voxel_lights.glsl.
+	struct Reservoir
+	{
+		ui32 light = LIGHT_INVALID;
+		float weightSum = 0.f;
+		// candidates seen, M
+		float count = 0.f;
+		// unbiased contribution weight W of light, valid after Finalize
+		float weight = 0.f;
+
+		// streams one candidate in, u is uniform in [0, 1).
+		bool Update(ui32 candidate, float candidateWeight, float u)
+		{
+			weightSum += candidateWeight;
+			count += 1.f;
+			if (candidateWeight > 0.f && u * weightSum < candidateWeight) {
+				light = candidate;
+				return true;
+			}
+			return false;
+		}
+
+		// streams a finalized reservoir in, targetPdf is the target of its light at the receiving pixel.
+		bool Merge(const Reservoir& other, float targetPdf, float u)
+		{
+			float previousCount = count;
+			bool chosen = Update(other.light, targetPdf * other.weight * other.count, u);
+			count = previousCount + other.count;
+			return chosen;
+		}
+
+		void Finalize(float targetPdf)
+		{
+			weight = targetPdf > 0.f && count > 0.f ? weightSum / (count * targetPdf) : 0.f;
+		}
+	};
+
+	struct RestirSettings
+	{
+		// lights drawn from the light tree per pixel and frame.
+		ui32 initialCandidates = 16;
+		ui32 spatialNeighbors = 4;
+		// in pixels
+		float spatialRadius = 16.f;
+		// the reused history counts at most maxHistory times the fresh candidates.
+		float maxHistory = 20.f;
+		bool temporalReuse = true;
+		bool spatialReuse = true;
+		// traces the initial pick before reuse so occluded lights do not spread to neighbors.
+		bool visibilityReuse = true;
+		// reuse is rejected between pixels that differ more than this in relative distance or normal cosine.
+		float distanceTolerance = 0.05f;
+		float normalTolerance = 0.9f;
+	};
+
+	// CPU reference of direct lighting from many emissive voxels with reservoir resampling:
+	// candidates from the light tree, then temporal and spatial reuse of the chosen light.
+	// spatial reuse weighs neighbors with 1 / M and skips their visibility, which is biased near shadows.
+	class LUXEL_API RestirDirect
+	{
+	public:
+		RestirDirect(VoxelWorld* const w, const VoxelLights* const l, ui32 width, ui32 height,
+			const RestirSettings& s = RestirSettings{});
+		~RestirDirect();
+		RestirDirect(const RestirDirect&) = delete;
+		void operator=(const RestirDirect&) = delete;
+
+		// optional, speeds up the shadow rays.
+		void SetDistanceField(const VoxelDistanceField* field);
+
+		void Resize(ui32 w, ui32 h);
+		void Reset();
+
+		// the lights have to be updated before. returns the direct radiance reflected toward the camera
+		// in rgb and the reservoir M in a, zero for sky texels.
+		const glm::vec4* Render(const GBufferTexel* gbuffer, const ViewInfo& view);
+		const std::vector<Reservoir>& GetReservoirs() const;
+
+		const RestirSettings& GetSettings() const;
+		void SetSettings(const RestirSettings& s);
+		ui32 GetWidth() const;
+		ui32 GetHeight() const;
+
+	private:
+		float TargetPdf(ui32 light, const glm::vec3& position, const GBufferTexel& texel) const;
+		bool Visible(ui32 light, const glm::vec3& position, const glm::vec3& normal) const;
+
+		VoxelWorld* const world;
+		const VoxelLights* const lights;
+		const VoxelDistanceField* distanceField;
+		ui32 width, height;
+		RestirSettings settings;
+
+		std::array<std::vector<Reservoir>, 2> history;
+		// after spatial reuse, the ones that were shaded
+		std::vector<Reservoir> reservoirs;
+		std::vector<glm::vec4> output;
+		std::vector<GBufferTexel> previousGBuffer;
+		ViewInfo previousView;
+		ui64 previousLightRevision;
+		ui32 current;
+		bool hasHistory;
+		ui32 frame;
+	};
+}
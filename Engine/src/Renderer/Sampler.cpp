@@ -0,0 +1,185 @@
+#include "pch.h"
+
+#include "Sampler.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 TILE_PIXELS = BLUE_NOISE_SIZE * BLUE_NOISE_SIZE;
+		constexpr float CLUSTER_SIGMA = 1.5f;
+		// share of the tile set in the initial pattern
+		constexpr ui32 INITIAL_DIVISOR = 10;
+	}
+
+	BlueNoiseTile::BlueNoiseTile(ui32 seed)
+	{
+		static_assert((BLUE_NOISE_SIZE & (BLUE_NOISE_SIZE - 1)) == 0, "BLUE_NOISE_SIZE must be a power of two.");
+		constexpr ui32 mask = BLUE_NOISE_SIZE - 1;
+
+		// gaussian energy by toroidal offset
+		std::vector<float> kernel(TILE_PIXELS);
+		for (ui32 dy = 0;dy < BLUE_NOISE_SIZE;dy++) {
+			for (ui32 dx = 0;dx < BLUE_NOISE_SIZE;dx++) {
+				float x = static_cast<float>(std::min(dx, BLUE_NOISE_SIZE - dx));
+				float y = static_cast<float>(std::min(dy, BLUE_NOISE_SIZE - dy));
+				kernel[dx + dy * BLUE_NOISE_SIZE] = std::exp(-(x * x + y * y) / (2.f * CLUSTER_SIGMA * CLUSTER_SIGMA));
+			}
+		}
+
+		std::vector<ui8> pattern(TILE_PIXELS, 0);
+		std::vector<float> energy(TILE_PIXELS, 0.f);
+		auto splat = [&](ui32 p, float sign) {
+			ui32 px = p & mask, py = p / BLUE_NOISE_SIZE;
+			for (ui32 y = 0;y < BLUE_NOISE_SIZE;y++) {
+				const float* row = kernel.data() + ((y - py) & mask) * BLUE_NOISE_SIZE;
+				float* target = energy.data() + y * BLUE_NOISE_SIZE;
+				for (ui32 x = 0;x < BLUE_NOISE_SIZE;x++) {
+					target[x] += sign * row[(x - px) & mask];
+				}
+			}
+		};
+		auto tightestCluster = [&] {
+			ui32 best = 0;
+			float bestEnergy = -std::numeric_limits<float>::max();
+			for (ui32 p = 0;p < TILE_PIXELS;p++) {
+				if (pattern[p] != 0 && energy[p] > bestEnergy) {
+					bestEnergy = energy[p];
+					best = p;
+				}
+			}
+			return best;
+		};
+		auto largestVoid = [&] {
+			ui32 best = 0;
+			float bestEnergy = std::numeric_limits<float>::max();
+			for (ui32 p = 0;p < TILE_PIXELS;p++) {
+				if (pattern[p] == 0 && energy[p] < bestEnergy) {
+					bestEnergy = energy[p];
+					best = p;
+				}
+			}
+			return best;
+		};
+
+		ui32 ones = TILE_PIXELS / INITIAL_DIVISOR;
+		ui32 state = HashU32(seed ^ 0x2545F491u);
+		for (ui32 placed = 0;placed < ones;) {
+			state = HashU32(state);
+			ui32 p = state % TILE_PIXELS;
+			if (pattern[p] == 0) {
+				pattern[p] = 1;
+				splat(p, 1.f);
+				placed++;
+			}
+		}
+
+		// relax: move the tightest cluster into the largest void until that is where it came from
+		for (ui32 iteration = 0;iteration < TILE_PIXELS;iteration++) {
+			ui32 cluster = tightestCluster();
+			pattern[cluster] = 0;
+			splat(cluster, -1.f);
+			ui32 hole = largestVoid();
+			pattern[hole] = 1;
+			splat(hole, 1.f);
+			if (hole == cluster) {
+				break;
+			}
+		}
+		std::vector<ui8> initialPattern = pattern;
+		std::vector<float> initialEnergy = energy;
+
+		ranks.assign(TILE_PIXELS, 0);
+		// ranks below the initial pattern: strip clusters one by one
+		for (ui32 rank = ones;rank-- > 0;) {
+			ui32 cluster = tightestCluster();
+			pattern[cluster] = 0;
+			splat(cluster, -1.f);
+			ranks[cluster] = static_cast<ui16>(rank);
+		}
+		// ranks above it: fill voids until the tile is full
+		pattern = std::move(initialPattern);
+		energy = std::move(initialEnergy);
+		for (ui32 rank = ones;rank < TILE_PIXELS;rank++) {
+			ui32 hole = largestVoid();
+			pattern[hole] = 1;
+			splat(hole, 1.f);
+			ranks[hole] = static_cast<ui16>(rank);
+		}
+	}
+
+	BlueNoiseTile::~BlueNoiseTile()
+	{
+
+	}
+
+	ui32 BlueNoiseTile::Rank(ui32 x, ui32 y) const
+	{
+		return ranks[(x & (BLUE_NOISE_SIZE - 1)) + (y & (BLUE_NOISE_SIZE - 1)) * BLUE_NOISE_SIZE];
+	}
+
+	float BlueNoiseTile::Value(ui32 x, ui32 y) const
+	{
+		return (static_cast<float>(Rank(x, y)) + 0.5f) / static_cast<float>(TILE_PIXELS);
+	}
+
+	const std::vector<ui16>& BlueNoiseTile::GetRanks() const
+	{
+		return ranks;
+	}
+
+	Sampler::Sampler(ui32 seed) :
+		seed{ seed }, frameSeed{ 0 }, tile{ seed }
+	{
+		SetFrame(0);
+	}
+
+	Sampler::~Sampler()
+	{
+
+	}
+
+	void Sampler::SetFrame(ui32 frame)
+	{
+		frameSeed = HashCombine(seed, frame);
+	}
+
+	ui32 Sampler::GetFrameSeed() const
+	{
+		return frameSeed;
+	}
+
+	ui32 Sampler::PixelRank(const glm::uvec2& pixel) const
+	{
+		return tile.Rank(pixel.x, pixel.y);
+	}
+
+	float Sampler::Get1D(const glm::uvec2& pixel, ui32 sampleIndex, ui32 dimension) const
+	{
+		return SampleToFloat(SobolOwen(sampleIndex ^ PixelRank(pixel), dimension, frameSeed));
+	}
+
+	glm::vec2 Sampler::Get2D(const glm::uvec2& pixel, ui32 sampleIndex, ui32 dimension) const
+	{
+		ui32 index = sampleIndex ^ PixelRank(pixel);
+		return glm::vec2(SampleToFloat(SobolOwen(index, dimension, frameSeed)), SampleToFloat(SobolOwen(index, dimension + 1, frameSeed)));
+	}
+
+	const BlueNoiseTile& Sampler::GetTile() const
+	{
+		return tile;
+	}
+
+	std::vector<ui32> Sampler::GetGpuData() const
+	{
+		GpuSamplerHeader header{};
+		header.info = glm::uvec4(BLUE_NOISE_SIZE, SOBOL_DIMENSIONS, SOBOL_BITS, 0);
+		std::copy(SobolTables::Matrices.begin(), SobolTables::Matrices.end(), header.sobolMatrices);
+
+		std::vector<ui32> data(sizeof(GpuSamplerHeader) / sizeof(ui32) + TILE_PIXELS);
+		std::memcpy(data.data(), &header, sizeof(header));
+		const auto& tileRanks = tile.GetRanks();
+		std::copy(tileRanks.begin(), tileRanks.end(), data.begin() + sizeof(GpuSamplerHeader) / sizeof(ui32));
+		return data;
+	}
+}
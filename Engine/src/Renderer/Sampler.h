@@ -0,0 +1,176 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+
+// sobol dimensions before the sequence is padded with independently shuffled copies.
+// 4 keeps every even aligned pair of dimensions inside one group.
+#define SOBOL_DIMENSIONS 4
+#define SOBOL_BITS 32
+#define BLUE_NOISE_SIZE 64
+
+namespace Luxel
+{
+	namespace SobolTables
+	{
+		// generator matrix columns, Matrices[d * SOBOL_BITS + k] is xored in for bit k of the index.
+		// direction numbers from Joe and Kuo, dimension 0 is van der Corput.
+		inline constexpr std::array<ui32, SOBOL_DIMENSIONS * SOBOL_BITS> Matrices = [] {
+			// degree s, coefficients a and initial m per dimension after the first
+			constexpr ui32 degree[SOBOL_DIMENSIONS] = { 0, 1, 2, 3 };
+			constexpr ui32 coefficients[SOBOL_DIMENSIONS] = { 0, 0, 1, 1 };
+			constexpr ui32 initial[SOBOL_DIMENSIONS][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 3, 0 }, { 1, 3, 1 } };
+
+			std::array<ui32, SOBOL_DIMENSIONS * SOBOL_BITS> table{};
+			for (ui32 k = 0;k < SOBOL_BITS;k++) {
+				table[k] = 1u << (31 - k);
+			}
+			for (ui32 d = 1;d < SOBOL_DIMENSIONS;d++) {
+				ui32* v = table.data() + d * SOBOL_BITS;
+				ui32 s = degree[d];
+				for (ui32 k = 0;k < s;k++) {
+					v[k] = initial[d][k] << (31 - k);
+				}
+				for (ui32 k = s;k < SOBOL_BITS;k++) {
+					ui32 value = v[k - s] ^ (v[k - s] >> s);
+					for (ui32 i = 1;i < s;i++) {
+						if ((coefficients[d] >> (s - 1 - i)) & 1) {
+							value ^= v[k - i];
+						}
+					}
+					v[k] = value;
+				}
+			}
+			return table;
+		}();
+	}
+
+	inline ui32 ReverseBits(ui32 v)
+	{
+		v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+		v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+		v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+		v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);
+		return (v >> 16) | (v << 16);
+	}
+
+	inline ui32 HashU32(ui32 x)
+	{
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	inline ui32 HashCombine(ui32 seed, ui32 v)
+	{
+		return seed ^ (HashU32(v) + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+	}
+
+	// Laine-Karras style permutation: every bit is flipped by a hash of the bits below it.
+	inline ui32 LaineKarrasPermutation(ui32 x, ui32 seed)
+	{
+		x += seed;
+		x ^= x * 0x6C50B47Cu;
+		x ^= x * 0xB82F1E52u;
+		x ^= x * 0xC7AFE638u;
+		x ^= x * 0x8D22F6E6u;
+		return x;
+	}
+
+	// Owen scrambling on the binary digits of a [0, 1) fixed point value, from the most significant down.
+	// maps aligned blocks of 2^k values onto aligned blocks, so nets stay nets.
+	inline ui32 NestedUniformScramble(ui32 x, ui32 seed)
+	{
+		return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+	}
+
+	inline ui32 Sobol(ui32 index, ui32 dimension)
+	{
+		const ui32* matrix = SobolTables::Matrices.data() + dimension * SOBOL_BITS;
+		ui32 result = 0;
+		for (ui32 k = 0;index != 0;index >>= 1, k++) {
+			if (index & 1) {
+				result ^= matrix[k];
+			}
+		}
+		return result;
+	}
+
+	// any dimension: every SOBOL_DIMENSIONS dimensions shuffle the index with their own seed,
+	// every dimension is scrambled with its own seed (Burley 2020).
+	inline ui32 SobolOwen(ui32 index, ui32 dimension, ui32 seed)
+	{
+		ui32 group = dimension / SOBOL_DIMENSIONS;
+		ui32 shuffled = NestedUniformScramble(index, HashCombine(seed, 0xA511E9B3u ^ group));
+		return NestedUniformScramble(Sobol(shuffled, dimension % SOBOL_DIMENSIONS), HashCombine(seed, dimension));
+	}
+
+	// keeps 24 bits so the float is exact and shaders get the same value.
+	inline float SampleToFloat(ui32 v)
+	{
+		return static_cast<float>(v >> 8) * (1.f / 16777216.f);
+	}
+
+	// BLUE_NOISE_SIZE^2 toroidal void-and-cluster ranks: the pixels with rank < n form a
+	// blue noise pattern for every n. generated once per seed, about a few ms.
+	class LUXEL_API BlueNoiseTile
+	{
+	public:
+		BlueNoiseTile(ui32 seed = 0);
+		~BlueNoiseTile();
+
+		ui32 Rank(ui32 x, ui32 y) const;
+		// rank mapped to (0, 1)
+		float Value(ui32 x, ui32 y) const;
+		const std::vector<ui16>& GetRanks() const;
+
+	private:
+		std::vector<ui16> ranks;
+	};
+
+	// layout of the sampler buffer, must match shaders/sampler.glsl; followed by one ui32 rank per tile pixel.
+	struct GpuSamplerHeader
+	{
+		// tile size, sobol dimensions, sobol bits, 0
+		glm::uvec4 info;
+		ui32 sobolMatrices[SOBOL_DIMENSIONS * SOBOL_BITS];
+	};
+
+	// per pixel sample streams: sample i of a pixel is sobol index i ^ rank, with rank from the blue
+	// noise tile, under one scramble seed per frame. the first 2^k samples of a pixel are an aligned
+	// block, so every pixel sees a (0, k, 2) net in the first two dimensions of each group, and at
+	// 1 spp neighboring pixels take well spread points of the same net, pushing the error toward blue noise.
+	class LUXEL_API Sampler
+	{
+	public:
+		Sampler(ui32 seed = 0);
+		~Sampler();
+		Sampler(const Sampler&) = delete;
+		void operator=(const Sampler&) = delete;
+
+		// a new scramble per frame keeps temporal accumulation unbiased.
+		void SetFrame(ui32 frame);
+		ui32 GetFrameSeed() const;
+
+		ui32 PixelRank(const glm::uvec2& pixel) const;
+		float Get1D(const glm::uvec2& pixel, ui32 sampleIndex, ui32 dimension) const;
+		// dimension should be even so both dimensions sit in the same sobol group,
+		// pairs starting at a multiple of SOBOL_DIMENSIONS stratify best.
+		glm::vec2 Get2D(const glm::uvec2& pixel, ui32 sampleIndex, ui32 dimension) const;
+
+		const BlueNoiseTile& GetTile() const;
+		// GpuSamplerHeader followed by the tile ranks, upload once.
+		std::vector<ui32> GetGpuData() const;
+
+	private:
+		ui32 seed;
+		ui32 frameSeed;
+		BlueNoiseTile tile;
+	};
+}
@@ -0,0 +1,522 @@
+#include "pch.h"
+
+#include "SvgfDenoiser.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr float ALBEDO_EPSILON = 1e-3f;
+		constexpr float WEIGHT_EPSILON = 1e-6f;
+		// pixels with a shorter history get their variance from a spatial estimate
+		constexpr float VARIANCE_HISTORY = 4.f;
+		constexpr int VARIANCE_RADIUS = 3;
+		constexpr float MAX_HISTORY = 255.f;
+
+		// B3 spline, the a-trous kernel is KERNEL[kx] * KERNEL[ky]
+		constexpr float KERNEL[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+		const std::array<float, 25> INVERSE_OFFSET = [] {
+			std::array<float, 25> table{};
+			for (int ky = 0;ky < 5;ky++) {
+				for (int kx = 0;kx < 5;kx++) {
+					int dx = kx - 2, dy = ky - 2;
+					table[kx + ky * 5] = (dx == 0 && dy == 0) ? 0.f : 1.f / std::sqrt(static_cast<float>(dx * dx + dy * dy));
+				}
+			}
+			return table;
+		}();
+
+		inline float Luminance(float r, float g, float b)
+		{
+			return r * 0.2126f + g * 0.7152f + b * 0.0722f;
+		}
+
+		// exp(-e) for e >= 0 through 2^x with a degree 5 polynomial,
+		// the scalar and the AVX2 path share it so they agree up to rounding.
+		inline float ExpNeg(float e)
+		{
+			float x = std::max(-e * 1.44269504f, -126.f);
+			float xi = std::floor(x);
+			float f = x - xi;
+			float p = 1.3333558e-3f;
+			p = p * f + 9.6181291e-3f;
+			p = p * f + 5.5504109e-2f;
+			p = p * f + 2.4022651e-1f;
+			p = p * f + 6.9314718e-1f;
+			p = p * f + 1.f;
+			return p * std::bit_cast<float>((static_cast<int>(xi) + 127) << 23);
+		}
+
+		// the exponent of the edge stopping weight, the normal term is pow(dot, phi) ~ exp(-phi * (1 - dot))
+		// so all four terms share one exp.
+		inline float EdgeStop(float luminanceDistance, float depthDistance, float normalDot, float albedoDistance,
+			float inverseColor, float inverseDepth, float phiNormal, float inverseAlbedo)
+		{
+			return luminanceDistance * inverseColor + depthDistance * inverseDepth + phiNormal * (1.f - normalDot) + albedoDistance * inverseAlbedo;
+		}
+
+#ifdef LUXEL_SIMD_AVX2
+		inline __m256 Abs8(__m256 v)
+		{
+			return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+		}
+
+		inline __m256 Luminance8(__m256 r, __m256 g, __m256 b)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(0.2126f)), _mm256_mul_ps(g, _mm256_set1_ps(0.7152f))),
+				_mm256_mul_ps(b, _mm256_set1_ps(0.0722f)));
+		}
+
+		inline __m256 ExpNeg8(__m256 e)
+		{
+			__m256 x = _mm256_max_ps(_mm256_mul_ps(e, _mm256_set1_ps(-1.44269504f)), _mm256_set1_ps(-126.f));
+			__m256 xi = _mm256_floor_ps(x);
+			__m256 f = _mm256_sub_ps(x, xi);
+			__m256 p = _mm256_set1_ps(1.3333558e-3f);
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.6181291e-3f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.5504109e-2f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.4022651e-1f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.9314718e-1f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.f));
+			__m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(xi), _mm256_set1_epi32(127)), 23);
+			return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+		}
+#endif
+	}
+
+	void SvgfDenoiser::Planes::Resize(size_t count)
+	{
+		r.assign(count, 0.f);
+		g.assign(count, 0.f);
+		b.assign(count, 0.f);
+		variance.assign(count, 0.f);
+	}
+
+	SvgfDenoiser::SvgfDenoiser(ui32 width, ui32 height, const SvgfSettings& s) :
+		width{ 0 }, height{ 0 }, settings{ s }, current{ 0 }, previousView{}, hasHistory{ false }
+	{
+		Resize(width, height);
+	}
+
+	SvgfDenoiser::~SvgfDenoiser()
+	{
+
+	}
+
+	void SvgfDenoiser::Resize(ui32 w, ui32 h)
+	{
+		width = w;
+		height = h;
+		size_t count = static_cast<size_t>(w) * h;
+		for (auto* plane : { &normalX, &normalY, &normalZ, &depth, &depthGradient, &albedoR, &albedoG, &albedoB, &historyLength, &blurredVariance }) {
+			plane->assign(count, 0.f);
+		}
+		filtered[0].Resize(count);
+		filtered[1].Resize(count);
+		illuminationHistory.assign(count, glm::vec4(0.f));
+		moments[0].assign(count, glm::vec4(0.f));
+		moments[1].assign(count, glm::vec4(0.f));
+		previousGBuffer.assign(count, GBufferTexel{});
+		output.assign(count, glm::vec4(0.f));
+		Reset();
+	}
+
+	void SvgfDenoiser::Reset()
+	{
+		hasHistory = false;
+	}
+
+	const glm::vec4* SvgfDenoiser::Denoise(const glm::vec4* color, const GBufferTexel* gbuffer, const ViewInfo& view,
+		const std::vector<InvalidationBox>& boxes)
+	{
+		Temporal(color, gbuffer, view, boxes);
+		EstimateVariance();
+
+		auto feedback = [&](const Planes& planes) {
+			JobSystem::ParallelFor(height, 16, [&](ui32 begin, ui32 end) {
+				for (size_t i = static_cast<size_t>(begin) * width;i < static_cast<size_t>(end) * width;i++) {
+					illuminationHistory[i] = glm::vec4(planes.r[i], planes.g[i], planes.b[i], 0.f);
+				}
+			});
+		};
+
+		ui32 source = 1;
+		ui32 levels = std::max(settings.levels, 1u);
+		for (ui32 level = 0;level < levels;level++) {
+			Atrous(filtered[source], filtered[source ^ 1], 1u << level);
+			source ^= 1;
+			if (level == std::min(settings.feedbackLevel, levels - 1)) {
+				feedback(filtered[source]);
+			}
+		}
+
+		const Planes& result = filtered[source];
+		JobSystem::ParallelFor(height, 16, [&](ui32 begin, ui32 end) {
+			for (size_t i = static_cast<size_t>(begin) * width;i < static_cast<size_t>(end) * width;i++) {
+				output[i] = glm::vec4(result.r[i] * albedoR[i], result.g[i] * albedoG[i], result.b[i] * albedoB[i], historyLength[i]);
+			}
+		});
+
+		std::copy(gbuffer, gbuffer + previousGBuffer.size(), previousGBuffer.begin());
+		previousView = view;
+		hasHistory = true;
+		current ^= 1;
+		return output.data();
+	}
+
+	const glm::vec4* SvgfDenoiser::GetOutput() const
+	{
+		return output.data();
+	}
+
+	const SvgfSettings& SvgfDenoiser::GetSettings() const
+	{
+		return settings;
+	}
+
+	void SvgfDenoiser::SetSettings(const SvgfSettings& s)
+	{
+		settings = s;
+	}
+
+	ui32 SvgfDenoiser::GetWidth() const
+	{
+		return width;
+	}
+
+	ui32 SvgfDenoiser::GetHeight() const
+	{
+		return height;
+	}
+
+	void SvgfDenoiser::Temporal(const glm::vec4* color, const GBufferTexel* gbuffer, const ViewInfo& view, const std::vector<InvalidationBox>& boxes)
+	{
+		const std::vector<glm::vec4>& previousMoments = moments[current];
+		std::vector<glm::vec4>& nextMoments = moments[current ^ 1];
+		Planes& target = filtered[0];
+
+		JobSystem::ParallelFor(height, 4, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				for (ui32 x = 0;x < width;x++) {
+					size_t index = static_cast<size_t>(y) * width + x;
+					const GBufferTexel& texel = gbuffer[index];
+					bool sky = texel.distance <= 0.f;
+
+					// filter lighting only, texture detail comes back when remodulating
+					glm::vec3 albedo = sky ? glm::vec3(1.f) : glm::max(texel.albedo, glm::vec3(ALBEDO_EPSILON));
+					glm::vec3 illumination = glm::vec3(color[index]) / albedo;
+					float luminance = Luminance(illumination.x, illumination.y, illumination.z);
+					glm::vec2 moment(luminance, luminance * luminance);
+					float length = 1.f;
+
+					glm::vec3 position = TexelPosition(view, texel, x, y, width, height);
+					Reprojection reprojection;
+					if (hasHistory && (sky || !InsideAnyBox(position, boxes)) &&
+						Reproject(previousView, previousGBuffer.data(), width, height, position, texel,
+							settings.distanceTolerance, settings.normalTolerance, reprojection)) {
+						glm::vec3 previousIllumination(0.f);
+						glm::vec3 previousMoment(0.f);
+						for (ui32 tap = 0;tap < reprojection.count;tap++) {
+							previousIllumination += glm::vec3(illuminationHistory[reprojection.index[tap]]) * reprojection.weight[tap];
+							previousMoment += glm::vec3(previousMoments[reprojection.index[tap]]) * reprojection.weight[tap];
+						}
+						previousIllumination /= reprojection.weightSum;
+						previousMoment /= reprojection.weightSum;
+
+						length = std::min(previousMoment.z + 1.f, MAX_HISTORY);
+						illumination = glm::mix(previousIllumination, illumination, std::max(settings.colorAlpha, 1.f / length));
+						moment = glm::mix(glm::vec2(previousMoment.x, previousMoment.y), moment, std::max(settings.momentsAlpha, 1.f / length));
+					}
+
+					nextMoments[index] = glm::vec4(moment, length, 0.f);
+					target.r[index] = illumination.x;
+					target.g[index] = illumination.y;
+					target.b[index] = illumination.z;
+					target.variance[index] = std::max(0.f, moment.y - moment.x * moment.x);
+
+					normalX[index] = texel.normal.x;
+					normalY[index] = texel.normal.y;
+					normalZ[index] = texel.normal.z;
+					depth[index] = sky ? 0.f : texel.distance;
+					albedoR[index] = albedo.x;
+					albedoG[index] = albedo.y;
+					albedoB[index] = albedo.z;
+					historyLength[index] = length;
+				}
+			}
+		});
+
+		// smallest depth step to a neighbor per axis, so silhouettes do not widen the depth edge stop
+		JobSystem::ParallelFor(height, 8, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				for (ui32 x = 0;x < width;x++) {
+					size_t index = static_cast<size_t>(y) * width + x;
+					float d = depth[index];
+					if (d <= 0.f) {
+						depthGradient[index] = 0.f;
+						continue;
+					}
+					auto step = [&](bool valid, size_t neighbor) {
+						float dq = valid ? depth[neighbor] : 0.f;
+						return dq > 0.f ? std::abs(dq - d) : std::numeric_limits<float>::max();
+					};
+					float gx = std::min(step(x > 0, index - 1), step(x + 1 < width, index + 1));
+					float gy = std::min(step(y > 0, index - width), step(y + 1 < height, index + width));
+					gx = gx == std::numeric_limits<float>::max() ? 0.f : gx;
+					gy = gy == std::numeric_limits<float>::max() ? 0.f : gy;
+					depthGradient[index] = std::max({ gx, gy, d * 1e-3f });
+				}
+			}
+		});
+	}
+
+	void SvgfDenoiser::EstimateVariance()
+	{
+		const Planes& source = filtered[0];
+		Planes& target = filtered[1];
+		const std::vector<glm::vec4>& currentMoments = moments[current ^ 1];
+
+		JobSystem::ParallelFor(height, 4, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				for (ui32 x = 0;x < width;x++) {
+					size_t p = static_cast<size_t>(y) * width + x;
+					float dp = depth[p];
+					float length = historyLength[p];
+					if (dp <= 0.f || length >= VARIANCE_HISTORY) {
+						target.r[p] = source.r[p];
+						target.g[p] = source.g[p];
+						target.b[p] = source.b[p];
+						target.variance[p] = source.variance[p];
+						continue;
+					}
+
+					// too little history for temporal moments, estimate them over the neighborhood
+					float inverseDepth = 1.f / (settings.phiDepth * depthGradient[p] + WEIGHT_EPSILON);
+					glm::vec3 sum(0.f);
+					glm::vec2 momentSum(0.f);
+					float weightSum = 0.f;
+					for (int dy = -VARIANCE_RADIUS;dy <= VARIANCE_RADIUS;dy++) {
+						int qy = static_cast<int>(y) + dy;
+						if (qy < 0 || qy >= static_cast<int>(height)) {
+							continue;
+						}
+						for (int dx = -VARIANCE_RADIUS;dx <= VARIANCE_RADIUS;dx++) {
+							int qx = static_cast<int>(x) + dx;
+							if (qx < 0 || qx >= static_cast<int>(width)) {
+								continue;
+							}
+							size_t q = static_cast<size_t>(qy) * width + qx;
+							float normalDot = normalX[p] * normalX[q] + normalY[p] * normalY[q] + normalZ[p] * normalZ[q];
+							if (depth[q] <= 0.f || normalDot <= 0.f) {
+								continue;
+							}
+							float offset = std::sqrt(static_cast<float>(dx * dx + dy * dy));
+							float weight = ExpNeg(std::abs(depth[q] - dp) * inverseDepth / std::max(offset, 1.f) +
+								settings.phiNormal * (1.f - normalDot));
+							sum += glm::vec3(source.r[q], source.g[q], source.b[q]) * weight;
+							momentSum += glm::vec2(currentMoments[q]) * weight;
+							weightSum += weight;
+						}
+					}
+					// zero normals (sky, background) match no neighbor, not even themselves
+					if (weightSum <= 0.f) {
+						target.r[p] = source.r[p];
+						target.g[p] = source.g[p];
+						target.b[p] = source.b[p];
+						target.variance[p] = source.variance[p];
+						continue;
+					}
+					sum /= weightSum;
+					momentSum /= weightSum;
+					target.r[p] = sum.x;
+					target.g[p] = sum.y;
+					target.b[p] = sum.z;
+					// boost the spatial estimate while the history is short
+					target.variance[p] = std::max(0.f, momentSum.y - momentSum.x * momentSum.x) * VARIANCE_HISTORY / length;
+				}
+			}
+		});
+	}
+
+	void SvgfDenoiser::Atrous(const Planes& source, Planes& target, ui32 step)
+	{
+		// the luminance edge stop uses a 3x3 gaussian of the variance
+		JobSystem::ParallelFor(height, 8, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				ui32 y0 = y > 0 ? y - 1 : y;
+				ui32 y1 = y + 1 < height ? y + 1 : y;
+				for (ui32 x = 0;x < width;x++) {
+					ui32 x0 = x > 0 ? x - 1 : x;
+					ui32 x1 = x + 1 < width ? x + 1 : x;
+					auto row = [&](ui32 ry) {
+						const float* v = source.variance.data() + static_cast<size_t>(ry) * width;
+						return v[x0] * 0.25f + v[x] * 0.5f + v[x1] * 0.25f;
+					};
+					blurredVariance[static_cast<size_t>(y) * width + x] = row(y0) * 0.25f + row(y) * 0.5f + row(y1) * 0.25f;
+				}
+			}
+		});
+
+		JobSystem::ParallelFor(height, 4, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				ui32 x = 0;
+#ifdef LUXEL_SIMD_AVX2
+				// pixels whose taps stay inside the row take the SIMD path
+				ui32 border = std::min(2 * step, width);
+				ui32 interior = width > 4 * step ? (width - 4 * step) / 8 * 8 : 0;
+				AtrousSpan(source, target, y, 0, border, step);
+				AtrousSpanAVX2(source, target, y, border, border + interior, step);
+				x = border + interior;
+#endif
+				AtrousSpan(source, target, y, x, width, step);
+			}
+		});
+	}
+
+	void SvgfDenoiser::AtrousSpan(const Planes& source, Planes& target, ui32 y, ui32 begin, ui32 end, ui32 step) const
+	{
+		float inverseAlbedo = 1.f / settings.phiAlbedo;
+		for (ui32 x = begin;x < end;x++) {
+			size_t p = static_cast<size_t>(y) * width + x;
+			float dp = depth[p];
+			if (dp <= 0.f) {
+				target.r[p] = source.r[p];
+				target.g[p] = source.g[p];
+				target.b[p] = source.b[p];
+				target.variance[p] = source.variance[p];
+				continue;
+			}
+
+			float luminanceP = Luminance(source.r[p], source.g[p], source.b[p]);
+			float inverseColor = 1.f / (settings.phiColor * std::sqrt(blurredVariance[p]) + WEIGHT_EPSILON);
+			float inverseDepth = 1.f / (settings.phiDepth * depthGradient[p] * static_cast<float>(step) + WEIGHT_EPSILON);
+
+			float center = KERNEL[2] * KERNEL[2];
+			float sumR = source.r[p] * center, sumG = source.g[p] * center, sumB = source.b[p] * center;
+			float sumVariance = source.variance[p] * center * center;
+			float weightSum = center;
+			for (int ky = 0;ky < 5;ky++) {
+				int qy = static_cast<int>(y) + (ky - 2) * static_cast<int>(step);
+				if (qy < 0 || qy >= static_cast<int>(height)) {
+					continue;
+				}
+				for (int kx = 0;kx < 5;kx++) {
+					int qx = static_cast<int>(x) + (kx - 2) * static_cast<int>(step);
+					if ((kx == 2 && ky == 2) || qx < 0 || qx >= static_cast<int>(width)) {
+						continue;
+					}
+					size_t q = static_cast<size_t>(qy) * width + qx;
+					float normalDot = normalX[p] * normalX[q] + normalY[p] * normalY[q] + normalZ[p] * normalZ[q];
+					if (depth[q] <= 0.f || normalDot <= 0.f) {
+						continue;
+					}
+					float albedoDistance = std::abs(albedoR[q] - albedoR[p]) + std::abs(albedoG[q] - albedoG[p]) + std::abs(albedoB[q] - albedoB[p]);
+					float e = EdgeStop(std::abs(Luminance(source.r[q], source.g[q], source.b[q]) - luminanceP), std::abs(depth[q] - dp), normalDot,
+						albedoDistance, inverseColor, inverseDepth * INVERSE_OFFSET[kx + ky * 5], settings.phiNormal, inverseAlbedo);
+					float weight = KERNEL[kx] * KERNEL[ky] * ExpNeg(e);
+					sumR += source.r[q] * weight;
+					sumG += source.g[q] * weight;
+					sumB += source.b[q] * weight;
+					sumVariance += source.variance[q] * weight * weight;
+					weightSum += weight;
+				}
+			}
+			target.r[p] = sumR / weightSum;
+			target.g[p] = sumG / weightSum;
+			target.b[p] = sumB / weightSum;
+			target.variance[p] = sumVariance / (weightSum * weightSum);
+		}
+	}
+
+#ifdef LUXEL_SIMD_AVX2
+	void SvgfDenoiser::AtrousSpanAVX2(const Planes& source, Planes& target, ui32 y, ui32 begin, ui32 end, ui32 step) const
+	{
+		// 8 neighboring pixels read 8 neighboring taps, so every tap is one unaligned load per plane
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 epsilon = _mm256_set1_ps(WEIGHT_EPSILON);
+		const __m256 phiColor = _mm256_set1_ps(settings.phiColor);
+		const __m256 phiNormal = _mm256_set1_ps(settings.phiNormal);
+		const __m256 depthScale = _mm256_set1_ps(settings.phiDepth * static_cast<float>(step));
+		const __m256 inverseAlbedo = _mm256_set1_ps(1.f / settings.phiAlbedo);
+		const __m256 center = _mm256_set1_ps(KERNEL[2] * KERNEL[2]);
+
+		for (ui32 x = begin;x < end;x += 8) {
+			size_t p = static_cast<size_t>(y) * width + x;
+			__m256 dp = _mm256_loadu_ps(depth.data() + p);
+			__m256 rp = _mm256_loadu_ps(source.r.data() + p);
+			__m256 gp = _mm256_loadu_ps(source.g.data() + p);
+			__m256 bp = _mm256_loadu_ps(source.b.data() + p);
+			__m256 vp = _mm256_loadu_ps(source.variance.data() + p);
+			__m256 nxp = _mm256_loadu_ps(normalX.data() + p);
+			__m256 nyp = _mm256_loadu_ps(normalY.data() + p);
+			__m256 nzp = _mm256_loadu_ps(normalZ.data() + p);
+			__m256 arp = _mm256_loadu_ps(albedoR.data() + p);
+			__m256 agp = _mm256_loadu_ps(albedoG.data() + p);
+			__m256 abp = _mm256_loadu_ps(albedoB.data() + p);
+
+			__m256 luminanceP = Luminance8(rp, gp, bp);
+			__m256 inverseColor = _mm256_div_ps(one, _mm256_add_ps(_mm256_mul_ps(phiColor, _mm256_sqrt_ps(_mm256_loadu_ps(blurredVariance.data() + p))), epsilon));
+			__m256 inverseDepth = _mm256_div_ps(one, _mm256_add_ps(_mm256_mul_ps(depthScale, _mm256_loadu_ps(depthGradient.data() + p)), epsilon));
+
+			__m256 sumR = _mm256_mul_ps(rp, center);
+			__m256 sumG = _mm256_mul_ps(gp, center);
+			__m256 sumB = _mm256_mul_ps(bp, center);
+			__m256 sumVariance = _mm256_mul_ps(vp, _mm256_mul_ps(center, center));
+			__m256 weightSum = center;
+
+			for (int ky = 0;ky < 5;ky++) {
+				int qy = static_cast<int>(y) + (ky - 2) * static_cast<int>(step);
+				if (qy < 0 || qy >= static_cast<int>(height)) {
+					continue;
+				}
+				for (int kx = 0;kx < 5;kx++) {
+					if (kx == 2 && ky == 2) {
+						continue;
+					}
+					size_t q = static_cast<size_t>(qy) * width + x + (kx - 2) * static_cast<int>(step);
+					__m256 dq = _mm256_loadu_ps(depth.data() + q);
+					__m256 normalDot = _mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(nxp, _mm256_loadu_ps(normalX.data() + q)),
+						_mm256_mul_ps(nyp, _mm256_loadu_ps(normalY.data() + q))),
+						_mm256_mul_ps(nzp, _mm256_loadu_ps(normalZ.data() + q)));
+					__m256 valid = _mm256_and_ps(_mm256_cmp_ps(dq, zero, _CMP_GT_OQ), _mm256_cmp_ps(normalDot, zero, _CMP_GT_OQ));
+					if (_mm256_movemask_ps(valid) == 0) {
+						continue;
+					}
+
+					__m256 rq = _mm256_loadu_ps(source.r.data() + q);
+					__m256 gq = _mm256_loadu_ps(source.g.data() + q);
+					__m256 bq = _mm256_loadu_ps(source.b.data() + q);
+					__m256 albedoDistance = _mm256_add_ps(_mm256_add_ps(
+						Abs8(_mm256_sub_ps(_mm256_loadu_ps(albedoR.data() + q), arp)),
+						Abs8(_mm256_sub_ps(_mm256_loadu_ps(albedoG.data() + q), agp))),
+						Abs8(_mm256_sub_ps(_mm256_loadu_ps(albedoB.data() + q), abp)));
+
+					__m256 e = _mm256_mul_ps(Abs8(_mm256_sub_ps(Luminance8(rq, gq, bq), luminanceP)), inverseColor);
+					e = _mm256_add_ps(e, _mm256_mul_ps(_mm256_mul_ps(Abs8(_mm256_sub_ps(dq, dp)), inverseDepth), _mm256_set1_ps(INVERSE_OFFSET[kx + ky * 5])));
+					e = _mm256_add_ps(e, _mm256_mul_ps(phiNormal, _mm256_sub_ps(one, normalDot)));
+					e = _mm256_add_ps(e, _mm256_mul_ps(albedoDistance, inverseAlbedo));
+
+					__m256 weight = _mm256_mul_ps(_mm256_set1_ps(KERNEL[kx] * KERNEL[ky]), ExpNeg8(e));
+					weight = _mm256_and_ps(weight, valid);
+					sumR = _mm256_add_ps(sumR, _mm256_mul_ps(rq, weight));
+					sumG = _mm256_add_ps(sumG, _mm256_mul_ps(gq, weight));
+					sumB = _mm256_add_ps(sumB, _mm256_mul_ps(bq, weight));
+					sumVariance = _mm256_add_ps(sumVariance, _mm256_mul_ps(_mm256_loadu_ps(source.variance.data() + q), _mm256_mul_ps(weight, weight)));
+					weightSum = _mm256_add_ps(weightSum, weight);
+				}
+			}
+
+			// sky lanes pass through unfiltered
+			__m256 sky = _mm256_cmp_ps(dp, zero, _CMP_LE_OQ);
+			__m256 inverseWeight = _mm256_div_ps(one, weightSum);
+			_mm256_storeu_ps(target.r.data() + p, _mm256_blendv_ps(_mm256_mul_ps(sumR, inverseWeight), rp, sky));
+			_mm256_storeu_ps(target.g.data() + p, _mm256_blendv_ps(_mm256_mul_ps(sumG, inverseWeight), gp, sky));
+			_mm256_storeu_ps(target.b.data() + p, _mm256_blendv_ps(_mm256_mul_ps(sumB, inverseWeight), bp, sky));
+			_mm256_storeu_ps(target.variance.data() + p, _mm256_blendv_ps(_mm256_mul_ps(sumVariance, _mm256_mul_ps(inverseWeight, inverseWeight)), vp, sky));
+		}
+	}
+#endif
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "GBuffer.h"
+
+namespace Luxel
+{
+	struct SvgfSettings
+	{
+		// lower bound of the blend weight of the new frame, for illumination and its moments.
+		float colorAlpha = 0.2f;
+		float momentsAlpha = 0.2f;
+		// reprojection rejection, see TemporalSettings.
+		float distanceTolerance = 0.05f;
+		float normalTolerance = 0.9f;
+		// a-trous levels, at least one; level i samples with a step of 1 << i pixels.
+		ui32 levels = 5;
+		// output of this level (or the last one) becomes the next frame's illumination history.
+		ui32 feedbackLevel = 0;
+		// edge stopping: luminance in standard deviations, normal exponent,
+		// depth in local depth gradients and albedo in summed channel difference.
+		float phiColor = 4.f;
+		float phiNormal = 128.f;
+		float phiDepth = 1.f;
+		float phiAlbedo = 0.1f;
+	};
+
+	// spatio-temporal variance guided filter (SVGF) for 1 spp input, CPU reference of the svgf_*.comp shaders.
+	// radiance is demodulated by albedo, accumulated with its luminance moments, and filtered by a-trous
+	// levels whose luminance edge stop follows the estimated variance. the a-trous levels run 8 pixels
+	// at a time with AVX2.
+	class LUXEL_API SvgfDenoiser
+	{
+	public:
+		SvgfDenoiser(ui32 width, ui32 height, const SvgfSettings& s = SvgfSettings{});
+		~SvgfDenoiser();
+		SvgfDenoiser(const SvgfDenoiser&) = delete;
+		void operator=(const SvgfDenoiser&) = delete;
+
+		void Resize(ui32 w, ui32 h);
+		void Reset();
+
+		// color and gbuffer hold width * height texels of the current frame.
+		// returns the denoised radiance in rgb and the history length in a.
+		const glm::vec4* Denoise(const glm::vec4* color, const GBufferTexel* gbuffer, const ViewInfo& view,
+			const std::vector<InvalidationBox>& boxes = {});
+		const glm::vec4* GetOutput() const;
+
+		const SvgfSettings& GetSettings() const;
+		void SetSettings(const SvgfSettings& s);
+		ui32 GetWidth() const;
+		ui32 GetHeight() const;
+
+	private:
+		// illumination and variance, one plane per channel so rows load straight into SIMD registers.
+		struct Planes
+		{
+			std::vector<float> r, g, b, variance;
+
+			void Resize(size_t count);
+		};
+
+		void Temporal(const glm::vec4* color, const GBufferTexel* gbuffer, const ViewInfo& view, const std::vector<InvalidationBox>& boxes);
+		void EstimateVariance();
+		void Atrous(const Planes& source, Planes& target, ui32 step);
+		void AtrousSpan(const Planes& source, Planes& target, ui32 y, ui32 begin, ui32 end, ui32 step) const;
+#ifdef LUXEL_SIMD_AVX2
+		void AtrousSpanAVX2(const Planes& source, Planes& target, ui32 y, ui32 begin, ui32 end, ui32 step) const;
+#endif
+
+		ui32 width, height;
+		SvgfSettings settings;
+
+		// guides of the current frame, also one plane per channel
+		std::vector<float> normalX, normalY, normalZ, depth, depthGradient;
+		std::vector<float> albedoR, albedoG, albedoB;
+		std::vector<float> historyLength;
+
+		std::array<Planes, 2> filtered;
+		std::vector<float> blurredVariance;
+
+		std::vector<glm::vec4> illuminationHistory;
+		// luminance mean, luminance squared mean and history length
+		std::array<std::vector<glm::vec4>, 2> moments;
+		ui32 current;
+		std::vector<GBufferTexel> previousGBuffer;
+		ViewInfo previousView;
+		bool hasHistory;
+
+		std::vector<glm::vec4> output;
+	};
+}
@@ -0,0 +1,167 @@
+#include "pch.h"
+
+#include "SvgfPass.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 GROUP_SIZE = 8;
+	}
+
+	SvgfPass::SvgfPass(Device* const d, ui32 w, ui32 h, const std::string& shaderDirectory,
+		ui32 maxBoxes, const SvgfSettings& s) :
+		device{ d }, width{ w }, height{ h }, maxBoxes{ maxBoxes }, settings{ s }, gbufferInput{ VK_NULL_HANDLE },
+		frameIndex{ 0 }, current{ 0 }, previousView{}, hasHistory{ false }
+	{
+		temporalPipeline = std::make_unique<ComputePipeline>(device, shaderDirectory + "/svgf_temporal.comp.spv", 8, 0, MAX_FRAMES_IN_FLIGHT * 2);
+		variancePipeline = std::make_unique<ComputePipeline>(device, shaderDirectory + "/svgf_variance.comp.spv", 5, 0, MAX_FRAMES_IN_FLIGHT * 2);
+		atrousPipeline = std::make_unique<ComputePipeline>(device, shaderDirectory + "/svgf_atrous.comp.spv", 6,
+			static_cast<ui32>(sizeof(LevelConstants)), MAX_FRAMES_IN_FLIGHT * 4);
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT * 2;i++) {
+			temporalSets.push_back(temporalPipeline->AllocateDescriptorSet());
+			varianceSets.push_back(variancePipeline->AllocateDescriptorSet());
+			atrousSets.push_back(atrousPipeline->AllocateDescriptorSet());
+			atrousSets.push_back(atrousPipeline->AllocateDescriptorSet());
+		}
+
+		VkDeviceSize frameSize = sizeof(SvgfFrameConstants) + static_cast<VkDeviceSize>(maxBoxes) * sizeof(InvalidationBox);
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT;i++) {
+			frameBuffers[i] = std::make_unique<Buffer>(device, frameSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frameMapped[i] = frameBuffers[i]->Map();
+		}
+
+		VkDeviceSize pixelCount = static_cast<VkDeviceSize>(width) * height;
+		auto storage = [&](VkDeviceSize size, VkBufferUsageFlags usage) {
+			return std::make_unique<Buffer>(device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		};
+		for (ui32 i = 0;i < 2;i++) {
+			momentBuffers[i] = storage(pixelCount * sizeof(glm::vec4), 0);
+			illuminationBuffers[i] = storage(pixelCount * sizeof(glm::vec4), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+		}
+		illuminationHistory = storage(pixelCount * sizeof(glm::vec4), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		previousGBuffer = storage(pixelCount * sizeof(GBufferTexel), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		outputBuffer = storage(pixelCount * sizeof(glm::vec4), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	}
+
+	SvgfPass::~SvgfPass()
+	{
+		Info("Destroy SVGF pass.");
+		vkQueueWaitIdle(device->GetGraphicsQueue());
+		for (auto& frame : frameBuffers) {
+			frame->Unmap();
+		}
+		temporalPipeline.reset();
+		variancePipeline.reset();
+		atrousPipeline.reset();
+	}
+
+	void SvgfPass::SetInputs(VkBuffer color, VkBuffer gbuffer)
+	{
+		gbufferInput = gbuffer;
+		for (ui32 frame = 0;frame < MAX_FRAMES_IN_FLIGHT;frame++) {
+			VkBuffer constants = frameBuffers[frame]->GetBuffer();
+			for (ui32 parity = 0;parity < 2;parity++) {
+				ui32 set = frame * 2 + parity;
+				VkBuffer momentsIn = momentBuffers[parity]->GetBuffer();
+				VkBuffer momentsOut = momentBuffers[parity ^ 1]->GetBuffer();
+				temporalPipeline->UpdateDescriptorSet(temporalSets[set], {
+					constants, gbuffer, color, previousGBuffer->GetBuffer(), illuminationHistory->GetBuffer(),
+					momentsIn, momentsOut, illuminationBuffers[0]->GetBuffer() });
+				variancePipeline->UpdateDescriptorSet(varianceSets[set], {
+					constants, gbuffer, momentsOut, illuminationBuffers[0]->GetBuffer(), illuminationBuffers[1]->GetBuffer() });
+				// direction d reads illumination buffer d ^ 1 and writes buffer d
+				for (ui32 direction = 0;direction < 2;direction++) {
+					atrousPipeline->UpdateDescriptorSet(atrousSets[set * 2 + direction], {
+						constants, gbuffer, momentsOut, illuminationBuffers[direction ^ 1]->GetBuffer(),
+						illuminationBuffers[direction]->GetBuffer(), outputBuffer->GetBuffer() });
+				}
+			}
+		}
+		Reset();
+	}
+
+	void SvgfPass::Reset()
+	{
+		hasHistory = false;
+	}
+
+	VkBuffer SvgfPass::Record(VkCommandBuffer commandBuffer, const ViewInfo& view, const std::vector<InvalidationBox>& boxes)
+	{
+		if (gbufferInput == VK_NULL_HANDLE) {
+			Error("SVGF pass has no inputs.");
+			throw std::runtime_error("SVGF pass has no inputs.");
+		}
+
+		frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+		ui32 boxCount = static_cast<ui32>(boxes.size());
+		// too many edits for the box list: drop the whole history instead
+		bool valid = hasHistory && boxCount <= maxBoxes;
+
+		SvgfFrameConstants constants{};
+		constants.inverseViewProjection = view.inverseViewProjection;
+		constants.previousViewProjection = previousView.viewProjection;
+		constants.position = view.position;
+		constants.previousPosition = previousView.position;
+		constants.extent = glm::uvec4(width, height, valid ? boxCount : 0, valid ? 1 : 0);
+		constants.temporal = glm::vec4(settings.colorAlpha, settings.momentsAlpha, settings.distanceTolerance, settings.normalTolerance);
+		constants.phi = glm::vec4(settings.phiColor, settings.phiNormal, settings.phiDepth, settings.phiAlbedo);
+		ui8* mapped = static_cast<ui8*>(frameMapped[frameIndex]);
+		std::memcpy(mapped, &constants, sizeof(constants));
+		if (valid && boxCount > 0) {
+			std::memcpy(mapped + sizeof(constants), boxes.data(), boxCount * sizeof(InvalidationBox));
+		}
+
+		ui32 set = frameIndex * 2 + current;
+		ComputePipeline::MemoryBarrier(commandBuffer);
+		Dispatch(commandBuffer, *temporalPipeline, temporalSets[set]);
+		Dispatch(commandBuffer, *variancePipeline, varianceSets[set]);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = static_cast<VkDeviceSize>(width) * height * sizeof(glm::vec4);
+		ui32 levels = std::max(settings.levels, 1u);
+		ui32 source = 1;
+		for (ui32 level = 0;level < levels;level++) {
+			LevelConstants levelConstants{ 1u << level, level + 1 == levels ? 1u : 0u };
+			atrousPipeline->Bind(commandBuffer, atrousSets[set * 2 + (source ^ 1)]);
+			atrousPipeline->PushConstants(commandBuffer, &levelConstants);
+			atrousPipeline->Dispatch(commandBuffer, (width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE);
+			ComputePipeline::MemoryBarrier(commandBuffer);
+			source ^= 1;
+			if (level == std::min(settings.feedbackLevel, levels - 1)) {
+				vkCmdCopyBuffer(commandBuffer, illuminationBuffers[source]->GetBuffer(), illuminationHistory->GetBuffer(), 1, &copyRegion);
+			}
+		}
+
+		copyRegion.size = static_cast<VkDeviceSize>(width) * height * sizeof(GBufferTexel);
+		vkCmdCopyBuffer(commandBuffer, gbufferInput, previousGBuffer->GetBuffer(), 1, &copyRegion);
+
+		previousView = view;
+		hasHistory = true;
+		current ^= 1;
+		return outputBuffer->GetBuffer();
+	}
+
+	VkBuffer SvgfPass::GetOutputBuffer() const
+	{
+		return outputBuffer->GetBuffer();
+	}
+
+	const SvgfSettings& SvgfPass::GetSettings() const
+	{
+		return settings;
+	}
+
+	void SvgfPass::SetSettings(const SvgfSettings& s)
+	{
+		settings = s;
+	}
+
+	void SvgfPass::Dispatch(VkCommandBuffer commandBuffer, ComputePipeline& pipeline, VkDescriptorSet descriptorSet)
+	{
+		pipeline.Bind(commandBuffer, descriptorSet);
+		pipeline.Dispatch(commandBuffer, (width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE);
+		ComputePipeline::MemoryBarrier(commandBuffer);
+	}
+}
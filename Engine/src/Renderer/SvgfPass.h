@@ -0,0 +1,91 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Device.h"
+#include "EngineCore/Buffer.h"
+#include "EngineCore/ComputePipeline.h"
+#include "GBuffer.h"
+#include "SvgfDenoiser.h"
+
+namespace Luxel
+{
+	// binding 0 of the svgf_*.comp shaders, followed by the invalidation boxes.
+	struct SvgfFrameConstants
+	{
+		glm::mat4 inverseViewProjection;
+		glm::mat4 previousViewProjection;
+		glm::vec4 position;
+		glm::vec4 previousPosition;
+		// width, height, box count, 1 when the history is valid
+		glm::uvec4 extent;
+		// colorAlpha, momentsAlpha, distanceTolerance, normalTolerance
+		glm::vec4 temporal;
+		// phiColor, phiNormal, phiDepth, phiAlbedo
+		glm::vec4 phi;
+	};
+
+	// GPU SVGF over storage buffers, SvgfDenoiser is its CPU reference.
+	// shaderDirectory holds svgf_temporal, svgf_variance and svgf_atrous .comp.spv.
+	class LUXEL_API SvgfPass
+	{
+	public:
+		SvgfPass(Device* const d, ui32 w, ui32 h, const std::string& shaderDirectory,
+			ui32 maxBoxes = 64, const SvgfSettings& s = SvgfSettings{});
+		~SvgfPass();
+		SvgfPass(const SvgfPass&) = delete;
+		void operator=(const SvgfPass&) = delete;
+
+		// color holds a vec4 and gbuffer a GBufferTexel per pixel; not while frames are in flight.
+		void SetInputs(VkBuffer color, VkBuffer gbuffer);
+		void Reset();
+
+		// records all stages and the G-buffer copy for the next frame,
+		// returns the buffer holding the result (rgb radiance, a history length).
+		VkBuffer Record(VkCommandBuffer commandBuffer, const ViewInfo& view, const std::vector<InvalidationBox>& boxes = {});
+		VkBuffer GetOutputBuffer() const;
+
+		const SvgfSettings& GetSettings() const;
+		void SetSettings(const SvgfSettings& s);
+
+	private:
+		struct LevelConstants
+		{
+			ui32 step;
+			ui32 last;
+		};
+
+		void Dispatch(VkCommandBuffer commandBuffer, ComputePipeline& pipeline, VkDescriptorSet descriptorSet);
+
+		Device* const device;
+		ui32 width, height;
+		ui32 maxBoxes;
+		SvgfSettings settings;
+
+		std::unique_ptr<ComputePipeline> temporalPipeline;
+		std::unique_ptr<ComputePipeline> variancePipeline;
+		std::unique_ptr<ComputePipeline> atrousPipeline;
+		// temporal and variance sets per frame in flight and moments parity,
+		// a-trous sets additionally per ping-pong direction
+		std::vector<VkDescriptorSet> temporalSets;
+		std::vector<VkDescriptorSet> varianceSets;
+		std::vector<VkDescriptorSet> atrousSets;
+
+		std::array<std::unique_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> frameBuffers;
+		std::array<void*, MAX_FRAMES_IN_FLIGHT> frameMapped;
+		std::array<std::unique_ptr<Buffer>, 2> momentBuffers;
+		std::array<std::unique_ptr<Buffer>, 2> illuminationBuffers;
+		std::unique_ptr<Buffer> illuminationHistory;
+		std::unique_ptr<Buffer> previousGBuffer;
+		std::unique_ptr<Buffer> outputBuffer;
+		VkBuffer gbufferInput;
+
+		ui32 frameIndex;
+		ui32 current;
+		ViewInfo previousView;
+		bool hasHistory;
+	};
+}
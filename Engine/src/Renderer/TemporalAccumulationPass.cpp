@@ -0,0 +1,121 @@
+#include "pch.h"
+
+#include "TemporalAccumulationPass.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 GROUP_SIZE = 8;
+		constexpr ui32 BINDING_COUNT = 6;
+	}
+
+	TemporalAccumulationPass::TemporalAccumulationPass(Device* const d, ui32 w, ui32 h, const std::string& shaderPath,
+		ui32 maxBoxes, const TemporalSettings& s) :
+		device{ d }, width{ w }, height{ h }, maxBoxes{ maxBoxes }, settings{ s }, gbufferInput{ VK_NULL_HANDLE },
+		frameIndex{ 0 }, current{ 0 }, previousView{}, hasHistory{ false }
+	{
+		pipeline = std::make_unique<ComputePipeline>(device, shaderPath, BINDING_COUNT, 0, MAX_FRAMES_IN_FLIGHT * 2);
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT * 2;i++) {
+			descriptorSets.push_back(pipeline->AllocateDescriptorSet());
+		}
+
+		VkDeviceSize frameSize = sizeof(TemporalFrameConstants) + static_cast<VkDeviceSize>(maxBoxes) * sizeof(InvalidationBox);
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT;i++) {
+			frameBuffers[i] = std::make_unique<Buffer>(device, frameSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frameMapped[i] = frameBuffers[i]->Map();
+		}
+
+		VkDeviceSize pixelCount = static_cast<VkDeviceSize>(width) * height;
+		for (auto& history : historyBuffers) {
+			history = std::make_unique<Buffer>(device, pixelCount * sizeof(glm::vec4),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		previousGBuffer = std::make_unique<Buffer>(device, pixelCount * sizeof(GBufferTexel),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	TemporalAccumulationPass::~TemporalAccumulationPass()
+	{
+		Info("Destroy temporal accumulation pass.");
+		vkQueueWaitIdle(device->GetGraphicsQueue());
+		for (auto& frame : frameBuffers) {
+			frame->Unmap();
+		}
+		pipeline.reset();
+	}
+
+	void TemporalAccumulationPass::SetInputs(VkBuffer color, VkBuffer gbuffer)
+	{
+		gbufferInput = gbuffer;
+		for (ui32 frame = 0;frame < MAX_FRAMES_IN_FLIGHT;frame++) {
+			for (ui32 direction = 0;direction < 2;direction++) {
+				pipeline->UpdateDescriptorSet(descriptorSets[frame * 2 + direction], {
+					frameBuffers[frame]->GetBuffer(), color, gbuffer, previousGBuffer->GetBuffer(),
+					historyBuffers[direction]->GetBuffer(), historyBuffers[direction ^ 1]->GetBuffer() });
+			}
+		}
+		Reset();
+	}
+
+	void TemporalAccumulationPass::Reset()
+	{
+		hasHistory = false;
+	}
+
+	VkBuffer TemporalAccumulationPass::Record(VkCommandBuffer commandBuffer, const ViewInfo& view, const std::vector<InvalidationBox>& boxes)
+	{
+		if (gbufferInput == VK_NULL_HANDLE) {
+			Error("Temporal accumulation pass has no inputs.");
+			throw std::runtime_error("Temporal accumulation pass has no inputs.");
+		}
+
+		frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+		ui32 boxCount = static_cast<ui32>(boxes.size());
+		// too many edits for the box list: drop the whole history instead
+		bool valid = hasHistory && boxCount <= maxBoxes;
+
+		TemporalFrameConstants constants{};
+		constants.inverseViewProjection = view.inverseViewProjection;
+		constants.previousViewProjection = previousView.viewProjection;
+		constants.position = view.position;
+		constants.previousPosition = previousView.position;
+		constants.extent = glm::uvec4(width, height, valid ? boxCount : 0, valid ? 1 : 0);
+		constants.settings = glm::vec4(settings.maxHistory, settings.distanceTolerance, settings.normalTolerance, 0.f);
+		ui8* mapped = static_cast<ui8*>(frameMapped[frameIndex]);
+		std::memcpy(mapped, &constants, sizeof(constants));
+		if (valid && boxCount > 0) {
+			std::memcpy(mapped + sizeof(constants), boxes.data(), boxCount * sizeof(InvalidationBox));
+		}
+
+		ComputePipeline::MemoryBarrier(commandBuffer);
+		pipeline->Bind(commandBuffer, descriptorSets[frameIndex * 2 + current]);
+		pipeline->Dispatch(commandBuffer, (width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE);
+		ComputePipeline::MemoryBarrier(commandBuffer);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = static_cast<VkDeviceSize>(width) * height * sizeof(GBufferTexel);
+		vkCmdCopyBuffer(commandBuffer, gbufferInput, previousGBuffer->GetBuffer(), 1, &copyRegion);
+
+		previousView = view;
+		hasHistory = true;
+		current ^= 1;
+		return historyBuffers[current]->GetBuffer();
+	}
+
+	VkBuffer TemporalAccumulationPass::GetOutputBuffer() const
+	{
+		return historyBuffers[current]->GetBuffer();
+	}
+
+	const TemporalSettings& TemporalAccumulationPass::GetSettings() const
+	{
+		return settings;
+	}
+
+	void TemporalAccumulationPass::SetSettings(const TemporalSettings& s)
+	{
+		settings = s;
+	}
+}
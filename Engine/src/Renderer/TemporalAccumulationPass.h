@@ -0,0 +1,72 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Device.h"
+#include "EngineCore/Buffer.h"
+#include "EngineCore/ComputePipeline.h"
+#include "GBuffer.h"
+#include "TemporalAccumulator.h"
+
+namespace Luxel
+{
+	// binding 0 of temporal_accumulate.comp, followed by the invalidation boxes.
+	struct TemporalFrameConstants
+	{
+		glm::mat4 inverseViewProjection;
+		glm::mat4 previousViewProjection;
+		glm::vec4 position;
+		glm::vec4 previousPosition;
+		// width, height, box count, 1 when the history is valid
+		glm::uvec4 extent;
+		// maxHistory, distanceTolerance, normalTolerance
+		glm::vec4 settings;
+	};
+
+	// GPU temporal accumulation over storage buffers, TemporalAccumulator is its CPU reference.
+	class LUXEL_API TemporalAccumulationPass
+	{
+	public:
+		TemporalAccumulationPass(Device* const d, ui32 w, ui32 h, const std::string& shaderPath,
+			ui32 maxBoxes = 64, const TemporalSettings& s = TemporalSettings{});
+		~TemporalAccumulationPass();
+		TemporalAccumulationPass(const TemporalAccumulationPass&) = delete;
+		void operator=(const TemporalAccumulationPass&) = delete;
+
+		// color holds a vec4 and gbuffer a GBufferTexel per pixel; not while frames are in flight.
+		void SetInputs(VkBuffer color, VkBuffer gbuffer);
+		void Reset();
+
+		// records the accumulation and the G-buffer copy for the next frame,
+		// returns the buffer holding the result (rgb radiance, a history length).
+		VkBuffer Record(VkCommandBuffer commandBuffer, const ViewInfo& view, const std::vector<InvalidationBox>& boxes = {});
+		VkBuffer GetOutputBuffer() const;
+
+		const TemporalSettings& GetSettings() const;
+		void SetSettings(const TemporalSettings& s);
+
+	private:
+		Device* const device;
+		ui32 width, height;
+		ui32 maxBoxes;
+		TemporalSettings settings;
+
+		std::unique_ptr<ComputePipeline> pipeline;
+		// one set per frame in flight and history direction
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		std::array<std::unique_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> frameBuffers;
+		std::array<void*, MAX_FRAMES_IN_FLIGHT> frameMapped;
+		std::array<std::unique_ptr<Buffer>, 2> historyBuffers;
+		std::unique_ptr<Buffer> previousGBuffer;
+		VkBuffer gbufferInput;
+
+		ui32 frameIndex;
+		ui32 current;
+		ViewInfo previousView;
+		bool hasHistory;
+	};
+}
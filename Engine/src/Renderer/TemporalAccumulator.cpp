@@ -0,0 +1,98 @@
+#include "pch.h"
+
+#include "TemporalAccumulator.h"
+
+namespace Luxel
+{
+	TemporalAccumulator::TemporalAccumulator(ui32 width, ui32 height, const TemporalSettings& s) :
+		width{ 0 }, height{ 0 }, settings{ s }, current{ 0 }, previousView{}, hasHistory{ false }
+	{
+		Resize(width, height);
+	}
+
+	TemporalAccumulator::~TemporalAccumulator()
+	{
+
+	}
+
+	void TemporalAccumulator::Resize(ui32 w, ui32 h)
+	{
+		width = w;
+		height = h;
+		size_t count = static_cast<size_t>(w) * h;
+		history[0].assign(count, glm::vec4(0.f));
+		history[1].assign(count, glm::vec4(0.f));
+		previousGBuffer.assign(count, GBufferTexel{});
+		Reset();
+	}
+
+	void TemporalAccumulator::Reset()
+	{
+		hasHistory = false;
+	}
+
+	const glm::vec4* TemporalAccumulator::Accumulate(const glm::vec4* color, const GBufferTexel* gbuffer, const ViewInfo& view,
+		const std::vector<InvalidationBox>& boxes)
+	{
+		const std::vector<glm::vec4>& source = history[current];
+		std::vector<glm::vec4>& target = history[current ^ 1];
+
+		JobSystem::ParallelFor(height, 4, [&](ui32 begin, ui32 end) {
+			for (ui32 y = begin;y < end;y++) {
+				for (ui32 x = 0;x < width;x++) {
+					size_t index = static_cast<size_t>(y) * width + x;
+					const GBufferTexel& texel = gbuffer[index];
+					glm::vec3 radiance = glm::vec3(color[index]);
+
+					glm::vec3 position = TexelPosition(view, texel, x, y, width, height);
+					Reprojection reprojection;
+					if (!hasHistory || (texel.distance > 0.f && InsideAnyBox(position, boxes)) ||
+						!Reproject(previousView, previousGBuffer.data(), width, height, position, texel,
+							settings.distanceTolerance, settings.normalTolerance, reprojection)) {
+						target[index] = glm::vec4(radiance, 1.f);
+						continue;
+					}
+
+					glm::vec4 sum(0.f);
+					for (ui32 tap = 0;tap < reprojection.count;tap++) {
+						sum += source[reprojection.index[tap]] * reprojection.weight[tap];
+					}
+					glm::vec4 reprojected = sum / reprojection.weightSum;
+					float length = std::min(reprojected.w + 1.f, settings.maxHistory);
+					target[index] = glm::vec4(glm::mix(glm::vec3(reprojected), radiance, 1.f / length), length);
+				}
+			}
+		});
+
+		std::copy(gbuffer, gbuffer + previousGBuffer.size(), previousGBuffer.begin());
+		previousView = view;
+		hasHistory = true;
+		current ^= 1;
+		return history[current].data();
+	}
+
+	const glm::vec4* TemporalAccumulator::GetOutput() const
+	{
+		return history[current].data();
+	}
+
+	const TemporalSettings& TemporalAccumulator::GetSettings() const
+	{
+		return settings;
+	}
+
+	void TemporalAccumulator::SetSettings(const TemporalSettings& s)
+	{
+		settings = s;
+	}
+
+	ui32 TemporalAccumulator::GetWidth() const
+	{
+		return width;
+	}
+
+	ui32 TemporalAccumulator::GetHeight() const
+	{
+		return height;
+	}
+}
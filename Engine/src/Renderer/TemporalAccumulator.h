@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "GBuffer.h"
+
+namespace Luxel
+{
+	struct TemporalSettings
+	{
+		// cap on the history length, the current frame always weighs at least 1 / maxHistory.
+		float maxHistory = 64.f;
+		// relative difference between expected and stored hit distance that rejects a history sample.
+		float distanceTolerance = 0.05f;
+		// minimum cosine between the current and the history normal.
+		float normalTolerance = 0.9f;
+	};
+
+	// CPU reference of shaders/temporal_accumulate.comp: reprojects an HDR history through camera
+	// motion, rejects samples by distance and normal, and resets inside invalidation boxes.
+	class LUXEL_API TemporalAccumulator
+	{
+	public:
+		TemporalAccumulator(ui32 width, ui32 height, const TemporalSettings& s = TemporalSettings{});
+		~TemporalAccumulator();
+		TemporalAccumulator(const TemporalAccumulator&) = delete;
+		void operator=(const TemporalAccumulator&) = delete;
+
+		void Resize(ui32 w, ui32 h);
+		void Reset();
+
+		// color and gbuffer hold width * height texels of the current frame.
+		// returns the accumulated radiance in rgb and the history length in a.
+		const glm::vec4* Accumulate(const glm::vec4* color, const GBufferTexel* gbuffer, const ViewInfo& view,
+			const std::vector<InvalidationBox>& boxes = {});
+		const glm::vec4* GetOutput() const;
+
+		const TemporalSettings& GetSettings() const;
+		void SetSettings(const TemporalSettings& s);
+		ui32 GetWidth() const;
+		ui32 GetHeight() const;
+
+	private:
+		ui32 width, height;
+		TemporalSettings settings;
+
+		std::array<std::vector<glm::vec4>, 2> history;
+		ui32 current;
+		std::vector<GBufferTexel> previousGBuffer;
+		ViewInfo previousView;
+		bool hasHistory;
+	};
+}
@@ -0,0 +1,400 @@
+#include "pch.h"
+
+#include "VoxelBlockLight.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		const glm::ivec3 FACE_OFFSETS[6] = {
+			glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0),
+			glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0),
+			glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+		};
+
+		inline ui32 Channel(ui32 packed, ui32 channel)
+		{
+			return (packed >> (channel * 8)) & 0xFF;
+		}
+
+		inline ui32 HashChunk(const ChunkCoord& coord)
+		{
+			return (static_cast<ui32>(coord.x) * 73856093u) ^ (static_cast<ui32>(coord.y) * 19349663u) ^ (static_cast<ui32>(coord.z) * 83492791u);
+		}
+	}
+
+	class VoxelBlockLight::Walker
+	{
+	public:
+		Walker(VoxelBlockLight& owner) : owner{ owner }, lightCoord{ 0 }, light{ nullptr }, lightCached{ false }, stamped{ nullptr },
+			voxelCoord{ 0 }, voxels{ nullptr }, voxelsCached{ false }
+		{
+
+		}
+
+		ui32 Get(const glm::ivec3& position)
+		{
+			Cache(ToChunkCoord(position));
+			return light != nullptr ? light->light[Chunk::Index(position.x & (CHUNK_SIZE - 1), position.y & (CHUNK_SIZE - 1), position.z & (CHUNK_SIZE - 1))] : 0;
+		}
+
+		ui32 Get(const glm::ivec3& position, ui32 channel)
+		{
+			Cache(ToChunkCoord(position));
+			return light != nullptr ? *Byte(position, channel) : 0;
+		}
+
+		void Set(const glm::ivec3& position, ui32 channel, ui32 level)
+		{
+			ChunkCoord coord = ToChunkCoord(position);
+			Cache(coord);
+			if (light == nullptr) {
+				if (level == 0) {
+					return;
+				}
+				light = owner.AcquireChunk(coord);
+			}
+			if (stamped != light) {
+				light->revision.store(owner.revision, std::memory_order_relaxed);
+				stamped = light;
+			}
+			*Byte(position, channel) = static_cast<ui8>(level);
+		}
+
+		Voxel GetVoxel(const glm::ivec3& position)
+		{
+			ChunkCoord coord = ToChunkCoord(position);
+			if (!voxelsCached || coord != voxelCoord) {
+				voxels = owner.world->GetChunk(coord);
+				voxelCoord = coord;
+				voxelsCached = true;
+			}
+			return voxels != nullptr ? voxels->Get(ToLocalCoord(position)) : Voxel();
+		}
+
+		ui32 GetEmission(const glm::ivec3& position, ui32 channel)
+		{
+			Voxel voxel = GetVoxel(position);
+			return voxel.IsEmpty() ? 0 : Channel(owner.emission[voxel.material], channel);
+		}
+
+	private:
+		void Cache(const ChunkCoord& coord)
+		{
+			if (!lightCached || coord != lightCoord) {
+				light = owner.FindChunk(coord);
+				lightCoord = coord;
+				lightCached = true;
+			}
+		}
+
+		// channels are separate bytes of the word, so each channel job writes only its own
+		ui8* Byte(const glm::ivec3& position, ui32 channel)
+		{
+			ui32 index = Chunk::Index(position.x & (CHUNK_SIZE - 1), position.y & (CHUNK_SIZE - 1), position.z & (CHUNK_SIZE - 1));
+			return reinterpret_cast<ui8*>(light->light.data() + index) + channel;
+		}
+
+		VoxelBlockLight& owner;
+		ChunkCoord lightCoord;
+		LightChunk* light;
+		bool lightCached;
+		LightChunk* stamped;
+		ChunkCoord voxelCoord;
+		const Chunk* voxels;
+		bool voxelsCached;
+	};
+
+	VoxelBlockLight::VoxelBlockLight(VoxelWorld* const w) :
+		world{ w }, emission(1 << 16, 0), emissionChanged{ false }, tableSlots{ 0 }, syncedRevision{ 0 }, revision{ 0 }
+	{
+		RebuildTable();
+	}
+
+	VoxelBlockLight::~VoxelBlockLight()
+	{
+		slots.clear();
+	}
+
+	void VoxelBlockLight::SetEmission(ui16 material, const glm::uvec3& level)
+	{
+		glm::uvec3 clamped = glm::min(level, glm::uvec3(BLOCK_LIGHT_MAX));
+		emission[material] = clamped.x | (clamped.y << 8) | (clamped.z << 16);
+		emissionChanged = true;
+	}
+
+	ui32 VoxelBlockLight::Update()
+	{
+		ui64 worldRevision = world->GetRevision();
+		if (worldRevision == syncedRevision && !emissionChanged) {
+			return 0;
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		revision++;
+
+		// with every level cleared only the sources need seeding
+		bool rebuild = syncedRevision == 0 || emissionChanged;
+		if (emissionChanged) {
+			for (auto& slot : slots) {
+				slot->light.fill(0);
+				slot->revision = revision;
+			}
+			known.clear();
+			syncedRevision = 0;
+			emissionChanged = false;
+		}
+
+		EpochGuard guard;
+		std::vector<std::pair<ChunkCoord, ui64>> scan;
+		for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk != nullptr) {
+				scan.emplace_back(coord, chunk->GetModifiedBricks(syncedRevision));
+				known.insert(coord);
+			}
+		}
+		// removed chunks turned to air as a whole
+		for (auto it = known.begin();it != known.end();) {
+			if (world->GetChunk(*it) == nullptr) {
+				scan.emplace_back(*it, ~0ull);
+				it = known.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		syncedRevision = worldRevision;
+
+		for (auto& channel : queues) {
+			channel.removes.clear();
+			channel.adds.clear();
+			channel.visited = 0;
+		}
+		Walker walker(*this);
+		std::vector<ui32> packed(BRICK_VOLUME);
+		for (const auto& [coord, bricks] : scan) {
+			const Chunk* chunk = world->GetChunk(coord);
+			glm::ivec3 origin = ChunkOrigin(coord);
+			for (ui64 mask = bricks;mask != 0;mask &= mask - 1) {
+				ui32 brick = static_cast<ui32>(std::countr_zero(mask));
+				if (chunk != nullptr) {
+					chunk->DecodeBrick(brick, packed.data());
+				}
+				else {
+					std::fill(packed.begin(), packed.end(), 0);
+				}
+				ui32 offset = Chunk::BrickOffset(brick);
+				for (ui32 i = 0;i < BRICK_VOLUME;i++) {
+					Voxel voxel = Voxel::Unpack(packed[i]);
+					if (rebuild && voxel.IsEmpty()) {
+						continue;
+					}
+					ui32 x, y, z;
+					MortonDecode(offset + i, x, y, z);
+					Seed(walker, origin + glm::ivec3(x, y, z), voxel);
+				}
+			}
+		}
+
+		stats.chunksScanned = static_cast<ui32>(scan.size());
+		stats.seeds = 0;
+		for (const auto& channel : queues) {
+			stats.seeds += static_cast<ui32>(channel.removes.size() + channel.adds.size());
+		}
+		if (stats.seeds != 0) {
+			JobSystem::ParallelFor(BLOCK_LIGHT_CHANNELS, 1, [&](ui32 begin, ui32 end) {
+				EpochGuard jobGuard;
+				for (ui32 channel = begin;channel < end;channel++) {
+					Propagate(channel);
+				}
+			});
+		}
+
+		stats.visited = 0;
+		for (const auto& channel : queues) {
+			stats.visited += channel.visited;
+		}
+		if (tableSlots != slots.size()) {
+			RebuildTable();
+		}
+		stats.litChunks = static_cast<ui32>(slots.size());
+		stats.relightMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats.chunksScanned;
+	}
+
+	void VoxelBlockLight::Seed(Walker& walker, const glm::ivec3& position, const Voxel& voxel)
+	{
+		ui32 word = walker.Get(position);
+		ui32 source = voxel.IsEmpty() ? 0 : emission[voxel.material];
+		for (ui32 channel = 0;channel < BLOCK_LIGHT_CHANNELS;channel++) {
+			ChannelQueues& queue = queues[channel];
+			ui32 level = Channel(word, channel);
+			if (!voxel.IsEmpty()) {
+				// solid voxels hold their own emission and block the rest
+				ui32 target = Channel(source, channel);
+				if (level == target) {
+					continue;
+				}
+				if (level != 0) {
+					walker.Set(position, channel, 0);
+					queue.removes.push_back(LightNode{ position, static_cast<ui8>(level) });
+				}
+				if (target != 0) {
+					walker.Set(position, channel, target);
+					queue.adds.push_back(LightNode{ position, static_cast<ui8>(target) });
+				}
+			}
+			else if (level != 0) {
+				// lit air stays lit only next to a voxel one level brighter, else its source is gone
+				bool supported = false;
+				for (const auto& offset : FACE_OFFSETS) {
+					if (walker.Get(position + offset, channel) == level + 1) {
+						supported = true;
+						break;
+					}
+				}
+				if (!supported) {
+					walker.Set(position, channel, 0);
+					queue.removes.push_back(LightNode{ position, static_cast<ui8>(level) });
+				}
+			}
+			else {
+				// dark air, possibly just opened up, refills from its lit neighbors
+				for (const auto& offset : FACE_OFFSETS) {
+					ui32 neighbor = walker.Get(position + offset, channel);
+					if (neighbor > 1) {
+						queue.adds.push_back(LightNode{ position + offset, static_cast<ui8>(neighbor) });
+					}
+				}
+			}
+		}
+	}
+
+	void VoxelBlockLight::Propagate(ui32 channel)
+	{
+		ChannelQueues& queue = queues[channel];
+		Walker walker(*this);
+
+		// clears everything darker than the removed light that it could have reached, the brighter
+		// voxels met on the way and the sources are where it refills from
+		for (size_t i = 0;i < queue.removes.size();i++) {
+			LightNode node = queue.removes[i];
+			for (const auto& offset : FACE_OFFSETS) {
+				glm::ivec3 neighbor = node.position + offset;
+				ui32 level = walker.Get(neighbor, channel);
+				if (level == 0) {
+					continue;
+				}
+				if (level >= node.level || walker.GetEmission(neighbor, channel) != 0) {
+					queue.adds.push_back(LightNode{ neighbor, static_cast<ui8>(level) });
+					continue;
+				}
+				walker.Set(neighbor, channel, 0);
+				queue.removes.push_back(LightNode{ neighbor, static_cast<ui8>(level) });
+			}
+		}
+
+		for (size_t i = 0;i < queue.adds.size();i++) {
+			LightNode node = queue.adds[i];
+			// the level may have changed since the node was queued
+			ui32 level = walker.Get(node.position, channel);
+			if (level <= 1) {
+				continue;
+			}
+			for (const auto& offset : FACE_OFFSETS) {
+				glm::ivec3 neighbor = node.position + offset;
+				if (walker.Get(neighbor, channel) + 1 >= level || !walker.GetVoxel(neighbor).IsEmpty()) {
+					continue;
+				}
+				walker.Set(neighbor, channel, level - 1);
+				queue.adds.push_back(LightNode{ neighbor, static_cast<ui8>(level - 1) });
+			}
+		}
+		queue.visited = queue.removes.size() + queue.adds.size();
+	}
+
+	VoxelBlockLight::LightChunk* VoxelBlockLight::FindChunk(const ChunkCoord& coord) const
+	{
+		std::shared_lock<std::shared_mutex> lock(chunkMutex);
+		auto it = slotIndices.find(coord);
+		return it != slotIndices.end() ? slots[it->second].get() : nullptr;
+	}
+
+	VoxelBlockLight::LightChunk* VoxelBlockLight::AcquireChunk(const ChunkCoord& coord)
+	{
+		std::unique_lock<std::shared_mutex> lock(chunkMutex);
+		auto [it, inserted] = slotIndices.try_emplace(coord, static_cast<ui32>(slots.size()));
+		if (inserted) {
+			auto chunk = std::make_unique<LightChunk>();
+			chunk->coord = coord;
+			chunk->revision = revision;
+			chunk->light.fill(0);
+			slots.push_back(std::move(chunk));
+		}
+		return slots[it->second].get();
+	}
+
+	void VoxelBlockLight::RebuildTable()
+	{
+		// at most half full, like the scene table
+		ui32 capacity = std::max(16u, std::bit_ceil(static_cast<ui32>(slots.size()) * 2));
+		table.assign(capacity + 1, glm::ivec4(0, 0, 0, static_cast<int>(BLOCK_LIGHT_INVALID)));
+		table[0] = glm::ivec4(static_cast<int>(capacity - 1), 0, 0, 0);
+		for (ui32 slot = 0;slot < slots.size();slot++) {
+			const ChunkCoord& coord = slots[slot]->coord;
+			ui32 index = HashChunk(coord) & (capacity - 1);
+			while (static_cast<ui32>(table[index + 1].w) != BLOCK_LIGHT_INVALID) {
+				index = (index + 1) & (capacity - 1);
+			}
+			table[index + 1] = glm::ivec4(coord, static_cast<int>(slot));
+		}
+		tableSlots = static_cast<ui32>(slots.size());
+	}
+
+	glm::uvec3 VoxelBlockLight::GetLight(const glm::ivec3& position) const
+	{
+		const LightChunk* chunk = FindChunk(ToChunkCoord(position));
+		if (chunk == nullptr) {
+			return glm::uvec3(0);
+		}
+		glm::ivec3 local = ToLocalCoord(position);
+		ui32 word = chunk->light[Chunk::Index(local.x, local.y, local.z)];
+		return glm::uvec3(Channel(word, 0), Channel(word, 1), Channel(word, 2));
+	}
+
+	const std::vector<glm::ivec4>& VoxelBlockLight::GetChunkTable() const
+	{
+		return table;
+	}
+
+	ui32 VoxelBlockLight::GetSlotCount() const
+	{
+		return static_cast<ui32>(slots.size());
+	}
+
+	const ui32* VoxelBlockLight::GetSlotLight(ui32 slot) const
+	{
+		return slots[slot]->light.data();
+	}
+
+	std::vector<ui32> VoxelBlockLight::GetModifiedSlots(ui64 sinceRevision) const
+	{
+		std::vector<ui32> modified;
+		for (ui32 slot = 0;slot < slots.size();slot++) {
+			if (slots[slot]->revision.load(std::memory_order_relaxed) > sinceRevision) {
+				modified.push_back(slot);
+			}
+		}
+		return modified;
+	}
+
+	ui64 VoxelBlockLight::GetRevision() const
+	{
+		return revision;
+	}
+
+	const BlockLightStats& VoxelBlockLight::GetStats() const
+	{
+		return stats;
+	}
+}
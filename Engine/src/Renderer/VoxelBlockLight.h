@@ -0,0 +1,110 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel/Morton.h"
+#include "Voxel/VoxelWorld.h"
+
+#define BLOCK_LIGHT_MAX 15
+#define BLOCK_LIGHT_CHANNELS 3
+#define BLOCK_LIGHT_INVALID 0xFFFFFFFFu
+
+namespace Luxel
+{
+	struct BlockLightStats
+	{
+		// of the last Update
+		ui32 chunksScanned = 0;
+		ui32 seeds = 0;
+		ui64 visited = 0;
+		double relightMilliseconds = 0.0;
+		ui32 litChunks = 0;
+	};
+
+	// baked colored block light for the raster and preview modes. light spreads from emissive voxels through
+	// air, losing one level per voxel, in a flood fill per channel. Update only relights around the bricks
+	// edited since the last call: voxels that lost their source are cleared through a removal queue, the
+	// border of what was cleared and the new sources refill through an add queue, and the three channels run
+	// on the workers at once. layouts below must match shaders/block_light.glsl.
+	class LUXEL_API VoxelBlockLight
+	{
+	public:
+		VoxelBlockLight(VoxelWorld* const w);
+		~VoxelBlockLight();
+		VoxelBlockLight(const VoxelBlockLight&) = delete;
+		void operator=(const VoxelBlockLight&) = delete;
+
+		// level per channel up to BLOCK_LIGHT_MAX, 0 removes it. relights everything at the next Update.
+		void SetEmission(ui16 material, const glm::uvec3& level);
+
+		// returns the number of chunks scanned for changes.
+		ui32 Update();
+
+		glm::uvec3 GetLight(const glm::ivec3& position) const;
+
+		// header (mask, 0, 0, 0) and then (chunk coord, slot) entries with linear probing, hashed as
+		// sceneHashChunk; empty entries have slot BLOCK_LIGHT_INVALID.
+		const std::vector<glm::ivec4>& GetChunkTable() const;
+		ui32 GetSlotCount() const;
+		// CHUNK_VOLUME words in Morton order, red | green << 8 | blue << 16 per voxel.
+		const ui32* GetSlotLight(ui32 slot) const;
+		// slots whose light changed since revision, the ones to upload.
+		std::vector<ui32> GetModifiedSlots(ui64 sinceRevision) const;
+		// bumped by every Update that relit anything.
+		ui64 GetRevision() const;
+		const BlockLightStats& GetStats() const;
+
+	private:
+		struct LightChunk
+		{
+			ChunkCoord coord;
+			std::atomic<ui64> revision{ 0 };
+			// one byte per channel, so the channels never write the same byte
+			std::array<ui32, CHUNK_VOLUME> light;
+		};
+
+		struct LightNode
+		{
+			glm::ivec3 position;
+			ui8 level;
+		};
+
+		struct ChannelQueues
+		{
+			std::vector<LightNode> removes;
+			std::vector<LightNode> adds;
+			ui64 visited = 0;
+		};
+
+		// per thread cache of the last light and world chunk
+		class Walker;
+
+		LightChunk* FindChunk(const ChunkCoord& coord) const;
+		LightChunk* AcquireChunk(const ChunkCoord& coord);
+		void Seed(Walker& walker, const glm::ivec3& position, const Voxel& voxel);
+		void Propagate(ui32 channel);
+		void RebuildTable();
+
+		VoxelWorld* const world;
+		// packed levels per material, 0 for materials that do not emit
+		std::vector<ui32> emission;
+		bool emissionChanged;
+
+		mutable std::shared_mutex chunkMutex;
+		std::vector<std::unique_ptr<LightChunk>> slots;
+		std::unordered_map<ChunkCoord, ui32, ChunkCoordHash> slotIndices;
+		std::vector<glm::ivec4> table;
+		ui32 tableSlots;
+
+		// world chunks as of the last Update, to notice removed ones
+		std::unordered_set<ChunkCoord, ChunkCoordHash> known;
+		ui64 syncedRevision;
+		std::array<ChannelQueues, BLOCK_LIGHT_CHANNELS> queues;
+		ui64 revision;
+		BlockLightStats stats;
+	};
+}
@@ -0,0 +1,658 @@
+#include "pch.h"
+
+#include "VoxelGpuScene.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// index words of the narrowest chunk, 1 bit per voxel
+		constexpr ui32 PALETTE_WORDS_MIN_ORDER = 10;
+		constexpr ui32 PALETTE_ENTRIES_MIN_ORDER = 4;
+		// CHUNK_PALETTE_MAX entries
+		constexpr ui32 PALETTE_ENTRIES_MAX_ORDER = 12;
+	}
+
+	VoxelGpuScene::VoxelGpuScene(Device* const d, VoxelWorld* const w, const VoxelGpuSceneSettings& s) :
+		device{ d }, world{ w }, settings{ s }, stagingUsed{ 0 }, frameIndex{ 0 }, syncedRevision{ 0 },
+		distanceField{ nullptr }, syncedFieldRevision{ 0 }
+	{
+		// keep the load factor at or below one half
+		ui32 hashCapacity = std::bit_ceil(std::max(settings.maxChunks * 2, 16u));
+		hashMask = hashCapacity - 1;
+		hashTable.assign(hashCapacity, GpuHashEntry{ glm::ivec4(0, 0, 0, static_cast<int>(GPU_INVALID_INDEX)) });
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		// the first hash entry is a header holding the mask, the table follows it
+		VkDeviceSize hashSize = (static_cast<VkDeviceSize>(hashCapacity) + 1) * sizeof(GpuHashEntry);
+		hashBuffer = std::make_unique<Buffer>(device, hashSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		nodeBuffer = std::make_unique<Buffer>(device, static_cast<VkDeviceSize>(settings.maxChunks) * sizeof(GpuChunkNode),
+			usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		// a palette chunk is at most one direct chunk of words and one full palette
+		VkDeviceSize chunkBytes = BRICK_COUNT * BRICK_VOLUME * sizeof(ui32);
+		if (settings.paletteChunks) {
+			ui32 wordOrder = std::max(static_cast<ui32>(std::bit_width(settings.maxPaletteWords)) - 1, PALETTE_WORDS_MIN_ORDER + 5);
+			ui32 entryOrder = std::max(static_cast<ui32>(std::bit_width(settings.maxPaletteEntries)) - 1, PALETTE_ENTRIES_MAX_ORDER);
+			wordPool.Init(wordOrder, PALETTE_WORDS_MIN_ORDER);
+			entryPool.Init(entryOrder, PALETTE_ENTRIES_MIN_ORDER);
+			paletteHeaderBuffer = std::make_unique<Buffer>(device, static_cast<VkDeviceSize>(settings.maxChunks) * sizeof(GpuPaletteChunk),
+				usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			paletteWordBuffer = std::make_unique<Buffer>(device, (static_cast<VkDeviceSize>(1) << wordOrder) * sizeof(ui32),
+				usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			paletteEntryBuffer = std::make_unique<Buffer>(device, (static_cast<VkDeviceSize>(1) << entryOrder) * sizeof(ui32),
+				usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			chunkBytes += CHUNK_PALETTE_MAX * sizeof(ui32) + sizeof(GpuPaletteChunk);
+		}
+		else {
+			brickBuffer = std::make_unique<Buffer>(device, static_cast<VkDeviceSize>(settings.maxBricks) * BRICK_VOLUME * sizeof(ui32),
+				usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+
+		std::vector<GpuHashEntry> initialTable(hashCapacity + 1);
+		initialTable[0].entry = glm::ivec4(static_cast<int>(hashMask), 0, 0, 0);
+		std::copy(hashTable.begin(), hashTable.end(), initialTable.begin() + 1);
+		hashBuffer->Upload(initialTable.data(), hashSize);
+
+		// one chunk always fits, whatever the budget, plus room for a full hash table rewrite
+		stagingSize = settings.uploadBudget + sizeof(GpuChunkNode) + chunkBytes + hashSize;
+		for (ui32 i = 0;i < MAX_FRAMES_IN_FLIGHT;i++) {
+			stagingBuffers[i] = std::make_unique<Buffer>(device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			stagingMapped[i] = static_cast<ui8*>(stagingBuffers[i]->Map());
+		}
+
+		// handed out lowest first, so neighboring allocations end up in neighboring memory
+		freeNodes.resize(settings.maxChunks);
+		for (ui32 i = 0;i < settings.maxChunks;i++) {
+			freeNodes[i] = settings.maxChunks - 1 - i;
+		}
+		ui32 brickCount = settings.paletteChunks ? 0 : settings.maxBricks;
+		freeBricks.resize(brickCount);
+		for (ui32 i = 0;i < brickCount;i++) {
+			freeBricks[i] = brickCount - 1 - i;
+		}
+	}
+
+	VoxelGpuScene::~VoxelGpuScene()
+	{
+		Info("Destroy voxel gpu scene.");
+		vkQueueWaitIdle(device->GetGraphicsQueue());
+		for (auto& staging : stagingBuffers) {
+			staging->Unmap();
+			staging.reset();
+		}
+		paletteEntryBuffer.reset();
+		paletteWordBuffer.reset();
+		paletteHeaderBuffer.reset();
+		brickBuffer.reset();
+		nodeBuffer.reset();
+		hashBuffer.reset();
+	}
+
+	const VoxelGpuSceneStats& VoxelGpuScene::Update(VkCommandBuffer commandBuffer)
+	{
+		// chunks stay alive until the bricks are packed
+		EpochGuard guard;
+		GatherChanges();
+		return Upload(commandBuffer);
+	}
+
+	const VoxelGpuSceneStats& VoxelGpuScene::Update(VkCommandBuffer commandBuffer, const VoxelSnapshot& snapshot)
+	{
+		GatherChanges(snapshot);
+		return Upload(commandBuffer);
+	}
+
+	const VoxelGpuSceneStats& VoxelGpuScene::Upload(VkCommandBuffer commandBuffer)
+	{
+		stats = VoxelGpuSceneStats{};
+		frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+		stagingUsed = 0;
+		hashCopies.clear();
+		nodeCopies.clear();
+		brickCopies.clear();
+		paletteHeaderCopies.clear();
+		paletteWordCopies.clear();
+		paletteEntryCopies.clear();
+
+		// slots are assigned serially, then the bricks are packed on the workers
+		std::vector<BrickUpload> uploads;
+		std::vector<std::pair<ui32, GpuChunkNode>> nodes;
+		VkDeviceSize brickBytes = BRICK_VOLUME * sizeof(ui32);
+		VkDeviceSize spent = 0;
+		// bricks and chunks that found no room stay pending until a slot frees up
+		std::vector<std::pair<ChunkCoord, ui64>> retries;
+		bool full = false;
+		for (auto it = pending.begin();it != pending.end() && spent < settings.uploadBudget;) {
+			const ChunkCoord coord = it->first;
+			ui64 dirtyBricks = it->second;
+			it = pending.erase(it);
+
+			const Chunk* chunk = snapshot.IsValid() ? snapshot.GetChunk(coord) : world->GetChunk(coord);
+			if (chunk == nullptr) {
+				continue;
+			}
+
+			auto resident = residents.find(coord);
+			if (resident == residents.end()) {
+				if (freeNodes.empty()) {
+					if (!full) {
+						Warning("Voxel gpu scene is out of chunk nodes, chunk", coord.x, coord.y, coord.z, "waits.");
+					}
+					full = true;
+					retries.emplace_back(coord, dirtyBricks);
+					continue;
+				}
+				resident = residents.emplace(coord, ResidentChunk{}).first;
+				resident->second.node = freeNodes.back();
+				resident->second.slots.fill(GPU_INVALID_INDEX);
+				freeNodes.pop_back();
+				HashInsert(coord, resident->second.node);
+			}
+			ResidentChunk& target = resident->second;
+
+			ui64 brickMask = chunk->GetBrickMask();
+			ui64 retryBricks = 0;
+			if (settings.paletteChunks) {
+				if (!StagePalette(*chunk, target, dirtyBricks, spent)) {
+					if (!full) {
+						Warning("Voxel gpu scene palette pools are full, chunk", coord.x, coord.y, coord.z, "waits.");
+					}
+					full = true;
+					retries.emplace_back(coord, dirtyBricks);
+					// a chunk shipped before keeps its old node and blocks, a new one goes up empty
+					// so its hash entry never leads to what the node held before
+					if (target.firstWord != GPU_INVALID_INDEX) {
+						continue;
+					}
+					brickMask = 0;
+				}
+				dirtyBricks = 0;
+			}
+			while (dirtyBricks != 0) {
+				ui32 brick = static_cast<ui32>(std::countr_zero(dirtyBricks));
+				dirtyBricks &= dirtyBricks - 1;
+
+				if (chunk->IsBrickEmpty(brick)) {
+					if (target.slots[brick] != GPU_INVALID_INDEX) {
+						freeBricks.push_back(target.slots[brick]);
+						target.slots[brick] = GPU_INVALID_INDEX;
+					}
+					continue;
+				}
+				if (target.slots[brick] == GPU_INVALID_INDEX) {
+					if (freeBricks.empty()) {
+						if (!full) {
+							Warning("Voxel gpu scene brick pool is full, bricks wait for a free slot.");
+						}
+						full = true;
+						brickMask &= ~(1ull << brick);
+						retryBricks |= 1ull << brick;
+						continue;
+					}
+					target.slots[brick] = freeBricks.back();
+					freeBricks.pop_back();
+				}
+
+				VkDeviceSize offset = Stage(nullptr, brickBytes);
+				uploads.push_back({ chunk, brick, target.slots[brick], offset });
+				AddCopy(brickCopies, offset, static_cast<VkDeviceSize>(target.slots[brick]) * brickBytes, brickBytes);
+				spent += brickBytes;
+			}
+
+			GpuChunkNode node{};
+			node.coord = glm::ivec4(coord, 0);
+			node.info = glm::uvec4(static_cast<ui32>(brickMask), static_cast<ui32>(brickMask >> 32), 0, 0);
+			for (ui32 brick = 0;brick < BRICK_COUNT;brick++) {
+				node.brickSlots[brick] = (brickMask & (1ull << brick)) != 0 ? target.slots[brick] : GPU_INVALID_INDEX;
+			}
+			const PackedBrickDistances* distances = distanceField != nullptr ? distanceField->GetPacked(coord) : nullptr;
+			if (distances != nullptr) {
+				std::copy(distances->begin(), distances->end(), node.brickDistances);
+			}
+			nodes.emplace_back(target.node, node);
+			spent += sizeof(GpuChunkNode);
+			if (retryBricks != 0) {
+				retries.emplace_back(coord, retryBricks);
+			}
+		}
+		for (const auto& [coord, bricks] : retries) {
+			pending[coord] |= bricks;
+		}
+
+		// nodes are staged after all bricks so consecutive brick slots stay mergeable
+		for (const auto& [index, node] : nodes) {
+			VkDeviceSize offset = Stage(&node, sizeof(GpuChunkNode));
+			AddCopy(nodeCopies, offset, static_cast<VkDeviceSize>(index) * sizeof(GpuChunkNode), sizeof(GpuChunkNode));
+		}
+		stats.nodesUploaded = static_cast<ui32>(nodes.size());
+
+		ui8* mapped = stagingMapped[frameIndex];
+		JobSystem::ParallelFor(static_cast<ui32>(uploads.size()), 16, [&](ui32 begin, ui32 end) {
+			EpochGuard jobGuard;
+			for (ui32 i = begin;i < end;i++) {
+				const BrickUpload& upload = uploads[i];
+				upload.chunk->DecodeBrick(upload.brick, reinterpret_cast<ui32*>(mapped + upload.stagingOffset));
+			}
+		});
+		stats.bricksUploaded = static_cast<ui32>(uploads.size());
+
+		std::sort(dirtyHashEntries.begin(), dirtyHashEntries.end());
+		dirtyHashEntries.erase(std::unique(dirtyHashEntries.begin(), dirtyHashEntries.end()), dirtyHashEntries.end());
+		for (ui32 index : dirtyHashEntries) {
+			VkDeviceSize offset = Stage(&hashTable[index], sizeof(GpuHashEntry));
+			AddCopy(hashCopies, offset, (static_cast<VkDeviceSize>(index) + 1) * sizeof(GpuHashEntry), sizeof(GpuHashEntry));
+		}
+		dirtyHashEntries.clear();
+
+		// the shared buffers are still read by frames in flight: their reads finish before the copies
+		// write, and the copies finish before this frame reads
+		// the palette buffers only get regions with paletteChunks, the brick pool only without
+		std::pair<std::vector<VkBufferCopy>*, Buffer*> targets[6] = {
+			{ &brickCopies, brickBuffer.get() }, { &paletteWordCopies, paletteWordBuffer.get() },
+			{ &paletteEntryCopies, paletteEntryBuffer.get() }, { &paletteHeaderCopies, paletteHeaderBuffer.get() },
+			{ &nodeCopies, nodeBuffer.get() }, { &hashCopies, hashBuffer.get() }
+		};
+		std::vector<VkBufferMemoryBarrier> before;
+		std::vector<VkBufferMemoryBarrier> after;
+		for (const auto& [regions, target] : targets) {
+			if (regions->empty()) {
+				continue;
+			}
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = target->GetBuffer();
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			before.push_back(barrier);
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			after.push_back(barrier);
+		}
+		VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		if (!before.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, static_cast<ui32>(before.size()), before.data(), 0, nullptr);
+		}
+		for (const auto& [regions, target] : targets) {
+			if (regions->empty()) {
+				continue;
+			}
+			vkCmdCopyBuffer(commandBuffer, stagingBuffers[frameIndex]->GetBuffer(), target->GetBuffer(), static_cast<ui32>(regions->size()), regions->data());
+			stats.copyRegions += static_cast<ui32>(regions->size());
+		}
+		if (!after.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages,
+				0, 0, nullptr, static_cast<ui32>(after.size()), after.data(), 0, nullptr);
+		}
+
+		stats.bytesUploaded = stagingUsed;
+		stats.pendingChunks = pending.size();
+		stats.residentBricks = settings.paletteChunks ? 0 : settings.maxBricks - static_cast<ui32>(freeBricks.size());
+		stats.residentWords = wordPool.used;
+		stats.residentEntries = entryPool.used;
+		return stats;
+	}
+
+	void VoxelGpuScene::SetDistanceField(const VoxelDistanceField* field)
+	{
+		distanceField = field;
+		syncedFieldRevision = 0;
+		// every resident node has to pick up the new distances
+		for (const auto& [coord, resident] : residents) {
+			pending.try_emplace(coord, 0);
+		}
+	}
+
+	VkBuffer VoxelGpuScene::GetHashBuffer() const
+	{
+		return hashBuffer->GetBuffer();
+	}
+
+	VkBuffer VoxelGpuScene::GetNodeBuffer() const
+	{
+		return nodeBuffer->GetBuffer();
+	}
+
+	VkBuffer VoxelGpuScene::GetBrickBuffer() const
+	{
+		return brickBuffer != nullptr ? brickBuffer->GetBuffer() : VK_NULL_HANDLE;
+	}
+
+	VkBuffer VoxelGpuScene::GetPaletteHeaderBuffer() const
+	{
+		return paletteHeaderBuffer != nullptr ? paletteHeaderBuffer->GetBuffer() : VK_NULL_HANDLE;
+	}
+
+	VkBuffer VoxelGpuScene::GetPaletteWordBuffer() const
+	{
+		return paletteWordBuffer != nullptr ? paletteWordBuffer->GetBuffer() : VK_NULL_HANDLE;
+	}
+
+	VkBuffer VoxelGpuScene::GetPaletteEntryBuffer() const
+	{
+		return paletteEntryBuffer != nullptr ? paletteEntryBuffer->GetBuffer() : VK_NULL_HANDLE;
+	}
+
+	const VoxelGpuSceneStats& VoxelGpuScene::GetStats() const
+	{
+		return stats;
+	}
+
+	ui32 VoxelGpuScene::Hash(const ChunkCoord& coord)
+	{
+		return (static_cast<ui32>(coord.x) * 73856093u) ^ (static_cast<ui32>(coord.y) * 19349663u) ^ (static_cast<ui32>(coord.z) * 83492791u);
+	}
+
+	void VoxelGpuScene::HashInsert(const ChunkCoord& coord, ui32 node)
+	{
+		ui32 index = Hash(coord) & hashMask;
+		while (static_cast<ui32>(hashTable[index].entry.w) != GPU_INVALID_INDEX) {
+			index = (index + 1) & hashMask;
+		}
+		hashTable[index].entry = glm::ivec4(coord, static_cast<int>(node));
+		dirtyHashEntries.push_back(index);
+	}
+
+	void VoxelGpuScene::HashErase(const ChunkCoord& coord)
+	{
+		ui32 index = Hash(coord) & hashMask;
+		while (glm::ivec3(hashTable[index].entry) != coord) {
+			if (static_cast<ui32>(hashTable[index].entry.w) == GPU_INVALID_INDEX) {
+				return;
+			}
+			index = (index + 1) & hashMask;
+		}
+
+		// backward shift deletion keeps probe chains intact without tombstones
+		ui32 next = index;
+		while (true) {
+			next = (next + 1) & hashMask;
+			if (static_cast<ui32>(hashTable[next].entry.w) == GPU_INVALID_INDEX) {
+				break;
+			}
+			ui32 home = Hash(glm::ivec3(hashTable[next].entry)) & hashMask;
+			bool movable = index <= next ? (home <= index || home > next) : (home <= index && home > next);
+			if (movable) {
+				hashTable[index] = hashTable[next];
+				dirtyHashEntries.push_back(index);
+				index = next;
+			}
+		}
+		hashTable[index].entry = glm::ivec4(0, 0, 0, static_cast<int>(GPU_INVALID_INDEX));
+		dirtyHashEntries.push_back(index);
+	}
+
+	void VoxelGpuScene::GatherFieldChanges()
+	{
+		if (distanceField != nullptr && distanceField->GetRevision() != syncedFieldRevision) {
+			// distances only touch the node, no bricks are re-sent
+			for (const auto& coord : distanceField->GetModifiedChunks(syncedFieldRevision)) {
+				pending.try_emplace(coord, 0);
+			}
+			syncedFieldRevision = distanceField->GetRevision();
+		}
+	}
+
+	void VoxelGpuScene::GatherChanges()
+	{
+		GatherFieldChanges();
+
+		ui64 revision = world->GetRevision();
+		if (revision == syncedRevision) {
+			return;
+		}
+
+		for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk != nullptr) {
+				pending[coord] |= chunk->GetModifiedBricks(syncedRevision);
+			}
+		}
+
+		std::vector<ChunkCoord> removed;
+		for (const auto& [coord, resident] : residents) {
+			if (world->GetChunk(coord) == nullptr) {
+				removed.push_back(coord);
+			}
+		}
+		for (const auto& coord : removed) {
+			ReleaseChunk(coord);
+		}
+		syncedRevision = revision;
+	}
+
+	void VoxelGpuScene::GatherChanges(const VoxelSnapshot& next)
+	{
+		GatherFieldChanges();
+
+		// versions share untouched chunks, so only the chunks a commit replaced are compared
+		for (const auto& coord : next.Diff(snapshot)) {
+			const Chunk* chunk = next.GetChunk(coord);
+			if (chunk == nullptr) {
+				ReleaseChunk(coord);
+				continue;
+			}
+			const Chunk* previous = snapshot.GetChunk(coord);
+			pending[coord] |= previous != nullptr ? ChangedBricks(*previous, *chunk) : ~0ull;
+		}
+		// holds the chunks of the uploaded version until the next one replaces it
+		snapshot = next;
+	}
+
+	ui64 VoxelGpuScene::ChangedBricks(const Chunk& previous, const Chunk& chunk)
+	{
+		ui64 changed = previous.GetBrickMask() ^ chunk.GetBrickMask();
+		ui64 both = previous.GetBrickMask() & chunk.GetBrickMask();
+		std::array<ui32, BRICK_VOLUME> a;
+		std::array<ui32, BRICK_VOLUME> b;
+		while (both != 0) {
+			ui32 brick = static_cast<ui32>(std::countr_zero(both));
+			both &= both - 1;
+			previous.DecodeBrick(brick, a.data());
+			chunk.DecodeBrick(brick, b.data());
+			if (a != b) {
+				changed |= 1ull << brick;
+			}
+		}
+		return changed;
+	}
+
+	bool VoxelGpuScene::StagePalette(const Chunk& chunk, ResidentChunk& target, ui64 dirtyBricks, VkDeviceSize& spent)
+	{
+		const std::vector<ui32>& words = chunk.GetIndexWords();
+		const std::vector<ui32>& palette = chunk.GetPalette();
+		ui32 bitsLog2 = chunk.GetBitsLog2();
+		ui32 wordOrder = static_cast<ui32>(std::bit_width(words.size() - 1));
+		ui32 entryOrder = palette.empty() ? 0 : std::max(static_cast<ui32>(std::bit_width(palette.size() - 1)), PALETTE_ENTRIES_MIN_ORDER);
+
+		// new blocks are taken before the old ones go, so a chunk that does not fit keeps what it has
+		ui32 firstWord = target.firstWord;
+		ui32 firstEntry = target.firstEntry;
+		bool newWords = firstWord == GPU_INVALID_INDEX || target.wordOrder != wordOrder;
+		bool newEntries = !palette.empty() && (firstEntry == GPU_INVALID_INDEX || target.entryOrder != entryOrder);
+		if (newWords) {
+			firstWord = wordPool.Allocate(wordOrder);
+			if (firstWord == GPU_INVALID_INDEX) {
+				return false;
+			}
+		}
+		if (newEntries) {
+			firstEntry = entryPool.Allocate(entryOrder);
+			if (firstEntry == GPU_INVALID_INDEX) {
+				if (newWords) {
+					wordPool.Free(firstWord, wordOrder);
+				}
+				return false;
+			}
+		}
+		if (newWords && target.firstWord != GPU_INVALID_INDEX) {
+			wordPool.Free(target.firstWord, target.wordOrder);
+		}
+		if ((newEntries || palette.empty()) && target.firstEntry != GPU_INVALID_INDEX) {
+			entryPool.Free(target.firstEntry, target.entryOrder);
+		}
+		if (palette.empty()) {
+			firstEntry = GPU_INVALID_INDEX;
+		}
+
+		// indices only mean the same voxels as before under the same width and palette, otherwise every word goes
+		bool relaid = newWords || target.bitsLog2 != bitsLog2 || target.palette != palette;
+		VkDeviceSize wordBytes = static_cast<VkDeviceSize>(words.size()) * sizeof(ui32);
+		if (relaid) {
+			VkDeviceSize offset = Stage(words.data(), wordBytes);
+			AddCopy(paletteWordCopies, offset, static_cast<VkDeviceSize>(firstWord) * sizeof(ui32), wordBytes);
+			spent += wordBytes;
+		}
+		else {
+			// each brick is one run of indices in Morton order, so one run of words
+			ui32 shift = CHUNK_DIRECT_BITS_LOG2 - bitsLog2;
+			ui32 brickWords = BRICK_VOLUME >> shift;
+			while (dirtyBricks != 0) {
+				ui32 brick = static_cast<ui32>(std::countr_zero(dirtyBricks));
+				dirtyBricks &= dirtyBricks - 1;
+				ui32 first = Chunk::BrickOffset(brick) >> shift;
+				VkDeviceSize offset = Stage(words.data() + first, brickWords * sizeof(ui32));
+				AddCopy(paletteWordCopies, offset, (static_cast<VkDeviceSize>(firstWord) + first) * sizeof(ui32), brickWords * sizeof(ui32));
+				spent += brickWords * sizeof(ui32);
+			}
+		}
+		if (!palette.empty() && (newEntries || target.palette != palette)) {
+			VkDeviceSize paletteBytes = static_cast<VkDeviceSize>(palette.size()) * sizeof(ui32);
+			VkDeviceSize offset = Stage(palette.data(), paletteBytes);
+			AddCopy(paletteEntryCopies, offset, static_cast<VkDeviceSize>(firstEntry) * sizeof(ui32), paletteBytes);
+			spent += paletteBytes;
+		}
+
+		target.firstWord = firstWord;
+		target.wordOrder = wordOrder;
+		target.firstEntry = firstEntry;
+		target.entryOrder = entryOrder;
+		target.bitsLog2 = bitsLog2;
+		target.palette = palette;
+
+		GpuPaletteChunk header{};
+		header.firstWord = firstWord;
+		header.firstEntry = palette.empty() ? 0 : firstEntry;
+		header.bitsLog2 = bitsLog2;
+		header.entries = static_cast<ui32>(palette.size());
+		VkDeviceSize offset = Stage(&header, sizeof(GpuPaletteChunk));
+		AddCopy(paletteHeaderCopies, offset, static_cast<VkDeviceSize>(target.node) * sizeof(GpuPaletteChunk), sizeof(GpuPaletteChunk));
+		spent += sizeof(GpuPaletteChunk);
+		return true;
+	}
+
+	void VoxelGpuScene::ReleasePalette(ResidentChunk& target)
+	{
+		if (target.firstWord != GPU_INVALID_INDEX) {
+			wordPool.Free(target.firstWord, target.wordOrder);
+			target.firstWord = GPU_INVALID_INDEX;
+		}
+		if (target.firstEntry != GPU_INVALID_INDEX) {
+			entryPool.Free(target.firstEntry, target.entryOrder);
+			target.firstEntry = GPU_INVALID_INDEX;
+		}
+		target.palette.clear();
+	}
+
+	void VoxelGpuScene::BuddyPool::Init(ui32 capacityOrder, ui32 smallestOrder)
+	{
+		minOrder = smallestOrder;
+		maxOrder = capacityOrder;
+		used = 0;
+		freeBlocks.assign(maxOrder - minOrder + 1, std::set<ui32>{});
+		freeBlocks.back().insert(0);
+	}
+
+	ui32 VoxelGpuScene::BuddyPool::Allocate(ui32 order)
+	{
+		order = std::max(order, minOrder);
+		ui32 found = order;
+		while (found <= maxOrder && freeBlocks[found - minOrder].empty()) {
+			found++;
+		}
+		if (found > maxOrder) {
+			return GPU_INVALID_INDEX;
+		}
+		// the lowest block keeps allocations packed toward the start
+		auto& blocks = freeBlocks[found - minOrder];
+		ui32 offset = *blocks.begin();
+		blocks.erase(blocks.begin());
+		while (found > order) {
+			found--;
+			freeBlocks[found - minOrder].insert(offset + (1u << found));
+		}
+		used += 1u << order;
+		return offset;
+	}
+
+	void VoxelGpuScene::BuddyPool::Free(ui32 offset, ui32 order)
+	{
+		order = std::max(order, minOrder);
+		used -= 1u << order;
+		while (order < maxOrder) {
+			auto& blocks = freeBlocks[order - minOrder];
+			auto buddy = blocks.find(offset ^ (1u << order));
+			if (buddy == blocks.end()) {
+				break;
+			}
+			blocks.erase(buddy);
+			offset = std::min(offset, offset ^ (1u << order));
+			order++;
+		}
+		freeBlocks[order - minOrder].insert(offset);
+	}
+
+	void VoxelGpuScene::ReleaseChunk(const ChunkCoord& coord)
+	{
+		auto it = residents.find(coord);
+		if (it == residents.end()) {
+			return;
+		}
+		for (ui32 slot : it->second.slots) {
+			if (slot != GPU_INVALID_INDEX) {
+				freeBricks.push_back(slot);
+			}
+		}
+		ReleasePalette(it->second);
+		freeNodes.push_back(it->second.node);
+		HashErase(coord);
+		residents.erase(it);
+		pending.erase(coord);
+	}
+
+	VkDeviceSize VoxelGpuScene::Stage(const void* data, VkDeviceSize size)
+	{
+		if (stagingUsed + size > stagingSize) {
+			Error("Voxel gpu scene staging buffer of", stagingSize, "bytes overflowed.");
+			throw std::runtime_error("Voxel gpu scene staging buffer overflow.");
+		}
+		VkDeviceSize offset = stagingUsed;
+		if (data != nullptr) {
+			std::memcpy(stagingMapped[frameIndex] + offset, data, static_cast<size_t>(size));
+		}
+		stagingUsed += size;
+		return offset;
+	}
+
+	void VoxelGpuScene::AddCopy(std::vector<VkBufferCopy>& regions, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size)
+	{
+		// staging is filled in order, so a copy continuing the last one on both sides is merged into it
+		if (!regions.empty()) {
+			VkBufferCopy& last = regions.back();
+			if (last.srcOffset + last.size == srcOffset && last.dstOffset + last.size == dstOffset) {
+				last.size += size;
+				return;
+			}
+		}
+		VkBufferCopy region{};
+		region.srcOffset = srcOffset;
+		region.dstOffset = dstOffset;
+		region.size = size;
+		regions.push_back(region);
+	}
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Device.h"
+#include "EngineCore/Buffer.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel/VoxelWorld.h"
+#include "Voxel/VoxelSnapshots.h"
+#include "Voxel/VoxelDistanceField.h"
+
+#define GPU_INVALID_INDEX 0xFFFFFFFFu
+
+namespace Luxel
+{
+	// layouts below must match shaders/voxel_scene.glsl.
+	struct GpuChunkNode
+	{
+		glm::ivec4 coord;
+		// brickMask in x/y (low/high 32 bits).
+		glm::uvec4 info;
+		// slot in the brick pool per brick, GPU_INVALID_INDEX for empty bricks.
+		// a slot holds BRICK_VOLUME packed voxels in Morton order, same as Chunk storage.
+		ui32 brickSlots[BRICK_COUNT];
+		// packed brick distances of VoxelDistanceField, all zero when no field is attached.
+		ui32 brickDistances[DISTANCE_FIELD_WORDS];
+	};
+
+	// open addressing with linear probing, keyed by chunk coord; w holds the node index.
+	struct GpuHashEntry
+	{
+		glm::ivec4 entry;
+	};
+
+	struct VoxelGpuSceneSettings
+	{
+		ui32 maxChunks = 16384;
+		ui32 maxBricks = 32768;
+		// bytes staged per Update, edits beyond it are spread over the following frames.
+		VkDeviceSize uploadBudget = 4 * 1024 * 1024;
+		// ships chunks in their palette layout, Chunk::GetIndexWords and GetPalette as they are, instead of
+		// expanding them into the brick pool; shaders decode it with VOXEL_SCENE_PALETTE defined.
+		// maxBricks is unused then and the two sizes below are rounded down to powers of two.
+		bool paletteChunks = false;
+		ui32 maxPaletteWords = 16 * 1024 * 1024;
+		ui32 maxPaletteEntries = 1024 * 1024;
+	};
+
+	struct VoxelGpuSceneStats
+	{
+		VkDeviceSize bytesUploaded = 0;
+		ui32 bricksUploaded = 0;
+		ui32 nodesUploaded = 0;
+		ui32 copyRegions = 0;
+		size_t pendingChunks = 0;
+		ui32 residentBricks = 0;
+		// with paletteChunks, words and palette entries allocated for the resident chunks
+		ui32 residentWords = 0;
+		ui32 residentEntries = 0;
+	};
+
+	// GPU resident copy of a VoxelWorld or VoxelSnapshot: a chunk hash table, chunk nodes and a pool of
+	// 8^3 bricks, or with paletteChunks the palette layout of each chunk in buddy allocated blocks.
+	// only bricks stamped since the last update, or that differ from the last snapshot, are copied.
+	class LUXEL_API VoxelGpuScene
+	{
+	public:
+		VoxelGpuScene(Device* const d, VoxelWorld* const w, const VoxelGpuSceneSettings& s = VoxelGpuSceneSettings{});
+		~VoxelGpuScene();
+		VoxelGpuScene(const VoxelGpuScene&) = delete;
+		void operator=(const VoxelGpuScene&) = delete;
+
+		// records the copies into commandBuffer between a shader -> transfer and a transfer -> shader barrier.
+		// the caller must have waited for the frame that last used this frame slot.
+		const VoxelGpuSceneStats& Update(VkCommandBuffer commandBuffer);
+		// the same from a pinned version instead of the world, which may then be nullptr. the scene holds
+		// the snapshot until the next Update, so editors commit meanwhile without touching what uploads.
+		// use one kind of Update for the lifetime of the scene.
+		const VoxelGpuSceneStats& Update(VkCommandBuffer commandBuffer, const VoxelSnapshot& snapshot);
+
+		// optional, lets shaders skip empty space; nodes are re-sent when the field changes.
+		// the field has to be updated before this scene each frame.
+		void SetDistanceField(const VoxelDistanceField* field);
+
+		VkBuffer GetHashBuffer() const;
+		VkBuffer GetNodeBuffer() const;
+		// VK_NULL_HANDLE with paletteChunks.
+		VkBuffer GetBrickBuffer() const;
+		// with paletteChunks: a GpuPaletteChunk per chunk node, then the words and palettes they point into.
+		// VK_NULL_HANDLE otherwise.
+		VkBuffer GetPaletteHeaderBuffer() const;
+		VkBuffer GetPaletteWordBuffer() const;
+		VkBuffer GetPaletteEntryBuffer() const;
+
+		const VoxelGpuSceneStats& GetStats() const;
+
+	private:
+		struct ResidentChunk
+		{
+			ui32 node = GPU_INVALID_INDEX;
+			std::array<ui32, BRICK_COUNT> slots;
+			// palette layout: the blocks holding the words and palette, and what they were last filled with
+			ui32 firstWord = GPU_INVALID_INDEX;
+			ui32 wordOrder = 0;
+			ui32 firstEntry = GPU_INVALID_INDEX;
+			ui32 entryOrder = 0;
+			ui32 bitsLog2 = 0;
+			std::vector<ui32> palette;
+		};
+
+		// power of two blocks of at least 1 << minOrder units, split from and merged back with their buddies.
+		struct BuddyPool
+		{
+			std::vector<std::set<ui32>> freeBlocks;
+			ui32 minOrder = 0;
+			ui32 maxOrder = 0;
+			ui32 used = 0;
+
+			void Init(ui32 capacityOrder, ui32 smallestOrder);
+			// offset of a block of 1 << order units, GPU_INVALID_INDEX when none is left.
+			ui32 Allocate(ui32 order);
+			void Free(ui32 offset, ui32 order);
+		};
+
+		struct BrickUpload
+		{
+			const Chunk* chunk;
+			ui32 brick;
+			ui32 slot;
+			VkDeviceSize stagingOffset;
+		};
+
+		static ui32 Hash(const ChunkCoord& coord);
+		void HashInsert(const ChunkCoord& coord, ui32 node);
+		void HashErase(const ChunkCoord& coord);
+
+		const VoxelGpuSceneStats& Upload(VkCommandBuffer commandBuffer);
+		void GatherFieldChanges();
+		void GatherChanges();
+		void GatherChanges(const VoxelSnapshot& next);
+		// bricks whose voxels differ between two versions of a chunk.
+		static ui64 ChangedBricks(const Chunk& previous, const Chunk& chunk);
+		// stages the words and palette of chunk that changed, false when the pools have no room for it.
+		bool StagePalette(const Chunk& chunk, ResidentChunk& target, ui64 dirtyBricks, VkDeviceSize& spent);
+		void ReleasePalette(ResidentChunk& target);
+		void ReleaseChunk(const ChunkCoord& coord);
+		VkDeviceSize Stage(const void* data, VkDeviceSize size);
+		void AddCopy(std::vector<VkBufferCopy>& regions, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size);
+
+		Device* const device;
+		VoxelWorld* const world;
+		VoxelGpuSceneSettings settings;
+
+		std::unique_ptr<Buffer> hashBuffer;
+		std::unique_ptr<Buffer> nodeBuffer;
+		std::unique_ptr<Buffer> brickBuffer;
+		std::unique_ptr<Buffer> paletteHeaderBuffer;
+		std::unique_ptr<Buffer> paletteWordBuffer;
+		std::unique_ptr<Buffer> paletteEntryBuffer;
+		BuddyPool wordPool;
+		BuddyPool entryPool;
+		std::array<std::unique_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> stagingBuffers;
+		std::array<ui8*, MAX_FRAMES_IN_FLIGHT> stagingMapped;
+		VkDeviceSize stagingSize;
+		VkDeviceSize stagingUsed;
+		ui32 frameIndex;
+
+		// CPU mirror of the hash table, so entries can be patched one by one.
+		std::vector<GpuHashEntry> hashTable;
+		std::vector<ui32> dirtyHashEntries;
+		ui32 hashMask;
+
+		std::unordered_map<ChunkCoord, ResidentChunk, ChunkCoordHash> residents;
+		std::unordered_map<ChunkCoord, ui64, ChunkCoordHash> pending;
+		std::vector<ui32> freeNodes;
+		std::vector<ui32> freeBricks;
+		ui64 syncedRevision;
+		// the version last gathered from, invalid while the scene follows the world
+		VoxelSnapshot snapshot;
+		const VoxelDistanceField* distanceField;
+		ui64 syncedFieldRevision;
+
+		std::vector<VkBufferCopy> hashCopies;
+		std::vector<VkBufferCopy> nodeCopies;
+		std::vector<VkBufferCopy> brickCopies;
+		std::vector<VkBufferCopy> paletteHeaderCopies;
+		std::vector<VkBufferCopy> paletteWordCopies;
+		std::vector<VkBufferCopy> paletteEntryCopies;
+
+		VoxelGpuSceneStats stats;
+	};
+}
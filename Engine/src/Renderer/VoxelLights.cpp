@@ -0,0 +1,369 @@
+#include "pch.h"
+
+#include "VoxelLights.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr float PI = 3.14159265f;
+		// lights closer than this are treated as this close
+		constexpr float MIN_DISTANCE_SQUARED = 0.25f;
+
+		const glm::ivec3 FACE_OFFSETS[6] = {
+			glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0),
+			glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0),
+			glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+		};
+
+		inline float Luminance(const glm::vec3& c)
+		{
+			return c.x * 0.2126f + c.y * 0.7152f + c.z * 0.0722f;
+		}
+	}
+
+	VoxelLights::VoxelLights(VoxelWorld* const w) :
+		world{ w }, emissionChanged{ false }, syncedRevision{ 0 }, totalPower{ 0.f }, revision{ 0 }
+	{
+
+	}
+
+	VoxelLights::~VoxelLights()
+	{
+		chunkLights.clear();
+	}
+
+	void VoxelLights::SetEmission(ui16 material, float intensity)
+	{
+		if (intensity > 0.f) {
+			emission[material] = intensity;
+		}
+		else {
+			emission.erase(material);
+		}
+		emissionChanged = true;
+	}
+
+	ui32 VoxelLights::Update()
+	{
+		ui64 worldRevision = world->GetRevision();
+		if (worldRevision == syncedRevision && !emissionChanged) {
+			return 0;
+		}
+
+		EpochGuard guard;
+		// exposure of border voxels depends on the face neighbors, so they are extracted again too
+		std::unordered_set<ChunkCoord, ChunkCoordHash> dirty;
+		if (emissionChanged) {
+			chunkLights.clear();
+			for (const auto& coord : world->GetChunkCoords()) {
+				dirty.insert(coord);
+			}
+		}
+		else {
+			for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+				dirty.insert(coord);
+				for (const auto& offset : FACE_OFFSETS) {
+					if (world->GetChunk(coord + offset) != nullptr) {
+						dirty.insert(coord + offset);
+					}
+				}
+			}
+			for (auto it = chunkLights.begin();it != chunkLights.end();) {
+				if (world->GetChunk(it->first) == nullptr) {
+					for (const auto& offset : FACE_OFFSETS) {
+						if (world->GetChunk(it->first + offset) != nullptr) {
+							dirty.insert(it->first + offset);
+						}
+					}
+					it = chunkLights.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+		syncedRevision = worldRevision;
+		emissionChanged = false;
+
+		std::vector<ChunkCoord> coords(dirty.begin(), dirty.end());
+		std::vector<std::vector<VoxelLight>> extracted(coords.size());
+		JobSystem::ParallelFor(static_cast<ui32>(coords.size()), 4, [&](ui32 begin, ui32 end) {
+			EpochGuard guard;
+			for (ui32 i = begin;i < end;i++) {
+				const Chunk* chunk = world->GetChunk(coords[i]);
+				if (chunk == nullptr || emission.empty()) {
+					continue;
+				}
+				glm::ivec3 origin = ChunkOrigin(coords[i]);
+				chunk->ForEachSolidVoxel([&](ui32 x, ui32 y, ui32 z, const Voxel& voxel) {
+					auto it = emission.find(voxel.material);
+					if (it == emission.end()) {
+						return;
+					}
+					ui32 faces = 0;
+					for (ui32 face = 0;face < 6;face++) {
+						glm::ivec3 neighbor = glm::ivec3(x, y, z) + FACE_OFFSETS[face];
+						bool inside = neighbor.x >= 0 && neighbor.y >= 0 && neighbor.z >= 0 &&
+							neighbor.x < CHUNK_SIZE && neighbor.y < CHUNK_SIZE && neighbor.z < CHUNK_SIZE;
+						bool empty = inside ? chunk->Get(neighbor).IsEmpty() : world->GetVoxel(origin + neighbor).IsEmpty();
+						if (empty) {
+							faces |= 1u << face;
+						}
+					}
+					glm::vec3 radiance = Voxel::UnpackColor(voxel.color) * it->second;
+					float luminance = Luminance(radiance);
+					if (faces == 0 || luminance <= 0.f) {
+						return;
+					}
+					// each exposed unit face emits pi * radiance
+					float power = PI * luminance * static_cast<float>(std::popcount(faces));
+					extracted[i].push_back(VoxelLight{ glm::vec3(origin + glm::ivec3(x, y, z)) + glm::vec3(0.5f), power, radiance, faces });
+				});
+			}
+		});
+
+		for (size_t i = 0;i < coords.size();i++) {
+			if (extracted[i].empty()) {
+				chunkLights.erase(coords[i]);
+			}
+			else {
+				chunkLights[coords[i]] = std::move(extracted[i]);
+			}
+		}
+		Rebuild();
+		return static_cast<ui32>(coords.size());
+	}
+
+	const std::vector<VoxelLight>& VoxelLights::GetLights() const
+	{
+		return lights;
+	}
+
+	const std::vector<LightAliasEntry>& VoxelLights::GetAliasTable() const
+	{
+		return aliasTable;
+	}
+
+	const std::vector<LightTreeNode>& VoxelLights::GetTree() const
+	{
+		return tree;
+	}
+
+	float VoxelLights::GetTotalPower() const
+	{
+		return totalPower;
+	}
+
+	ui64 VoxelLights::GetRevision() const
+	{
+		return revision;
+	}
+
+	bool VoxelLights::SamplePower(float u, LightSample& sample) const
+	{
+		if (lights.empty()) {
+			return false;
+		}
+		float scaled = u * static_cast<float>(lights.size());
+		ui32 bucket = std::min(static_cast<ui32>(scaled), static_cast<ui32>(lights.size()) - 1);
+		const LightAliasEntry& entry = aliasTable[bucket];
+		sample.light = scaled - static_cast<float>(bucket) < entry.probability ? bucket : entry.alias;
+		sample.pdf = PowerPdf(sample.light);
+		return true;
+	}
+
+	float VoxelLights::PowerPdf(ui32 light) const
+	{
+		return totalPower > 0.f ? lights[light].power / totalPower : 0.f;
+	}
+
+	bool VoxelLights::SampleTree(const glm::vec3& position, const glm::vec3& normal, float u, LightSample& sample) const
+	{
+		if (tree.empty()) {
+			return false;
+		}
+		ui32 node = 0;
+		float pdf = 1.f;
+		while ((tree[node].child & LIGHT_TREE_LEAF) == 0) {
+			ui32 left = tree[node].child;
+			float importanceLeft = Importance(tree[left], position, normal);
+			float importanceRight = Importance(tree[left + 1], position, normal);
+			float total = importanceLeft + importanceRight;
+			if (total <= 0.f) {
+				return false;
+			}
+			// reuse u for the choice below, rescaled into the chosen side
+			float probabilityLeft = importanceLeft / total;
+			if (u < probabilityLeft) {
+				u = std::min(u / probabilityLeft, 0.99999994f);
+				node = left;
+				pdf *= probabilityLeft;
+			}
+			else {
+				u = std::min((u - probabilityLeft) / (1.f - probabilityLeft), 0.99999994f);
+				node = left + 1;
+				pdf *= 1.f - probabilityLeft;
+			}
+		}
+		sample.light = tree[node].child & ~LIGHT_TREE_LEAF;
+		sample.pdf = pdf;
+		return pdf > 0.f;
+	}
+
+	float VoxelLights::TreePdf(const glm::vec3& position, const glm::vec3& normal, ui32 light) const
+	{
+		float pdf = 1.f;
+		for (ui32 node = leaves[light];node != 0;node = parents[node]) {
+			ui32 first = tree[parents[node]].child;
+			ui32 sibling = node == first ? first + 1 : first;
+			float importance = Importance(tree[node], position, normal);
+			float total = importance + Importance(tree[sibling], position, normal);
+			if (total <= 0.f) {
+				return 0.f;
+			}
+			pdf *= importance / total;
+		}
+		return pdf;
+	}
+
+	glm::vec3 VoxelLights::Irradiance(const VoxelLight& light, const glm::vec3& position, const glm::vec3& normal)
+	{
+		glm::vec3 offset = light.position - position;
+		float distanceSquared = glm::dot(offset, offset);
+		if (distanceSquared <= 0.f) {
+			return glm::vec3(0.f);
+		}
+		glm::vec3 direction = offset / std::sqrt(distanceSquared);
+		float cosine = glm::dot(normal, direction);
+		if (cosine <= 0.f) {
+			return glm::vec3(0.f);
+		}
+		// projected area of the exposed faces that look toward position
+		float area = 0.f;
+		for (ui32 axis = 0;axis < 3;axis++) {
+			float facing = -direction[axis];
+			ui32 face = axis * 2 + (facing > 0.f ? 0 : 1);
+			if ((light.faces >> face) & 1) {
+				area += std::abs(facing);
+			}
+		}
+		return light.radiance * (area * cosine / std::max(distanceSquared, MIN_DISTANCE_SQUARED));
+	}
+
+	float VoxelLights::Importance(const LightTreeNode& node, const glm::vec3& position, const glm::vec3& normal) const
+	{
+		// zero when the whole box is behind the surface
+		glm::vec3 support(normal.x > 0.f ? node.boundsMax.x : node.boundsMin.x,
+			normal.y > 0.f ? node.boundsMax.y : node.boundsMin.y,
+			normal.z > 0.f ? node.boundsMax.z : node.boundsMin.z);
+		if (glm::dot(normal, normal) > 0.f && glm::dot(normal, support - position) <= 0.f) {
+			return 0.f;
+		}
+		glm::vec3 extent = node.boundsMax - node.boundsMin;
+		glm::vec3 offset = (node.boundsMin + node.boundsMax) * 0.5f - position;
+		return node.power / std::max(glm::dot(offset, offset), glm::dot(extent, extent) * 0.25f);
+	}
+
+	void VoxelLights::Rebuild()
+	{
+		lights.clear();
+		for (auto& [coord, list] : chunkLights) {
+			lights.insert(lights.end(), list.begin(), list.end());
+		}
+		revision++;
+		aliasTable.clear();
+		tree.clear();
+		parents.clear();
+		leaves.clear();
+		totalPower = 0.f;
+		ui32 count = static_cast<ui32>(lights.size());
+		if (count == 0) {
+			return;
+		}
+
+		// Morton order keeps nearby lights in the same subtrees
+		glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+		for (const auto& light : lights) {
+			boundsMin = glm::min(boundsMin, light.position);
+			boundsMax = glm::max(boundsMax, light.position);
+		}
+		glm::vec3 scale = 1023.f / glm::max(boundsMax - boundsMin, glm::vec3(1.f));
+		std::vector<std::pair<ui32, ui32>> codes(count);
+		JobSystem::ParallelFor(count, 4096, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				glm::uvec3 cell = glm::uvec3((lights[i].position - boundsMin) * scale);
+				codes[i] = { MortonEncode(cell.x, cell.y, cell.z), i };
+			}
+		});
+		std::sort(codes.begin(), codes.end());
+		std::vector<VoxelLight> sorted(count);
+		for (ui32 i = 0;i < count;i++) {
+			sorted[i] = lights[codes[i].second];
+			totalPower += sorted[i].power;
+		}
+		lights = std::move(sorted);
+
+		// Vose: split buckets into under and over full, top the under full ones up from the others
+		aliasTable.resize(count);
+		std::vector<float> scaled(count);
+		std::vector<ui32> small, large;
+		for (ui32 i = 0;i < count;i++) {
+			scaled[i] = lights[i].power * static_cast<float>(count) / totalPower;
+			(scaled[i] < 1.f ? small : large).push_back(i);
+		}
+		while (!small.empty() && !large.empty()) {
+			ui32 under = small.back();
+			small.pop_back();
+			ui32 over = large.back();
+			aliasTable[under] = LightAliasEntry{ scaled[under], over };
+			scaled[over] -= 1.f - scaled[under];
+			if (scaled[over] < 1.f) {
+				large.pop_back();
+				small.push_back(over);
+			}
+		}
+		// what is left is full up to rounding
+		for (ui32 i : large) {
+			aliasTable[i] = LightAliasEntry{ 1.f, i };
+		}
+		for (ui32 i : small) {
+			aliasTable[i] = LightAliasEntry{ 1.f, i };
+		}
+
+		tree.resize(static_cast<size_t>(count) * 2 - 1);
+		parents.assign(tree.size(), 0);
+		leaves.resize(count);
+		ui32 nextNode = 1;
+		BuildNode(0, 0, count, nextNode);
+		// the root sums in another order than the loop above, PowerPdf divides by it like lightPowerPdf
+		totalPower = tree[0].power;
+	}
+
+	void VoxelLights::BuildNode(ui32 node, ui32 begin, ui32 end, ui32& nextNode)
+	{
+		LightTreeNode& target = tree[node];
+		if (end - begin == 1) {
+			target.boundsMin = lights[begin].position - glm::vec3(0.5f);
+			target.boundsMax = lights[begin].position + glm::vec3(0.5f);
+			target.power = lights[begin].power;
+			target.child = begin | LIGHT_TREE_LEAF;
+			leaves[begin] = node;
+			return;
+		}
+		ui32 left = nextNode;
+		nextNode += 2;
+		parents[left] = node;
+		parents[left + 1] = node;
+		ui32 middle = begin + (end - begin) / 2;
+		BuildNode(left, begin, middle, nextNode);
+		BuildNode(left + 1, middle, end, nextNode);
+
+		const LightTreeNode& a = tree[left];
+		const LightTreeNode& b = tree[left + 1];
+		tree[node].boundsMin = glm::min(a.boundsMin, b.boundsMin);
+		tree[node].boundsMax = glm::max(a.boundsMax, b.boundsMax);
+		tree[node].power = a.power + b.power;
+		tree[node].child = left;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel/Morton.h"
+#include "Voxel/VoxelWorld.h"
+
+#define LIGHT_TREE_LEAF 0x80000000u
+#define LIGHT_INVALID 0xFFFFFFFFu
+
+namespace Luxel
+{
+	// layouts below must match shaders/voxel_lights.glsl.
+	struct VoxelLight
+	{
+		// voxel center
+		glm::vec3 position;
+		float power;
+		glm::vec3 radiance;
+		// exposed faces, bit 2 * axis for the positive side and 2 * axis + 1 for the negative side
+		ui32 faces;
+	};
+
+	// Vose alias table entry: keep the bucket with probability, else take alias.
+	struct LightAliasEntry
+	{
+		float probability;
+		ui32 alias;
+	};
+
+	// bounding volume hierarchy over the lights in Morton order, children of an inner node are adjacent.
+	struct LightTreeNode
+	{
+		glm::vec3 boundsMin;
+		float power;
+		glm::vec3 boundsMax;
+		// first child, or the light index | LIGHT_TREE_LEAF
+		ui32 child;
+	};
+
+	struct LightSample
+	{
+		ui32 light = LIGHT_INVALID;
+		float pdf = 0.f;
+	};
+
+	// emissive voxels of a VoxelWorld with two ways to pick one: power proportional through an alias
+	// table in O(1), and by estimated contribution at a shading point through the light tree in O(log n).
+	// a voxel is a light when its material has an emission and at least one face is exposed.
+	class LUXEL_API VoxelLights
+	{
+	public:
+		VoxelLights(VoxelWorld* const w);
+		~VoxelLights();
+		VoxelLights(const VoxelLights&) = delete;
+		void operator=(const VoxelLights&) = delete;
+
+		// emitted radiance of material is the voxel color times intensity, 0 removes it.
+		// takes effect for every chunk at the next Update.
+		void SetEmission(ui16 material, float intensity);
+
+		// re-extracts chunks modified since the last call on the workers and rebuilds the tables.
+		// returns the number of chunks extracted.
+		ui32 Update();
+
+		const std::vector<VoxelLight>& GetLights() const;
+		const std::vector<LightAliasEntry>& GetAliasTable() const;
+		const std::vector<LightTreeNode>& GetTree() const;
+		float GetTotalPower() const;
+		// bumped whenever the tables are rebuilt, light indices are only stable between bumps.
+		ui64 GetRevision() const;
+
+		bool SamplePower(float u, LightSample& sample) const;
+		float PowerPdf(ui32 light) const;
+
+		// normal may be zero for points in volumes.
+		bool SampleTree(const glm::vec3& position, const glm::vec3& normal, float u, LightSample& sample) const;
+		float TreePdf(const glm::vec3& position, const glm::vec3& normal, ui32 light) const;
+
+		// unshadowed irradiance a light delivers at position onto a surface with normal.
+		static glm::vec3 Irradiance(const VoxelLight& light, const glm::vec3& position, const glm::vec3& normal);
+
+	private:
+		float Importance(const LightTreeNode& node, const glm::vec3& position, const glm::vec3& normal) const;
+		void Rebuild();
+		void BuildNode(ui32 node, ui32 begin, ui32 end, ui32& nextNode);
+
+		VoxelWorld* const world;
+		std::unordered_map<ui16, float> emission;
+		bool emissionChanged;
+
+		std::unordered_map<ChunkCoord, std::vector<VoxelLight>, ChunkCoordHash> chunkLights;
+		ui64 syncedRevision;
+
+		std::vector<VoxelLight> lights;
+		std::vector<LightAliasEntry> aliasTable;
+		std::vector<LightTreeNode> tree;
+		// CPU only, for TreePdf
+		std::vector<ui32> parents;
+		std::vector<ui32> leaves;
+		float totalPower;
+		ui64 revision;
+	};
+}
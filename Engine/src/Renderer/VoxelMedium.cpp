@@ -0,0 +1,336 @@
+#include "pch.h"
+
+#include "VoxelMedium.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 MAX_STEPS = 1 << 16;
+		// ratio tracking plays russian roulette below this transmittance
+		constexpr float ROULETTE_THRESHOLD = 0.1f;
+
+		inline float NextFloat(ui32& seed)
+		{
+			return SampleToFloat(HashU32(seed++));
+		}
+
+		// exponential free flight distance for a majorant
+		inline float FreeFlight(float majorant, ui32& seed)
+		{
+			return -std::log(1.f - NextFloat(seed)) / majorant;
+		}
+
+		inline ui32 BrickVoxel(const glm::ivec3& local)
+		{
+			return Chunk::Index(local.x, local.y, local.z) & (BRICK_VOLUME - 1);
+		}
+	}
+
+	VoxelMedium::VoxelMedium(const MediumProperties& p) :
+		properties{ p }, brickCount{ 0 }, revision{ 0 }
+	{
+
+	}
+
+	VoxelMedium::~VoxelMedium()
+	{
+		Clear();
+	}
+
+	void VoxelMedium::SetDensity(const glm::ivec3& position, float density)
+	{
+		ui8 value = static_cast<ui8>(std::clamp(density, 0.f, 1.f) * MEDIUM_DENSITY_STEPS + 0.5f);
+		ChunkCoord coord = ToChunkCoord(position);
+		auto it = chunks.find(coord);
+		if (it == chunks.end()) {
+			if (value == 0) {
+				return;
+			}
+			it = chunks.emplace(coord, MediumChunk{}).first;
+		}
+		MediumChunk& chunk = it->second;
+		ui32 before = chunk.brickCount;
+		if (Write(chunk, ToLocalCoord(position), value)) {
+			revision++;
+		}
+		brickCount += chunk.brickCount;
+		brickCount -= before;
+		if (chunk.brickCount == 0) {
+			chunks.erase(it);
+		}
+	}
+
+	float VoxelMedium::GetDensity(const glm::ivec3& position) const
+	{
+		const Brick* brick = GetBrick(position);
+		if (brick == nullptr) {
+			return 0.f;
+		}
+		return static_cast<float>(brick->density[BrickVoxel(ToLocalCoord(position))]) / MEDIUM_DENSITY_STEPS;
+	}
+
+	void VoxelMedium::Fill(const glm::ivec3& minVoxel, const glm::ivec3& maxVoxel, const std::function<float(const glm::ivec3&)>& density)
+	{
+		if (maxVoxel.x <= minVoxel.x || maxVoxel.y <= minVoxel.y || maxVoxel.z <= minVoxel.z) {
+			return;
+		}
+		// the map is only touched here, the workers write into chunks of their own
+		ChunkCoord first = ToChunkCoord(minVoxel);
+		ChunkCoord last = ToChunkCoord(maxVoxel - glm::ivec3(1));
+		std::vector<std::pair<ChunkCoord, MediumChunk*>> jobs;
+		for (int z = first.z;z <= last.z;z++) {
+			for (int y = first.y;y <= last.y;y++) {
+				for (int x = first.x;x <= last.x;x++) {
+					ChunkCoord coord(x, y, z);
+					jobs.emplace_back(coord, &chunks[coord]);
+				}
+			}
+		}
+
+		std::atomic<bool> changed{ false };
+		JobSystem::ParallelFor(static_cast<ui32>(jobs.size()), 1, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				glm::ivec3 origin = ChunkOrigin(jobs[i].first);
+				glm::ivec3 from = glm::max(minVoxel, origin);
+				glm::ivec3 to = glm::min(maxVoxel, origin + glm::ivec3(CHUNK_SIZE));
+				bool chunkChanged = false;
+				for (int z = from.z;z < to.z;z++) {
+					for (int y = from.y;y < to.y;y++) {
+						for (int x = from.x;x < to.x;x++) {
+							glm::ivec3 position(x, y, z);
+							ui8 value = static_cast<ui8>(std::clamp(density(position), 0.f, 1.f) * MEDIUM_DENSITY_STEPS + 0.5f);
+							chunkChanged |= Write(*jobs[i].second, position - origin, value);
+						}
+					}
+				}
+				if (chunkChanged) {
+					changed = true;
+				}
+			}
+		});
+
+		for (const auto& [coord, chunk] : jobs) {
+			if (chunk->brickCount == 0) {
+				chunks.erase(coord);
+			}
+		}
+		brickCount = 0;
+		for (const auto& [coord, chunk] : chunks) {
+			brickCount += chunk.brickCount;
+		}
+		if (changed) {
+			revision++;
+		}
+	}
+
+	void VoxelMedium::Clear()
+	{
+		chunks.clear();
+		brickCount = 0;
+		revision++;
+	}
+
+	float VoxelMedium::GetMajorant(const glm::ivec3& brickPosition) const
+	{
+		const Brick* brick = GetBrick(brickPosition * BRICK_SIZE);
+		return brick == nullptr ? 0.f : static_cast<float>(brick->majorant) * properties.maxExtinction / MEDIUM_DENSITY_STEPS;
+	}
+
+	float VoxelMedium::GetExtinction(const glm::ivec3& position) const
+	{
+		return GetDensity(position) * properties.maxExtinction;
+	}
+
+	template<typename Visit>
+	void VoxelMedium::Traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, MediumTrackStats* stats, Visit&& visit) const
+	{
+		glm::vec3 invDirection(
+			direction.x != 0.f ? 1.f / direction.x : 0.f,
+			direction.y != 0.f ? 1.f / direction.y : 0.f,
+			direction.z != 0.f ? 1.f / direction.z : 0.f);
+		float scale = properties.maxExtinction / MEDIUM_DENSITY_STEPS;
+
+		float entry = 0.f;
+		float probe = 0.f;
+		// consecutive cells mostly share a chunk, the map is only searched when it changes
+		ChunkCoord cachedCoord(std::numeric_limits<int>::min());
+		auto it = chunks.end();
+		for (ui32 step = 0;step < MAX_STEPS && entry < maxDistance;step++) {
+			glm::ivec3 voxel = glm::ivec3(glm::floor(origin + direction * probe));
+			ChunkCoord coord = ToChunkCoord(voxel);
+			glm::ivec3 boxMin, boxMax;
+			const Brick* brick = nullptr;
+			if (coord != cachedCoord) {
+				cachedCoord = coord;
+				it = chunks.find(coord);
+			}
+			if (it == chunks.end()) {
+				boxMin = ChunkOrigin(coord);
+				boxMax = boxMin + glm::ivec3(CHUNK_SIZE);
+			}
+			else {
+				glm::ivec3 local = ToLocalCoord(voxel);
+				brick = it->second.bricks[Chunk::BrickIndex(local.x, local.y, local.z)].get();
+				boxMin = glm::ivec3(voxel.x >> BRICK_SIZE_LOG2, voxel.y >> BRICK_SIZE_LOG2, voxel.z >> BRICK_SIZE_LOG2) * BRICK_SIZE;
+				boxMax = boxMin + glm::ivec3(BRICK_SIZE);
+			}
+
+			float exit = std::numeric_limits<float>::max();
+			for (int i = 0;i < 3;i++) {
+				if (direction[i] != 0.f) {
+					float bound = static_cast<float>(direction[i] > 0.f ? boxMax[i] : boxMin[i]);
+					exit = std::min(exit, (bound - origin[i]) * invDirection[i]);
+				}
+			}
+			exit = std::min(exit, maxDistance);
+			if (stats != nullptr) {
+				stats->cells++;
+			}
+			float majorant = brick != nullptr ? static_cast<float>(brick->majorant) * scale : 0.f;
+			if (!visit(entry, exit, majorant, brick, boxMin)) {
+				return;
+			}
+			entry = std::max(entry, exit);
+			// nudge past the boundary so the next lookup lands in the neighboring cell
+			probe = entry + 1e-4f * std::max(1.f, entry);
+		}
+	}
+
+	bool VoxelMedium::SampleCollision(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ui32& seed,
+		float& distance, MediumTrackStats* stats) const
+	{
+		float scale = properties.maxExtinction / MEDIUM_DENSITY_STEPS;
+		bool collided = false;
+		Traverse(origin, direction, maxDistance, stats, [&](float t0, float t1, float majorant, const Brick* brick, const glm::ivec3& brickOrigin) {
+			if (majorant <= 0.f) {
+				return true;
+			}
+			// free flight restarts at every cell boundary, exponential distances have no memory
+			for (float t = t0 + FreeFlight(majorant, seed);t < t1;t += FreeFlight(majorant, seed)) {
+				glm::ivec3 local = glm::clamp(glm::ivec3(glm::floor(origin + direction * t)) - brickOrigin, 0, BRICK_SIZE - 1);
+				float extinction = static_cast<float>(brick->density[BrickVoxel(local)]) * scale;
+				if (stats != nullptr) {
+					stats->lookups++;
+				}
+				if (NextFloat(seed) * majorant < extinction) {
+					distance = t;
+					collided = true;
+					return false;
+				}
+			}
+			return true;
+		});
+		return collided;
+	}
+
+	float VoxelMedium::Transmittance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ui32& seed,
+		MediumTrackStats* stats) const
+	{
+		float scale = properties.maxExtinction / MEDIUM_DENSITY_STEPS;
+		float transmittance = 1.f;
+		Traverse(origin, direction, maxDistance, stats, [&](float t0, float t1, float majorant, const Brick* brick, const glm::ivec3& brickOrigin) {
+			if (majorant <= 0.f) {
+				return true;
+			}
+			for (float t = t0 + FreeFlight(majorant, seed);t < t1;t += FreeFlight(majorant, seed)) {
+				glm::ivec3 local = glm::clamp(glm::ivec3(glm::floor(origin + direction * t)) - brickOrigin, 0, BRICK_SIZE - 1);
+				float extinction = static_cast<float>(brick->density[BrickVoxel(local)]) * scale;
+				if (stats != nullptr) {
+					stats->lookups++;
+				}
+				transmittance *= 1.f - extinction / majorant;
+				if (transmittance < ROULETTE_THRESHOLD) {
+					if (NextFloat(seed) < 0.5f) {
+						transmittance = 0.f;
+						return false;
+					}
+					transmittance *= 2.f;
+				}
+			}
+			return true;
+		});
+		return transmittance;
+	}
+
+	float VoxelMedium::MarchTransmittance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float step, ui32& seed,
+		MediumTrackStats* stats) const
+	{
+		float opticalDepth = 0.f;
+		for (float t = NextFloat(seed) * step;t < maxDistance;t += step) {
+			opticalDepth += GetExtinction(glm::ivec3(glm::floor(origin + direction * t))) * step;
+			if (stats != nullptr) {
+				stats->cells++;
+				stats->lookups++;
+			}
+		}
+		return std::exp(-opticalDepth);
+	}
+
+	const MediumProperties& VoxelMedium::GetProperties() const
+	{
+		return properties;
+	}
+
+	void VoxelMedium::SetProperties(const MediumProperties& p)
+	{
+		properties = p;
+		revision++;
+	}
+
+	size_t VoxelMedium::GetBrickCount() const
+	{
+		return brickCount;
+	}
+
+	size_t VoxelMedium::GetMemoryUsage() const
+	{
+		return brickCount * sizeof(Brick) + chunks.size() * sizeof(MediumChunk);
+	}
+
+	ui64 VoxelMedium::GetRevision() const
+	{
+		return revision;
+	}
+
+	const VoxelMedium::Brick* VoxelMedium::GetBrick(const glm::ivec3& position) const
+	{
+		auto it = chunks.find(ToChunkCoord(position));
+		if (it == chunks.end()) {
+			return nullptr;
+		}
+		glm::ivec3 local = ToLocalCoord(position);
+		return it->second.bricks[Chunk::BrickIndex(local.x, local.y, local.z)].get();
+	}
+
+	bool VoxelMedium::Write(MediumChunk& chunk, const glm::ivec3& local, ui8 value)
+	{
+		std::unique_ptr<Brick>& brick = chunk.bricks[Chunk::BrickIndex(local.x, local.y, local.z)];
+		if (brick == nullptr) {
+			if (value == 0) {
+				return false;
+			}
+			brick = std::make_unique<Brick>();
+			chunk.brickCount++;
+		}
+		ui32 index = BrickVoxel(local);
+		ui8 previous = brick->density[index];
+		if (previous == value) {
+			return false;
+		}
+		brick->density[index] = value;
+		brick->count = static_cast<ui16>(brick->count + (value != 0) - (previous != 0));
+		if (brick->count == 0) {
+			brick.reset();
+			chunk.brickCount--;
+			return true;
+		}
+		if (value > brick->majorant) {
+			brick->majorant = value;
+		}
+		else if (previous == brick->majorant) {
+			brick->majorant = *std::max_element(brick->density.begin(), brick->density.end());
+		}
+		return true;
+	}
+}
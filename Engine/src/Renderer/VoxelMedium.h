@@ -0,0 +1,106 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel/Voxel.h"
+#include "Voxel/Chunk.h"
+#include "Sampler.h"
+
+// densities are stored as 8 bit steps of the medium's maximum extinction.
+#define MEDIUM_DENSITY_STEPS 255
+
+namespace Luxel
+{
+	struct MediumProperties
+	{
+		// extinction per voxel of length at density 1.
+		float maxExtinction = 1.f;
+		// scattering / extinction.
+		glm::vec3 albedo = glm::vec3(0.9f);
+	};
+
+	// work done by one query, the cost measure for the benchmarks.
+	struct MediumTrackStats
+	{
+		// majorant cells, empty bricks and absent chunks crossed
+		ui32 cells = 0;
+		// density lookups
+		ui32 lookups = 0;
+	};
+
+	// per voxel density of a participating medium (fog, smoke, clouds), sparse in the same chunk and
+	// 8^3 brick layout as VoxelWorld: only bricks with some density are allocated. every brick keeps
+	// the maximum density inside it, the majorant grid the trackers step through, so empty space costs
+	// one step per absent chunk or brick and the number of tentative collisions follows the local density.
+	// queries are const and may run on many threads, edits may not run alongside them.
+	class LUXEL_API VoxelMedium
+	{
+	public:
+		VoxelMedium(const MediumProperties& p = MediumProperties{});
+		~VoxelMedium();
+		VoxelMedium(const VoxelMedium&) = delete;
+		void operator=(const VoxelMedium&) = delete;
+
+		// density in [0, 1], 0 frees storage.
+		void SetDensity(const glm::ivec3& position, float density);
+		float GetDensity(const glm::ivec3& position) const;
+		// writes density(p) for every voxel of [minVoxel, maxVoxel), chunks run on the workers.
+		void Fill(const glm::ivec3& minVoxel, const glm::ivec3& maxVoxel, const std::function<float(const glm::ivec3&)>& density);
+		void Clear();
+
+		// maximum extinction inside a brick, brickPosition is the voxel position >> BRICK_SIZE_LOG2.
+		float GetMajorant(const glm::ivec3& brickPosition) const;
+		float GetExtinction(const glm::ivec3& position) const;
+
+		// delta tracking: distance to a real collision along the ray, false when the ray leaves
+		// [0, maxDistance) first. direction must be normalized, seed is advanced per random number.
+		bool SampleCollision(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ui32& seed,
+			float& distance, MediumTrackStats* stats = nullptr) const;
+		// ratio tracking: unbiased transmittance estimate over [0, maxDistance).
+		float Transmittance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ui32& seed,
+			MediumTrackStats* stats = nullptr) const;
+		// reference ray marching with a fixed step and a random offset, biased by the step size.
+		float MarchTransmittance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float step, ui32& seed,
+			MediumTrackStats* stats = nullptr) const;
+
+		const MediumProperties& GetProperties() const;
+		void SetProperties(const MediumProperties& p);
+		size_t GetBrickCount() const;
+		size_t GetMemoryUsage() const;
+		// bumped on every edit.
+		ui64 GetRevision() const;
+
+	private:
+		struct Brick
+		{
+			// Morton order, same as Chunk storage
+			std::array<ui8, BRICK_VOLUME> density{};
+			ui16 count = 0;
+			ui8 majorant = 0;
+		};
+
+		struct MediumChunk
+		{
+			std::array<std::unique_ptr<Brick>, BRICK_COUNT> bricks;
+			ui32 brickCount = 0;
+		};
+
+		// walks the majorant cells along the ray: visit(t0, t1, majorant, brick, brickOrigin) until it
+		// returns false, brick is nullptr for empty cells.
+		template<typename Visit>
+		void Traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, MediumTrackStats* stats, Visit&& visit) const;
+
+		const Brick* GetBrick(const glm::ivec3& position) const;
+		// writes one voxel of an allocated or new brick, returns false when nothing changed.
+		static bool Write(MediumChunk& chunk, const glm::ivec3& local, ui8 value);
+
+		MediumProperties properties;
+		std::unordered_map<ChunkCoord, MediumChunk, ChunkCoordHash> chunks;
+		size_t brickCount;
+		ui64 revision;
+	};
+}
@@ -0,0 +1,424 @@
+#include "pch.h"
+
+#include "VoxelModels.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 MAX_STEPS = 1 << 16;
+
+		// rows of the rotation matrix of a quaternion.
+		void RotationRows(const glm::vec4& rotation, glm::vec3 rows[3])
+		{
+			float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+			rows[0] = glm::vec3(1.f - 2.f * (y * y + z * z), 2.f * (x * y - w * z), 2.f * (x * z + w * y));
+			rows[1] = glm::vec3(2.f * (x * y + w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - w * x));
+			rows[2] = glm::vec3(2.f * (x * z - w * y), 2.f * (y * z + w * x), 1.f - 2.f * (x * x + y * y));
+		}
+
+		inline glm::vec3 Apply(const GpuModelInstance& gpu, const glm::vec3& p, float w)
+		{
+			return glm::vec3(
+				gpu.rows[0].x * p.x + gpu.rows[0].y * p.y + gpu.rows[0].z * p.z + gpu.rows[0].w * w,
+				gpu.rows[1].x * p.x + gpu.rows[1].y * p.y + gpu.rows[1].z * p.z + gpu.rows[1].w * w,
+				gpu.rows[2].x * p.x + gpu.rows[2].y * p.y + gpu.rows[2].z * p.z + gpu.rows[2].w * w);
+		}
+
+		// same as VoxelRaycast: distance to where the ray leaves [minCorner, maxCorner) and the axis it leaves through.
+		float ExitDistance(const glm::vec3& origin, const glm::vec3& invDirection, const glm::vec3& direction,
+			const glm::ivec3& minCorner, const glm::ivec3& maxCorner, int& axis)
+		{
+			float exit = std::numeric_limits<float>::max();
+			axis = 0;
+			for (int i = 0;i < 3;i++) {
+				if (direction[i] == 0.f) {
+					continue;
+				}
+				float bound = static_cast<float>(direction[i] > 0.f ? maxCorner[i] : minCorner[i]);
+				float t = (bound - origin[i]) * invDirection[i];
+				if (t < exit) {
+					exit = t;
+					axis = i;
+				}
+			}
+			return exit;
+		}
+	}
+
+	VoxelModelLibrary::VoxelModelLibrary() :
+		palettes(MODEL_PALETTE_SIZE, 0), revision{ 0 }
+	{
+
+	}
+
+	VoxelModelLibrary::~VoxelModelLibrary()
+	{
+		brickLookup.clear();
+	}
+
+	ui32 VoxelModelLibrary::AddModel(const glm::ivec3& size, const Voxel* voxels)
+	{
+		return AddModel(size, [&](const glm::ivec3& p) {
+			return voxels[p.x + size.x * (p.y + size.y * p.z)];
+		});
+	}
+
+	ui32 VoxelModelLibrary::AddModel(const VoxelWorld& world, const glm::ivec3& min, const glm::ivec3& max)
+	{
+		// bricks are sampled one after the other, so the chunk rarely changes between two voxels
+		EpochGuard guard;
+		ChunkCoord cachedCoord(std::numeric_limits<int>::max());
+		const Chunk* cachedChunk = nullptr;
+		return AddModel(max - min, [&](const glm::ivec3& p) {
+			glm::ivec3 position = min + p;
+			ChunkCoord coord = ToChunkCoord(position);
+			if (coord != cachedCoord) {
+				cachedCoord = coord;
+				cachedChunk = world.GetChunk(coord);
+			}
+			return cachedChunk != nullptr ? cachedChunk->Get(ToLocalCoord(position)) : Voxel{};
+		});
+	}
+
+	ui32 VoxelModelLibrary::AddModel(const glm::ivec3& size, const std::function<Voxel(const glm::ivec3&)>& sample)
+	{
+		if (size.x <= 0 || size.y <= 0 || size.z <= 0) {
+			Error("Voxel model size", size.x, size.y, size.z, "is not positive.");
+			throw std::runtime_error("Invalid voxel model size.");
+		}
+
+		GpuVoxelModel model{};
+		model.size = size;
+		model.bricks = glm::ivec3((size.x + BRICK_SIZE - 1) >> BRICK_SIZE_LOG2,
+			(size.y + BRICK_SIZE - 1) >> BRICK_SIZE_LOG2, (size.z + BRICK_SIZE - 1) >> BRICK_SIZE_LOG2);
+		model.firstBrick = static_cast<ui32>(brickRefs.size());
+		model.solidBricks = 0;
+		ui32 brickCount = static_cast<ui32>(model.bricks.x * model.bricks.y * model.bricks.z);
+		brickRefs.resize(brickRefs.size() + brickCount, MODEL_INVALID);
+
+		std::array<ui32, BRICK_VOLUME> voxels;
+		for (ui32 brick = 0;brick < brickCount;brick++) {
+			glm::ivec3 brickMin = glm::ivec3(
+				static_cast<int>(brick % model.bricks.x),
+				static_cast<int>(brick / model.bricks.x % model.bricks.y),
+				static_cast<int>(brick / (model.bricks.x * model.bricks.y))) * BRICK_SIZE;
+			bool solid = false;
+			for (ui32 i = 0;i < BRICK_VOLUME;i++) {
+				ui32 local = MortonTables::Compact[i];
+				glm::ivec3 p = brickMin + glm::ivec3(local & 7, (local >> 3) & 7, local >> 6);
+				Voxel voxel = p.x < size.x && p.y < size.y && p.z < size.z ? sample(p) : Voxel{};
+				voxels[i] = voxel.IsEmpty() ? 0 : voxel.Pack();
+				solid |= !voxel.IsEmpty();
+			}
+			if (solid) {
+				brickRefs[model.firstBrick + brick] = AcquireBrick(voxels.data());
+				model.solidBricks++;
+			}
+		}
+
+		ui32 id;
+		if (!freeModels.empty()) {
+			id = freeModels.back();
+			freeModels.pop_back();
+			models[id] = model;
+		}
+		else {
+			id = static_cast<ui32>(models.size());
+			models.push_back(model);
+		}
+		stats.modelCount++;
+		stats.referencedBricks += model.solidBricks;
+		revision++;
+		return id;
+	}
+
+	void VoxelModelLibrary::RemoveModel(ui32 model)
+	{
+		if (model >= models.size() || models[model].size.x == 0) {
+			Error("Removing unknown voxel model", model, ".");
+			throw std::runtime_error("Unknown voxel model.");
+		}
+		GpuVoxelModel& removed = models[model];
+		ui32 brickCount = static_cast<ui32>(removed.bricks.x * removed.bricks.y * removed.bricks.z);
+		for (ui32 i = 0;i < brickCount;i++) {
+			if (brickRefs[removed.firstBrick + i] != MODEL_INVALID) {
+				ReleaseBrick(brickRefs[removed.firstBrick + i]);
+			}
+		}
+
+		// close the gap so the refs stay packed
+		brickRefs.erase(brickRefs.begin() + removed.firstBrick, brickRefs.begin() + removed.firstBrick + brickCount);
+		for (auto& other : models) {
+			if (other.size.x != 0 && other.firstBrick > removed.firstBrick) {
+				other.firstBrick -= brickCount;
+			}
+		}
+
+		stats.modelCount--;
+		stats.referencedBricks -= removed.solidBricks;
+		removed = GpuVoxelModel{};
+		freeModels.push_back(model);
+		revision++;
+	}
+
+	ui32 VoxelModelLibrary::AddPalette(const std::vector<Voxel>& remap)
+	{
+		if (remap.size() > MODEL_PALETTE_SIZE) {
+			Error("Voxel model palette got", remap.size(), "entries, at most", MODEL_PALETTE_SIZE, "fit.");
+			throw std::runtime_error("Voxel model palette too large.");
+		}
+		ui32 id = static_cast<ui32>(palettes.size() / MODEL_PALETTE_SIZE);
+		palettes.resize(palettes.size() + MODEL_PALETTE_SIZE, 0);
+		for (size_t i = 0;i < remap.size();i++) {
+			palettes[id * MODEL_PALETTE_SIZE + i] = remap[i].IsEmpty() ? 0 : remap[i].Pack();
+		}
+		revision++;
+		return id;
+	}
+
+	Voxel VoxelModelLibrary::Remap(ui32 palette, const Voxel& voxel) const
+	{
+		if (voxel.material >= MODEL_PALETTE_SIZE || palette >= palettes.size() / MODEL_PALETTE_SIZE) {
+			return voxel;
+		}
+		ui32 entry = palettes[palette * MODEL_PALETTE_SIZE + voxel.material];
+		return entry != 0 ? Voxel::Unpack(entry) : voxel;
+	}
+
+	Voxel VoxelModelLibrary::Get(ui32 model, const glm::ivec3& position) const
+	{
+		if (model >= models.size()) {
+			return Voxel{};
+		}
+		const GpuVoxelModel& m = models[model];
+		if (position.x < 0 || position.y < 0 || position.z < 0 ||
+			position.x >= m.size.x || position.y >= m.size.y || position.z >= m.size.z) {
+			return Voxel{};
+		}
+		glm::ivec3 brick(position.x >> BRICK_SIZE_LOG2, position.y >> BRICK_SIZE_LOG2, position.z >> BRICK_SIZE_LOG2);
+		ui32 slot = brickRefs[m.firstBrick + brick.x + m.bricks.x * (brick.y + m.bricks.y * brick.z)];
+		if (slot == MODEL_INVALID) {
+			return Voxel{};
+		}
+		return Voxel::Unpack(brickPool[slot * BRICK_VOLUME + MortonEncode(position.x & 7, position.y & 7, position.z & 7)]);
+	}
+
+	void VoxelModelLibrary::GetBounds(ui32 model, glm::vec3& min, glm::vec3& max) const
+	{
+		min = glm::vec3(0.f);
+		max = model < models.size() ? glm::vec3(models[model].size) : glm::vec3(0.f);
+	}
+
+	ModelHit VoxelModelLibrary::Trace(ui32 model, ui32 palette, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+	{
+		ModelHit result;
+		if (model >= models.size() || models[model].size.x == 0) {
+			return result;
+		}
+		const GpuVoxelModel& m = models[model];
+		glm::vec3 invDirection(
+			direction.x != 0.f ? 1.f / direction.x : 0.f,
+			direction.y != 0.f ? 1.f / direction.y : 0.f,
+			direction.z != 0.f ? 1.f / direction.z : 0.f);
+
+		// clip the ray to the model box first
+		float tEnter = 0.f;
+		float tExit = maxDistance;
+		int entryAxis = -1;
+		for (int i = 0;i < 3;i++) {
+			float size = static_cast<float>(m.size[i]);
+			if (direction[i] == 0.f) {
+				if (origin[i] < 0.f || origin[i] >= size) {
+					return result;
+				}
+				continue;
+			}
+			float t0 = (0.f - origin[i]) * invDirection[i];
+			float t1 = (size - origin[i]) * invDirection[i];
+			if (t0 > t1) {
+				std::swap(t0, t1);
+			}
+			if (t0 > tEnter) {
+				tEnter = t0;
+				entryAxis = i;
+			}
+			tExit = std::min(tExit, t1);
+		}
+		if (tEnter > tExit) {
+			return result;
+		}
+
+		glm::ivec3 last = m.size - glm::ivec3(1);
+		float t = tEnter;
+		float entry = tEnter;
+		ui32 steps = 0;
+		while (t <= tExit && steps < MAX_STEPS) {
+			// the clip leaves t on the box, rounding may put the point just outside of it
+			glm::ivec3 voxel = glm::clamp(glm::ivec3(glm::floor(origin + direction * t)), glm::ivec3(0), last);
+			glm::ivec3 brick(voxel.x >> BRICK_SIZE_LOG2, voxel.y >> BRICK_SIZE_LOG2, voxel.z >> BRICK_SIZE_LOG2);
+			ui32 slot = brickRefs[m.firstBrick + brick.x + m.bricks.x * (brick.y + m.bricks.y * brick.z)];
+
+			glm::ivec3 boxMin, boxMax;
+			if (slot == MODEL_INVALID) {
+				boxMin = brick * BRICK_SIZE;
+				boxMax = boxMin + glm::ivec3(BRICK_SIZE);
+			}
+			else {
+				ui32 packed = brickPool[slot * BRICK_VOLUME + MortonEncode(voxel.x & 7, voxel.y & 7, voxel.z & 7)];
+				if (packed != 0) {
+					result.hit = true;
+					result.voxel = voxel;
+					result.distance = entry;
+					result.value = Remap(palette, Voxel::Unpack(packed));
+					if (entryAxis >= 0) {
+						result.normal[entryAxis] = direction[entryAxis] > 0.f ? -1.f : 1.f;
+					}
+					return result;
+				}
+				boxMin = voxel;
+				boxMax = voxel + glm::ivec3(1);
+			}
+
+			entry = ExitDistance(origin, invDirection, direction, boxMin, boxMax, entryAxis);
+			// nudge past the boundary so the next lookup lands in the neighboring cell
+			t = entry + 1e-4f * std::max(1.f, entry);
+			steps++;
+		}
+		return result;
+	}
+
+	ModelHit VoxelModelLibrary::TraceInstance(const ModelInstance& instance, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+	{
+		// the model space direction keeps the scale, so t is the same distance on both sides
+		GpuModelInstance gpu = MakeGpuInstance(instance);
+		ModelHit result = Trace(instance.model, instance.palette, Apply(gpu, origin, 1.f), Apply(gpu, direction, 0.f), maxDistance);
+		if (result.hit) {
+			glm::vec3 rows[3];
+			RotationRows(instance.rotation, rows);
+			glm::vec3 n = result.normal;
+			result.normal = glm::vec3(glm::dot(rows[0], n), glm::dot(rows[1], n), glm::dot(rows[2], n));
+		}
+		return result;
+	}
+
+	ModelHit VoxelModelLibrary::TraceInstances(const ModelInstance* instances, const InstanceBvh& bvh,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+	{
+		ModelHit closest;
+		bvh.Traverse(origin, direction, maxDistance, [&](ui32 instance, float& distance) {
+			ModelHit hit = TraceInstance(instances[instance], origin, direction, distance);
+			if (hit.hit && (!closest.hit || hit.distance < closest.distance)) {
+				closest = hit;
+				closest.instance = instance;
+				distance = hit.distance;
+			}
+		});
+		return closest;
+	}
+
+	ui32 VoxelModelLibrary::AcquireBrick(const ui32* voxels)
+	{
+		ui64 hash = HashBrick(voxels);
+		auto range = brickLookup.equal_range(hash);
+		for (auto it = range.first;it != range.second;it++) {
+			if (std::memcmp(&brickPool[static_cast<size_t>(it->second) * BRICK_VOLUME], voxels, BRICK_VOLUME * sizeof(ui32)) == 0) {
+				brickUsers[it->second]++;
+				return it->second;
+			}
+		}
+
+		ui32 slot;
+		if (!freeBricks.empty()) {
+			slot = freeBricks.back();
+			freeBricks.pop_back();
+		}
+		else {
+			slot = static_cast<ui32>(brickUsers.size());
+			brickPool.resize(brickPool.size() + BRICK_VOLUME);
+			brickUsers.push_back(0);
+			brickHashes.push_back(0);
+		}
+		std::memcpy(&brickPool[static_cast<size_t>(slot) * BRICK_VOLUME], voxels, BRICK_VOLUME * sizeof(ui32));
+		brickUsers[slot] = 1;
+		brickHashes[slot] = hash;
+		brickLookup.emplace(hash, slot);
+		stats.uniqueBricks++;
+		stats.poolBytes = brickPool.size() * sizeof(ui32);
+		return slot;
+	}
+
+	void VoxelModelLibrary::ReleaseBrick(ui32 slot)
+	{
+		if (--brickUsers[slot] > 0) {
+			return;
+		}
+		auto range = brickLookup.equal_range(brickHashes[slot]);
+		for (auto it = range.first;it != range.second;it++) {
+			if (it->second == slot) {
+				brickLookup.erase(it);
+				break;
+			}
+		}
+		// the data stays until the slot is reused, nothing references it
+		freeBricks.push_back(slot);
+		stats.uniqueBricks--;
+	}
+
+	ui64 VoxelModelLibrary::HashBrick(const ui32* voxels)
+	{
+		ui64 h = 0xCBF29CE484222325ull;
+		for (ui32 i = 0;i < BRICK_VOLUME;i++) {
+			h = (h ^ voxels[i]) * 0x100000001B3ull;
+		}
+		return h ^ (h >> 29);
+	}
+
+	const std::vector<GpuVoxelModel>& VoxelModelLibrary::GetModels() const
+	{
+		return models;
+	}
+
+	const std::vector<ui32>& VoxelModelLibrary::GetBrickRefs() const
+	{
+		return brickRefs;
+	}
+
+	const std::vector<ui32>& VoxelModelLibrary::GetBrickPool() const
+	{
+		return brickPool;
+	}
+
+	const std::vector<ui32>& VoxelModelLibrary::GetPalettes() const
+	{
+		return palettes;
+	}
+
+	ui64 VoxelModelLibrary::GetRevision() const
+	{
+		return revision;
+	}
+
+	const VoxelModelStats& VoxelModelLibrary::GetStats() const
+	{
+		return stats;
+	}
+
+	GpuModelInstance VoxelModelLibrary::MakeGpuInstance(const ModelInstance& instance)
+	{
+		// inverse of position + scale * R * p: R^T (p - position) / scale
+		glm::vec3 rows[3];
+		RotationRows(instance.rotation, rows);
+		float invScale = 1.f / instance.scale;
+		GpuModelInstance gpu{};
+		for (int i = 0;i < 3;i++) {
+			glm::vec3 column = glm::vec3(rows[0][i], rows[1][i], rows[2][i]) * invScale;
+			gpu.rows[i] = glm::vec4(column, -glm::dot(column, instance.position));
+		}
+		gpu.model = instance.model;
+		gpu.palette = instance.palette;
+		gpu.scale = instance.scale;
+		gpu.padding = 0;
+		return gpu;
+	}
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "Voxel/Voxel.h"
+#include "Voxel/Morton.h"
+#include "Voxel/VoxelWorld.h"
+#include "Renderer/InstanceBvh.h"
+
+#define MODEL_INVALID 0xFFFFFFFFu
+// materials a palette can remap, higher ones are kept as they are.
+#define MODEL_PALETTE_SIZE 256
+
+namespace Luxel
+{
+	// layouts below must match shaders/voxel_models.glsl.
+	struct GpuVoxelModel
+	{
+		// in voxels, zero for removed models
+		glm::ivec3 size;
+		// first entry of GetBrickRefs
+		ui32 firstBrick;
+		// brick grid, GetBrickRefs holds one entry per brick with x fastest
+		glm::ivec3 bricks;
+		ui32 solidBricks;
+	};
+
+	// world to model space as three rows of a 3x4 matrix, the rotation already divided by the scale.
+	struct GpuModelInstance
+	{
+		glm::vec4 rows[3];
+		ui32 model;
+		ui32 palette;
+		float scale;
+		ui32 padding;
+	};
+
+	// one placement of a model, the same transform convention as Scene.
+	struct ModelInstance
+	{
+		ui32 model = MODEL_INVALID;
+		ui32 palette = 0;
+		glm::vec3 position = glm::vec3(0.f);
+		// quaternion, xyz vector part and w
+		glm::vec4 rotation = glm::vec4(0.f, 0.f, 0.f, 1.f);
+		float scale = 1.f;
+	};
+
+	struct ModelHit
+	{
+		bool hit = false;
+		ui32 instance = MODEL_INVALID;
+		// in model space
+		glm::ivec3 voxel = glm::ivec3(0);
+		// world space face normal, zero when the ray starts inside a solid voxel.
+		glm::vec3 normal = glm::vec3(0.f);
+		float distance = 0.f;
+		// after the palette remap
+		Voxel value;
+	};
+
+	struct VoxelModelStats
+	{
+		ui32 modelCount = 0;
+		// bricks held in the pool
+		ui32 uniqueBricks = 0;
+		// solid bricks over all models, what the pool would hold without deduplication
+		ui32 referencedBricks = 0;
+		size_t poolBytes = 0;
+	};
+
+	// shared voxel models for prefabs placed many times: trees, rocks, buildings.
+	// models are cut into 8^3 bricks and identical bricks are stored once in a pool shared by every
+	// model, so memory grows with unique content. instances only carry a transform and a palette,
+	// which remaps materials per placement. the tables are laid out for the GPU as they are, one copy
+	// per model no matter how often it is placed.
+	// adding and removing models or palettes must not overlap with traces.
+	class LUXEL_API VoxelModelLibrary
+	{
+	public:
+		VoxelModelLibrary();
+		~VoxelModelLibrary();
+		VoxelModelLibrary(const VoxelModelLibrary&) = delete;
+		void operator=(const VoxelModelLibrary&) = delete;
+
+		// size.x * size.y * size.z voxels with x fastest. model space has voxel (0, 0, 0) at the origin.
+		ui32 AddModel(const glm::ivec3& size, const Voxel* voxels);
+		// copies the voxels in [min, max) of world, for prefabs built in an editing world.
+		ui32 AddModel(const VoxelWorld& world, const glm::ivec3& min, const glm::ivec3& max);
+		// bricks no other model uses go back to the pool, the id is reused.
+		void RemoveModel(ui32 model);
+
+		// remap[material] replaces voxels of that material, empty entries keep them.
+		// at most MODEL_PALETTE_SIZE entries. palette 0 is the identity.
+		ui32 AddPalette(const std::vector<Voxel>& remap);
+		Voxel Remap(ui32 palette, const Voxel& voxel) const;
+
+		Voxel Get(ui32 model, const glm::ivec3& position) const;
+		// model space box, for Scene::SetLocalBounds.
+		void GetBounds(ui32 model, glm::vec3& min, glm::vec3& max) const;
+
+		// model space traversal. direction need not be normalized, distances are in multiples of it;
+		// empty bricks are skipped whole.
+		ModelHit Trace(ui32 model, ui32 palette, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+		// world space ray against one placement, distances stay in world units.
+		ModelHit TraceInstance(const ModelInstance& instance, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+		// closest hit over placements, bvh built over their world bounds in the same order.
+		ModelHit TraceInstances(const ModelInstance* instances, const InstanceBvh& bvh,
+			const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+		const std::vector<GpuVoxelModel>& GetModels() const;
+		// pool slot per brick of every model, MODEL_INVALID for empty bricks.
+		const std::vector<ui32>& GetBrickRefs() const;
+		// BRICK_VOLUME packed voxels per slot in Morton order, same as Chunk storage.
+		const std::vector<ui32>& GetBrickPool() const;
+		// MODEL_PALETTE_SIZE packed voxels per palette, 0 keeps the material.
+		const std::vector<ui32>& GetPalettes() const;
+		// bumped whenever a table changes, re-upload them then.
+		ui64 GetRevision() const;
+		const VoxelModelStats& GetStats() const;
+
+		static GpuModelInstance MakeGpuInstance(const ModelInstance& instance);
+
+	private:
+		// voxel at a model position, sample(position) for every position in [0, size).
+		ui32 AddModel(const glm::ivec3& size, const std::function<Voxel(const glm::ivec3&)>& sample);
+		// pool slot holding the same voxels, adding them if there is none.
+		ui32 AcquireBrick(const ui32* voxels);
+		void ReleaseBrick(ui32 slot);
+		static ui64 HashBrick(const ui32* voxels);
+
+		std::vector<GpuVoxelModel> models;
+		std::vector<ui32> freeModels;
+		std::vector<ui32> brickRefs;
+
+		std::vector<ui32> brickPool;
+		std::vector<ui32> brickUsers;
+		std::vector<ui64> brickHashes;
+		std::vector<ui32> freeBricks;
+		std::unordered_multimap<ui64, ui32> brickLookup;
+
+		std::vector<ui32> palettes;
+		ui64 revision;
+		VoxelModelStats stats;
+	};
+}
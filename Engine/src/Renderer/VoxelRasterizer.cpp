@@ -0,0 +1,220 @@
+#include "pch.h"
+
+#include "VoxelRasterizer.h"
+
+namespace Luxel
+{
+	VoxelRasterizer::VoxelRasterizer(Device* const d, VoxelWorld* const w) :
+		device{ d }, world{ w }, indexQuadCapacity{ 0 }, syncedRevision{ 0 }, updateCount{ 0 }
+	{
+
+	}
+
+	VoxelRasterizer::~VoxelRasterizer()
+	{
+		Info("Destroy voxel rasterizer.");
+		vkQueueWaitIdle(device->GetGraphicsQueue());
+		meshes.clear();
+		retiredBuffers.clear();
+		indexBuffer.reset();
+	}
+
+	void VoxelRasterizer::ConfigurePipeline(PipelineConfigInfo& configInfo)
+	{
+		configInfo.bindingDescriptions = VoxelVertex::GetBindingDescriptions();
+		configInfo.attributeDescriptions = VoxelVertex::GetAttributeDescriptions();
+		configInfo.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	}
+
+	VkPushConstantRange VoxelRasterizer::GetPushConstantRange()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(VoxelRasterPushConstants);
+		return pushConstantRange;
+	}
+
+	ui32 VoxelRasterizer::Update(VkCommandBuffer commandBuffer)
+	{
+		updateCount++;
+		while (!retiredBuffers.empty() && retiredBuffers.front().first + MAX_FRAMES_IN_FLIGHT < updateCount) {
+			retiredBuffers.pop_front();
+		}
+
+		ui64 revision = world->GetRevision();
+		if (revision == syncedRevision) {
+			return 0;
+		}
+
+		// the lookups below probe the chunk table, which a concurrent insert may replace
+		EpochGuard guard;
+		// a changed chunk also changes the border faces and occlusion of its neighbors
+		std::unordered_set<ChunkCoord, ChunkCoordHash> dirty;
+		auto markWithNeighbors = [&](const ChunkCoord& coord) {
+			for (int dz = -1;dz <= 1;dz++) {
+				for (int dy = -1;dy <= 1;dy++) {
+					for (int dx = -1;dx <= 1;dx++) {
+						dirty.insert(coord + glm::ivec3(dx, dy, dz));
+					}
+				}
+			}
+		};
+
+		for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+			markWithNeighbors(coord);
+		}
+		for (auto it = meshes.begin();it != meshes.end();) {
+			if (world->GetChunk(it->first) == nullptr) {
+				markWithNeighbors(it->first);
+				RetireBuffer(std::move(it->second.vertexBuffer));
+				it = meshes.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		syncedRevision = revision;
+
+		std::vector<ChunkCoord> remesh;
+		remesh.reserve(dirty.size());
+		for (const auto& coord : dirty) {
+			if (world->GetChunk(coord) != nullptr) {
+				remesh.push_back(coord);
+			}
+		}
+		if (remesh.empty()) {
+			return 0;
+		}
+
+		// mesh on the workers
+		std::vector<std::vector<VoxelVertex>> results(remesh.size());
+		JobSystem::ParallelFor(static_cast<ui32>(remesh.size()), 1, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				GreedyMesher::MeshChunk(*world, remesh[i], results[i]);
+			}
+		});
+
+		// upload everything through one staging buffer, copied by the frame instead of a submit that waits
+		VkDeviceSize totalSize = 0;
+		ui32 maxQuads = 0;
+		for (const auto& vertices : results) {
+			totalSize += vertices.size() * sizeof(VoxelVertex);
+			maxQuads = std::max(maxQuads, static_cast<ui32>(vertices.size() / 4));
+		}
+		EnsureIndexCapacity(maxQuads);
+
+		std::unique_ptr<Buffer> staging;
+		if (totalSize > 0) {
+			staging = std::make_unique<Buffer>(device, totalSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		VkDeviceSize stagingOffset = 0;
+		for (size_t i = 0;i < remesh.size();i++) {
+			ChunkMesh& mesh = meshes[remesh[i]];
+			if (mesh.vertexBuffer != nullptr) {
+				RetireBuffer(std::move(mesh.vertexBuffer));
+			}
+			mesh.quadCount = static_cast<ui32>(results[i].size() / 4);
+			if (mesh.quadCount == 0) {
+				meshes.erase(remesh[i]);
+				continue;
+			}
+
+			VkDeviceSize size = results[i].size() * sizeof(VoxelVertex);
+			staging->WriteToBuffer(results[i].data(), size, stagingOffset);
+			mesh.vertexBuffer = std::make_unique<Buffer>(device, size,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = stagingOffset;
+			copyRegion.dstOffset = 0;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(commandBuffer, staging->GetBuffer(), mesh.vertexBuffer->GetBuffer(), 1, &copyRegion);
+			stagingOffset += size;
+		}
+
+		// new vertex buffers only, nothing reads them before the copies
+		if (staging != nullptr) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+			RetireBuffer(std::move(staging));
+		}
+
+		Debug("Voxel rasterizer re-meshed", remesh.size(), "chunks,", totalSize, "bytes uploaded.");
+		return static_cast<ui32>(remesh.size());
+	}
+
+	void VoxelRasterizer::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& viewProjection)
+	{
+		if (meshes.empty() || indexBuffer == nullptr) {
+			return;
+		}
+
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+		VoxelRasterPushConstants pushConstants{};
+		pushConstants.viewProjection = viewProjection;
+		for (const auto& [coord, mesh] : meshes) {
+			pushConstants.chunkOrigin = glm::ivec4(ChunkOrigin(coord), 0);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VoxelRasterPushConstants), &pushConstants);
+
+			VkBuffer vertexBuffers[] = { mesh.vertexBuffer->GetBuffer() };
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+			vkCmdDrawIndexed(commandBuffer, mesh.quadCount * 6, 1, 0, 0, 0);
+		}
+	}
+
+	size_t VoxelRasterizer::GetMeshCount() const
+	{
+		return meshes.size();
+	}
+
+	ui64 VoxelRasterizer::GetQuadCount() const
+	{
+		ui64 quads = 0;
+		for (const auto& [coord, mesh] : meshes) {
+			quads += mesh.quadCount;
+		}
+		return quads;
+	}
+
+	void VoxelRasterizer::EnsureIndexCapacity(ui32 quadCount)
+	{
+		if (quadCount <= indexQuadCapacity) {
+			return;
+		}
+
+		// every quad uses the same 0-1-2 2-3-0 pattern, so one shared buffer serves all chunks
+		ui32 capacity = std::max(quadCount, indexQuadCapacity * 2);
+		std::vector<ui32> indices(static_cast<size_t>(capacity) * 6);
+		for (ui32 q = 0;q < capacity;q++) {
+			indices[q * 6 + 0] = q * 4 + 0;
+			indices[q * 6 + 1] = q * 4 + 1;
+			indices[q * 6 + 2] = q * 4 + 2;
+			indices[q * 6 + 3] = q * 4 + 2;
+			indices[q * 6 + 4] = q * 4 + 3;
+			indices[q * 6 + 5] = q * 4 + 0;
+		}
+
+		if (indexBuffer != nullptr) {
+			RetireBuffer(std::move(indexBuffer));
+		}
+		VkDeviceSize size = indices.size() * sizeof(ui32);
+		indexBuffer = std::make_unique<Buffer>(device, size,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		indexBuffer->Upload(indices.data(), size);
+		indexQuadCapacity = capacity;
+	}
+
+	void VoxelRasterizer::RetireBuffer(std::unique_ptr<Buffer> buffer)
+	{
+		retiredBuffers.emplace_back(updateCount, std::move(buffer));
+	}
+}
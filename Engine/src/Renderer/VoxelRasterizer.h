@@ -0,0 +1,68 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Device.h"
+#include "EngineCore/Buffer.h"
+#include "EngineCore/JobSystem.h"
+#include "EngineCore/RenderPipeline.h"
+#include "Voxel/VoxelWorld.h"
+#include "Voxel/GreedyMesher.h"
+
+namespace Luxel
+{
+	struct VoxelRasterPushConstants
+	{
+		glm::mat4 viewProjection;
+		glm::ivec4 chunkOrigin;
+	};
+
+	// raster fallback for primary visibility: greedy meshes per chunk, rebuilt only when dirty.
+	class LUXEL_API VoxelRasterizer
+	{
+	public:
+		VoxelRasterizer(Device* const d, VoxelWorld* const w);
+		~VoxelRasterizer();
+		VoxelRasterizer(const VoxelRasterizer&) = delete;
+		void operator=(const VoxelRasterizer&) = delete;
+
+		// sets vertex input, winding and the push constant layout expected by voxel_raster shaders.
+		static void ConfigurePipeline(PipelineConfigInfo& configInfo);
+		static VkPushConstantRange GetPushConstantRange();
+
+		// re-meshes changed chunks and their neighbors on worker threads, then records their upload into
+		// commandBuffer, outside a render pass and before Draw. the caller must have waited for the frame that
+		// last used this frame slot. returns the number of chunks that were re-meshed.
+		ui32 Update(VkCommandBuffer commandBuffer);
+		void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& viewProjection);
+
+		size_t GetMeshCount() const;
+		ui64 GetQuadCount() const;
+
+	private:
+		struct ChunkMesh
+		{
+			std::unique_ptr<Buffer> vertexBuffer;
+			ui32 quadCount = 0;
+		};
+
+		void EnsureIndexCapacity(ui32 quadCount);
+		void RetireBuffer(std::unique_ptr<Buffer> buffer);
+
+		Device* const device;
+		VoxelWorld* const world;
+
+		std::unordered_map<ChunkCoord, ChunkMesh, ChunkCoordHash> meshes;
+		std::unique_ptr<Buffer> indexBuffer;
+		ui32 indexQuadCapacity;
+		ui64 syncedRevision;
+
+		// buffers may still be read by frames in flight, staging buffers by the copies of one, so they are
+		// freed a few updates later.
+		std::deque<std::pair<ui64, std::unique_ptr<Buffer>>> retiredBuffers;
+		ui64 updateCount;
+	};
+}
@@ -0,0 +1,463 @@
+#include "pch.h"
+
+#include "Scene.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 MOVED = COMPONENT_TRANSFORM | COMPONENT_BOUNDS;
+		constexpr ui32 MODIFIED = COMPONENT_MODEL | COMPONENT_MATERIAL;
+
+		inline bool ByIndex(const EntityHandle& a, const EntityHandle& b)
+		{
+			return a.index < b.index;
+		}
+	}
+
+	Scene::Scene() : entityCount{ 0 }, pendingStructural{ false }
+	{
+
+	}
+
+	Scene::~Scene()
+	{
+		Clear();
+	}
+
+	EntityHandle Scene::Create(ui32 components)
+	{
+		ui32 index;
+		if (!freeSlots.empty()) {
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			index = static_cast<ui32>(slots.size());
+			slots.emplace_back();
+		}
+		EntitySlot& slot = slots[index];
+		EntityHandle entity{ index, slot.generation };
+
+		components &= COMPONENT_ALL;
+		SceneTable& table = GetTable(components);
+		slot.table = tableIndices[components];
+		slot.row = AddRow(table, entity);
+		entityCount++;
+
+		pendingAdded.push_back(entity);
+		pendingStructural |= table.Has(MOVED);
+		return entity;
+	}
+
+	void Scene::Destroy(EntityHandle entity)
+	{
+		const EntitySlot& slot = Resolve(entity);
+		SceneTable& table = *tables[slot.table];
+		pendingStructural |= table.Has(MOVED);
+		RemoveRow(table, slot.row);
+
+		EntitySlot& freed = slots[entity.index];
+		freed.table = ENTITY_INVALID;
+		freed.generation++;
+		freeSlots.push_back(entity.index);
+		entityCount--;
+		pendingRemoved.push_back(entity);
+	}
+
+	bool Scene::IsAlive(EntityHandle entity) const
+	{
+		return entity.index < slots.size() && slots[entity.index].table != ENTITY_INVALID &&
+			slots[entity.index].generation == entity.generation;
+	}
+
+	void Scene::Clear()
+	{
+		for (ui32 i = 0;i < slots.size();i++) {
+			if (slots[i].table != ENTITY_INVALID) {
+				pendingRemoved.push_back(EntityHandle{ i, slots[i].generation });
+				slots[i].table = ENTITY_INVALID;
+				slots[i].generation++;
+				freeSlots.push_back(i);
+			}
+		}
+		for (auto& table : tables) {
+			pendingStructural |= table->Size() > 0 && table->Has(MOVED);
+			ui32 components = table->components;
+			*table = SceneTable{};
+			table->components = components;
+		}
+		entityCount = 0;
+	}
+
+	void Scene::AddComponents(EntityHandle entity, ui32 components)
+	{
+		Move(entity, GetComponents(entity) | components);
+	}
+
+	void Scene::RemoveComponents(EntityHandle entity, ui32 components)
+	{
+		Move(entity, GetComponents(entity) & ~components);
+	}
+
+	ui32 Scene::GetComponents(EntityHandle entity) const
+	{
+		return tables[Resolve(entity).table]->components;
+	}
+
+	void Scene::SetTransform(EntityHandle entity, const glm::vec3& position, const glm::vec4& rotation, float scale)
+	{
+		const EntitySlot& slot = Resolve(entity);
+		SceneTable& table = *tables[slot.table];
+		if (!table.Has(COMPONENT_TRANSFORM)) {
+			return;
+		}
+		table.positions[slot.row] = position;
+		table.rotations[slot.row] = rotation;
+		table.scales[slot.row] = scale;
+		table.MarkDirty(slot.row, COMPONENT_TRANSFORM);
+	}
+
+	void Scene::SetLocalBounds(EntityHandle entity, const glm::vec3& min, const glm::vec3& max)
+	{
+		const EntitySlot& slot = Resolve(entity);
+		SceneTable& table = *tables[slot.table];
+		if (!table.Has(COMPONENT_BOUNDS)) {
+			return;
+		}
+		table.localMin[slot.row] = min;
+		table.localMax[slot.row] = max;
+		table.MarkDirty(slot.row, COMPONENT_BOUNDS);
+	}
+
+	void Scene::SetModel(EntityHandle entity, ui32 model)
+	{
+		const EntitySlot& slot = Resolve(entity);
+		SceneTable& table = *tables[slot.table];
+		if (!table.Has(COMPONENT_MODEL)) {
+			return;
+		}
+		table.models[slot.row] = model;
+		table.MarkDirty(slot.row, COMPONENT_MODEL);
+	}
+
+	void Scene::SetMaterial(EntityHandle entity, ui32 material)
+	{
+		const EntitySlot& slot = Resolve(entity);
+		SceneTable& table = *tables[slot.table];
+		if (!table.Has(COMPONENT_MATERIAL)) {
+			return;
+		}
+		table.materials[slot.row] = material;
+		table.MarkDirty(slot.row, COMPONENT_MATERIAL);
+	}
+
+	glm::vec3 Scene::GetPosition(EntityHandle entity) const
+	{
+		const EntitySlot& slot = Resolve(entity);
+		const SceneTable& table = *tables[slot.table];
+		return table.Has(COMPONENT_TRANSFORM) ? table.positions[slot.row] : glm::vec3(0.f);
+	}
+
+	glm::vec4 Scene::GetRotation(EntityHandle entity) const
+	{
+		const EntitySlot& slot = Resolve(entity);
+		const SceneTable& table = *tables[slot.table];
+		return table.Has(COMPONENT_TRANSFORM) ? table.rotations[slot.row] : glm::vec4(0.f, 0.f, 0.f, 1.f);
+	}
+
+	float Scene::GetScale(EntityHandle entity) const
+	{
+		const EntitySlot& slot = Resolve(entity);
+		const SceneTable& table = *tables[slot.table];
+		return table.Has(COMPONENT_TRANSFORM) ? table.scales[slot.row] : 1.f;
+	}
+
+	BvhBounds Scene::GetWorldBounds(EntityHandle entity) const
+	{
+		const EntitySlot& slot = Resolve(entity);
+		const SceneTable& table = *tables[slot.table];
+		if (!table.Has(COMPONENT_BOUNDS)) {
+			return BvhBounds{};
+		}
+		return BvhBounds{ table.worldMin[slot.row], table.worldMax[slot.row] };
+	}
+
+	ui32 Scene::GetModel(EntityHandle entity) const
+	{
+		const EntitySlot& slot = Resolve(entity);
+		const SceneTable& table = *tables[slot.table];
+		return table.Has(COMPONENT_MODEL) ? table.models[slot.row] : 0;
+	}
+
+	ui32 Scene::GetMaterial(EntityHandle entity) const
+	{
+		const EntitySlot& slot = Resolve(entity);
+		const SceneTable& table = *tables[slot.table];
+		return table.Has(COMPONENT_MATERIAL) ? table.materials[slot.row] : 0;
+	}
+
+	void Scene::ForEach(ui32 components, const std::function<void(SceneTable& table, ui32 begin, ui32 end)>& func)
+	{
+		// one flat range over the matching tables, so small tables share jobs with big ones
+		std::vector<SceneTable*> matching;
+		std::vector<ui32> batchStart;
+		ui32 batchCount = 0;
+		for (auto& table : tables) {
+			if (table->Has(components) && table->Size() > 0) {
+				matching.push_back(table.get());
+				batchStart.push_back(batchCount);
+				batchCount += (table->Size() + SCENE_BATCH_SIZE - 1) / SCENE_BATCH_SIZE;
+			}
+		}
+		JobSystem::ParallelFor(batchCount, 1, [&](ui32 begin, ui32 end) {
+			for (ui32 batch = begin;batch < end;batch++) {
+				ui32 t = static_cast<ui32>(std::upper_bound(batchStart.begin(), batchStart.end(), batch) - batchStart.begin()) - 1;
+				SceneTable& table = *matching[t];
+				ui32 first = (batch - batchStart[t]) * SCENE_BATCH_SIZE;
+				func(table, first, std::min(first + SCENE_BATCH_SIZE, table.Size()));
+			}
+		});
+	}
+
+	const SceneChanges& Scene::CollectChanges()
+	{
+		changes.moved.clear();
+		changes.modified.clear();
+		std::mutex mutex;
+		ForEach(0, [&](SceneTable& table, ui32 begin, ui32 end) {
+			bool hasWorldBounds = table.Has(MOVED);
+			// entities without bounds are not in the BVH, so a transform write leaves nothing to refit
+			bool bounded = table.Has(COMPONENT_BOUNDS);
+			std::vector<EntityHandle> moved, modified;
+			for (ui32 row = begin;row < end;row++) {
+				ui8 flags = table.dirty[row];
+				if (flags == 0) {
+					continue;
+				}
+				if ((flags & MOVED) != 0) {
+					if (hasWorldBounds) {
+						BvhBounds world = TransformBounds(table.localMin[row], table.localMax[row],
+							table.positions[row], table.rotations[row], table.scales[row]);
+						table.worldMin[row] = world.min;
+						table.worldMax[row] = world.max;
+					}
+					else if (table.Has(COMPONENT_BOUNDS)) {
+						table.worldMin[row] = table.localMin[row];
+						table.worldMax[row] = table.localMax[row];
+					}
+					if (bounded) {
+						moved.push_back(table.entities[row]);
+					}
+				}
+				if ((flags & MODIFIED) != 0) {
+					modified.push_back(table.entities[row]);
+				}
+				table.dirty[row] = 0;
+			}
+			if (!moved.empty() || !modified.empty()) {
+				std::lock_guard<std::mutex> lock(mutex);
+				changes.moved.insert(changes.moved.end(), moved.begin(), moved.end());
+				changes.modified.insert(changes.modified.end(), modified.begin(), modified.end());
+			}
+		});
+		std::sort(changes.moved.begin(), changes.moved.end(), ByIndex);
+		std::sort(changes.modified.begin(), changes.modified.end(), ByIndex);
+
+		changes.added.swap(pendingAdded);
+		changes.removed.swap(pendingRemoved);
+		pendingAdded.clear();
+		pendingRemoved.clear();
+		std::sort(changes.added.begin(), changes.added.end(), ByIndex);
+		std::sort(changes.removed.begin(), changes.removed.end(), ByIndex);
+
+		changes.structural = pendingStructural;
+		pendingStructural = false;
+		if (changes.structural) {
+			instances.clear();
+			for (ui32 i = 0;i < slots.size();i++) {
+				if (slots[i].table != ENTITY_INVALID && tables[slots[i].table]->Has(MOVED)) {
+					instances.push_back(EntityHandle{ i, slots[i].generation });
+				}
+			}
+		}
+		return changes;
+	}
+
+	const SceneChanges& Scene::GetChanges() const
+	{
+		return changes;
+	}
+
+	const std::vector<EntityHandle>& Scene::GetInstances() const
+	{
+		return instances;
+	}
+
+	void Scene::GatherInstanceBounds(std::vector<BvhBounds>& bounds) const
+	{
+		bounds.resize(instances.size());
+		JobSystem::ParallelFor(static_cast<ui32>(instances.size()), SCENE_BATCH_SIZE, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				if (!IsAlive(instances[i])) {
+					// destroyed since the last CollectChanges
+					bounds[i] = BvhBounds{};
+					continue;
+				}
+				const EntitySlot& slot = slots[instances[i].index];
+				const SceneTable& table = *tables[slot.table];
+				bounds[i] = table.Has(MOVED) ? BvhBounds{ table.worldMin[slot.row], table.worldMax[slot.row] } : BvhBounds{};
+			}
+		});
+	}
+
+	ui32 Scene::GetEntityCount() const
+	{
+		return entityCount;
+	}
+
+	const std::vector<std::unique_ptr<SceneTable>>& Scene::GetTables() const
+	{
+		return tables;
+	}
+
+	BvhBounds Scene::TransformBounds(const glm::vec3& localMin, const glm::vec3& localMax,
+		const glm::vec3& position, const glm::vec4& rotation, float scale)
+	{
+		if (localMin.x > localMax.x) {
+			return BvhBounds{};
+		}
+		// rotation matrix of the quaternion, the world extent is |R| times the local one
+		float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+		glm::vec3 row0(1.f - 2.f * (y * y + z * z), 2.f * (x * y - w * z), 2.f * (x * z + w * y));
+		glm::vec3 row1(2.f * (x * y + w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - w * x));
+		glm::vec3 row2(2.f * (x * z - w * y), 2.f * (y * z + w * x), 1.f - 2.f * (x * x + y * y));
+		glm::vec3 center = (localMin + localMax) * 0.5f;
+		glm::vec3 extent = (localMax - localMin) * 0.5f;
+		glm::vec3 worldCenter = position + glm::vec3(glm::dot(row0, center), glm::dot(row1, center), glm::dot(row2, center)) * scale;
+		glm::vec3 worldExtent = glm::vec3(glm::dot(glm::abs(row0), extent), glm::dot(glm::abs(row1), extent), glm::dot(glm::abs(row2), extent)) * std::abs(scale);
+		return BvhBounds{ worldCenter - worldExtent, worldCenter + worldExtent };
+	}
+
+	SceneTable& Scene::GetTable(ui32 components)
+	{
+		auto it = tableIndices.find(components);
+		if (it != tableIndices.end()) {
+			return *tables[it->second];
+		}
+		tableIndices[components] = static_cast<ui32>(tables.size());
+		tables.push_back(std::make_unique<SceneTable>());
+		tables.back()->components = components;
+		return *tables.back();
+	}
+
+	ui32 Scene::AddRow(SceneTable& table, EntityHandle entity)
+	{
+		ui32 row = table.Size();
+		table.entities.push_back(entity);
+		if (table.Has(COMPONENT_TRANSFORM)) {
+			table.positions.push_back(glm::vec3(0.f));
+			table.rotations.push_back(glm::vec4(0.f, 0.f, 0.f, 1.f));
+			table.scales.push_back(1.f);
+		}
+		if (table.Has(COMPONENT_BOUNDS)) {
+			BvhBounds empty;
+			table.localMin.push_back(empty.min);
+			table.localMax.push_back(empty.max);
+			table.worldMin.push_back(empty.min);
+			table.worldMax.push_back(empty.max);
+		}
+		if (table.Has(COMPONENT_MODEL)) {
+			table.models.push_back(0);
+		}
+		if (table.Has(COMPONENT_MATERIAL)) {
+			table.materials.push_back(0);
+		}
+		// new rows show up in every change list once
+		table.dirty.push_back(static_cast<ui8>(table.components));
+		return row;
+	}
+
+	void Scene::RemoveRow(SceneTable& table, ui32 row)
+	{
+		ui32 last = table.Size() - 1;
+		if (row != last) {
+			CopyRow(table, last, table, row);
+			table.entities[row] = table.entities[last];
+			table.dirty[row] = table.dirty[last];
+			slots[table.entities[row].index].row = row;
+		}
+		table.entities.pop_back();
+		table.dirty.pop_back();
+		if (table.Has(COMPONENT_TRANSFORM)) {
+			table.positions.pop_back();
+			table.rotations.pop_back();
+			table.scales.pop_back();
+		}
+		if (table.Has(COMPONENT_BOUNDS)) {
+			table.localMin.pop_back();
+			table.localMax.pop_back();
+			table.worldMin.pop_back();
+			table.worldMax.pop_back();
+		}
+		if (table.Has(COMPONENT_MODEL)) {
+			table.models.pop_back();
+		}
+		if (table.Has(COMPONENT_MATERIAL)) {
+			table.materials.pop_back();
+		}
+	}
+
+	void Scene::CopyRow(const SceneTable& source, ui32 sourceRow, SceneTable& target, ui32 targetRow)
+	{
+		ui32 shared = source.components & target.components;
+		if ((shared & COMPONENT_TRANSFORM) != 0) {
+			target.positions[targetRow] = source.positions[sourceRow];
+			target.rotations[targetRow] = source.rotations[sourceRow];
+			target.scales[targetRow] = source.scales[sourceRow];
+		}
+		if ((shared & COMPONENT_BOUNDS) != 0) {
+			target.localMin[targetRow] = source.localMin[sourceRow];
+			target.localMax[targetRow] = source.localMax[sourceRow];
+			target.worldMin[targetRow] = source.worldMin[sourceRow];
+			target.worldMax[targetRow] = source.worldMax[sourceRow];
+		}
+		if ((shared & COMPONENT_MODEL) != 0) {
+			target.models[targetRow] = source.models[sourceRow];
+		}
+		if ((shared & COMPONENT_MATERIAL) != 0) {
+			target.materials[targetRow] = source.materials[sourceRow];
+		}
+	}
+
+	void Scene::Move(EntityHandle entity, ui32 components)
+	{
+		components &= COMPONENT_ALL;
+		const EntitySlot& slot = Resolve(entity);
+		ui32 sourceIndex = slot.table;
+		ui32 sourceRow = slot.row;
+		if (tables[sourceIndex]->components == components) {
+			return;
+		}
+		// GetTable may grow the table list, so tables are looked up again after it
+		SceneTable& target = GetTable(components);
+		SceneTable& source = *tables[sourceIndex];
+		ui32 targetRow = AddRow(target, entity);
+		CopyRow(source, sourceRow, target, targetRow);
+		pendingStructural |= source.Has(MOVED) != target.Has(MOVED);
+
+		RemoveRow(source, sourceRow);
+		EntitySlot& moved = slots[entity.index];
+		moved.table = tableIndices[components];
+		moved.row = targetRow;
+	}
+
+	const Scene::EntitySlot& Scene::Resolve(EntityHandle entity) const
+	{
+		if (!IsAlive(entity)) {
+			Error("Scene entity", entity.index, "generation", entity.generation, "is not alive.");
+			throw std::runtime_error("Stale scene entity handle.");
+		}
+		return slots[entity.index];
+	}
+}
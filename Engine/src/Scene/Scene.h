@@ -0,0 +1,166 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Renderer/InstanceBvh.h"
+
+#define ENTITY_INVALID 0xFFFFFFFFu
+// rows handed to one job by Scene::ForEach.
+#define SCENE_BATCH_SIZE 1024
+
+namespace Luxel
+{
+	// component bits; an archetype is the set an entity has.
+	enum SceneComponent : ui32
+	{
+		// position, rotation, scale
+		COMPONENT_TRANSFORM = 1 << 0,
+		// model space box, with the world box derived from it and the transform
+		COMPONENT_BOUNDS = 1 << 1,
+		// voxel model the renderer draws
+		COMPONENT_MODEL = 1 << 2,
+		COMPONENT_MATERIAL = 1 << 3,
+		COMPONENT_ALL = (1 << 4) - 1
+	};
+
+	// stays valid across moves between tables; the generation tells a reused slot apart.
+	struct EntityHandle
+	{
+		ui32 index = ENTITY_INVALID;
+		ui32 generation = 0;
+
+		bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+	};
+
+	// one archetype: a column per component it has, the other columns stay empty.
+	// rows are packed, removing one moves the last row into its place.
+	struct SceneTable
+	{
+		ui32 components = 0;
+		std::vector<EntityHandle> entities;
+
+		std::vector<glm::vec3> positions;
+		// quaternion, xyz vector part and w
+		std::vector<glm::vec4> rotations;
+		std::vector<float> scales;
+
+		std::vector<glm::vec3> localMin, localMax;
+		std::vector<glm::vec3> worldMin, worldMax;
+
+		std::vector<ui32> models;
+		std::vector<ui32> materials;
+
+		// components written since the last CollectChanges
+		std::vector<ui8> dirty;
+
+		ui32 Size() const { return static_cast<ui32>(entities.size()); }
+		bool Has(ui32 c) const { return (components & c) == c; }
+		// for writes made straight into the columns, e.g. from ForEach.
+		void MarkDirty(ui32 row, ui32 c) { dirty[row] |= static_cast<ui8>(c); }
+	};
+
+	// what changed since the previous CollectChanges, handles sorted by index.
+	struct SceneChanges
+	{
+		std::vector<EntityHandle> added;
+		std::vector<EntityHandle> removed;
+		// transform or bounds written on entities with bounds, world bounds are already updated: the BVH refit set
+		std::vector<EntityHandle> moved;
+		// model or material written: the upload set
+		std::vector<EntityHandle> modified;
+		// entities came, went or gained or lost bounds; the instance list changed and the BVH needs a Build
+		bool structural = false;
+	};
+
+	// entity storage for dynamic voxel objects in structure of arrays tables, one per archetype.
+	// ForEach and CollectChanges run on the workers; creating, destroying and changing the components
+	// of entities must not overlap with them.
+	class LUXEL_API Scene
+	{
+	public:
+		Scene();
+		~Scene();
+		Scene(const Scene&) = delete;
+		void operator=(const Scene&) = delete;
+
+		// identity transform, empty bounds, model and material 0.
+		EntityHandle Create(ui32 components);
+		void Destroy(EntityHandle entity);
+		bool IsAlive(EntityHandle entity) const;
+		void Clear();
+
+		// moves the entity to the table of its new archetype, keeping the values both have.
+		void AddComponents(EntityHandle entity, ui32 components);
+		void RemoveComponents(EntityHandle entity, ui32 components);
+		ui32 GetComponents(EntityHandle entity) const;
+
+		// setters mark the component dirty, they are ignored for entities without it.
+		void SetTransform(EntityHandle entity, const glm::vec3& position, const glm::vec4& rotation = glm::vec4(0.f, 0.f, 0.f, 1.f), float scale = 1.f);
+		void SetLocalBounds(EntityHandle entity, const glm::vec3& min, const glm::vec3& max);
+		void SetModel(EntityHandle entity, ui32 model);
+		void SetMaterial(EntityHandle entity, ui32 material);
+
+		glm::vec3 GetPosition(EntityHandle entity) const;
+		glm::vec4 GetRotation(EntityHandle entity) const;
+		float GetScale(EntityHandle entity) const;
+		// as of the last CollectChanges.
+		BvhBounds GetWorldBounds(EntityHandle entity) const;
+		ui32 GetModel(EntityHandle entity) const;
+		ui32 GetMaterial(EntityHandle entity) const;
+
+		// func(table, begin, end) over the rows of every table holding all of components, in batches on the workers.
+		void ForEach(ui32 components, const std::function<void(SceneTable& table, ui32 begin, ui32 end)>& func);
+
+		// derives world bounds of moved entities and lists the changes, then clears them.
+		const SceneChanges& CollectChanges();
+		const SceneChanges& GetChanges() const;
+
+		// entities with transform and bounds, the order the BVH is built in. changes only on structural frames.
+		const std::vector<EntityHandle>& GetInstances() const;
+		// world bounds of GetInstances, ready for InstanceBvh::Build or Refit.
+		void GatherInstanceBounds(std::vector<BvhBounds>& bounds) const;
+
+		ui32 GetEntityCount() const;
+		const std::vector<std::unique_ptr<SceneTable>>& GetTables() const;
+
+		// world box of a model space box under a transform.
+		static BvhBounds TransformBounds(const glm::vec3& localMin, const glm::vec3& localMax,
+			const glm::vec3& position, const glm::vec4& rotation, float scale);
+
+	private:
+		struct EntitySlot
+		{
+			ui32 table = ENTITY_INVALID;
+			ui32 row = 0;
+			ui32 generation = 0;
+		};
+
+		SceneTable& GetTable(ui32 components);
+		// appends a default row for entity, returns its index.
+		ui32 AddRow(SceneTable& table, EntityHandle entity);
+		void RemoveRow(SceneTable& table, ui32 row);
+		void CopyRow(const SceneTable& source, ui32 sourceRow, SceneTable& target, ui32 targetRow);
+		void Move(EntityHandle entity, ui32 components);
+		// table and row of a live entity, throws for stale handles.
+		const EntitySlot& Resolve(EntityHandle entity) const;
+
+		std::vector<std::unique_ptr<SceneTable>> tables;
+		std::unordered_map<ui32, ui32> tableIndices;
+
+		std::vector<EntitySlot> slots;
+		std::vector<ui32> freeSlots;
+		ui32 entityCount;
+
+		SceneChanges changes;
+		// gathered between two CollectChanges calls
+		std::vector<EntityHandle> pendingAdded;
+		std::vector<EntityHandle> pendingRemoved;
+		bool pendingStructural;
+		std::vector<EntityHandle> instances;
+	};
+}
@@ -0,0 +1,485 @@
+#include "pch.h"
+
+#include "Chunk.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 INVALID_ENTRY = 0xFFFFFFFFu;
+	}
+
+	Chunk::Chunk() :
+		words(CHUNK_VOLUME / 32, 0), palette(1, 0), paletteCounts(1, CHUNK_VOLUME), lookupUsed{ 0 }, bitsLog2{ 0 },
+		brickMask{ 0 }, solidCount{ 0 }, revision{ 0 }
+	{
+		brickSolidCounts.fill(0);
+		brickRevisions.fill(0);
+	}
+
+	ui32 Chunk::BrickIndex(ui32 x, ui32 y, ui32 z)
+	{
+		ui32 bx = x >> BRICK_SIZE_LOG2;
+		ui32 by = y >> BRICK_SIZE_LOG2;
+		ui32 bz = z >> BRICK_SIZE_LOG2;
+		return bx + by * BRICKS_PER_AXIS + bz * BRICKS_PER_AXIS * BRICKS_PER_AXIS;
+	}
+
+	ui32 Chunk::BrickOffset(ui32 brick)
+	{
+		ui32 bx = brick % BRICKS_PER_AXIS;
+		ui32 by = brick / BRICKS_PER_AXIS % BRICKS_PER_AXIS;
+		ui32 bz = brick / (BRICKS_PER_AXIS * BRICKS_PER_AXIS);
+		return MortonEncode(bx, by, bz) << (3 * BRICK_SIZE_LOG2);
+	}
+
+	Voxel Chunk::Get(ui32 x, ui32 y, ui32 z) const
+	{
+		ui32 index = Index(x, y, z);
+		return Voxel::Unpack(bitsLog2 == CHUNK_DIRECT_BITS_LOG2 ? words[index] : palette[ReadIndex(index)]);
+	}
+
+	Voxel Chunk::Get(const glm::ivec3& local) const
+	{
+		return Get(local.x, local.y, local.z);
+	}
+
+	void Chunk::Set(ui32 x, ui32 y, ui32 z, const Voxel& voxel)
+	{
+		ui32 index = Index(x, y, z);
+		ui32 packed = voxel.Pack();
+		if (bitsLog2 == CHUNK_DIRECT_BITS_LOG2) {
+			bool wasDirectEmpty = Voxel::Unpack(words[index]).IsEmpty();
+			words[index] = packed;
+			UpdateCounts(x, y, z, wasDirectEmpty, voxel.IsEmpty());
+			return;
+		}
+
+		ui32 previous = ReadIndex(index);
+		if (palette[previous] == packed) {
+			return;
+		}
+		bool wasEmpty = Voxel::Unpack(palette[previous]).IsEmpty();
+
+		// acquiring may widen the indices, previous stays valid through that
+		ui32 entry = AcquireEntry(packed);
+		if (entry == INVALID_ENTRY) {
+			MakeDirect();
+			Set(x, y, z, voxel);
+			return;
+		}
+		paletteCounts[entry]++;
+		WriteIndex(index, entry);
+		ReleaseEntry(previous);
+		UpdateCounts(x, y, z, wasEmpty, voxel.IsEmpty());
+	}
+
+	void Chunk::Set(const glm::ivec3& local, const Voxel& voxel)
+	{
+		Set(local.x, local.y, local.z, voxel);
+	}
+
+	void Chunk::Fill(const Voxel& voxel)
+	{
+		// fresh vectors, so a chunk that went wide or direct gives the memory back
+		words = std::vector<ui32>(CHUNK_VOLUME / 32, 0);
+		palette = std::vector<ui32>(1, voxel.Pack());
+		paletteCounts = std::vector<ui16>(1, CHUNK_VOLUME);
+		std::vector<ui32>().swap(freeEntries);
+		std::vector<ui32>().swap(paletteLookup);
+		lookupUsed = 0;
+		bitsLog2 = 0;
+		if (voxel.IsEmpty()) {
+			brickSolidCounts.fill(0);
+			brickMask = 0;
+			solidCount = 0;
+		}
+		else {
+			brickSolidCounts.fill(BRICK_VOLUME);
+			brickMask = ~0ull;
+			solidCount = CHUNK_VOLUME;
+		}
+	}
+
+	void Chunk::Load(const ui32* packed)
+	{
+		words = std::vector<ui32>(CHUNK_VOLUME / 32, 0);
+		std::vector<ui32>().swap(palette);
+		std::vector<ui16>().swap(paletteCounts);
+		std::vector<ui32>().swap(freeEntries);
+		std::vector<ui32>().swap(paletteLookup);
+		lookupUsed = 0;
+		bitsLog2 = 0;
+
+		// neighbors in Morton order mostly match, so the palette is only searched when the voxel changes
+		ui32 lastPacked = ~packed[0];
+		ui32 lastEntry = 0;
+		for (ui32 i = 0;i < CHUNK_VOLUME;i++) {
+			if (packed[i] != lastPacked) {
+				lastPacked = packed[i];
+				lastEntry = AcquireEntry(lastPacked);
+				if (lastEntry == INVALID_ENTRY) {
+					MakeDirect();
+					std::memcpy(words.data(), packed, CHUNK_VOLUME * sizeof(ui32));
+					break;
+				}
+			}
+			paletteCounts[lastEntry]++;
+			WriteIndex(i, lastEntry);
+		}
+
+		solidCount = 0;
+		brickMask = 0;
+		for (ui32 brick = 0;brick < BRICK_COUNT;brick++) {
+			const ui32* data = packed + BrickOffset(brick);
+			ui32 count = 0;
+			for (ui32 i = 0;i < BRICK_VOLUME;i++) {
+				count += (data[i] & 0xFFFF) != 0 ? 1 : 0;
+			}
+			brickSolidCounts[brick] = static_cast<ui16>(count);
+			brickMask |= count > 0 ? 1ull << brick : 0;
+			solidCount += count;
+		}
+	}
+
+	void Chunk::Merge(const Chunk& other)
+	{
+		if (other.IsEmpty()) {
+			return;
+		}
+		other.ForEachSolidVoxel([this](ui32 x, ui32 y, ui32 z, const Voxel& voxel) {
+			Set(x, y, z, voxel);
+		});
+	}
+
+	void Chunk::MergeUnder(const Chunk& other)
+	{
+		if (other.IsEmpty()) {
+			return;
+		}
+		other.ForEachSolidVoxel([this](ui32 x, ui32 y, ui32 z, const Voxel& voxel) {
+			if (Get(x, y, z).IsEmpty()) {
+				Set(x, y, z, voxel);
+			}
+		});
+	}
+
+	bool Chunk::IsEmpty() const
+	{
+		return solidCount == 0;
+	}
+
+	ui32 Chunk::GetSolidCount() const
+	{
+		return solidCount;
+	}
+
+	ui64 Chunk::GetBrickMask() const
+	{
+		return brickMask;
+	}
+
+	bool Chunk::IsBrickEmpty(ui32 brick) const
+	{
+		return (brickMask & (1ull << brick)) == 0;
+	}
+
+	void Chunk::DecodeBrick(ui32 brick, ui32* packed) const
+	{
+		ui32 offset = BrickOffset(brick);
+		if (bitsLog2 == CHUNK_DIRECT_BITS_LOG2) {
+			std::memcpy(packed, words.data() + offset, BRICK_VOLUME * sizeof(ui32));
+			return;
+		}
+#ifdef LUXEL_SIMD_AVX2
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i mask = _mm256_set1_epi32(static_cast<int>((1u << (1u << bitsLog2)) - 1u));
+		const __m256i low = _mm256_set1_epi32(31);
+		const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(bitsLog2));
+		const int* wordData = reinterpret_cast<const int*>(words.data());
+		const int* paletteData = reinterpret_cast<const int*>(palette.data());
+		for (ui32 i = 0;i < BRICK_VOLUME;i += 8) {
+			__m256i bit = _mm256_sll_epi32(_mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(offset + i)), lanes), shift);
+			__m256i word = _mm256_i32gather_epi32(wordData, _mm256_srli_epi32(bit, 5), 4);
+			__m256i entry = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(bit, low)), mask);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(packed + i), _mm256_i32gather_epi32(paletteData, entry, 4));
+		}
+#else
+		for (ui32 i = 0;i < BRICK_VOLUME;i++) {
+			packed[i] = palette[ReadIndex(offset + i)];
+		}
+#endif
+	}
+
+	void Chunk::Decode(ui32* packed) const
+	{
+		// Morton order keeps each brick one contiguous run, in brick Morton order
+		for (ui32 brick = 0;brick < BRICK_COUNT;brick++) {
+			DecodeBrick(brick, packed + BrickOffset(brick));
+		}
+	}
+
+	ui32 Chunk::GetBitsLog2() const
+	{
+		return bitsLog2;
+	}
+
+	const std::vector<ui32>& Chunk::GetIndexWords() const
+	{
+		return words;
+	}
+
+	const std::vector<ui32>& Chunk::GetPalette() const
+	{
+		return palette;
+	}
+
+	size_t Chunk::GetMemoryUsage() const
+	{
+		return sizeof(Chunk) + words.capacity() * sizeof(ui32) + palette.capacity() * sizeof(ui32) +
+			paletteCounts.capacity() * sizeof(ui16) + freeEntries.capacity() * sizeof(ui32) +
+			paletteLookup.capacity() * sizeof(ui32);
+	}
+
+	ui32 Chunk::AcquireEntry(ui32 packed)
+	{
+		ui32 entry = FindEntry(packed);
+		if (entry != INVALID_ENTRY) {
+			return entry;
+		}
+
+		if (palette.size() - freeEntries.size() >= CHUNK_PALETTE_MAX) {
+			return INVALID_ENTRY;
+		}
+		if (!freeEntries.empty()) {
+			entry = freeEntries.back();
+			freeEntries.pop_back();
+			palette[entry] = packed;
+		}
+		else {
+			entry = static_cast<ui32>(palette.size());
+			if ((entry >> (1u << bitsLog2)) != 0) {
+				Repack(bitsLog2 + 1, nullptr);
+			}
+			palette.push_back(packed);
+			paletteCounts.push_back(0);
+		}
+
+		if (!paletteLookup.empty()) {
+			LookupInsert(entry);
+		}
+		else if (palette.size() > CHUNK_PALETTE_LINEAR) {
+			// the new entry has no users yet, count it as one so the rebuild takes it
+			paletteCounts[entry]++;
+			RebuildLookup();
+			paletteCounts[entry]--;
+		}
+		return entry;
+	}
+
+	ui32 Chunk::FindEntry(ui32 packed) const
+	{
+		if (!paletteLookup.empty()) {
+			ui32 slot = paletteLookup[LookupSlot(packed)];
+			return slot != 0 ? slot - 1 : INVALID_ENTRY;
+		}
+		for (ui32 i = 0;i < palette.size();i++) {
+			if (palette[i] == packed && paletteCounts[i] > 0) {
+				return i;
+			}
+		}
+		return INVALID_ENTRY;
+	}
+
+	ui32 Chunk::LookupSlot(ui32 packed) const
+	{
+		// slot holding packed, or the empty slot ending its probe sequence
+		ui32 mask = static_cast<ui32>(paletteLookup.size()) - 1;
+		ui32 slot = (packed * 0x9E3779B1u) >> (32 - std::countr_zero(static_cast<ui32>(paletteLookup.size())));
+		while (paletteLookup[slot] != 0 && palette[paletteLookup[slot] - 1] != packed) {
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	void Chunk::LookupInsert(ui32 entry)
+	{
+		// kept at most three quarters full
+		if ((lookupUsed + 1) * 4 > paletteLookup.size() * 3) {
+			paletteCounts[entry]++;
+			RebuildLookup();
+			paletteCounts[entry]--;
+			return;
+		}
+		paletteLookup[LookupSlot(palette[entry])] = entry + 1;
+		lookupUsed++;
+	}
+
+	void Chunk::LookupErase(ui32 packed)
+	{
+		ui32 mask = static_cast<ui32>(paletteLookup.size()) - 1;
+		ui32 shift = 32 - std::countr_zero(static_cast<ui32>(paletteLookup.size()));
+		ui32 hole = LookupSlot(packed);
+		if (paletteLookup[hole] == 0) {
+			return;
+		}
+		// pull later entries of the run back into the hole unless that would put them before their home slot
+		ui32 slot = hole;
+		while (true) {
+			slot = (slot + 1) & mask;
+			if (paletteLookup[slot] == 0) {
+				break;
+			}
+			ui32 home = (palette[paletteLookup[slot] - 1] * 0x9E3779B1u) >> shift;
+			if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+				paletteLookup[hole] = paletteLookup[slot];
+				hole = slot;
+			}
+		}
+		paletteLookup[hole] = 0;
+		lookupUsed--;
+	}
+
+	void Chunk::RebuildLookup()
+	{
+		ui32 used = 0;
+		for (ui16 count : paletteCounts) {
+			used += count > 0 ? 1 : 0;
+		}
+		// half full after a rebuild
+		ui32 size = 32;
+		while (size < used * 2) {
+			size *= 2;
+		}
+		paletteLookup.assign(size, 0);
+		lookupUsed = 0;
+		for (ui32 i = 0;i < palette.size();i++) {
+			if (paletteCounts[i] > 0) {
+				paletteLookup[LookupSlot(palette[i])] = i + 1;
+				lookupUsed++;
+			}
+		}
+	}
+
+	void Chunk::ReleaseEntry(ui32 entry)
+	{
+		if (--paletteCounts[entry] > 0) {
+			return;
+		}
+		if (!paletteLookup.empty()) {
+			LookupErase(palette[entry]);
+		}
+		freeEntries.push_back(entry);
+
+		// shrink only once half of the narrower width is enough, so edits around a boundary do not repack each time
+		ui32 used = static_cast<ui32>(palette.size() - freeEntries.size());
+		if (bitsLog2 > 0 && used <= (1u << (1u << (bitsLog2 - 1))) / 2) {
+			Compact();
+		}
+	}
+
+	void Chunk::Repack(ui32 newBitsLog2, const std::vector<ui32>* remap)
+	{
+		std::vector<ui32> packedWords((CHUNK_VOLUME << newBitsLog2) / 32, 0);
+		for (ui32 i = 0;i < CHUNK_VOLUME;i++) {
+			ui32 entry = ReadIndex(i);
+			if (remap != nullptr) {
+				entry = (*remap)[entry];
+			}
+			ui32 bit = i << newBitsLog2;
+			packedWords[bit >> 5] |= entry << (bit & 31);
+		}
+		words = std::move(packedWords);
+		bitsLog2 = newBitsLog2;
+	}
+
+	void Chunk::MakeDirect()
+	{
+		std::vector<ui32> direct(CHUNK_VOLUME);
+		Decode(direct.data());
+		words = std::move(direct);
+		bitsLog2 = CHUNK_DIRECT_BITS_LOG2;
+		// swapped out so the memory goes too
+		std::vector<ui32>().swap(palette);
+		std::vector<ui16>().swap(paletteCounts);
+		std::vector<ui32>().swap(freeEntries);
+		std::vector<ui32>().swap(paletteLookup);
+		lookupUsed = 0;
+	}
+
+	void Chunk::Compact()
+	{
+		std::vector<ui32> remap(palette.size(), 0);
+		std::vector<ui32> compacted;
+		std::vector<ui16> counts;
+		for (ui32 i = 0;i < palette.size();i++) {
+			if (paletteCounts[i] > 0) {
+				remap[i] = static_cast<ui32>(compacted.size());
+				compacted.push_back(palette[i]);
+				counts.push_back(paletteCounts[i]);
+			}
+		}
+
+		ui32 newBitsLog2 = 0;
+		while ((1u << (1u << newBitsLog2)) < compacted.size()) {
+			newBitsLog2++;
+		}
+		Repack(newBitsLog2, &remap);
+		palette = std::move(compacted);
+		paletteCounts = std::move(counts);
+		std::vector<ui32>().swap(freeEntries);
+
+		std::vector<ui32>().swap(paletteLookup);
+		lookupUsed = 0;
+		if (palette.size() > CHUNK_PALETTE_LINEAR) {
+			RebuildLookup();
+		}
+	}
+
+	ui64 Chunk::GetRevision() const
+	{
+		return revision;
+	}
+
+	void Chunk::SetRevision(ui64 value, ui64 modifiedBricks)
+	{
+		revision = value;
+		while (modifiedBricks != 0) {
+			ui32 brick = static_cast<ui32>(std::countr_zero(modifiedBricks));
+			modifiedBricks &= modifiedBricks - 1;
+			brickRevisions[brick] = value;
+		}
+	}
+
+	ui64 Chunk::GetModifiedBricks(ui64 sinceRevision) const
+	{
+		ui64 modified = 0;
+		for (ui32 brick = 0;brick < BRICK_COUNT;brick++) {
+			if (brickRevisions[brick] > sinceRevision) {
+				modified |= 1ull << brick;
+			}
+		}
+		return modified;
+	}
+
+	void Chunk::UpdateCounts(ui32 x, ui32 y, ui32 z, bool wasEmpty, bool isEmpty)
+	{
+		if (wasEmpty == isEmpty) {
+			return;
+		}
+
+		ui32 brick = BrickIndex(x, y, z);
+		if (isEmpty) {
+			solidCount--;
+			if (--brickSolidCounts[brick] == 0) {
+				brickMask &= ~(1ull << brick);
+			}
+		}
+		else {
+			solidCount++;
+			if (brickSolidCounts[brick]++ == 0) {
+				brickMask |= 1ull << brick;
+			}
+		}
+	}
+}
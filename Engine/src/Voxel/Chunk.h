@@ -0,0 +1,172 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "Voxel.h"
+#include "Morton.h"
+
+// palettes up to this size are searched linearly, larger ones through a hash table.
+#define CHUNK_PALETTE_LINEAR 16
+// past this many entries a palette costs more than the voxels, the chunk then stores them directly.
+#define CHUNK_PALETTE_MAX 4096
+#define CHUNK_DIRECT_BITS_LOG2 5
+
+namespace Luxel
+{
+	// layout must match shaders/palette_chunk.glsl.
+	struct GpuPaletteChunk
+	{
+		// where VoxelGpuScene put GetIndexWords and GetPalette in its word and entry buffers
+		ui32 firstWord;
+		ui32 firstEntry;
+		// CHUNK_DIRECT_BITS_LOG2 for chunks storing packed voxels
+		ui32 bitsLog2;
+		ui32 entries;
+	};
+
+	// palette compressed: every distinct voxel is stored once in a per chunk palette, and each voxel
+	// is an index into it, bit packed at 1, 2, 4, 8 or 16 bits. the width grows when the palette
+	// outgrows it and shrinks once enough entries are unused again. chunks with more than
+	// CHUNK_PALETTE_MAX distinct voxels store them directly until the next Fill.
+	class LUXEL_API Chunk
+	{
+	public:
+		Chunk();
+
+		// indices are stored in Morton order, so every 8^3 brick is one contiguous run of BRICK_VOLUME indices.
+		static ui32 Index(ui32 x, ui32 y, ui32 z) { return MortonEncode(x, y, z); }
+		static ui32 BrickIndex(ui32 x, ui32 y, ui32 z);
+		// storage offset of the first voxel of a brick.
+		static ui32 BrickOffset(ui32 brick);
+
+		Voxel Get(ui32 x, ui32 y, ui32 z) const;
+		Voxel Get(const glm::ivec3& local) const;
+		void Set(ui32 x, ui32 y, ui32 z, const Voxel& voxel);
+		void Set(const glm::ivec3& local, const Voxel& voxel);
+		void Fill(const Voxel& voxel);
+		// replaces the whole chunk with CHUNK_VOLUME packed voxels in Morton order, see Decode.
+		void Load(const ui32* packed);
+
+		// writes every non-empty voxel of other over this chunk.
+		void Merge(const Chunk& other);
+		// writes the non-empty voxels of other only where this chunk is empty.
+		void MergeUnder(const Chunk& other);
+
+		bool IsEmpty() const;
+		ui32 GetSolidCount() const;
+
+		// one bit per 8^3 brick, set when the brick holds any solid voxel.
+		ui64 GetBrickMask() const;
+		bool IsBrickEmpty(ui32 brick) const;
+
+		// BRICK_VOLUME packed voxels in Morton order, decoded 8 at a time with AVX2.
+		void DecodeBrick(ui32 brick, ui32* packed) const;
+		// CHUNK_VOLUME packed voxels in Morton order.
+		void Decode(ui32* packed) const;
+
+		// index width is 1 << GetBitsLog2() bits, CHUNK_DIRECT_BITS_LOG2 when the words are packed voxels.
+		ui32 GetBitsLog2() const;
+		// CHUNK_VOLUME indices in Morton order, 32 >> GetBitsLog2() per word starting at the low bits.
+		const std::vector<ui32>& GetIndexWords() const;
+		// packed voxels, entries no voxel uses anymore may be left in place.
+		const std::vector<ui32>& GetPalette() const;
+		size_t GetMemoryUsage() const;
+
+		// walks every voxel in storage order: func(x, y, z, voxel).
+		template<typename Func>
+		void ForEachVoxel(Func&& func) const
+		{
+			for (ui32 brick = 0;brick < BRICK_COUNT;brick++) {
+				VisitBrick(brick, false, func);
+			}
+		}
+
+		// walks the solid voxels in storage order, skipping empty bricks: func(x, y, z, voxel).
+		template<typename Func>
+		void ForEachSolidVoxel(Func&& func) const
+		{
+			ui64 mask = brickMask;
+			while (mask != 0) {
+				ui32 brick = static_cast<ui32>(std::countr_zero(mask));
+				mask &= mask - 1;
+				VisitBrick(brick, true, func);
+			}
+		}
+
+		// world revision of the last modification, see VoxelWorld::MarkModified.
+		// bricks carry their own revision so consumers can update only what changed.
+		ui64 GetRevision() const;
+		void SetRevision(ui64 value, ui64 modifiedBricks = ~0ull);
+		ui64 GetModifiedBricks(ui64 sinceRevision) const;
+
+	private:
+		template<typename Func>
+		void VisitBrick(ui32 brick, bool solidOnly, Func& func) const
+		{
+			ui32 bx = (brick % BRICKS_PER_AXIS) * BRICK_SIZE;
+			ui32 by = (brick / BRICKS_PER_AXIS % BRICKS_PER_AXIS) * BRICK_SIZE;
+			ui32 bz = (brick / (BRICKS_PER_AXIS * BRICKS_PER_AXIS)) * BRICK_SIZE;
+			std::array<ui32, BRICK_VOLUME> data;
+			DecodeBrick(brick, data.data());
+			for (ui32 i = 0;i < BRICK_VOLUME;i++) {
+				Voxel voxel = Voxel::Unpack(data[i]);
+				if (solidOnly && voxel.IsEmpty()) {
+					continue;
+				}
+				// the low 9 bits of a Morton code are the position inside the brick
+				ui32 local = MortonTables::Compact[i];
+				func(bx + (local & 7), by + ((local >> 3) & 7), bz + (local >> 6), voxel);
+			}
+		}
+
+		ui32 ReadIndex(ui32 index) const
+		{
+			ui32 bit = index << bitsLog2;
+			return (words[bit >> 5] >> (bit & 31)) & ((1u << (1u << bitsLog2)) - 1u);
+		}
+
+		void WriteIndex(ui32 index, ui32 entry)
+		{
+			ui32 bit = index << bitsLog2;
+			ui32 mask = ((1u << (1u << bitsLog2)) - 1u) << (bit & 31);
+			ui32& word = words[bit >> 5];
+			word = (word & ~mask) | (entry << (bit & 31));
+		}
+
+		// palette entry holding packed, added with no users if there is none.
+		// INVALID when the palette is full, the chunk has to go direct then.
+		ui32 AcquireEntry(ui32 packed);
+		ui32 FindEntry(ui32 packed) const;
+		// open addressing over the used entries, linear probing with backward shift deletion.
+		ui32 LookupSlot(ui32 packed) const;
+		void LookupInsert(ui32 entry);
+		void LookupErase(ui32 packed);
+		void RebuildLookup();
+		// drops a user of entry, shrinking the width once few entries are left.
+		void ReleaseEntry(ui32 entry);
+		// re-encodes every index at the new width, through remap when given.
+		void Repack(ui32 newBitsLog2, const std::vector<ui32>* remap);
+		// drops unused entries and packs at the smallest width that holds the rest.
+		void Compact();
+		void MakeDirect();
+
+		void UpdateCounts(ui32 x, ui32 y, ui32 z, bool wasEmpty, bool isEmpty);
+
+		std::vector<ui32> words;
+		std::vector<ui32> palette;
+		// voxels per palette entry, 0 for free entries
+		std::vector<ui16> paletteCounts;
+		std::vector<ui32> freeEntries;
+		// entry + 1 per slot, 0 for empty slots; only kept for palettes over CHUNK_PALETTE_LINEAR entries
+		std::vector<ui32> paletteLookup;
+		ui32 lookupUsed;
+		ui32 bitsLog2;
+		std::array<ui16, BRICK_COUNT> brickSolidCounts;
+		ui64 brickMask;
+		ui32 solidCount;
+		ui64 revision;
+		std::array<ui64, BRICK_COUNT> brickRevisions;
+	};
+}
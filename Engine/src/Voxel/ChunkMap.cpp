@@ -0,0 +1,257 @@
+#include "pch.h"
+
+#include "ChunkMap.h"
+
+namespace Luxel
+{
+	ChunkMap::ChunkMap() : table{ new Table(CHUNK_MAP_MIN_CAPACITY) }, count{ 0 }
+	{
+
+	}
+
+	ChunkMap::~ChunkMap()
+	{
+		Table* current = table.load();
+		for (ui32 i = 0;i <= current->mask;i++) {
+			delete current->slots[i].chunk.load(std::memory_order_relaxed);
+		}
+		delete current;
+		Epoch::Collect();
+	}
+
+	Chunk* ChunkMap::Find(const ChunkCoord& coord) const
+	{
+		ui64 key = PackKey(coord);
+		Slot* slot = Locate(table.load(std::memory_order_acquire), key, Hash(key));
+		return slot == nullptr ? nullptr : slot->chunk.load(std::memory_order_acquire);
+	}
+
+	void ChunkMap::ForEach(const std::function<void(const ChunkCoord&, Chunk&)>& func) const
+	{
+		Table* current = table.load(std::memory_order_acquire);
+		for (ui32 i = 0;i <= current->mask;i++) {
+			Chunk* chunk = current->slots[i].chunk.load(std::memory_order_acquire);
+			if (chunk != nullptr) {
+				func(UnpackKey(current->slots[i].key.load(std::memory_order_relaxed)), *chunk);
+			}
+		}
+	}
+
+	std::pair<Chunk*, bool> ChunkMap::Insert(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+	{
+		ui64 key = PackKey(coord);
+		ui64 hash = Hash(key);
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(Stripe(hash));
+				Slot* slot = Claim(table.load(std::memory_order_relaxed), key, hash);
+				if (slot != nullptr) {
+					Chunk* existing = slot->chunk.load(std::memory_order_relaxed);
+					if (existing != nullptr) {
+						return { existing, false };
+					}
+					Chunk* stored = chunk.release();
+					slot->chunk.store(stored, std::memory_order_release);
+					count++;
+					return { stored, true };
+				}
+			}
+			Grow();
+		}
+	}
+
+	Chunk* ChunkMap::Merge(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk, const std::function<void(Chunk& existing, const Chunk& chunk)>& merge)
+	{
+		ui64 key = PackKey(coord);
+		ui64 hash = Hash(key);
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(Stripe(hash));
+				Slot* slot = Claim(table.load(std::memory_order_relaxed), key, hash);
+				if (slot != nullptr) {
+					Chunk* existing = slot->chunk.load(std::memory_order_relaxed);
+					if (existing != nullptr) {
+						merge(*existing, *chunk);
+						return existing;
+					}
+					Chunk* stored = chunk.release();
+					slot->chunk.store(stored, std::memory_order_release);
+					count++;
+					return stored;
+				}
+			}
+			Grow();
+		}
+	}
+
+	void ChunkMap::Replace(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+	{
+		ui64 key = PackKey(coord);
+		ui64 hash = Hash(key);
+		Chunk* replaced = nullptr;
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(Stripe(hash));
+				Slot* slot = Claim(table.load(std::memory_order_relaxed), key, hash);
+				if (slot != nullptr) {
+					replaced = slot->chunk.exchange(chunk.release());
+					if (replaced == nullptr) {
+						count++;
+					}
+					break;
+				}
+			}
+			Grow();
+		}
+		if (replaced != nullptr) {
+			Epoch::Retire(replaced);
+		}
+	}
+
+	bool ChunkMap::Erase(const ChunkCoord& coord)
+	{
+		ui64 key = PackKey(coord);
+		ui64 hash = Hash(key);
+		Chunk* erased = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(Stripe(hash));
+			Slot* slot = Locate(table.load(std::memory_order_relaxed), key, hash);
+			if (slot != nullptr) {
+				erased = slot->chunk.exchange(nullptr);
+			}
+			if (erased != nullptr) {
+				count--;
+			}
+		}
+		if (erased == nullptr) {
+			return false;
+		}
+		Epoch::Retire(erased);
+		return true;
+	}
+
+	void ChunkMap::Clear()
+	{
+		Table* previous;
+		auto chunks = std::make_unique<std::vector<std::unique_ptr<Chunk>>>();
+		{
+			std::array<std::unique_lock<std::mutex>, CHUNK_MAP_STRIPES> locks;
+			for (ui32 i = 0;i < CHUNK_MAP_STRIPES;i++) {
+				locks[i] = std::unique_lock<std::mutex>(stripes[i].mutex);
+			}
+			previous = table.load(std::memory_order_relaxed);
+			for (ui32 i = 0;i <= previous->mask;i++) {
+				Chunk* chunk = previous->slots[i].chunk.load(std::memory_order_relaxed);
+				if (chunk != nullptr) {
+					chunks->emplace_back(chunk);
+				}
+			}
+			table.store(new Table(CHUNK_MAP_MIN_CAPACITY));
+			count = 0;
+		}
+		// readers may still walk the old table and its chunks, both go in one retire each.
+		Epoch::Retire(chunks.release());
+		Epoch::Retire(previous);
+	}
+
+	size_t ChunkMap::GetCount() const
+	{
+		return count.load(std::memory_order_relaxed);
+	}
+
+	ui32 ChunkMap::GetCapacity() const
+	{
+		EpochGuard guard;
+		return table.load(std::memory_order_acquire)->mask + 1;
+	}
+
+	ChunkCoord ChunkMap::UnpackKey(ui64 key)
+	{
+		constexpr int BIAS = 1 << 20;
+		constexpr ui64 MASK = (1ull << 21) - 1;
+		return ChunkCoord(static_cast<int>(key >> 42 & MASK) - BIAS, static_cast<int>(key >> 21 & MASK) - BIAS, static_cast<int>(key & MASK) - BIAS);
+	}
+
+	ChunkMap::Slot* ChunkMap::Locate(Table* current, ui64 key, ui64 hash)
+	{
+		ui32 index = static_cast<ui32>(hash) & current->mask;
+		for (ui32 i = 0;i <= current->mask;i++) {
+			Slot& slot = current->slots[index];
+			ui64 stored = slot.key.load(std::memory_order_acquire);
+			if (stored == key) {
+				return &slot;
+			}
+			// keys are never removed from a table, so the first empty slot ends the probe
+			if (stored == 0) {
+				return nullptr;
+			}
+			index = (index + 1) & current->mask;
+		}
+		return nullptr;
+	}
+
+	ChunkMap::Slot* ChunkMap::Claim(Table* current, ui64 key, ui64 hash)
+	{
+		// dead keys count as well, growing at 3/4 keeps probes short and an empty slot in every chain
+		ui32 limit = (current->mask + 1) / 4 * 3;
+		ui32 index = static_cast<ui32>(hash) & current->mask;
+		for (ui32 i = 0;i <= current->mask;i++) {
+			Slot& slot = current->slots[index];
+			ui64 stored = slot.key.load(std::memory_order_acquire);
+			if (stored == 0) {
+				if (current->usedKeys.load(std::memory_order_relaxed) >= limit) {
+					return nullptr;
+				}
+				// writers of other stripes race for the same empty slots
+				if (slot.key.compare_exchange_strong(stored, key)) {
+					current->usedKeys.fetch_add(1, std::memory_order_relaxed);
+					return &slot;
+				}
+			}
+			if (stored == key) {
+				return &slot;
+			}
+			index = (index + 1) & current->mask;
+		}
+		return nullptr;
+	}
+
+	void ChunkMap::Grow()
+	{
+		Table* previous;
+		{
+			std::array<std::unique_lock<std::mutex>, CHUNK_MAP_STRIPES> locks;
+			for (ui32 i = 0;i < CHUNK_MAP_STRIPES;i++) {
+				locks[i] = std::unique_lock<std::mutex>(stripes[i].mutex);
+			}
+			previous = table.load(std::memory_order_relaxed);
+			// another writer may have grown it while this one waited
+			if (previous->usedKeys.load(std::memory_order_relaxed) < (previous->mask + 1) / 4 * 3) {
+				return;
+			}
+
+			ui32 capacity = CHUNK_MAP_MIN_CAPACITY;
+			while (capacity < count.load(std::memory_order_relaxed) * 4) {
+				capacity *= 2;
+			}
+			Table* next = new Table(capacity);
+			for (ui32 i = 0;i <= previous->mask;i++) {
+				Chunk* chunk = previous->slots[i].chunk.load(std::memory_order_relaxed);
+				if (chunk == nullptr) {
+					continue;
+				}
+				ui64 key = previous->slots[i].key.load(std::memory_order_relaxed);
+				ui32 index = static_cast<ui32>(Hash(key)) & next->mask;
+				while (next->slots[index].key.load(std::memory_order_relaxed) != 0) {
+					index = (index + 1) & next->mask;
+				}
+				next->slots[index].key.store(key, std::memory_order_relaxed);
+				next->slots[index].chunk.store(chunk, std::memory_order_relaxed);
+				next->usedKeys.fetch_add(1, std::memory_order_relaxed);
+			}
+			// readers pick the new table up from here, the ones still on the old one see the same chunks
+			table.store(next);
+		}
+		Epoch::Retire(previous);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Epoch.h"
+#include "Voxel.h"
+#include "Chunk.h"
+
+#define CHUNK_MAP_MIN_CAPACITY 256
+#define CHUNK_MAP_STRIPES 64
+
+namespace Luxel
+{
+	// concurrent open addressing map from chunk coordinate to chunk. Find never locks; Insert, Replace
+	// and Erase lock one of CHUNK_MAP_STRIPES stripes picked by the hash, so writers only wait on
+	// writers of nearby keys, and growing locks them all. removed chunks and outgrown tables are
+	// retired to Epoch, so whatever a thread loaded inside an EpochGuard stays valid until it leaves.
+	// coordinates must lie within +-2^20 chunks.
+	class LUXEL_API ChunkMap
+	{
+	public:
+		ChunkMap();
+		~ChunkMap();
+		ChunkMap(const ChunkMap&) = delete;
+		void operator=(const ChunkMap&) = delete;
+
+		// Find and ForEach must run inside an EpochGuard.
+		Chunk* Find(const ChunkCoord& coord) const;
+		// visits a snapshot of the table; chunks inserted meanwhile may be missed.
+		void ForEach(const std::function<void(const ChunkCoord&, Chunk&)>& func) const;
+
+		// keeps an existing chunk and drops the new one. returns the stored chunk and whether it is the new one.
+		std::pair<Chunk*, bool> Insert(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+		// returns the stored chunk, merge runs under the stripe lock when coord is already taken.
+		Chunk* Merge(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk, const std::function<void(Chunk& existing, const Chunk& chunk)>& merge);
+		// stores chunk and retires the one it replaces.
+		void Replace(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+		bool Erase(const ChunkCoord& coord);
+		void Clear();
+
+		size_t GetCount() const;
+		ui32 GetCapacity() const;
+
+	private:
+		// a key stays in its slot once claimed, erasing only clears the chunk; growing drops dead keys.
+		struct Slot
+		{
+			std::atomic<ui64> key{ 0 };
+			std::atomic<Chunk*> chunk{ nullptr };
+		};
+
+		struct Table
+		{
+			ui32 mask;
+			std::atomic<ui32> usedKeys{ 0 };
+			std::unique_ptr<Slot[]> slots;
+
+			explicit Table(ui32 capacity) : mask{ capacity - 1 }, slots{ new Slot[capacity] } { }
+		};
+
+		// 21 bits per axis with the top bit set, 0 marks an empty slot.
+		static ui64 PackKey(const ChunkCoord& coord)
+		{
+			constexpr ui64 BIAS = 1ull << 20;
+			constexpr ui64 MASK = (1ull << 21) - 1;
+			return (1ull << 63) | (((static_cast<ui64>(coord.x) + BIAS) & MASK) << 42)
+				| (((static_cast<ui64>(coord.y) + BIAS) & MASK) << 21) | ((static_cast<ui64>(coord.z) + BIAS) & MASK);
+		}
+		static ChunkCoord UnpackKey(ui64 key);
+		static ui64 Hash(ui64 key)
+		{
+			key ^= key >> 33;
+			key *= 0xFF51AFD7ED558CCDull;
+			key ^= key >> 33;
+			return key;
+		}
+
+		static Slot* Locate(Table* current, ui64 key, ui64 hash);
+		// slot holding key, claiming an empty one under the stripe lock of key. nullptr when the table
+		// has to grow first.
+		static Slot* Claim(Table* current, ui64 key, ui64 hash);
+		std::mutex& Stripe(ui64 hash) const { return stripes[hash >> 58 & (CHUNK_MAP_STRIPES - 1)].mutex; }
+		// locks every stripe and rehashes the live chunks into a table sized for them.
+		void Grow();
+
+		struct alignas(64) StripeLock
+		{
+			std::mutex mutex;
+		};
+
+		std::atomic<Table*> table;
+		std::atomic<size_t> count;
+		mutable std::array<StripeLock, CHUNK_MAP_STRIPES> stripes;
+	};
+}
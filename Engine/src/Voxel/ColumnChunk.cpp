@@ -0,0 +1,340 @@
+#include "pch.h"
+
+#include "ColumnChunk.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// Morton offset of each height in a column, added to the offset of the column base
+		alignas(32) constexpr std::array<ui32, CHUNK_SIZE> HEIGHT_OFFSETS = [] {
+			std::array<ui32, CHUNK_SIZE> offsets{};
+			for (ui32 y = 0;y < CHUNK_SIZE;y++) {
+				ui32 spread = 0;
+				for (ui32 bit = 0;bit < CHUNK_SIZE_LOG2;bit++) {
+					spread |= ((y >> bit) & 1) << (3 * bit + 1);
+				}
+				offsets[y] = spread;
+			}
+			return offsets;
+		}();
+	}
+
+	ColumnChunk::ColumnChunk()
+	{
+		Fill(Voxel{});
+	}
+
+	ColumnChunk::Builder::Builder()
+	{
+		rowStarts[0] = 0;
+	}
+
+	void ColumnChunk::Builder::Append(ui32 packed, ui32 end)
+	{
+		ui32 entry = lastEntry;
+		if (palette.empty() || packed != lastPacked) {
+			auto it = lookup.find(packed);
+			if (it != lookup.end()) {
+				entry = it->second;
+			}
+			else {
+				entry = static_cast<ui32>(palette.size());
+				palette.push_back(packed);
+				lookup.emplace(packed, entry);
+			}
+			lastPacked = packed;
+			lastEntry = entry;
+		}
+
+		if (runEntries.size() > columnStart && runEntries.back() == entry) {
+			runEnds.back() = static_cast<ui8>(end);
+		}
+		else {
+			runEntries.push_back(entry);
+			runEnds.push_back(static_cast<ui8>(end));
+		}
+	}
+
+	void ColumnChunk::Builder::EndColumn(ui32 column)
+	{
+		columnStart = static_cast<ui32>(runEntries.size());
+		if ((column + 1) % CHUNK_SIZE == 0) {
+			rowStarts[(column + 1) / CHUNK_SIZE] = static_cast<ui16>(columnStart);
+		}
+	}
+
+	void ColumnChunk::Encode(const Chunk& chunk)
+	{
+		std::vector<ui32> packed(CHUNK_VOLUME);
+		chunk.Decode(packed.data());
+		Encode(packed.data());
+	}
+
+	void ColumnChunk::Decode(Chunk& chunk) const
+	{
+		std::vector<ui32> packed(CHUNK_VOLUME);
+		Decode(packed.data());
+		chunk.Load(packed.data());
+	}
+
+	void ColumnChunk::Encode(const ui32* packed)
+	{
+		Builder builder;
+		// one voxel in front of the column, set to differ from the first so y = 0 always starts a run
+		alignas(32) ui32 values[CHUNK_SIZE + 8];
+		ui32* column = values + 8;
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+				ui32 base = MortonEncode(x, 0, z);
+				ui32 starts = 0;
+#ifdef LUXEL_SIMD_AVX2
+				__m256i baseOffset = _mm256_set1_epi32(static_cast<int>(base));
+				for (ui32 y = 0;y < CHUNK_SIZE;y += 8) {
+					__m256i offsets = _mm256_add_epi32(baseOffset, _mm256_load_si256(reinterpret_cast<const __m256i*>(HEIGHT_OFFSETS.data() + y)));
+					__m256i gathered = _mm256_i32gather_epi32(reinterpret_cast<const int*>(packed), offsets, 4);
+					_mm256_store_si256(reinterpret_cast<__m256i*>(column + y), gathered);
+				}
+				column[-1] = ~column[0];
+				for (ui32 y = 0;y < CHUNK_SIZE;y += 8) {
+					__m256i current = _mm256_load_si256(reinterpret_cast<const __m256i*>(column + y));
+					__m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + y - 1));
+					ui32 equal = static_cast<ui32>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(current, previous))));
+					starts |= (~equal & 0xFF) << y;
+				}
+#else
+				for (ui32 y = 0;y < CHUNK_SIZE;y++) {
+					column[y] = packed[base + HEIGHT_OFFSETS[y]];
+					starts |= (y == 0 || column[y] != column[y - 1]) ? 1u << y : 0;
+				}
+#endif
+				while (starts != 0) {
+					ui32 begin = static_cast<ui32>(std::countr_zero(starts));
+					starts &= starts - 1;
+					ui32 end = starts != 0 ? static_cast<ui32>(std::countr_zero(starts)) : CHUNK_SIZE;
+					builder.Append(column[begin], end);
+				}
+				builder.EndColumn(Column(x, z));
+			}
+		}
+		Take(builder);
+	}
+
+	void ColumnChunk::Decode(ui32* packed) const
+	{
+		alignas(32) ui32 column[CHUNK_SIZE];
+		ui32 run = 0;
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+				ui32 begin = 0;
+				while (begin < CHUNK_SIZE) {
+					ui32 entry, end;
+					ReadRun(run++, entry, end);
+					ui32 value = palette[entry];
+#ifdef LUXEL_SIMD_AVX2
+					// masked stores of the 8 wide blocks the run touches
+					__m256i broadcast = _mm256_set1_epi32(static_cast<int>(value));
+					for (ui32 block = begin & ~7u;block < end;block += 8) {
+						__m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+						lanes = _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(block)));
+						__m256i mask = _mm256_and_si256(
+							_mm256_cmpgt_epi32(lanes, _mm256_set1_epi32(static_cast<int>(begin) - 1)),
+							_mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(end)), lanes));
+						_mm256_maskstore_epi32(reinterpret_cast<int*>(column + block), mask, broadcast);
+					}
+#else
+					std::fill(column + begin, column + end, value);
+#endif
+					begin = end;
+				}
+				ui32 base = MortonEncode(x, 0, z);
+				for (ui32 y = 0;y < CHUNK_SIZE;y++) {
+					packed[base + HEIGHT_OFFSETS[y]] = column[y];
+				}
+			}
+		}
+	}
+
+	Voxel ColumnChunk::Get(ui32 x, ui32 y, ui32 z) const
+	{
+		ui32 run = FindColumn(Column(x, z));
+		while (true) {
+			ui32 entry, end;
+			ReadRun(run++, entry, end);
+			if (y < end) {
+				return Voxel::Unpack(palette[entry]);
+			}
+		}
+	}
+
+	void ColumnChunk::Fill(const Voxel& voxel)
+	{
+		Builder builder;
+		for (ui32 c = 0;c < CHUNK_COLUMNS;c++) {
+			builder.Append(voxel.Pack(), CHUNK_SIZE);
+			builder.EndColumn(c);
+		}
+		Take(builder);
+	}
+
+	void ColumnChunk::FillBox(const glm::ivec3& min, const glm::ivec3& max, const Voxel& voxel)
+	{
+		glm::ivec3 lo = glm::clamp(min, glm::ivec3(0), glm::ivec3(CHUNK_SIZE));
+		glm::ivec3 hi = glm::clamp(max, glm::ivec3(0), glm::ivec3(CHUNK_SIZE));
+		if (lo.x >= hi.x || lo.y >= hi.y || lo.z >= hi.z) {
+			return;
+		}
+
+		Builder builder;
+		ui32 packed = voxel.Pack();
+		ui32 run = 0;
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+				bool inside = static_cast<int>(x) >= lo.x && static_cast<int>(x) < hi.x &&
+					static_cast<int>(z) >= lo.z && static_cast<int>(z) < hi.z;
+				if (inside) {
+					CopyRuns(builder, run, 0, lo.y, 0);
+					builder.Append(packed, hi.y);
+					CopyRuns(builder, run, hi.y, CHUNK_SIZE, 0);
+				}
+				else {
+					CopyRuns(builder, run, 0, CHUNK_SIZE, 0);
+				}
+				builder.EndColumn(Column(x, z));
+				run = NextColumn(run);
+			}
+		}
+		Take(builder);
+	}
+
+	void ColumnChunk::CopyBox(const ColumnChunk& source, const glm::ivec3& sourceMin, const glm::ivec3& targetMin, const glm::ivec3& size)
+	{
+		glm::ivec3 sourceMax = sourceMin + size;
+		glm::ivec3 targetMax = targetMin + size;
+		for (int i = 0;i < 3;i++) {
+			if (size[i] <= 0 || sourceMin[i] < 0 || targetMin[i] < 0 || sourceMax[i] > CHUNK_SIZE || targetMax[i] > CHUNK_SIZE) {
+				Error("Column chunk copy box of size", size.x, size.y, size.z, "leaves the chunk.");
+				throw std::runtime_error("Copy box outside the chunk.");
+			}
+		}
+
+		// the runs are read from the old arrays while the builder writes new ones, so source may be this
+		Builder builder;
+		int shift = targetMin.y - sourceMin.y;
+		ui32 run = 0;
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			// source columns of a row are consecutive as well, only the first one is searched for
+			ui32 sourceRun = 0;
+			for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+				bool inside = static_cast<int>(x) >= targetMin.x && static_cast<int>(x) < targetMax.x &&
+					static_cast<int>(z) >= targetMin.z && static_cast<int>(z) < targetMax.z;
+				if (inside) {
+					if (static_cast<int>(x) == targetMin.x) {
+						sourceRun = source.FindColumn(Column(sourceMin.x, z - targetMin.z + sourceMin.z));
+					}
+					CopyRuns(builder, run, 0, targetMin.y, 0);
+					source.CopyRuns(builder, sourceRun, sourceMin.y, sourceMax.y, shift);
+					CopyRuns(builder, run, targetMax.y, CHUNK_SIZE, 0);
+					sourceRun = source.NextColumn(sourceRun);
+				}
+				else {
+					CopyRuns(builder, run, 0, CHUNK_SIZE, 0);
+				}
+				builder.EndColumn(Column(x, z));
+				run = NextColumn(run);
+			}
+		}
+		Take(builder);
+	}
+
+	bool ColumnChunk::IsEmpty() const
+	{
+		// entries are only kept while a run uses them
+		for (ui32 packed : palette) {
+			if (!Voxel::Unpack(packed).IsEmpty()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	ui32 ColumnChunk::GetRunCount() const
+	{
+		return runCount;
+	}
+
+	size_t ColumnChunk::GetMemoryUsage() const
+	{
+		return sizeof(ColumnChunk) + palette.capacity() * sizeof(ui32) + runWords.capacity() * sizeof(ui32);
+	}
+
+	ui32 ColumnChunk::FindColumn(ui32 column) const
+	{
+		ui32 run = rowStarts[column / CHUNK_SIZE];
+		for (ui32 x = 0;x < column % CHUNK_SIZE;x++) {
+			run = NextColumn(run);
+		}
+		return run;
+	}
+
+	ui32 ColumnChunk::NextColumn(ui32 run) const
+	{
+		ui32 entry, end;
+		do {
+			ReadRun(run++, entry, end);
+		} while (end < CHUNK_SIZE);
+		return run;
+	}
+
+	void ColumnChunk::CopyRuns(Builder& builder, ui32 run, ui32 begin, ui32 end, int shift) const
+	{
+		if (begin >= end) {
+			return;
+		}
+		ui32 runEnd = 0;
+		while (runEnd < CHUNK_SIZE) {
+			ui32 entry;
+			ReadRun(run++, entry, runEnd);
+			if (runEnd > begin) {
+				ui32 clipped = std::min(runEnd, end);
+				builder.Append(palette[entry], static_cast<ui32>(static_cast<int>(clipped) + shift));
+				if (runEnd >= end) {
+					return;
+				}
+			}
+		}
+	}
+
+	void ColumnChunk::Take(Builder& builder)
+	{
+		// cold chunks stay around for long, so they only keep the memory they use.
+		// fills and copies can leave entries no run uses, those are dropped here
+		std::vector<ui32> remap(builder.palette.size(), 0xFFFFFFFFu);
+		palette.clear();
+		for (ui32 entry : builder.runEntries) {
+			if (remap[entry] == 0xFFFFFFFFu) {
+				remap[entry] = static_cast<ui32>(palette.size());
+				palette.push_back(builder.palette[entry]);
+			}
+		}
+		palette.shrink_to_fit();
+
+		ui32 entryBits = 0;
+		while ((1u << entryBits) < palette.size()) {
+			entryBits++;
+		}
+		runBits = entryBits + CHUNK_SIZE_LOG2;
+		runCount = static_cast<ui32>(builder.runEntries.size());
+		// one more word, so reading a run may always load two
+		std::vector<ui32> words((static_cast<size_t>(runCount) * runBits + 31) / 32 + 1, 0);
+		for (ui32 r = 0;r < runCount;r++) {
+			ui32 value = (remap[builder.runEntries[r]] << CHUNK_SIZE_LOG2) | (builder.runEnds[r] - 1u);
+			ui32 bit = r * runBits;
+			ui64 shifted = static_cast<ui64>(value) << (bit & 31);
+			words[bit >> 5] |= static_cast<ui32>(shifted);
+			words[(bit >> 5) + 1] |= static_cast<ui32>(shifted >> 32);
+		}
+		runWords = std::move(words);
+		rowStarts = builder.rowStarts;
+	}
+}
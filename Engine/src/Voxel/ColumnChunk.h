@@ -0,0 +1,91 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "Morton.h"
+
+#define CHUNK_COLUMNS (CHUNK_SIZE * CHUNK_SIZE)
+
+namespace Luxel
+{
+	// run length encoded chunk for cold storage: each of the 32x32 vertical columns is a list of runs
+	// of identical voxels from y = 0 up. a run is a palette entry and the y it ends at, bit packed at
+	// just the width the palette needs, so terrain with a handful of layers per column takes a few
+	// bytes per column. fills and copies work on the runs without expanding them.
+	class LUXEL_API ColumnChunk
+	{
+	public:
+		// all air.
+		ColumnChunk();
+
+		void Encode(const Chunk& chunk);
+		void Decode(Chunk& chunk) const;
+		// CHUNK_VOLUME packed voxels in Morton order, the layout of Chunk::Decode and Chunk::Load.
+		// columns are gathered and compared 8 voxels at a time with AVX2.
+		void Encode(const ui32* packed);
+		void Decode(ui32* packed) const;
+
+		Voxel Get(ui32 x, ui32 y, ui32 z) const;
+		void Fill(const Voxel& voxel);
+		// voxels in [min, max), clamped to the chunk.
+		void FillBox(const glm::ivec3& min, const glm::ivec3& max, const Voxel& voxel);
+		// size voxels from sourceMin of source to targetMin of this chunk, both boxes must lie inside
+		// their chunks. source may be this chunk.
+		void CopyBox(const ColumnChunk& source, const glm::ivec3& sourceMin, const glm::ivec3& targetMin, const glm::ivec3& size);
+
+		bool IsEmpty() const;
+		ui32 GetRunCount() const;
+		size_t GetMemoryUsage() const;
+
+		// columns are stored x first, the order every operation walks them in.
+		static ui32 Column(ui32 x, ui32 z) { return x + z * CHUNK_SIZE; }
+
+	private:
+		// appends runs column by column, merging neighbors that hold the same voxel.
+		struct Builder
+		{
+			std::vector<ui32> palette;
+			std::unordered_map<ui32, ui32> lookup;
+			std::vector<ui32> runEntries;
+			std::vector<ui8> runEnds;
+			std::array<ui16, CHUNK_SIZE + 1> rowStarts;
+			ui32 columnStart = 0;
+			ui32 lastPacked = 0;
+			ui32 lastEntry = 0;
+
+			Builder();
+			void Append(ui32 packed, ui32 end);
+			void EndColumn(ui32 column);
+		};
+
+		void ReadRun(ui32 run, ui32& entry, ui32& end) const
+		{
+			ui32 bit = run * runBits;
+			ui64 pair = static_cast<ui64>(runWords[bit >> 5]) | (static_cast<ui64>(runWords[(bit >> 5) + 1]) << 32);
+			ui32 value = static_cast<ui32>(pair >> (bit & 31)) & ((1u << runBits) - 1u);
+			entry = value >> CHUNK_SIZE_LOG2;
+			end = (value & (CHUNK_SIZE - 1)) + 1;
+		}
+
+		// first run of column, walking from the start of its row.
+		ui32 FindColumn(ui32 column) const;
+		// first run of the column after the one starting at run.
+		ui32 NextColumn(ui32 run) const;
+		// appends the runs of the column starting at run clipped to [begin, end), moved up by shift.
+		void CopyRuns(Builder& builder, ui32 run, ui32 begin, ui32 end, int shift) const;
+		void Take(Builder& builder);
+
+		std::vector<ui32> palette;
+		// runCount runs of runBits bits, entry << CHUNK_SIZE_LOG2 | (end - 1), and one word of padding
+		std::vector<ui32> runWords;
+		ui32 runBits;
+		ui32 runCount;
+		// first run of each row of columns with the same z
+		std::array<ui16, CHUNK_SIZE + 1> rowStarts;
+	};
+}
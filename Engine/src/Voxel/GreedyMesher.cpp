@@ -0,0 +1,225 @@
+#include "pch.h"
+
+#include "GreedyMesher.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr int PADDED_SIZE = CHUNK_SIZE + 2;
+		constexpr int PADDED_VOLUME = PADDED_SIZE * PADDED_SIZE * PADDED_SIZE;
+
+		inline int PaddedIndex(int x, int y, int z)
+		{
+			return x + y * PADDED_SIZE + z * PADDED_SIZE * PADDED_SIZE;
+		}
+
+		inline bool IsSolid(ui32 packed)
+		{
+			return (packed & 0xFFFF) != 0;
+		}
+
+		// copies the chunk plus a one voxel border from its 26 neighbors.
+		void GatherPadded(const VoxelWorld& world, const ChunkCoord& coord, std::vector<ui32>& padded)
+		{
+			padded.assign(PADDED_VOLUME, 0);
+			for (int dz = -1;dz <= 1;dz++) {
+				for (int dy = -1;dy <= 1;dy++) {
+					for (int dx = -1;dx <= 1;dx++) {
+						const Chunk* chunk = world.GetChunk(coord + glm::ivec3(dx, dy, dz));
+						if (chunk == nullptr || chunk->IsEmpty()) {
+							continue;
+						}
+
+						// padded range covered by this neighbor
+						int x0 = dx < 0 ? 0 : (dx == 0 ? 1 : PADDED_SIZE - 1), x1 = dx < 0 ? 1 : (dx == 0 ? PADDED_SIZE - 1 : PADDED_SIZE);
+						int y0 = dy < 0 ? 0 : (dy == 0 ? 1 : PADDED_SIZE - 1), y1 = dy < 0 ? 1 : (dy == 0 ? PADDED_SIZE - 1 : PADDED_SIZE);
+						int z0 = dz < 0 ? 0 : (dz == 0 ? 1 : PADDED_SIZE - 1), z1 = dz < 0 ? 1 : (dz == 0 ? PADDED_SIZE - 1 : PADDED_SIZE);
+						for (int z = z0;z < z1;z++) {
+							for (int y = y0;y < y1;y++) {
+								for (int x = x0;x < x1;x++) {
+									Voxel voxel = chunk->Get((x - 1) & (CHUNK_SIZE - 1), (y - 1) & (CHUNK_SIZE - 1), (z - 1) & (CHUNK_SIZE - 1));
+									padded[PaddedIndex(x, y, z)] = voxel.Pack();
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		inline ui32 VertexAO(bool side1, bool side2, bool corner)
+		{
+			if (side1 && side2) {
+				return 0;
+			}
+			return 3 - (static_cast<ui32>(side1) + static_cast<ui32>(side2) + static_cast<ui32>(corner));
+		}
+	}
+
+	std::vector<VkVertexInputBindingDescription> VoxelVertex::GetBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(VoxelVertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> VoxelVertex::GetAttributeDescriptions()
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32_UINT;
+		attributeDescriptions[0].offset = offsetof(VoxelVertex, position);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R32_UINT;
+		attributeDescriptions[1].offset = offsetof(VoxelVertex, attributes);
+		return attributeDescriptions;
+	}
+
+	GreedyMesher::GreedyMesher()
+	{
+
+	}
+
+	GreedyMesher::~GreedyMesher()
+	{
+
+	}
+
+	ui32 GreedyMesher::MeshChunk(const VoxelWorld& world, const ChunkCoord& coord, std::vector<VoxelVertex>& vertices)
+	{
+		vertices.clear();
+
+		EpochGuard guard;
+		const Chunk* center = world.GetChunk(coord);
+		if (center == nullptr || center->IsEmpty()) {
+			return 0;
+		}
+
+		thread_local std::vector<ui32> padded;
+		GatherPadded(world, coord, padded);
+
+		// face key: packed voxel in the low 32 bits, 4 corner ao values (2 bits each) above it.
+		std::array<ui64, CHUNK_SIZE * CHUNK_SIZE> mask;
+		ui32 quadCount = 0;
+
+		for (ui32 direction = 0;direction < 6;direction++) {
+			int axis = static_cast<int>(direction / 2);
+			int sign = direction % 2 == 0 ? 1 : -1;
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+
+			glm::ivec3 normal(0), du(0), dv(0);
+			normal[axis] = sign;
+			du[u] = 1;
+			dv[v] = 1;
+
+			for (int k = 0;k < CHUNK_SIZE;k++) {
+				// build the face mask of this slice
+				for (int j = 0;j < CHUNK_SIZE;j++) {
+					for (int i = 0;i < CHUNK_SIZE;i++) {
+						glm::ivec3 p(1);
+						p[axis] += k;
+						p[u] += i;
+						p[v] += j;
+
+						ui32 packed = padded[PaddedIndex(p.x, p.y, p.z)];
+						glm::ivec3 q = p + normal;
+						if (!IsSolid(packed) || IsSolid(padded[PaddedIndex(q.x, q.y, q.z)])) {
+							mask[j * CHUNK_SIZE + i] = 0;
+							continue;
+						}
+
+						auto solidAt = [&](const glm::ivec3& offset) {
+							glm::ivec3 s = q + offset;
+							return IsSolid(padded[PaddedIndex(s.x, s.y, s.z)]);
+						};
+						bool uNeg = solidAt(-du), uPos = solidAt(du);
+						bool vNeg = solidAt(-dv), vPos = solidAt(dv);
+						ui32 ao0 = VertexAO(uNeg, vNeg, solidAt(-du - dv));
+						ui32 ao1 = VertexAO(uPos, vNeg, solidAt(du - dv));
+						ui32 ao2 = VertexAO(uPos, vPos, solidAt(du + dv));
+						ui32 ao3 = VertexAO(uNeg, vPos, solidAt(-du + dv));
+						ui64 ao = ao0 | (ao1 << 2) | (ao2 << 4) | (ao3 << 6);
+						mask[j * CHUNK_SIZE + i] = static_cast<ui64>(packed) | (ao << 32);
+					}
+				}
+
+				// greedy merge into quads
+				int plane = k + (sign > 0 ? 1 : 0);
+				for (int j = 0;j < CHUNK_SIZE;j++) {
+					for (int i = 0;i < CHUNK_SIZE;) {
+						ui64 key = mask[j * CHUNK_SIZE + i];
+						if (key == 0) {
+							i++;
+							continue;
+						}
+
+						int width = 1;
+						while (i + width < CHUNK_SIZE && mask[j * CHUNK_SIZE + i + width] == key) {
+							width++;
+						}
+
+						int height = 1;
+						bool extend = true;
+						while (j + height < CHUNK_SIZE && extend) {
+							for (int w = 0;w < width;w++) {
+								if (mask[(j + height) * CHUNK_SIZE + i + w] != key) {
+									extend = false;
+									break;
+								}
+							}
+							if (extend) {
+								height++;
+							}
+						}
+
+						for (int h = 0;h < height;h++) {
+							for (int w = 0;w < width;w++) {
+								mask[(j + h) * CHUNK_SIZE + i + w] = 0;
+							}
+						}
+
+						// corners in (u, v): (i, j) (i + w, j) (i + w, j + h) (i, j + h), counter clockwise around +axis
+						glm::ivec3 corners[4];
+						const int cu[4] = { i, i + width, i + width, i };
+						const int cv[4] = { j, j, j + height, j + height };
+						ui32 aos[4];
+						for (int c = 0;c < 4;c++) {
+							corners[c][axis] = plane;
+							corners[c][u] = cu[c];
+							corners[c][v] = cv[c];
+							aos[c] = static_cast<ui32>(key >> (32 + 2 * c)) & 3;
+						}
+
+						// faces pointing down the axis wind the other way
+						int order[4] = { 0, 1, 2, 3 };
+						if (sign < 0) {
+							order[1] = 3;
+							order[3] = 1;
+						}
+
+						// split along the diagonal that keeps occlusion from bleeding across the quad
+						int first = aos[order[0]] + aos[order[2]] < aos[order[1]] + aos[order[3]] ? 1 : 0;
+
+						ui32 attributes = static_cast<ui32>(key & 0xFFFFFFFFull);
+						for (int c = 0;c < 4;c++) {
+							int corner = order[(first + c) & 3];
+							vertices.push_back(VoxelVertex::Pack(corners[corner].x, corners[corner].y, corners[corner].z, direction, aos[corner], attributes));
+						}
+						quadCount++;
+
+						i += width;
+					}
+				}
+			}
+		}
+
+		return quadCount;
+	}
+}
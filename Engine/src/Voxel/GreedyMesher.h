@@ -0,0 +1,45 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+
+namespace Luxel
+{
+	// 8 byte packed vertex, positions are relative to the chunk origin.
+	// position: x | y << 6 | z << 12 | normal << 18 | ao << 21
+	// attributes: Voxel::Pack() (material | color << 16)
+	struct VoxelVertex
+	{
+		ui32 position;
+		ui32 attributes;
+
+		static VoxelVertex Pack(ui32 x, ui32 y, ui32 z, ui32 normal, ui32 ao, ui32 attributes)
+		{
+			return VoxelVertex{ x | (y << 6) | (z << 12) | (normal << 18) | (ao << 21), attributes };
+		}
+
+		static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
+		static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
+	};
+
+	// merges coplanar faces with the same voxel and ambient occlusion into quads.
+	// every quad is 4 vertices ordered for the shared 0-1-2 2-3-0 index pattern.
+	class LUXEL_API GreedyMesher
+	{
+	public:
+		GreedyMesher(const GreedyMesher&) = delete;
+		GreedyMesher operator=(const GreedyMesher&) = delete;
+
+		// reads neighbor chunks from the world for border faces and occlusion; returns the quad count.
+		static ui32 MeshChunk(const VoxelWorld& world, const ChunkCoord& coord, std::vector<VoxelVertex>& vertices);
+
+	private:
+		GreedyMesher();
+		~GreedyMesher();
+	};
+}
@@ -0,0 +1,339 @@
+#include "pch.h"
+
+#include "MeshLoader.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		enum class PlyFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+		struct PlyProperty
+		{
+			std::string name;
+			std::string type;
+			// list properties only.
+			bool isList = false;
+			std::string countType;
+		};
+
+		struct PlyElement
+		{
+			std::string name;
+			ui32 count = 0;
+			std::vector<PlyProperty> properties;
+		};
+
+		ui32 PlyTypeSize(const std::string& type)
+		{
+			if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+			if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+			if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32") return 4;
+			if (type == "double" || type == "float64") return 8;
+			Error("Unknown PLY property type:", type);
+			throw std::runtime_error("Unknown PLY property type.");
+		}
+
+		bool PlyTypeIsNormalizedColor(const std::string& type)
+		{
+			return type == "uchar" || type == "uint8";
+		}
+
+		double ReadBinaryValue(std::ifstream& file, const std::string& type, bool bigEndian)
+		{
+			ui32 size = PlyTypeSize(type);
+			ui8 bytes[8];
+			file.read(reinterpret_cast<char*>(bytes), size);
+			if (bigEndian) {
+				std::reverse(bytes, bytes + size);
+			}
+
+			if (type == "char" || type == "int8") { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+			if (type == "uchar" || type == "uint8") { return bytes[0]; }
+			if (type == "short" || type == "int16") { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+			if (type == "ushort" || type == "uint16") { ui16 v; std::memcpy(&v, bytes, 2); return v; }
+			if (type == "int" || type == "int32") { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+			if (type == "uint" || type == "uint32") { ui32 v; std::memcpy(&v, bytes, 4); return v; }
+			if (type == "float" || type == "float32") { float v; std::memcpy(&v, bytes, 4); return v; }
+			double v; std::memcpy(&v, bytes, 8); return v;
+		}
+
+		// resolves a 1-based (or negative, relative) OBJ index.
+		ui32 ResolveObjIndex(int index, size_t count)
+		{
+			if (index > 0 && static_cast<size_t>(index) <= count) {
+				return static_cast<ui32>(index - 1);
+			}
+			if (index < 0 && static_cast<size_t>(-static_cast<int64_t>(index)) <= count) {
+				return static_cast<ui32>(static_cast<int64_t>(count) + index);
+			}
+			Error("Invalid OBJ index", index, "with", count, "vertices.");
+			throw std::runtime_error("Invalid OBJ index.");
+		}
+
+		void AddPolygon(TriangleMesh& mesh, const std::vector<ui32>& polygon, ui16 material)
+		{
+			for (ui32 index : polygon) {
+				if (index >= mesh.positions.size()) {
+					Error("Face index", index, "out of range with", mesh.positions.size(), "vertices.");
+					throw std::runtime_error("Face index out of range.");
+				}
+			}
+			// fan triangulation
+			for (size_t i = 2;i < polygon.size();i++) {
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i - 1]);
+				mesh.indices.push_back(polygon[i]);
+				mesh.triangleMaterials.push_back(material);
+			}
+		}
+	}
+
+	MeshLoader::MeshLoader()
+	{
+
+	}
+
+	MeshLoader::~MeshLoader()
+	{
+
+	}
+
+	TriangleMesh MeshLoader::Load(const std::string& filePath)
+	{
+		std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		if (extension == "obj") {
+			return LoadOBJ(filePath);
+		}
+		if (extension == "ply") {
+			return LoadPLY(filePath);
+		}
+		Error("Unsupported mesh format:", filePath);
+		throw std::runtime_error("Unsupported mesh format.");
+	}
+
+	TriangleMesh MeshLoader::LoadOBJ(const std::string& filePath)
+	{
+		std::ifstream file{ filePath };
+		if (!file.is_open()) {
+			Fatal("The file:", filePath, "does not exist.");
+			throw std::runtime_error("failed to open file.");
+		}
+
+		TriangleMesh mesh;
+		std::unordered_map<std::string, ui16> materialLookup;
+		ui16 currentMaterial = 0;
+		mesh.materialNames.push_back("default");
+
+		std::string line;
+		std::vector<ui32> polygon;
+		while (std::getline(file, line)) {
+			std::istringstream ss{ line };
+			std::string keyword;
+			ss >> keyword;
+
+			if (keyword == "v") {
+				glm::vec3 position{};
+				ss >> position.x >> position.y >> position.z;
+				mesh.positions.push_back(position);
+
+				// vertex colors appended after the position (common OBJ extension).
+				glm::vec3 color{};
+				if (ss >> color.x >> color.y >> color.z) {
+					mesh.colors.resize(mesh.positions.size() - 1, glm::vec3(1.f));
+					mesh.colors.push_back(color);
+				}
+				else if (!mesh.colors.empty()) {
+					mesh.colors.push_back(glm::vec3(1.f));
+				}
+			}
+			else if (keyword == "f") {
+				polygon.clear();
+				std::string corner;
+				while (ss >> corner) {
+					int index = std::stoi(corner.substr(0, corner.find('/')));
+					polygon.push_back(ResolveObjIndex(index, mesh.positions.size()));
+				}
+				AddPolygon(mesh, polygon, currentMaterial);
+			}
+			else if (keyword == "usemtl") {
+				std::string name;
+				ss >> name;
+				auto it = materialLookup.find(name);
+				if (it == materialLookup.end()) {
+					currentMaterial = static_cast<ui16>(mesh.materialNames.size());
+					materialLookup[name] = currentMaterial;
+					mesh.materialNames.push_back(name);
+				}
+				else {
+					currentMaterial = it->second;
+				}
+			}
+		}
+
+		if (!mesh.colors.empty()) {
+			mesh.colors.resize(mesh.positions.size(), glm::vec3(1.f));
+		}
+
+		Info("Load OBJ:", filePath, "[", "Vertices:", mesh.positions.size(), "Triangles:", mesh.GetTriangleCount(), "Materials:", mesh.materialNames.size(), "]");
+		return mesh;
+	}
+
+	TriangleMesh MeshLoader::LoadPLY(const std::string& filePath)
+	{
+		std::ifstream file{ filePath, std::ios::binary };
+		if (!file.is_open()) {
+			Fatal("The file:", filePath, "does not exist.");
+			throw std::runtime_error("failed to open file.");
+		}
+
+		// header
+		std::string line;
+		std::getline(file, line);
+		if (line.rfind("ply", 0) != 0) {
+			Error("Not a PLY file:", filePath);
+			throw std::runtime_error("Not a PLY file.");
+		}
+
+		PlyFormat format = PlyFormat::Ascii;
+		std::vector<PlyElement> elements;
+		while (std::getline(file, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			std::istringstream ss{ line };
+			std::string keyword;
+			ss >> keyword;
+
+			if (keyword == "format") {
+				std::string name;
+				ss >> name;
+				if (name == "binary_little_endian") format = PlyFormat::BinaryLittleEndian;
+				else if (name == "binary_big_endian") format = PlyFormat::BinaryBigEndian;
+			}
+			else if (keyword == "element") {
+				PlyElement element;
+				ss >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property" && !elements.empty()) {
+				PlyProperty property;
+				std::string type;
+				ss >> type;
+				if (type == "list") {
+					property.isList = true;
+					ss >> property.countType >> property.type >> property.name;
+				}
+				else {
+					property.type = type;
+					ss >> property.name;
+				}
+				elements.back().properties.push_back(property);
+			}
+			else if (keyword == "end_header") {
+				break;
+			}
+		}
+
+		TriangleMesh mesh;
+		mesh.materialNames.push_back("default");
+		bool bigEndian = format == PlyFormat::BinaryBigEndian;
+		std::vector<double> values;
+		std::vector<ui32> polygon;
+
+		for (const auto& element : elements) {
+			bool isVertex = element.name == "vertex";
+			bool isFace = element.name == "face";
+
+			int px = -1, py = -1, pz = -1, cr = -1, cg = -1, cb = -1, faceList = -1, faceMaterial = -1;
+			for (int i = 0;i < static_cast<int>(element.properties.size());i++) {
+				const std::string& name = element.properties[i].name;
+				if (name == "x") px = i;
+				else if (name == "y") py = i;
+				else if (name == "z") pz = i;
+				else if (name == "red" || name == "r") cr = i;
+				else if (name == "green" || name == "g") cg = i;
+				else if (name == "blue" || name == "b") cb = i;
+				else if (name == "vertex_indices" || name == "vertex_index") faceList = i;
+				else if (name == "material_index") faceMaterial = i;
+			}
+			if (isVertex && (px < 0 || py < 0 || pz < 0)) {
+				Error("PLY vertex element has no position:", filePath);
+				throw std::runtime_error("PLY vertex element has no position.");
+			}
+			bool hasColor = isVertex && cr >= 0 && cg >= 0 && cb >= 0;
+			float colorScale = hasColor && PlyTypeIsNormalizedColor(element.properties[cr].type) ? 1.f / 255.f : 1.f;
+
+			for (ui32 n = 0;n < element.count;n++) {
+				values.assign(element.properties.size(), 0.0);
+				polygon.clear();
+
+				std::istringstream ss;
+				if (format == PlyFormat::Ascii) {
+					std::getline(file, line);
+					ss.str(line);
+				}
+
+				for (int i = 0;i < static_cast<int>(element.properties.size());i++) {
+					const PlyProperty& property = element.properties[i];
+					if (property.isList) {
+						double count = 0.0;
+						if (format == PlyFormat::Ascii) ss >> count;
+						else count = ReadBinaryValue(file, property.countType, bigEndian);
+
+						for (ui32 k = 0;k < static_cast<ui32>(count);k++) {
+							double value = 0.0;
+							if (format == PlyFormat::Ascii) ss >> value;
+							else value = ReadBinaryValue(file, property.type, bigEndian);
+							if (isFace && i == faceList) {
+								// negative values would not survive the cast, AddPolygon checks the rest
+								if (value < 0.0) {
+									Error("Negative PLY face index", value, "in", filePath);
+									throw std::runtime_error("Face index out of range.");
+								}
+								polygon.push_back(static_cast<ui32>(std::min(value, 4294967295.0)));
+							}
+						}
+					}
+					else {
+						if (format == PlyFormat::Ascii) ss >> values[i];
+						else values[i] = ReadBinaryValue(file, property.type, bigEndian);
+					}
+				}
+
+				if (isVertex) {
+					mesh.positions.emplace_back(
+						static_cast<float>(values[px]),
+						static_cast<float>(values[py]),
+						static_cast<float>(values[pz]));
+					if (hasColor) {
+						mesh.colors.emplace_back(
+							static_cast<float>(values[cr]) * colorScale,
+							static_cast<float>(values[cg]) * colorScale,
+							static_cast<float>(values[cb]) * colorScale);
+					}
+				}
+				else if (isFace) {
+					ui16 material = 0;
+					if (faceMaterial >= 0) {
+						material = static_cast<ui16>(values[faceMaterial]) + 1;
+						while (mesh.materialNames.size() <= material) {
+							mesh.materialNames.push_back("material_" + std::to_string(mesh.materialNames.size() - 1));
+						}
+					}
+					AddPolygon(mesh, polygon, material);
+				}
+			}
+
+			if (!file) {
+				Error("Unexpected end of PLY file:", filePath);
+				throw std::runtime_error("Unexpected end of PLY file.");
+			}
+		}
+
+		Info("Load PLY:", filePath, "[", "Vertices:", mesh.positions.size(), "Triangles:", mesh.GetTriangleCount(), "]");
+		return mesh;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+
+namespace Luxel
+{
+	struct TriangleMesh
+	{
+		std::vector<glm::vec3> positions;
+		// optional, one color per position when present.
+		std::vector<glm::vec3> colors;
+		std::vector<ui32> indices;
+		// one entry per triangle, indexing materialNames.
+		std::vector<ui16> triangleMaterials;
+		std::vector<std::string> materialNames;
+
+		ui32 GetTriangleCount() const { return static_cast<ui32>(indices.size() / 3); }
+		bool HasColors() const { return !colors.empty(); }
+	};
+
+	class LUXEL_API MeshLoader
+	{
+	public:
+		MeshLoader(const MeshLoader&) = delete;
+		MeshLoader operator=(const MeshLoader&) = delete;
+
+		// picks the parser from the file extension.
+		static TriangleMesh Load(const std::string& filePath);
+		static TriangleMesh LoadOBJ(const std::string& filePath);
+		static TriangleMesh LoadPLY(const std::string& filePath);
+
+	private:
+		MeshLoader();
+		~MeshLoader();
+	};
+}
@@ -0,0 +1,111 @@
+#include "pch.h"
+
+#include "Morton.h"
+
+namespace Luxel
+{
+	namespace
+	{
+#ifdef LUXEL_SIMD_AVX2
+		constexpr size_t BATCH_LANES = 8;
+
+		inline __m256i Part1By2(__m256i v)
+		{
+			v = _mm256_and_si256(v, _mm256_set1_epi32(0x000003FF));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_slli_epi32(v, 16)), _mm256_set1_epi32(static_cast<int>(0xFF0000FF)));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_slli_epi32(v, 8)), _mm256_set1_epi32(0x0300F00F));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_slli_epi32(v, 4)), _mm256_set1_epi32(0x030C30C3));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_slli_epi32(v, 2)), _mm256_set1_epi32(0x09249249));
+			return v;
+		}
+
+		inline __m256i Compact1By2(__m256i v)
+		{
+			v = _mm256_and_si256(v, _mm256_set1_epi32(0x09249249));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 2)), _mm256_set1_epi32(0x030C30C3));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 4)), _mm256_set1_epi32(0x0300F00F));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 8)), _mm256_set1_epi32(static_cast<int>(0xFF0000FF)));
+			v = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 16)), _mm256_set1_epi32(0x000003FF));
+			return v;
+		}
+
+		inline void EncodeLanes(const ui32* x, const ui32* y, const ui32* z, ui32* codes)
+		{
+			__m256i sx = Part1By2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x)));
+			__m256i sy = Part1By2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y)));
+			__m256i sz = Part1By2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(z)));
+			__m256i code = _mm256_or_si256(sx, _mm256_or_si256(_mm256_slli_epi32(sy, 1), _mm256_slli_epi32(sz, 2)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(codes), code);
+		}
+
+		inline void DecodeLanes(const ui32* codes, ui32* x, ui32* y, ui32* z)
+		{
+			__m256i code = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(x), Compact1By2(code));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(y), Compact1By2(_mm256_srli_epi32(code, 1)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(z), Compact1By2(_mm256_srli_epi32(code, 2)));
+		}
+#else
+		constexpr size_t BATCH_LANES = 4;
+
+		inline __m128i Part1By2(__m128i v)
+		{
+			v = _mm_and_si128(v, _mm_set1_epi32(0x000003FF));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_slli_epi32(v, 16)), _mm_set1_epi32(static_cast<int>(0xFF0000FF)));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_slli_epi32(v, 8)), _mm_set1_epi32(0x0300F00F));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_slli_epi32(v, 4)), _mm_set1_epi32(0x030C30C3));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_slli_epi32(v, 2)), _mm_set1_epi32(0x09249249));
+			return v;
+		}
+
+		inline __m128i Compact1By2(__m128i v)
+		{
+			v = _mm_and_si128(v, _mm_set1_epi32(0x09249249));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 2)), _mm_set1_epi32(0x030C30C3));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 4)), _mm_set1_epi32(0x0300F00F));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 8)), _mm_set1_epi32(static_cast<int>(0xFF0000FF)));
+			v = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 16)), _mm_set1_epi32(0x000003FF));
+			return v;
+		}
+
+		inline void EncodeLanes(const ui32* x, const ui32* y, const ui32* z, ui32* codes)
+		{
+			__m128i sx = Part1By2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x)));
+			__m128i sy = Part1By2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y)));
+			__m128i sz = Part1By2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(z)));
+			__m128i code = _mm_or_si128(sx, _mm_or_si128(_mm_slli_epi32(sy, 1), _mm_slli_epi32(sz, 2)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(codes), code);
+		}
+
+		inline void DecodeLanes(const ui32* codes, ui32* x, ui32* y, ui32* z)
+		{
+			__m128i code = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(x), Compact1By2(code));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(y), Compact1By2(_mm_srli_epi32(code, 1)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(z), Compact1By2(_mm_srli_epi32(code, 2)));
+		}
+#endif
+	}
+
+	void MortonEncodeBatch(const ui32* x, const ui32* y, const ui32* z, ui32* codes, size_t count)
+	{
+		size_t i = 0;
+		for (;i + BATCH_LANES <= count;i += BATCH_LANES) {
+			EncodeLanes(x + i, y + i, z + i, codes + i);
+		}
+		for (;i < count;i++) {
+			codes[i] = MortonEncode(x[i], y[i], z[i]);
+		}
+	}
+
+	void MortonDecodeBatch(const ui32* codes, ui32* x, ui32* y, ui32* z, size_t count)
+	{
+		size_t i = 0;
+		for (;i + BATCH_LANES <= count;i += BATCH_LANES) {
+			DecodeLanes(codes + i, x + i, y + i, z + i);
+		}
+		for (;i < count;i++) {
+			MortonDecode(codes[i], x[i], y[i], z[i]);
+		}
+	}
+}
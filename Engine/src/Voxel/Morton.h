@@ -0,0 +1,173 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+// 3D Morton (Z-order) codes: bit i of x, y and z lands at bit 3i, 3i+1 and 3i+2.
+// 32 bit codes hold 10 bits per axis, 64 bit codes 21 bits per axis.
+
+#define MORTON_MASK_X32 0x09249249u
+#define MORTON_MASK_Y32 0x12492492u
+#define MORTON_MASK_Z32 0x24924924u
+#define MORTON_MASK_X64 0x1249249249249249ull
+#define MORTON_MASK_Y64 0x2492492492492492ull
+#define MORTON_MASK_Z64 0x4924924924924924ull
+
+namespace Luxel
+{
+	namespace MortonTables
+	{
+		// 8 input bits spread to every third bit.
+		inline constexpr std::array<ui32, 256> Spread = [] {
+			std::array<ui32, 256> table{};
+			for (ui32 v = 0;v < 256;v++) {
+				ui32 spread = 0;
+				for (ui32 bit = 0;bit < 8;bit++) {
+					spread |= ((v >> bit) & 1u) << (bit * 3);
+				}
+				table[v] = spread;
+			}
+			return table;
+		}();
+
+		// 9 bit code -> x | y << 3 | z << 6.
+		inline constexpr std::array<ui16, 512> Compact = [] {
+			std::array<ui16, 512> table{};
+			for (ui32 code = 0;code < 512;code++) {
+				ui32 x = 0, y = 0, z = 0;
+				for (ui32 bit = 0;bit < 3;bit++) {
+					x |= ((code >> (bit * 3 + 0)) & 1u) << bit;
+					y |= ((code >> (bit * 3 + 1)) & 1u) << bit;
+					z |= ((code >> (bit * 3 + 2)) & 1u) << bit;
+				}
+				table[code] = static_cast<ui16>(x | (y << 3) | (z << 6));
+			}
+			return table;
+		}();
+	}
+
+	// table path, works everywhere.
+	inline ui32 MortonEncodeLUT(ui32 x, ui32 y, ui32 z)
+	{
+		using MortonTables::Spread;
+		ui32 sx = Spread[x & 0xFF] | (Spread[(x >> 8) & 0x3] << 24);
+		ui32 sy = Spread[y & 0xFF] | (Spread[(y >> 8) & 0x3] << 24);
+		ui32 sz = Spread[z & 0xFF] | (Spread[(z >> 8) & 0x3] << 24);
+		return sx | (sy << 1) | (sz << 2);
+	}
+
+	inline void MortonDecodeLUT(ui32 code, ui32& x, ui32& y, ui32& z)
+	{
+		x = y = z = 0;
+		for (ui32 group = 0;group < 4;group++) {
+			ui32 t = MortonTables::Compact[(code >> (group * 9)) & 0x1FF];
+			x |= (t & 7) << (group * 3);
+			y |= ((t >> 3) & 7) << (group * 3);
+			z |= (t >> 6) << (group * 3);
+		}
+	}
+
+	// shift-and-mask path, the same steps the SIMD batch functions run per lane.
+	inline ui32 MortonPart1By2(ui32 v)
+	{
+		v &= 0x000003FF;
+		v = (v ^ (v << 16)) & 0xFF0000FF;
+		v = (v ^ (v << 8)) & 0x0300F00F;
+		v = (v ^ (v << 4)) & 0x030C30C3;
+		v = (v ^ (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	inline ui32 MortonCompact1By2(ui32 v)
+	{
+		v &= 0x09249249;
+		v = (v ^ (v >> 2)) & 0x030C30C3;
+		v = (v ^ (v >> 4)) & 0x0300F00F;
+		v = (v ^ (v >> 8)) & 0xFF0000FF;
+		v = (v ^ (v >> 16)) & 0x000003FF;
+		return v;
+	}
+
+	inline ui64 MortonPart1By2(ui64 v)
+	{
+		v &= 0x1FFFFF;
+		v = (v | (v << 32)) & 0x1F00000000FFFFull;
+		v = (v | (v << 16)) & 0x1F0000FF0000FFull;
+		v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+		v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+		v = (v | (v << 2)) & 0x1249249249249249ull;
+		return v;
+	}
+
+	inline ui64 MortonCompact1By2(ui64 v)
+	{
+		v &= 0x1249249249249249ull;
+		v = (v ^ (v >> 2)) & 0x10C30C30C30C30C3ull;
+		v = (v ^ (v >> 4)) & 0x100F00F00F00F00Full;
+		v = (v ^ (v >> 8)) & 0x1F0000FF0000FFull;
+		v = (v ^ (v >> 16)) & 0x1F00000000FFFFull;
+		v = (v ^ (v >> 32)) & 0x1FFFFFull;
+		return v;
+	}
+
+	// default paths: pdep/pext when the build targets BMI2, tables otherwise.
+	// pdep/pext are microcoded on AMD before Zen 3; build without LUXEL_SIMD_BMI2 for those.
+	inline ui32 MortonEncode(ui32 x, ui32 y, ui32 z)
+	{
+#ifdef LUXEL_SIMD_BMI2
+		return _pdep_u32(x, MORTON_MASK_X32) | _pdep_u32(y, MORTON_MASK_Y32) | _pdep_u32(z, MORTON_MASK_Z32);
+#else
+		return MortonEncodeLUT(x, y, z);
+#endif
+	}
+
+	inline void MortonDecode(ui32 code, ui32& x, ui32& y, ui32& z)
+	{
+#ifdef LUXEL_SIMD_BMI2
+		x = _pext_u32(code, MORTON_MASK_X32);
+		y = _pext_u32(code, MORTON_MASK_Y32);
+		z = _pext_u32(code, MORTON_MASK_Z32);
+#else
+		MortonDecodeLUT(code, x, y, z);
+#endif
+	}
+
+	inline ui64 MortonEncode64(ui32 x, ui32 y, ui32 z)
+	{
+#ifdef LUXEL_SIMD_BMI2
+		return _pdep_u64(x, MORTON_MASK_X64) | _pdep_u64(y, MORTON_MASK_Y64) | _pdep_u64(z, MORTON_MASK_Z64);
+#else
+		return MortonPart1By2(static_cast<ui64>(x)) | (MortonPart1By2(static_cast<ui64>(y)) << 1) | (MortonPart1By2(static_cast<ui64>(z)) << 2);
+#endif
+	}
+
+	inline void MortonDecode64(ui64 code, ui32& x, ui32& y, ui32& z)
+	{
+#ifdef LUXEL_SIMD_BMI2
+		x = static_cast<ui32>(_pext_u64(code, MORTON_MASK_X64));
+		y = static_cast<ui32>(_pext_u64(code, MORTON_MASK_Y64));
+		z = static_cast<ui32>(_pext_u64(code, MORTON_MASK_Z64));
+#else
+		x = static_cast<ui32>(MortonCompact1By2(code));
+		y = static_cast<ui32>(MortonCompact1By2(code >> 1));
+		z = static_cast<ui32>(MortonCompact1By2(code >> 2));
+#endif
+	}
+
+	inline ui32 MortonEncode(const glm::ivec3& p)
+	{
+		return MortonEncode(static_cast<ui32>(p.x), static_cast<ui32>(p.y), static_cast<ui32>(p.z));
+	}
+
+	inline glm::ivec3 MortonDecode(ui32 code)
+	{
+		ui32 x, y, z;
+		MortonDecode(code, x, y, z);
+		return glm::ivec3(x, y, z);
+	}
+
+	// batch paths, 8 lanes with AVX2 and 4 with SSE, the scalar path finishes the tail.
+	LUXEL_API void MortonEncodeBatch(const ui32* x, const ui32* y, const ui32* z, ui32* codes, size_t count);
+	LUXEL_API void MortonDecodeBatch(const ui32* codes, ui32* x, ui32* y, ui32* z, size_t count);
+}
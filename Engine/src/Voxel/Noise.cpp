@@ -0,0 +1,409 @@
+#include "pch.h"
+
+#include "Noise.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 PRIME_X = 0x27D4EB2Du;
+		constexpr ui32 PRIME_Y = 0x165667B1u;
+		constexpr ui32 PRIME_Z = 0x9E3779B1u;
+		constexpr ui32 HASH_MULTIPLIER = 0x2C1B3C6Du;
+
+		constexpr float SIMPLEX_F2 = 0.36602540378f;
+		constexpr float SIMPLEX_G2 = 0.21132486540f;
+		constexpr float SIMPLEX_SCALE = 40.0f;
+
+		// the two warp fBms sample elsewhere with other seeds so they are independent
+		constexpr float WARP_OFFSET_X = 17.31f;
+		constexpr float WARP_OFFSET_Y = -41.87f;
+		constexpr ui32 WARP_SEED_X = 0x100u;
+		constexpr ui32 WARP_SEED_Y = 0x200u;
+
+		// x, y and z arrive already multiplied by their primes.
+		ui32 Hash(ui32 x, ui32 y, ui32 z, ui32 seed)
+		{
+			ui32 h = (seed ^ x ^ y ^ z) * HASH_MULTIPLIER;
+			return h ^ (h >> 15);
+		}
+
+		float Fade(float t)
+		{
+			return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+		}
+
+		float Lerp(float a, float b, float t)
+		{
+			return a + t * (b - a);
+		}
+
+		// one of the 12 cube edge directions, picked by the low 4 bits.
+		float Grad3(ui32 h, float x, float y, float z)
+		{
+			h &= 15;
+			float u = h < 8 ? x : y;
+			float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+			return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+		}
+
+		float Grad2(ui32 h, float x, float y)
+		{
+			h &= 7;
+			float u = h < 4 ? x : y;
+			float v = h < 4 ? y : x;
+			return ((h & 1) ? -u : u) + ((h & 2) ? -2.0f * v : 2.0f * v);
+		}
+
+		float GradientAt(float x, float y, float z, ui32 seed)
+		{
+			float fx = std::floor(x);
+			float fy = std::floor(y);
+			float fz = std::floor(z);
+			ui32 px0 = static_cast<ui32>(static_cast<int>(fx)) * PRIME_X;
+			ui32 py0 = static_cast<ui32>(static_cast<int>(fy)) * PRIME_Y;
+			ui32 pz0 = static_cast<ui32>(static_cast<int>(fz)) * PRIME_Z;
+			ui32 px1 = px0 + PRIME_X;
+			ui32 py1 = py0 + PRIME_Y;
+			ui32 pz1 = pz0 + PRIME_Z;
+			float x0 = x - fx;
+			float y0 = y - fy;
+			float z0 = z - fz;
+			float x1 = x0 - 1.0f;
+			float y1 = y0 - 1.0f;
+			float z1 = z0 - 1.0f;
+			float u = Fade(x0);
+			float v = Fade(y0);
+			float w = Fade(z0);
+
+			float a = Lerp(Grad3(Hash(px0, py0, pz0, seed), x0, y0, z0), Grad3(Hash(px1, py0, pz0, seed), x1, y0, z0), u);
+			float b = Lerp(Grad3(Hash(px0, py1, pz0, seed), x0, y1, z0), Grad3(Hash(px1, py1, pz0, seed), x1, y1, z0), u);
+			float c = Lerp(Grad3(Hash(px0, py0, pz1, seed), x0, y0, z1), Grad3(Hash(px1, py0, pz1, seed), x1, y0, z1), u);
+			float d = Lerp(Grad3(Hash(px0, py1, pz1, seed), x0, y1, z1), Grad3(Hash(px1, py1, pz1, seed), x1, y1, z1), u);
+			return Lerp(Lerp(a, b, v), Lerp(c, d, v), w);
+		}
+
+		float SimplexCorner(ui32 h, float x, float y)
+		{
+			float t = std::max(0.5f - x * x - y * y, 0.0f);
+			t *= t;
+			return t * t * Grad2(h, x, y);
+		}
+
+		float SimplexAt(float x, float y, ui32 seed)
+		{
+			float s = (x + y) * SIMPLEX_F2;
+			float i = std::floor(x + s);
+			float j = std::floor(y + s);
+			float t = (i + j) * SIMPLEX_G2;
+			float x0 = x - (i - t);
+			float y0 = y - (j - t);
+			// the lower or upper triangle of the skewed cell
+			float i1 = x0 > y0 ? 1.0f : 0.0f;
+			float j1 = 1.0f - i1;
+			float x1 = x0 - i1 + SIMPLEX_G2;
+			float y1 = y0 - j1 + SIMPLEX_G2;
+			float x2 = x0 + (-1.0f + 2.0f * SIMPLEX_G2);
+			float y2 = y0 + (-1.0f + 2.0f * SIMPLEX_G2);
+
+			ui32 pi = static_cast<ui32>(static_cast<int>(i)) * PRIME_X;
+			ui32 pj = static_cast<ui32>(static_cast<int>(j)) * PRIME_Y;
+			ui32 h0 = Hash(pi, pj, 0, seed);
+			ui32 h1 = Hash(pi + (i1 != 0.0f ? PRIME_X : 0), pj + (j1 != 0.0f ? PRIME_Y : 0), 0, seed);
+			ui32 h2 = Hash(pi + PRIME_X, pj + PRIME_Y, 0, seed);
+			return SIMPLEX_SCALE * (SimplexCorner(h0, x0, y0) + SimplexCorner(h1, x1, y1) + SimplexCorner(h2, x2, y2));
+		}
+
+#ifdef LUXEL_SIMD_AVX2
+		__m256i HashLanes(__m256i x, __m256i y, __m256i z, __m256i seed)
+		{
+			__m256i h = _mm256_xor_si256(_mm256_xor_si256(seed, x), _mm256_xor_si256(y, z));
+			h = _mm256_mullo_epi32(h, _mm256_set1_epi32(static_cast<int>(HASH_MULTIPLIER)));
+			return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+		}
+
+		__m256 FadeLanes(__m256 t)
+		{
+			__m256 p = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+			return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), p);
+		}
+
+		__m256 LerpLanes(__m256 a, __m256 b, __m256 t)
+		{
+			return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+		}
+
+		// flips the sign of value where the given bit of h is set.
+		__m256 FlipLanes(__m256 value, __m256i h, int bit)
+		{
+			__m256i sign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1 << bit)), 31 - bit);
+			return _mm256_xor_ps(value, _mm256_castsi256_ps(sign));
+		}
+
+		__m256 Grad3Lanes(__m256i h, __m256 x, __m256 y, __m256 z)
+		{
+			h = _mm256_and_si256(h, _mm256_set1_epi32(15));
+			__m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+			__m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+			__m256 useX = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+			__m256 u = _mm256_blendv_ps(y, x, below8);
+			__m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, useX), y, below4);
+			return _mm256_add_ps(FlipLanes(u, h, 0), FlipLanes(v, h, 1));
+		}
+
+		__m256 Grad2Lanes(__m256i h, __m256 x, __m256 y)
+		{
+			h = _mm256_and_si256(h, _mm256_set1_epi32(7));
+			__m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+			__m256 u = _mm256_blendv_ps(y, x, below4);
+			__m256 v = _mm256_blendv_ps(x, y, below4);
+			return _mm256_add_ps(FlipLanes(u, h, 0), FlipLanes(_mm256_mul_ps(_mm256_set1_ps(2.0f), v), h, 1));
+		}
+
+		__m256 GradientLanes(__m256 x, __m256 y, __m256 z, __m256i seed)
+		{
+			__m256 fx = _mm256_floor_ps(x);
+			__m256 fy = _mm256_floor_ps(y);
+			__m256 fz = _mm256_floor_ps(z);
+			__m256i px0 = _mm256_mullo_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(static_cast<int>(PRIME_X)));
+			__m256i py0 = _mm256_mullo_epi32(_mm256_cvttps_epi32(fy), _mm256_set1_epi32(static_cast<int>(PRIME_Y)));
+			__m256i pz0 = _mm256_mullo_epi32(_mm256_cvttps_epi32(fz), _mm256_set1_epi32(static_cast<int>(PRIME_Z)));
+			__m256i px1 = _mm256_add_epi32(px0, _mm256_set1_epi32(static_cast<int>(PRIME_X)));
+			__m256i py1 = _mm256_add_epi32(py0, _mm256_set1_epi32(static_cast<int>(PRIME_Y)));
+			__m256i pz1 = _mm256_add_epi32(pz0, _mm256_set1_epi32(static_cast<int>(PRIME_Z)));
+			__m256 one = _mm256_set1_ps(1.0f);
+			__m256 x0 = _mm256_sub_ps(x, fx);
+			__m256 y0 = _mm256_sub_ps(y, fy);
+			__m256 z0 = _mm256_sub_ps(z, fz);
+			__m256 x1 = _mm256_sub_ps(x0, one);
+			__m256 y1 = _mm256_sub_ps(y0, one);
+			__m256 z1 = _mm256_sub_ps(z0, one);
+			__m256 u = FadeLanes(x0);
+			__m256 v = FadeLanes(y0);
+			__m256 w = FadeLanes(z0);
+
+			__m256 a = LerpLanes(Grad3Lanes(HashLanes(px0, py0, pz0, seed), x0, y0, z0), Grad3Lanes(HashLanes(px1, py0, pz0, seed), x1, y0, z0), u);
+			__m256 b = LerpLanes(Grad3Lanes(HashLanes(px0, py1, pz0, seed), x0, y1, z0), Grad3Lanes(HashLanes(px1, py1, pz0, seed), x1, y1, z0), u);
+			__m256 c = LerpLanes(Grad3Lanes(HashLanes(px0, py0, pz1, seed), x0, y0, z1), Grad3Lanes(HashLanes(px1, py0, pz1, seed), x1, y0, z1), u);
+			__m256 d = LerpLanes(Grad3Lanes(HashLanes(px0, py1, pz1, seed), x0, y1, z1), Grad3Lanes(HashLanes(px1, py1, pz1, seed), x1, y1, z1), u);
+			return LerpLanes(LerpLanes(a, b, v), LerpLanes(c, d, v), w);
+		}
+
+		__m256 SimplexCornerLanes(__m256i h, __m256 x, __m256 y)
+		{
+			__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+			t = _mm256_max_ps(t, _mm256_setzero_ps());
+			t = _mm256_mul_ps(t, t);
+			return _mm256_mul_ps(_mm256_mul_ps(t, t), Grad2Lanes(h, x, y));
+		}
+
+		__m256 SimplexLanes(__m256 x, __m256 y, __m256i seed)
+		{
+			__m256 s = _mm256_mul_ps(_mm256_add_ps(x, y), _mm256_set1_ps(SIMPLEX_F2));
+			__m256 i = _mm256_floor_ps(_mm256_add_ps(x, s));
+			__m256 j = _mm256_floor_ps(_mm256_add_ps(y, s));
+			__m256 t = _mm256_mul_ps(_mm256_add_ps(i, j), _mm256_set1_ps(SIMPLEX_G2));
+			__m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(i, t));
+			__m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(j, t));
+			__m256 lower = _mm256_cmp_ps(x0, y0, _CMP_GT_OQ);
+			__m256 one = _mm256_set1_ps(1.0f);
+			__m256 i1 = _mm256_and_ps(lower, one);
+			__m256 j1 = _mm256_sub_ps(one, i1);
+			__m256 g2 = _mm256_set1_ps(SIMPLEX_G2);
+			__m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), g2);
+			__m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, j1), g2);
+			__m256 corner = _mm256_set1_ps(-1.0f + 2.0f * SIMPLEX_G2);
+			__m256 x2 = _mm256_add_ps(x0, corner);
+			__m256 y2 = _mm256_add_ps(y0, corner);
+
+			__m256i primeX = _mm256_set1_epi32(static_cast<int>(PRIME_X));
+			__m256i primeY = _mm256_set1_epi32(static_cast<int>(PRIME_Y));
+			__m256i pi = _mm256_mullo_epi32(_mm256_cvttps_epi32(i), primeX);
+			__m256i pj = _mm256_mullo_epi32(_mm256_cvttps_epi32(j), primeY);
+			__m256i zero = _mm256_setzero_si256();
+			__m256i stepX = _mm256_and_si256(_mm256_castps_si256(lower), primeX);
+			__m256i stepY = _mm256_andnot_si256(_mm256_castps_si256(lower), primeY);
+			__m256i h0 = HashLanes(pi, pj, zero, seed);
+			__m256i h1 = HashLanes(_mm256_add_epi32(pi, stepX), _mm256_add_epi32(pj, stepY), zero, seed);
+			__m256i h2 = HashLanes(_mm256_add_epi32(pi, primeX), _mm256_add_epi32(pj, primeY), zero, seed);
+			__m256 sum = _mm256_add_ps(_mm256_add_ps(SimplexCornerLanes(h0, x0, y0), SimplexCornerLanes(h1, x1, y1)), SimplexCornerLanes(h2, x2, y2));
+			return _mm256_mul_ps(sum, _mm256_set1_ps(SIMPLEX_SCALE));
+		}
+
+		__m256 FbmGradientLanes(__m256 x, __m256 y, __m256 z, ui32 seed, const NoiseOctaves& octaves)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			float amplitude = 1.0f;
+			float total = 0.0f;
+			float frequency = octaves.frequency;
+			for (ui32 i = 0;i < octaves.count;i++) {
+				__m256 f = _mm256_set1_ps(frequency);
+				__m256 n = GradientLanes(_mm256_mul_ps(x, f), _mm256_mul_ps(y, f), _mm256_mul_ps(z, f), _mm256_set1_epi32(static_cast<int>(seed + i)));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+				total += amplitude;
+				amplitude *= octaves.gain;
+				frequency *= octaves.lacunarity;
+			}
+			return total > 0.0f ? _mm256_mul_ps(sum, _mm256_set1_ps(1.0f / total)) : sum;
+		}
+
+		__m256 FbmSimplexLanes(__m256 x, __m256 y, ui32 seed, const NoiseOctaves& octaves)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			float amplitude = 1.0f;
+			float total = 0.0f;
+			float frequency = octaves.frequency;
+			for (ui32 i = 0;i < octaves.count;i++) {
+				__m256 f = _mm256_set1_ps(frequency);
+				__m256 n = SimplexLanes(_mm256_mul_ps(x, f), _mm256_mul_ps(y, f), _mm256_set1_epi32(static_cast<int>(seed + i)));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+				total += amplitude;
+				amplitude *= octaves.gain;
+				frequency *= octaves.lacunarity;
+			}
+			return total > 0.0f ? _mm256_mul_ps(sum, _mm256_set1_ps(1.0f / total)) : sum;
+		}
+#endif
+
+		float FbmGradientAt(float x, float y, float z, ui32 seed, const NoiseOctaves& octaves)
+		{
+			float sum = 0.0f;
+			float amplitude = 1.0f;
+			float total = 0.0f;
+			float frequency = octaves.frequency;
+			for (ui32 i = 0;i < octaves.count;i++) {
+				sum += GradientAt(x * frequency, y * frequency, z * frequency, seed + i) * amplitude;
+				total += amplitude;
+				amplitude *= octaves.gain;
+				frequency *= octaves.lacunarity;
+			}
+			return total > 0.0f ? sum * (1.0f / total) : sum;
+		}
+
+		float FbmSimplexAt(float x, float y, ui32 seed, const NoiseOctaves& octaves)
+		{
+			float sum = 0.0f;
+			float amplitude = 1.0f;
+			float total = 0.0f;
+			float frequency = octaves.frequency;
+			for (ui32 i = 0;i < octaves.count;i++) {
+				sum += SimplexAt(x * frequency, y * frequency, seed + i) * amplitude;
+				total += amplitude;
+				amplitude *= octaves.gain;
+				frequency *= octaves.lacunarity;
+			}
+			return total > 0.0f ? sum * (1.0f / total) : sum;
+		}
+	}
+
+	Noise::Noise(ui32 seed) : seed{ seed }
+	{
+
+	}
+
+	float Noise::Gradient(const glm::vec3& p) const
+	{
+		return GradientAt(p.x, p.y, p.z, seed);
+	}
+
+	float Noise::Simplex(const glm::vec2& p) const
+	{
+		return SimplexAt(p.x, p.y, seed);
+	}
+
+	float Noise::FbmGradient(const glm::vec3& p, const NoiseOctaves& octaves) const
+	{
+		return FbmGradientAt(p.x, p.y, p.z, seed, octaves);
+	}
+
+	float Noise::FbmSimplex(const glm::vec2& p, const NoiseOctaves& octaves) const
+	{
+		return FbmSimplexAt(p.x, p.y, seed, octaves);
+	}
+
+	float Noise::WarpSimplex(const glm::vec2& p, const NoiseOctaves& octaves, const NoiseOctaves& warp, float strength) const
+	{
+		float wx = FbmSimplexAt(p.x, p.y, seed + WARP_SEED_X, warp);
+		float wy = FbmSimplexAt(p.x + WARP_OFFSET_X, p.y + WARP_OFFSET_Y, seed + WARP_SEED_Y, warp);
+		return FbmSimplexAt(p.x + wx * strength, p.y + wy * strength, seed, octaves);
+	}
+
+	void Noise::Gradient(const float* x, const float* y, const float* z, float* out, ui32 count) const
+	{
+		ui32 i = 0;
+#ifdef LUXEL_SIMD_AVX2
+		__m256i lanesSeed = _mm256_set1_epi32(static_cast<int>(seed));
+		for (;i + NOISE_LANES <= count;i += NOISE_LANES) {
+			_mm256_storeu_ps(out + i, GradientLanes(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i), lanesSeed));
+		}
+#endif
+		for (;i < count;i++) {
+			out[i] = GradientAt(x[i], y[i], z[i], seed);
+		}
+	}
+
+	void Noise::Simplex(const float* x, const float* y, float* out, ui32 count) const
+	{
+		ui32 i = 0;
+#ifdef LUXEL_SIMD_AVX2
+		__m256i lanesSeed = _mm256_set1_epi32(static_cast<int>(seed));
+		for (;i + NOISE_LANES <= count;i += NOISE_LANES) {
+			_mm256_storeu_ps(out + i, SimplexLanes(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), lanesSeed));
+		}
+#endif
+		for (;i < count;i++) {
+			out[i] = SimplexAt(x[i], y[i], seed);
+		}
+	}
+
+	void Noise::FbmGradient(const float* x, const float* y, const float* z, float* out, ui32 count, const NoiseOctaves& octaves) const
+	{
+		ui32 i = 0;
+#ifdef LUXEL_SIMD_AVX2
+		for (;i + NOISE_LANES <= count;i += NOISE_LANES) {
+			_mm256_storeu_ps(out + i, FbmGradientLanes(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i), seed, octaves));
+		}
+#endif
+		for (;i < count;i++) {
+			out[i] = FbmGradientAt(x[i], y[i], z[i], seed, octaves);
+		}
+	}
+
+	void Noise::FbmSimplex(const float* x, const float* y, float* out, ui32 count, const NoiseOctaves& octaves) const
+	{
+		ui32 i = 0;
+#ifdef LUXEL_SIMD_AVX2
+		for (;i + NOISE_LANES <= count;i += NOISE_LANES) {
+			_mm256_storeu_ps(out + i, FbmSimplexLanes(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), seed, octaves));
+		}
+#endif
+		for (;i < count;i++) {
+			out[i] = FbmSimplexAt(x[i], y[i], seed, octaves);
+		}
+	}
+
+	void Noise::WarpSimplex(const float* x, const float* y, float* out, ui32 count, const NoiseOctaves& octaves, const NoiseOctaves& warp, float strength) const
+	{
+		ui32 i = 0;
+#ifdef LUXEL_SIMD_AVX2
+		__m256 lanesStrength = _mm256_set1_ps(strength);
+		for (;i + NOISE_LANES <= count;i += NOISE_LANES) {
+			__m256 px = _mm256_loadu_ps(x + i);
+			__m256 py = _mm256_loadu_ps(y + i);
+			__m256 wx = FbmSimplexLanes(px, py, seed + WARP_SEED_X, warp);
+			__m256 wy = FbmSimplexLanes(_mm256_add_ps(px, _mm256_set1_ps(WARP_OFFSET_X)), _mm256_add_ps(py, _mm256_set1_ps(WARP_OFFSET_Y)), seed + WARP_SEED_Y, warp);
+			px = _mm256_add_ps(px, _mm256_mul_ps(wx, lanesStrength));
+			py = _mm256_add_ps(py, _mm256_mul_ps(wy, lanesStrength));
+			_mm256_storeu_ps(out + i, FbmSimplexLanes(px, py, seed, octaves));
+		}
+#endif
+		for (;i < count;i++) {
+			out[i] = WarpSimplex(glm::vec2(x[i], y[i]), octaves, warp, strength);
+		}
+	}
+
+	ui32 Noise::GetSeed() const
+	{
+		return seed;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+// points evaluated together by the batch functions, one AVX2 register of floats.
+#define NOISE_LANES 8
+
+namespace Luxel
+{
+	struct NoiseOctaves
+	{
+		ui32 count = 5;
+		float frequency = 1.0f;
+		float lacunarity = 2.0f;
+		float gain = 0.5f;
+	};
+
+	// seeded gradient (Perlin) and simplex noise, roughly in [-1, 1]. lattice points are hashed
+	// instead of looked up in a permutation table, so the batch functions need no gathers and run
+	// NOISE_LANES points per instruction with AVX2; the scalar versions compute the same values.
+	// every octave of an fBm uses its own seed.
+	class LUXEL_API Noise
+	{
+	public:
+		Noise(ui32 seed = 0);
+
+		float Gradient(const glm::vec3& p) const;
+		float Simplex(const glm::vec2& p) const;
+		float FbmGradient(const glm::vec3& p, const NoiseOctaves& octaves) const;
+		float FbmSimplex(const glm::vec2& p, const NoiseOctaves& octaves) const;
+		// simplex fBm at p moved by strength times two more fBms of warp.
+		float WarpSimplex(const glm::vec2& p, const NoiseOctaves& octaves, const NoiseOctaves& warp, float strength) const;
+
+		// count points with coordinates in separate arrays, any count works.
+		void Gradient(const float* x, const float* y, const float* z, float* out, ui32 count) const;
+		void Simplex(const float* x, const float* y, float* out, ui32 count) const;
+		void FbmGradient(const float* x, const float* y, const float* z, float* out, ui32 count, const NoiseOctaves& octaves) const;
+		void FbmSimplex(const float* x, const float* y, float* out, ui32 count, const NoiseOctaves& octaves) const;
+		void WarpSimplex(const float* x, const float* y, float* out, ui32 count, const NoiseOctaves& octaves, const NoiseOctaves& warp, float strength) const;
+
+		ui32 GetSeed() const;
+
+	private:
+		ui32 seed;
+	};
+}
@@ -0,0 +1,210 @@
+#include "pch.h"
+
+#include "TerrainGenerator.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 CHUNKS_PER_JOB = 1;
+		constexpr ui32 COLUMNS = CHUNK_SIZE * CHUNK_SIZE;
+	}
+
+	TerrainGenerator::TerrainGenerator(VoxelWorld* const w, const TerrainSettings& settings) : world{ w }, settings{ settings }, noise{ settings.seed }
+	{
+
+	}
+
+	TerrainGenerator::~TerrainGenerator()
+	{
+
+	}
+
+	bool TerrainGenerator::Generate(const ChunkCoord& coord, Chunk& chunk) const
+	{
+		glm::ivec3 origin = ChunkOrigin(coord);
+		std::array<float, COLUMNS> columnX;
+		std::array<float, COLUMNS> columnZ;
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+				columnX[x + z * CHUNK_SIZE] = static_cast<float>(origin.x + static_cast<int>(x));
+				columnZ[x + z * CHUNK_SIZE] = static_cast<float>(origin.z + static_cast<int>(z));
+			}
+		}
+		std::array<float, COLUMNS> heights;
+		noise.WarpSimplex(columnX.data(), columnZ.data(), heights.data(), COLUMNS, settings.height, settings.warp, settings.warpStrength);
+
+		// highest solid y of each column, and of each row of columns
+		std::array<int, COLUMNS> tops;
+		std::array<int, CHUNK_SIZE> rowTops;
+		rowTops.fill(std::numeric_limits<int>::min());
+		for (ui32 i = 0;i < COLUMNS;i++) {
+			tops[i] = static_cast<int>(std::floor(settings.baseHeight + settings.heightScale * heights[i]));
+			rowTops[i / CHUNK_SIZE] = std::max(rowTops[i / CHUNK_SIZE], tops[i]);
+		}
+		if (*std::max_element(rowTops.begin(), rowTops.end()) < origin.y) {
+			return false;
+		}
+
+		std::vector<ui32> packed(CHUNK_VOLUME, 0);
+		std::array<float, CHUNK_SIZE> rowX;
+		std::array<float, CHUNK_SIZE> rowY;
+		std::array<float, CHUNK_SIZE> rowZ;
+		std::array<float, CHUNK_SIZE> caves;
+		for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+			rowX[x] = columnX[x];
+		}
+		ui32 pack[3] = { settings.grass.Pack(), settings.soil.Pack(), settings.stone.Pack() };
+		bool solid = false;
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 y = 0;y < CHUNK_SIZE;y++) {
+				int worldY = origin.y + static_cast<int>(y);
+				if (worldY > rowTops[z]) {
+					break;
+				}
+				rowY.fill(static_cast<float>(worldY));
+				rowZ.fill(static_cast<float>(origin.z + static_cast<int>(z)));
+				if (settings.caves.count != 0) {
+					noise.FbmGradient(rowX.data(), rowY.data(), rowZ.data(), caves.data(), CHUNK_SIZE, settings.caves);
+				}
+				else {
+					caves.fill(0.0f);
+				}
+				for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+					int depth = tops[x + z * CHUNK_SIZE] - worldY;
+					if (depth < 0 || caves[x] > settings.caveThreshold) {
+						continue;
+					}
+					ui32 layer = depth == 0 ? 0 : (depth < static_cast<int>(settings.soilDepth) ? 1 : 2);
+					packed[MortonEncode(x, y, z)] = pack[layer];
+					solid = true;
+				}
+			}
+		}
+		if (!solid) {
+			return false;
+		}
+		chunk.Load(packed.data());
+		return true;
+	}
+
+	ui32 TerrainGenerator::Generate(const std::vector<ChunkCoord>& coords)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		// chunks the world already holds were built in or restored before the generator got there
+		std::vector<bool> held(coords.size());
+		EpochGuard guard;
+		for (size_t i = 0;i < coords.size();i++) {
+			held[i] = world->GetChunk(coords[i]) != nullptr;
+		}
+		std::vector<std::unique_ptr<Chunk>> chunks(coords.size());
+		JobSystem::ParallelFor(static_cast<ui32>(coords.size()), CHUNKS_PER_JOB, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				if (held[i]) {
+					continue;
+				}
+				auto chunk = std::make_unique<Chunk>();
+				if (Generate(coords[i], *chunk)) {
+					chunks[i] = std::move(chunk);
+				}
+			}
+		});
+
+		stats.generated = 0;
+		stats.empty = 0;
+		stats.skipped = 0;
+		for (size_t i = 0;i < coords.size();i++) {
+			if (held[i]) {
+				generated[coords[i]] = 0;
+				stats.skipped++;
+				continue;
+			}
+			if (chunks[i] == nullptr) {
+				generated[coords[i]] = 0;
+				stats.empty++;
+				continue;
+			}
+			// a chunk inserted since the check wins, it is never overwritten and never unloaded either
+			Chunk* chunk = world->TryInsertChunk(coords[i], std::move(chunks[i]));
+			if (chunk == nullptr) {
+				generated[coords[i]] = 0;
+				stats.skipped++;
+				continue;
+			}
+			generated[coords[i]] = chunk->GetRevision();
+			stats.generated++;
+		}
+		stats.generateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats.generated;
+	}
+
+	void TerrainGenerator::Stream(const glm::vec3& center, float loadDistance, float unloadDistance, ui32 maxChunks)
+	{
+		ui32 unloaded = 0;
+		for (auto it = generated.begin();it != generated.end();) {
+			if (Distance(it->first, center) <= unloadDistance) {
+				++it;
+				continue;
+			}
+			bool keep = false;
+			if (it->second != 0) {
+				EpochGuard guard;
+				const Chunk* chunk = world->GetChunk(it->first);
+				// edited chunks stay, and so do chunks someone else took out of the world
+				keep = chunk == nullptr || chunk->GetRevision() != it->second;
+				if (!keep) {
+					world->RemoveChunk(it->first);
+					unloaded++;
+				}
+			}
+			it = keep ? std::next(it) : generated.erase(it);
+		}
+
+		// nothing but air above the highest possible surface
+		glm::ivec3 low = ToChunkCoord(glm::ivec3(glm::floor(center - loadDistance)));
+		glm::ivec3 high = ToChunkCoord(glm::ivec3(glm::floor(center + loadDistance)));
+		high.y = std::min(high.y, ToChunkCoord(glm::ivec3(0, static_cast<int>(std::ceil(settings.baseHeight + settings.heightScale)), 0)).y);
+		std::vector<std::pair<float, ChunkCoord>> missing;
+		for (int z = low.z;z <= high.z;z++) {
+			for (int y = low.y;y <= high.y;y++) {
+				for (int x = low.x;x <= high.x;x++) {
+					ChunkCoord coord(x, y, z);
+					float distance = Distance(coord, center);
+					if (distance <= loadDistance && generated.find(coord) == generated.end()) {
+						missing.emplace_back(distance, coord);
+					}
+				}
+			}
+		}
+		std::sort(missing.begin(), missing.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		std::vector<ChunkCoord> coords;
+		for (size_t i = 0;i < missing.size() && i < maxChunks;i++) {
+			coords.push_back(missing[i].second);
+		}
+		Generate(coords);
+		stats.unloaded = unloaded;
+		stats.pending = static_cast<ui32>(missing.size() - coords.size());
+	}
+
+	float TerrainGenerator::GetHeight(float x, float z) const
+	{
+		return settings.baseHeight + settings.heightScale * noise.WarpSimplex(glm::vec2(x, z), settings.height, settings.warp, settings.warpStrength);
+	}
+
+	const TerrainSettings& TerrainGenerator::GetSettings() const
+	{
+		return settings;
+	}
+
+	const TerrainStats& TerrainGenerator::GetStats() const
+	{
+		return stats;
+	}
+
+	float TerrainGenerator::Distance(const ChunkCoord& coord, const glm::vec3& center)
+	{
+		glm::vec3 chunkCenter = glm::vec3(ChunkOrigin(coord)) + glm::vec3(CHUNK_SIZE * 0.5f);
+		return glm::length(chunkCenter - center);
+	}
+}
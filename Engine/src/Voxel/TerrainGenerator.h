@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+#include "Noise.h"
+
+namespace Luxel
+{
+	struct TerrainSettings
+	{
+		ui32 seed = 1337;
+		// the surface lies heightScale voxels around baseHeight, following a domain warped simplex fBm
+		float baseHeight = 48.0f;
+		float heightScale = 64.0f;
+		NoiseOctaves height = { 6, 1.0f / 512.0f, 2.0f, 0.5f };
+		NoiseOctaves warp = { 3, 1.0f / 1024.0f, 2.0f, 0.5f };
+		// in voxels
+		float warpStrength = 128.0f;
+		// below the surface, voxels where the gradient fBm exceeds caveThreshold are carved out
+		NoiseOctaves caves = { 2, 1.0f / 64.0f, 2.0f, 0.5f };
+		float caveThreshold = 0.3f;
+		ui32 soilDepth = 4;
+		Voxel grass = { 1, Voxel::PackColor(glm::vec3(0.32f, 0.55f, 0.22f)) };
+		Voxel soil = { 2, Voxel::PackColor(glm::vec3(0.45f, 0.32f, 0.2f)) };
+		Voxel stone = { 3, Voxel::PackColor(glm::vec3(0.5f, 0.5f, 0.52f)) };
+	};
+
+	struct TerrainStats
+	{
+		// of the last Generate or Stream
+		ui32 generated = 0;
+		ui32 empty = 0;
+		// coords the world already held a chunk at
+		ui32 skipped = 0;
+		ui32 unloaded = 0;
+		// chunks within the load distance still waiting for a Stream
+		ui32 pending = 0;
+		double generateMilliseconds = 0.0;
+	};
+
+	// procedural terrain written straight into chunks. heights are evaluated a row of columns at a time
+	// and caves a row of voxels at a time through the batch functions of Noise, chunks in parallel on the workers.
+	class LUXEL_API TerrainGenerator
+	{
+	public:
+		TerrainGenerator(VoxelWorld* const w, const TerrainSettings& settings = TerrainSettings());
+		~TerrainGenerator();
+		TerrainGenerator(const TerrainGenerator&) = delete;
+		void operator=(const TerrainGenerator&) = delete;
+
+		// writes the terrain of coord into chunk, false when it is all air and chunk was left alone.
+		bool Generate(const ChunkCoord& coord, Chunk& chunk) const;
+		// generates the chunks on the workers and inserts those holding solid voxels, returns how many.
+		// coords the world holds a chunk at, already or by the time the result is inserted, are left alone.
+		ui32 Generate(const std::vector<ChunkCoord>& coords);
+		// generates up to maxChunks missing chunks within loadDistance voxels of center, nearest first.
+		// generated chunks farther than unloadDistance are removed again unless they were edited since,
+		// and come back the same when the camera returns.
+		void Stream(const glm::vec3& center, float loadDistance, float unloadDistance, ui32 maxChunks);
+
+		float GetHeight(float x, float z) const;
+		const TerrainSettings& GetSettings() const;
+		const TerrainStats& GetStats() const;
+
+	private:
+		static float Distance(const ChunkCoord& coord, const glm::vec3& center);
+
+		VoxelWorld* const world;
+		TerrainSettings settings;
+		Noise noise;
+		// revision the chunk was inserted at, 0 for chunks that came out empty or were already in the world
+		std::unordered_map<ChunkCoord, ui64, ChunkCoordHash> generated;
+		TerrainStats stats;
+	};
+}
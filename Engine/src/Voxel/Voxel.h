@@ -0,0 +1,79 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#define CHUNK_SIZE_LOG2 5
+#define CHUNK_SIZE 32
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+
+#define BRICK_SIZE_LOG2 3
+#define BRICK_SIZE 8
+#define BRICKS_PER_AXIS (CHUNK_SIZE / BRICK_SIZE)
+#define BRICK_COUNT (BRICKS_PER_AXIS * BRICKS_PER_AXIS * BRICKS_PER_AXIS)
+#define BRICK_VOLUME (BRICK_SIZE * BRICK_SIZE * BRICK_SIZE)
+
+namespace Luxel
+{
+	// material 0 is air, color is packed as RGB565.
+	struct Voxel
+	{
+		ui16 material = 0;
+		ui16 color = 0;
+
+		bool IsEmpty() const { return material == 0; }
+		ui32 Pack() const { return static_cast<ui32>(material) | (static_cast<ui32>(color) << 16); }
+
+		static Voxel Unpack(ui32 packed) { return Voxel{ static_cast<ui16>(packed & 0xFFFF), static_cast<ui16>(packed >> 16) }; }
+
+		static ui16 PackColor(const glm::vec3& rgb)
+		{
+			glm::vec3 c = glm::clamp(rgb, 0.f, 1.f);
+			ui16 r = static_cast<ui16>(c.x * 31.f + 0.5f);
+			ui16 g = static_cast<ui16>(c.y * 63.f + 0.5f);
+			ui16 b = static_cast<ui16>(c.z * 31.f + 0.5f);
+			return static_cast<ui16>((r << 11) | (g << 5) | b);
+		}
+
+		static glm::vec3 UnpackColor(ui16 color)
+		{
+			return glm::vec3(
+				static_cast<float>((color >> 11) & 31) / 31.f,
+				static_cast<float>((color >> 5) & 63) / 63.f,
+				static_cast<float>(color & 31) / 31.f);
+		}
+
+		bool operator==(const Voxel& other) const { return material == other.material && color == other.color; }
+		bool operator!=(const Voxel& other) const { return !(*this == other); }
+	};
+
+	using ChunkCoord = glm::ivec3;
+
+	struct ChunkCoordHash
+	{
+		size_t operator()(const ChunkCoord& c) const
+		{
+			ui64 h = static_cast<ui64>(static_cast<ui32>(c.x)) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<ui64>(static_cast<ui32>(c.y)) * 0xC2B2AE3D27D4EB4Full;
+			h ^= static_cast<ui64>(static_cast<ui32>(c.z)) * 0x165667B19E3779F9ull;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+	};
+
+	// world voxel position -> owning chunk and position inside it (floors for negatives).
+	inline ChunkCoord ToChunkCoord(const glm::ivec3& p)
+	{
+		return ChunkCoord(p.x >> CHUNK_SIZE_LOG2, p.y >> CHUNK_SIZE_LOG2, p.z >> CHUNK_SIZE_LOG2);
+	}
+
+	inline glm::ivec3 ToLocalCoord(const glm::ivec3& p)
+	{
+		return glm::ivec3(p.x & (CHUNK_SIZE - 1), p.y & (CHUNK_SIZE - 1), p.z & (CHUNK_SIZE - 1));
+	}
+
+	inline glm::ivec3 ChunkOrigin(const ChunkCoord& c)
+	{
+		return c * CHUNK_SIZE;
+	}
+}
@@ -0,0 +1,169 @@
+#include "pch.h"
+
+#include "VoxelColdStorage.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 CHUNKS_PER_JOB = 4;
+	}
+
+	VoxelColdStorage::VoxelColdStorage(VoxelWorld* const w) : world{ w }
+	{
+
+	}
+
+	VoxelColdStorage::~VoxelColdStorage()
+	{
+		Clear();
+	}
+
+	ui32 VoxelColdStorage::Evict(const std::vector<ChunkCoord>& coords)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		// keeps the sources alive for the workers too
+		EpochGuard guard;
+		std::vector<ChunkCoord> resident;
+		std::vector<const Chunk*> sources;
+		// cold chunks already at the coord, the world chunk was created there after they went cold
+		std::vector<const ColumnChunk*> previous;
+		for (const auto& coord : coords) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk != nullptr) {
+				resident.push_back(coord);
+				sources.push_back(chunk);
+				previous.push_back(Get(coord));
+			}
+		}
+
+		std::vector<std::unique_ptr<ColumnChunk>> encoded(resident.size());
+		JobSystem::ParallelFor(static_cast<ui32>(resident.size()), CHUNKS_PER_JOB, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				encoded[i] = std::make_unique<ColumnChunk>();
+				if (previous[i] == nullptr) {
+					encoded[i]->Encode(*sources[i]);
+					continue;
+				}
+				// the newer world voxels go over the cold ones
+				Chunk merged;
+				previous[i]->Decode(merged);
+				merged.Merge(*sources[i]);
+				encoded[i]->Encode(merged);
+			}
+		});
+
+		for (size_t i = 0;i < resident.size();i++) {
+			world->RemoveChunk(resident[i]);
+			chunks[resident[i]] = std::move(encoded[i]);
+		}
+		UpdateSizes();
+		stats.evicted = static_cast<ui32>(resident.size());
+		stats.evictMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats.evicted;
+	}
+
+	ui32 VoxelColdStorage::Restore(const std::vector<ChunkCoord>& coords)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<ChunkCoord> cold;
+		std::vector<const ColumnChunk*> sources;
+		for (const auto& coord : coords) {
+			auto it = chunks.find(coord);
+			if (it != chunks.end()) {
+				cold.push_back(coord);
+				sources.push_back(it->second.get());
+			}
+		}
+
+		std::vector<std::unique_ptr<Chunk>> decoded(cold.size());
+		JobSystem::ParallelFor(static_cast<ui32>(cold.size()), CHUNKS_PER_JOB, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				decoded[i] = std::make_unique<Chunk>();
+				sources[i]->Decode(*decoded[i]);
+			}
+		});
+
+		for (size_t i = 0;i < cold.size();i++) {
+			chunks.erase(cold[i]);
+			// cold edits may have emptied the chunk, the world only keeps chunks with solid voxels
+			if (decoded[i]->IsEmpty()) {
+				continue;
+			}
+			// a chunk created at the coord while it was cold holds newer voxels, the cold ones only fill its air
+			world->MergeChunk(cold[i], std::move(decoded[i]), true);
+		}
+		UpdateSizes();
+		stats.restored = static_cast<ui32>(cold.size());
+		stats.restoreMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats.restored;
+	}
+
+	void VoxelColdStorage::Stream(const glm::vec3& center, float evictDistance, float restoreDistance)
+	{
+		std::vector<ChunkCoord> evict;
+		for (const auto& coord : world->GetChunkCoords()) {
+			if (Distance(coord, center) > evictDistance) {
+				evict.push_back(coord);
+			}
+		}
+		std::vector<ChunkCoord> restore;
+		for (const auto& [coord, chunk] : chunks) {
+			if (Distance(coord, center) <= restoreDistance) {
+				restore.push_back(coord);
+			}
+		}
+		Evict(evict);
+		Restore(restore);
+	}
+
+	ColumnChunk* VoxelColdStorage::Get(const ChunkCoord& coord)
+	{
+		auto it = chunks.find(coord);
+		return it == chunks.end() ? nullptr : it->second.get();
+	}
+
+	const ColumnChunk* VoxelColdStorage::Get(const ChunkCoord& coord) const
+	{
+		auto it = chunks.find(coord);
+		return it == chunks.end() ? nullptr : it->second.get();
+	}
+
+	std::vector<ChunkCoord> VoxelColdStorage::GetCoords() const
+	{
+		std::vector<ChunkCoord> coords;
+		coords.reserve(chunks.size());
+		for (const auto& [coord, chunk] : chunks) {
+			coords.push_back(coord);
+		}
+		return coords;
+	}
+
+	void VoxelColdStorage::Clear()
+	{
+		chunks.clear();
+		stats.coldChunks = 0;
+		stats.coldBytes = 0;
+	}
+
+	const VoxelColdStorageStats& VoxelColdStorage::GetStats() const
+	{
+		return stats;
+	}
+
+	void VoxelColdStorage::UpdateSizes()
+	{
+		// summed again since cold chunks may have been edited in place through Get
+		stats.coldChunks = static_cast<ui32>(chunks.size());
+		stats.coldBytes = 0;
+		for (const auto& [coord, chunk] : chunks) {
+			stats.coldBytes += chunk->GetMemoryUsage();
+		}
+	}
+
+	float VoxelColdStorage::Distance(const ChunkCoord& coord, const glm::vec3& center)
+	{
+		glm::vec3 chunkCenter = glm::vec3(ChunkOrigin(coord)) + glm::vec3(CHUNK_SIZE * 0.5f);
+		return glm::length(chunkCenter - center);
+	}
+}
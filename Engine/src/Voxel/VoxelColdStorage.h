@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "VoxelWorld.h"
+#include "ColumnChunk.h"
+
+namespace Luxel
+{
+	struct VoxelColdStorageStats
+	{
+		// as of the last Evict or Restore
+		ui32 coldChunks = 0;
+		size_t coldBytes = 0;
+		ui32 evicted = 0;
+		ui32 restored = 0;
+		double evictMilliseconds = 0.0;
+		double restoreMilliseconds = 0.0;
+	};
+
+	// chunks streamed out of a VoxelWorld, kept run length encoded per column until they are needed again.
+	// encoding and decoding run on the workers; the chunks involved must not be edited meanwhile.
+	class LUXEL_API VoxelColdStorage
+	{
+	public:
+		VoxelColdStorage(VoxelWorld* const w);
+		~VoxelColdStorage();
+		VoxelColdStorage(const VoxelColdStorage&) = delete;
+		void operator=(const VoxelColdStorage&) = delete;
+
+		// encodes the chunks and removes them from the world, returns how many were evicted. a chunk that is
+		// already cold is merged with the world one, the world voxels win.
+		ui32 Evict(const std::vector<ChunkCoord>& coords);
+		// decodes the chunks back into the world, returns how many were restored. a world chunk created at
+		// the coord meanwhile is merged with the cold one, its voxels win.
+		ui32 Restore(const std::vector<ChunkCoord>& coords);
+		// chunks farther than evictDistance voxels from center go cold, cold chunks within restoreDistance come back.
+		// restoreDistance below evictDistance keeps chunks near the boundary from going back and forth.
+		void Stream(const glm::vec3& center, float evictDistance, float restoreDistance);
+
+		// cold reads and edits without a round trip through the world, nullptr when coord is not cold.
+		ColumnChunk* Get(const ChunkCoord& coord);
+		const ColumnChunk* Get(const ChunkCoord& coord) const;
+		std::vector<ChunkCoord> GetCoords() const;
+		void Clear();
+
+		const VoxelColdStorageStats& GetStats() const;
+
+	private:
+		void UpdateSizes();
+		static float Distance(const ChunkCoord& coord, const glm::vec3& center);
+
+		VoxelWorld* const world;
+		std::unordered_map<ChunkCoord, std::unique_ptr<ColumnChunk>, ChunkCoordHash> chunks;
+		VoxelColdStorageStats stats;
+	};
+}
@@ -0,0 +1,480 @@
+#include "pch.h"
+
+#include "VoxelConnectivity.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui16 LOCAL_NONE = 0xFFFF;
+		constexpr ui32 CHUNKS_PER_JOB = 1;
+
+		ui32 Linear(ui32 x, ui32 y, ui32 z)
+		{
+			return x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE;
+		}
+
+		bool Inside(const glm::ivec3& p, const glm::ivec3& min, const glm::ivec3& max)
+		{
+			return p.x >= min.x && p.y >= min.y && p.z >= min.z && p.x <= max.x && p.y <= max.y && p.z <= max.z;
+		}
+
+		void Extend(glm::ivec3& min, glm::ivec3& max, const glm::ivec3& p)
+		{
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+
+		// remembers the last chunk, fills mostly step within one. the caller holds an EpochGuard.
+		class VoxelReader
+		{
+		public:
+			explicit VoxelReader(const VoxelWorld* world) : world{ world }, lastCoord{ 0 }, last{ nullptr }, valid{ false } { }
+
+			bool IsSolid(const glm::ivec3& p)
+			{
+				ChunkCoord coord = ToChunkCoord(p);
+				if (!valid || coord != lastCoord) {
+					last = world->GetChunk(coord);
+					lastCoord = coord;
+					valid = true;
+				}
+				return last != nullptr && !last->Get(ToLocalCoord(p)).IsEmpty();
+			}
+
+		private:
+			const VoxelWorld* world;
+			ChunkCoord lastCoord;
+			const Chunk* last;
+			bool valid;
+		};
+
+		// one bit per voxel, allocated a chunk at a time.
+		class VisitedSet
+		{
+		public:
+			VisitedSet() : lastCoord{ 0 }, last{ nullptr } { }
+
+			bool Contains(const glm::ivec3& p)
+			{
+				ui64* bits = Bits(ToChunkCoord(p));
+				glm::ivec3 local = ToLocalCoord(p);
+				ui32 i = Linear(local.x, local.y, local.z);
+				return (bits[i >> 6] >> (i & 63)) & 1;
+			}
+
+			// false when p was already in the set.
+			bool Insert(const glm::ivec3& p)
+			{
+				ui64* bits = Bits(ToChunkCoord(p));
+				glm::ivec3 local = ToLocalCoord(p);
+				ui32 i = Linear(local.x, local.y, local.z);
+				ui64 bit = 1ull << (i & 63);
+				if (bits[i >> 6] & bit) {
+					return false;
+				}
+				bits[i >> 6] |= bit;
+				return true;
+			}
+
+		private:
+			ui64* Bits(const ChunkCoord& coord)
+			{
+				if (last == nullptr || coord != lastCoord) {
+					auto& bits = chunks[coord];
+					if (bits == nullptr) {
+						bits = std::make_unique<std::array<ui64, CHUNK_VOLUME / 64>>();
+						bits->fill(0);
+					}
+					last = bits->data();
+					lastCoord = coord;
+				}
+				return last;
+			}
+
+			std::unordered_map<ChunkCoord, std::unique_ptr<std::array<ui64, CHUNK_VOLUME / 64>>, ChunkCoordHash> chunks;
+			ChunkCoord lastCoord;
+			ui64* last;
+		};
+
+		const glm::ivec3 NEIGHBORS[6] = {
+			glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+			glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+			glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)
+		};
+
+		// depth first over the voxels matching seed; stops at the first solid voxel at or below groundY.
+		FloodResult Fill(VoxelReader& reader, VisitedSet& visited, const glm::ivec3& seed, const glm::ivec3& min, const glm::ivec3& max,
+			ui32 maxVoxels, int groundY, std::vector<glm::ivec3>* voxels)
+		{
+			FloodResult result;
+			if (!Inside(seed, min, max) || maxVoxels == 0 || !visited.Insert(seed)) {
+				return result;
+			}
+			bool solid = reader.IsSolid(seed);
+			std::vector<glm::ivec3> stack = { seed };
+			while (!stack.empty()) {
+				glm::ivec3 p = stack.back();
+				stack.pop_back();
+				result.voxels++;
+				Extend(result.min, result.max, p);
+				if (voxels != nullptr) {
+					voxels->push_back(p);
+				}
+				if (solid && p.y <= groundY) {
+					result.grounded = true;
+					return result;
+				}
+				for (const auto& offset : NEIGHBORS) {
+					glm::ivec3 n = p + offset;
+					if (!Inside(n, min, max)) {
+						continue;
+					}
+					if (reader.IsSolid(n) == solid && visited.Insert(n)) {
+						stack.push_back(n);
+					}
+				}
+				if (result.voxels >= maxVoxels && !stack.empty()) {
+					result.complete = false;
+					return result;
+				}
+			}
+			return result;
+		}
+	}
+
+	VoxelConnectivity::VoxelConnectivity(const VoxelWorld* const w) : world{ w }
+	{
+
+	}
+
+	VoxelConnectivity::~VoxelConnectivity()
+	{
+
+	}
+
+	void VoxelConnectivity::Label(const std::vector<ChunkCoord>& coords, int groundY)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		chunks.clear();
+		chunkIndices.clear();
+		for (const auto& coord : coords) {
+			if (chunkIndices.emplace(coord, static_cast<ui32>(chunks.size())).second) {
+				chunks.push_back({ coord, {}, 0, {} });
+			}
+		}
+
+		JobSystem::ParallelFor(static_cast<ui32>(chunks.size()), CHUNKS_PER_JOB, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				LabelChunk(chunks[i], groundY);
+			}
+		});
+
+		ui32 total = 0;
+		for (auto& chunk : chunks) {
+			chunk.first = total;
+			total += static_cast<ui32>(chunk.components.size());
+		}
+		parents = std::vector<std::atomic<ui32>>(total);
+		anchored = std::vector<std::atomic<bool>>(total);
+		std::vector<const VoxelComponent*> locals(total);
+		for (const auto& chunk : chunks) {
+			for (ui32 i = 0;i < chunk.components.size();i++) {
+				parents[chunk.first + i].store(chunk.first + i, std::memory_order_relaxed);
+				anchored[chunk.first + i].store(chunk.components[i].anchored, std::memory_order_relaxed);
+				locals[chunk.first + i] = &chunk.components[i];
+			}
+		}
+
+		JobSystem::ParallelFor(static_cast<ui32>(chunks.size()), CHUNKS_PER_JOB, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				MergeFaces(i);
+			}
+		});
+
+		// roots become components, then every label points straight at its component
+		components.clear();
+		componentOf.assign(total, COMPONENT_NONE);
+		for (ui32 label = 0;label < total;label++) {
+			if (Find(label) == label) {
+				componentOf[label] = static_cast<ui32>(components.size());
+				components.emplace_back();
+			}
+		}
+		for (ui32 label = 0;label < total;label++) {
+			ui32 component = componentOf[Find(label)];
+			componentOf[label] = component;
+			VoxelComponent& merged = components[component];
+			merged.voxels += locals[label]->voxels;
+			merged.min = glm::min(merged.min, locals[label]->min);
+			merged.max = glm::max(merged.max, locals[label]->max);
+			merged.anchored = merged.anchored || anchored[label].load(std::memory_order_relaxed);
+		}
+
+		stats.chunks = static_cast<ui32>(chunks.size());
+		stats.components = static_cast<ui32>(components.size());
+		stats.labelMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	ui32 VoxelConnectivity::GetLabel(const glm::ivec3& position) const
+	{
+		auto it = chunkIndices.find(ToChunkCoord(position));
+		if (it == chunkIndices.end()) {
+			return COMPONENT_NONE;
+		}
+		const ChunkLabels& chunk = chunks[it->second];
+		if (chunk.labels.empty()) {
+			return COMPONENT_NONE;
+		}
+		glm::ivec3 local = ToLocalCoord(position);
+		ui16 label = chunk.labels[Linear(local.x, local.y, local.z)];
+		return label == LOCAL_NONE ? COMPONENT_NONE : componentOf[chunk.first + label];
+	}
+
+	const std::vector<VoxelComponent>& VoxelConnectivity::GetComponents() const
+	{
+		return components;
+	}
+
+	FloodResult VoxelConnectivity::FloodFill(const glm::ivec3& seed, const glm::ivec3& min, const glm::ivec3& max, ui32 maxVoxels, std::vector<glm::ivec3>* voxels) const
+	{
+		EpochGuard guard;
+		VoxelReader reader(world);
+		VisitedSet visited;
+		return Fill(reader, visited, seed, min, max, maxVoxels, std::numeric_limits<int>::min(), voxels);
+	}
+
+	std::vector<VoxelIsland> VoxelConnectivity::FindIslands(const glm::ivec3& min, const glm::ivec3& max, int groundY, ui32 maxVoxels)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		// one seed per piece of solid the box and its shell hold, the fills inside the box are cheap
+		glm::ivec3 low = min - 1;
+		glm::ivec3 high = max + 1;
+		std::vector<glm::ivec3> seeds;
+		{
+			EpochGuard guard;
+			VoxelReader reader(world);
+			VisitedSet visited;
+			for (int z = low.z;z <= high.z;z++) {
+				for (int y = low.y;y <= high.y;y++) {
+					for (int x = low.x;x <= high.x;x++) {
+						glm::ivec3 p(x, y, z);
+						if (reader.IsSolid(p) && !visited.Contains(p)) {
+							seeds.push_back(p);
+							Fill(reader, visited, p, low, high, std::numeric_limits<ui32>::max(), std::numeric_limits<int>::min(), nullptr);
+						}
+					}
+				}
+			}
+		}
+
+		// pieces the box separates may still meet outside it, their fills find the same island
+		std::vector<VoxelIsland> found(seeds.size());
+		std::vector<ui8> isIsland(seeds.size(), 0);
+		std::atomic<ui64> visitedCount{ 0 };
+		glm::ivec3 unbounded(std::numeric_limits<int>::max() - 1);
+		JobSystem::ParallelFor(static_cast<ui32>(seeds.size()), 1, [&](ui32 begin, ui32 end) {
+			EpochGuard guard;
+			VoxelReader reader(world);
+			for (ui32 i = begin;i < end;i++) {
+				VisitedSet visited;
+				std::vector<glm::ivec3> voxels;
+				FloodResult result = Fill(reader, visited, seeds[i], -unbounded, unbounded, maxVoxels, groundY, &voxels);
+				visitedCount += result.voxels;
+				if (result.complete && !result.grounded) {
+					found[i] = { std::move(voxels), result.min, result.max };
+					isIsland[i] = 1;
+				}
+			}
+		});
+
+		std::vector<VoxelIsland> islands;
+		std::set<std::array<int, 3>> keys;
+		for (size_t i = 0;i < seeds.size();i++) {
+			if (!isIsland[i]) {
+				continue;
+			}
+			auto smallest = std::min_element(found[i].voxels.begin(), found[i].voxels.end(), [](const glm::ivec3& a, const glm::ivec3& b) {
+				return std::tie(a.z, a.y, a.x) < std::tie(b.z, b.y, b.x);
+			});
+			if (keys.insert({ smallest->x, smallest->y, smallest->z }).second) {
+				islands.push_back(std::move(found[i]));
+			}
+		}
+
+		stats.fills = static_cast<ui32>(seeds.size());
+		stats.visited = visitedCount.load();
+		stats.fillMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return islands;
+	}
+
+	const ConnectivityStats& VoxelConnectivity::GetStats() const
+	{
+		return stats;
+	}
+
+	ui32 VoxelConnectivity::Find(ui32 label) const
+	{
+		// path halving, a lost CAS only means another thread shortened the path first
+		while (true) {
+			ui32 parent = parents[label].load(std::memory_order_relaxed);
+			if (parent == label) {
+				return label;
+			}
+			ui32 grandparent = parents[parent].load(std::memory_order_relaxed);
+			if (grandparent != parent) {
+				parents[label].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+			}
+			label = grandparent;
+		}
+	}
+
+	void VoxelConnectivity::Union(ui32 a, ui32 b)
+	{
+		// the larger root always links below the smaller, so concurrent unions cannot form a cycle
+		while (true) {
+			a = Find(a);
+			b = Find(b);
+			if (a == b) {
+				return;
+			}
+			if (a < b) {
+				std::swap(a, b);
+			}
+			ui32 expected = a;
+			if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+				return;
+			}
+		}
+	}
+
+	void VoxelConnectivity::LabelChunk(ChunkLabels& chunk, int groundY) const
+	{
+		EpochGuard guard;
+		const Chunk* source = world->GetChunk(chunk.coord);
+		if (source == nullptr) {
+			return;
+		}
+		std::vector<ui8> solid(CHUNK_VOLUME, 0);
+		source->ForEachSolidVoxel([&solid](ui32 x, ui32 y, ui32 z, const Voxel&) { solid[Linear(x, y, z)] = 1; });
+
+		// one pass joining each voxel with its -x, -y and -z neighbors; a 6-connected 32^3 grid
+		// never needs more than CHUNK_VOLUME / 2 provisional labels, so they fit 16 bits
+		chunk.labels.assign(CHUNK_VOLUME, LOCAL_NONE);
+		std::vector<ui16> parent;
+		auto find = [&parent](ui16 label) {
+			while (parent[label] != label) {
+				parent[label] = parent[parent[label]];
+				label = parent[label];
+			}
+			return label;
+		};
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 y = 0;y < CHUNK_SIZE;y++) {
+				for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+					ui32 i = Linear(x, y, z);
+					if (!solid[i]) {
+						continue;
+					}
+					ui16 label = LOCAL_NONE;
+					ui32 previous[3] = { x > 0 ? i - 1 : i, y > 0 ? i - CHUNK_SIZE : i, z > 0 ? i - CHUNK_SIZE * CHUNK_SIZE : i };
+					for (ui32 n : previous) {
+						if (n == i || chunk.labels[n] == LOCAL_NONE) {
+							continue;
+						}
+						ui16 root = find(chunk.labels[n]);
+						if (label == LOCAL_NONE) {
+							label = root;
+						}
+						else if (root != label) {
+							parent[std::max(root, label)] = std::min(root, label);
+							label = std::min(root, label);
+						}
+					}
+					if (label == LOCAL_NONE) {
+						label = static_cast<ui16>(parent.size());
+						parent.push_back(label);
+					}
+					chunk.labels[i] = label;
+				}
+			}
+		}
+
+		std::vector<ui16> remap(parent.size(), LOCAL_NONE);
+		glm::ivec3 origin = ChunkOrigin(chunk.coord);
+		for (ui32 z = 0;z < CHUNK_SIZE;z++) {
+			for (ui32 y = 0;y < CHUNK_SIZE;y++) {
+				for (ui32 x = 0;x < CHUNK_SIZE;x++) {
+					ui16& label = chunk.labels[Linear(x, y, z)];
+					if (label == LOCAL_NONE) {
+						continue;
+					}
+					ui16 root = find(label);
+					if (remap[root] == LOCAL_NONE) {
+						remap[root] = static_cast<ui16>(chunk.components.size());
+						chunk.components.emplace_back();
+					}
+					label = remap[root];
+					VoxelComponent& component = chunk.components[label];
+					glm::ivec3 p = origin + glm::ivec3(x, y, z);
+					component.voxels++;
+					Extend(component.min, component.max, p);
+					component.anchored = component.anchored || p.y <= groundY;
+				}
+			}
+		}
+	}
+
+	void VoxelConnectivity::MergeFaces(ui32 index)
+	{
+		const ChunkLabels& chunk = chunks[index];
+		if (chunk.components.empty()) {
+			return;
+		}
+		EpochGuard guard;
+		for (ui32 axis = 0;axis < 3;axis++) {
+			for (int direction = -1;direction <= 1;direction += 2) {
+				ChunkCoord neighborCoord = chunk.coord;
+				neighborCoord[axis] += direction;
+				ui32 face = direction > 0 ? CHUNK_SIZE - 1 : 0;
+				ui32 across = CHUNK_SIZE - 1 - face;
+
+				auto it = chunkIndices.find(neighborCoord);
+				const ChunkLabels* labeled = it != chunkIndices.end() ? &chunks[it->second] : nullptr;
+				// faces between two labeled chunks are joined once, from the lower one
+				if (labeled != nullptr && (direction < 0 || labeled->components.empty())) {
+					continue;
+				}
+				// outside the labeled chunks, a solid neighbor may tie the component to the rest of the world
+				const Chunk* outside = labeled == nullptr ? world->GetChunk(neighborCoord) : nullptr;
+				if (labeled == nullptr && outside == nullptr) {
+					continue;
+				}
+
+				for (ui32 v = 0;v < CHUNK_SIZE;v++) {
+					for (ui32 u = 0;u < CHUNK_SIZE;u++) {
+						glm::uvec3 p(0);
+						p[axis] = face;
+						p[(axis + 1) % 3] = u;
+						p[(axis + 2) % 3] = v;
+						ui16 label = chunk.labels[Linear(p.x, p.y, p.z)];
+						if (label == LOCAL_NONE) {
+							continue;
+						}
+						glm::uvec3 q = p;
+						q[axis] = across;
+						if (labeled != nullptr) {
+							ui16 other = labeled->labels[Linear(q.x, q.y, q.z)];
+							if (other != LOCAL_NONE) {
+								Union(chunk.first + label, labeled->first + other);
+							}
+						}
+						else if (!outside->Get(q.x, q.y, q.z).IsEmpty()) {
+							anchored[chunk.first + label].store(true, std::memory_order_relaxed);
+						}
+					}
+				}
+			}
+		}
+	}
+}
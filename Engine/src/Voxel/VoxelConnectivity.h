@@ -0,0 +1,107 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+
+#define COMPONENT_NONE 0xFFFFFFFFu
+
+namespace Luxel
+{
+	struct VoxelComponent
+	{
+		ui64 voxels = 0;
+		glm::ivec3 min = glm::ivec3(std::numeric_limits<int>::max());
+		glm::ivec3 max = glm::ivec3(std::numeric_limits<int>::min());
+		// reaches groundY or a solid voxel outside the labeled chunks
+		bool anchored = false;
+	};
+
+	struct FloodResult
+	{
+		ui64 voxels = 0;
+		glm::ivec3 min = glm::ivec3(std::numeric_limits<int>::max());
+		glm::ivec3 max = glm::ivec3(std::numeric_limits<int>::min());
+		// false when the fill stopped at maxVoxels
+		bool complete = true;
+		bool grounded = false;
+	};
+
+	// solid voxels that lost their connection to the ground.
+	struct VoxelIsland
+	{
+		std::vector<glm::ivec3> voxels;
+		glm::ivec3 min;
+		glm::ivec3 max;
+	};
+
+	struct ConnectivityStats
+	{
+		ui32 chunks = 0;
+		ui32 components = 0;
+		double labelMilliseconds = 0.0;
+		// of the last FindIslands
+		ui32 fills = 0;
+		ui64 visited = 0;
+		double fillMilliseconds = 0.0;
+	};
+
+	// 6-connected components of the solid voxels of a world. Label works on a set of chunks: each one
+	// is labeled on a worker, then the labels are merged across shared faces with a lock free union find.
+	// FindIslands and FloodFill only walk out from the voxels they start at, so they cost what they visit
+	// instead of the size of the world.
+	class LUXEL_API VoxelConnectivity
+	{
+	public:
+		VoxelConnectivity(const VoxelWorld* const w);
+		~VoxelConnectivity();
+		VoxelConnectivity(const VoxelConnectivity&) = delete;
+		void operator=(const VoxelConnectivity&) = delete;
+
+		// voxels at or below groundY anchor their component; pass the chunks around an edit to label only those.
+		void Label(const std::vector<ChunkCoord>& chunks, int groundY);
+		// component of a voxel of the labeled chunks, COMPONENT_NONE for air and voxels outside them.
+		ui32 GetLabel(const glm::ivec3& position) const;
+		const std::vector<VoxelComponent>& GetComponents() const;
+
+		// voxels connected to seed that match it, solid or air, inside [min, max]. stops after maxVoxels
+		// and appends the visited positions to voxels when given.
+		FloodResult FloodFill(const glm::ivec3& seed, const glm::ivec3& min, const glm::ivec3& max, ui32 maxVoxels, std::vector<glm::ivec3>* voxels = nullptr) const;
+		// components touching [min, max] that reach neither groundY nor maxVoxels, typically called with
+		// the box of voxels an edit removed. one fill per component the box cuts, run on the workers.
+		std::vector<VoxelIsland> FindIslands(const glm::ivec3& min, const glm::ivec3& max, int groundY, ui32 maxVoxels);
+
+		const ConnectivityStats& GetStats() const;
+
+	private:
+		struct ChunkLabels
+		{
+			ChunkCoord coord;
+			// per voxel, x fastest, LOCAL_NONE for air
+			std::vector<ui16> labels;
+			ui32 first;
+			std::vector<VoxelComponent> components;
+		};
+
+		ui32 Find(ui32 label) const;
+		void Union(ui32 a, ui32 b);
+		void LabelChunk(ChunkLabels& chunk, int groundY) const;
+		void MergeFaces(ui32 chunk);
+
+		const VoxelWorld* const world;
+		std::vector<ChunkLabels> chunks;
+		std::unordered_map<ChunkCoord, ui32, ChunkCoordHash> chunkIndices;
+		mutable std::vector<std::atomic<ui32>> parents;
+		std::vector<std::atomic<bool>> anchored;
+		// global label -> component
+		std::vector<ui32> componentOf;
+		std::vector<VoxelComponent> components;
+		ConnectivityStats stats;
+	};
+}
@@ -0,0 +1,240 @@
+#include "pch.h"
+
+#include "VoxelDistanceField.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// the chunk plus one neighbor chunk on each side, in bricks
+		constexpr ui32 GRID_SIZE = BRICKS_PER_AXIS * 3;
+		constexpr ui32 GRID_BEGIN = BRICKS_PER_AXIS;
+		constexpr ui32 GRID_END = BRICKS_PER_AXIS * 2;
+		constexpr ui32 FAR_DISTANCE = 0xFF;
+
+		inline ui32 GridIndex(ui32 x, ui32 y, ui32 z)
+		{
+			return x + (y + z * GRID_SIZE) * GRID_SIZE;
+		}
+
+		inline ui32 Combine(ui32 offset, ui32 distance, DistanceMetric metric)
+		{
+			if (distance >= FAR_DISTANCE) {
+				return FAR_DISTANCE;
+			}
+			return metric == DistanceMetric::Chebyshev ? std::max(offset, distance) : std::min(offset + distance, FAR_DISTANCE);
+		}
+	}
+
+	VoxelDistanceField::VoxelDistanceField(VoxelWorld* const w, DistanceMetric m) :
+		world{ w }, metric{ m }, syncedRevision{ 0 }, revision{ 0 }
+	{
+
+	}
+
+	VoxelDistanceField::~VoxelDistanceField()
+	{
+		chunks.clear();
+	}
+
+	ui32 VoxelDistanceField::Update()
+	{
+		ui64 worldRevision = world->GetRevision();
+		if (worldRevision == syncedRevision) {
+			return 0;
+		}
+
+		// only a change in brick occupancy moves distances, voxel edits inside solid bricks do not
+		EpochGuard guard;
+		std::unordered_set<ChunkCoord, ChunkCoordHash> dirty;
+		auto markWithNeighbors = [&](const ChunkCoord& coord) {
+			for (int dz = -1;dz <= 1;dz++) {
+				for (int dy = -1;dy <= 1;dy++) {
+					for (int dx = -1;dx <= 1;dx++) {
+						dirty.insert(coord + glm::ivec3(dx, dy, dz));
+					}
+				}
+			}
+		};
+
+		for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk == nullptr) {
+				continue;
+			}
+			auto it = chunks.find(coord);
+			if (it == chunks.end() || it->second.brickMask != chunk->GetBrickMask()) {
+				markWithNeighbors(coord);
+			}
+		}
+		for (auto it = chunks.begin();it != chunks.end();) {
+			if (world->GetChunk(it->first) == nullptr) {
+				markWithNeighbors(it->first);
+				it = chunks.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		syncedRevision = worldRevision;
+
+		std::vector<std::pair<ChunkCoord, ChunkField*>> jobs;
+		for (const auto& coord : dirty) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk != nullptr) {
+				ChunkField& field = chunks[coord];
+				field.brickMask = chunk->GetBrickMask();
+				jobs.emplace_back(coord, &field);
+			}
+		}
+		if (jobs.empty()) {
+			return 0;
+		}
+
+		revision++;
+		JobSystem::ParallelFor(static_cast<ui32>(jobs.size()), 4, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				Compute(jobs[i].first, jobs[i].second->distances);
+				jobs[i].second->revision = revision;
+			}
+		});
+		return static_cast<ui32>(jobs.size());
+	}
+
+	bool VoxelDistanceField::GetBrickDistance(const glm::ivec3& brickPosition, ui32& distance) const
+	{
+		ChunkCoord coord(brickPosition.x >> (CHUNK_SIZE_LOG2 - BRICK_SIZE_LOG2),
+			brickPosition.y >> (CHUNK_SIZE_LOG2 - BRICK_SIZE_LOG2),
+			brickPosition.z >> (CHUNK_SIZE_LOG2 - BRICK_SIZE_LOG2));
+		auto it = chunks.find(coord);
+		if (it == chunks.end()) {
+			return false;
+		}
+		ui32 bx = brickPosition.x & (BRICKS_PER_AXIS - 1);
+		ui32 by = brickPosition.y & (BRICKS_PER_AXIS - 1);
+		ui32 bz = brickPosition.z & (BRICKS_PER_AXIS - 1);
+		distance = Unpack(it->second.distances, bx + (by + bz * BRICKS_PER_AXIS) * BRICKS_PER_AXIS);
+		return true;
+	}
+
+	bool VoxelDistanceField::GetEmptyBox(const glm::ivec3& brickPosition, glm::ivec3& minVoxel, glm::ivec3& maxVoxel) const
+	{
+		ui32 distance = 0;
+		if (!GetBrickDistance(brickPosition, distance) || distance == 0) {
+			return false;
+		}
+		int radius = static_cast<int>(BoxRadius(distance, metric));
+		minVoxel = (brickPosition - glm::ivec3(radius)) * BRICK_SIZE;
+		maxVoxel = (brickPosition + glm::ivec3(radius + 1)) * BRICK_SIZE;
+		return true;
+	}
+
+	const PackedBrickDistances* VoxelDistanceField::GetPacked(const ChunkCoord& coord) const
+	{
+		auto it = chunks.find(coord);
+		return it == chunks.end() ? nullptr : &it->second.distances;
+	}
+
+	ui64 VoxelDistanceField::GetRevision() const
+	{
+		return revision;
+	}
+
+	std::vector<ChunkCoord> VoxelDistanceField::GetModifiedChunks(ui64 sinceRevision) const
+	{
+		std::vector<ChunkCoord> coords;
+		for (const auto& [coord, field] : chunks) {
+			if (field.revision > sinceRevision) {
+				coords.push_back(coord);
+			}
+		}
+		return coords;
+	}
+
+	DistanceMetric VoxelDistanceField::GetMetric() const
+	{
+		return metric;
+	}
+
+	ui32 VoxelDistanceField::Unpack(const PackedBrickDistances& packed, ui32 brick)
+	{
+		return (packed[brick >> 2] >> ((brick & 3) * 8)) & 0xFF;
+	}
+
+	ui32 VoxelDistanceField::BoxRadius(ui32 distance, DistanceMetric metric)
+	{
+		if (distance == 0) {
+			return 0;
+		}
+		// a cube of radius r reaches manhattan distance 3r
+		return metric == DistanceMetric::Chebyshev ? distance - 1 : (distance - 1) / 3;
+	}
+
+	void VoxelDistanceField::Compute(const ChunkCoord& coord, PackedBrickDistances& distances) const
+	{
+		// separable transform: one 1D pass per axis, each pass only over the cells the next one reads
+		std::array<ui8, GRID_SIZE * GRID_SIZE * GRID_SIZE> occupied{};
+		EpochGuard guard;
+		for (int dz = -1;dz <= 1;dz++) {
+			for (int dy = -1;dy <= 1;dy++) {
+				for (int dx = -1;dx <= 1;dx++) {
+					const Chunk* chunk = world->GetChunk(coord + glm::ivec3(dx, dy, dz));
+					if (chunk == nullptr) {
+						continue;
+					}
+					ui64 mask = chunk->GetBrickMask();
+					while (mask != 0) {
+						ui32 brick = static_cast<ui32>(std::countr_zero(mask));
+						mask &= mask - 1;
+						ui32 x = (dx + 1) * BRICKS_PER_AXIS + brick % BRICKS_PER_AXIS;
+						ui32 y = (dy + 1) * BRICKS_PER_AXIS + brick / BRICKS_PER_AXIS % BRICKS_PER_AXIS;
+						ui32 z = (dz + 1) * BRICKS_PER_AXIS + brick / (BRICKS_PER_AXIS * BRICKS_PER_AXIS);
+						occupied[GridIndex(x, y, z)] = 1;
+					}
+				}
+			}
+		}
+
+		std::array<ui8, GRID_SIZE * GRID_SIZE * GRID_SIZE> passX;
+		for (ui32 z = 0;z < GRID_SIZE;z++) {
+			for (ui32 y = 0;y < GRID_SIZE;y++) {
+				for (ui32 x = GRID_BEGIN;x < GRID_END;x++) {
+					ui32 best = FAR_DISTANCE;
+					for (ui32 q = 0;q < GRID_SIZE;q++) {
+						if (occupied[GridIndex(q, y, z)] != 0) {
+							best = std::min(best, x > q ? x - q : q - x);
+						}
+					}
+					passX[GridIndex(x, y, z)] = static_cast<ui8>(best);
+				}
+			}
+		}
+
+		std::array<ui8, GRID_SIZE * GRID_SIZE * GRID_SIZE> passY;
+		for (ui32 z = 0;z < GRID_SIZE;z++) {
+			for (ui32 y = GRID_BEGIN;y < GRID_END;y++) {
+				for (ui32 x = GRID_BEGIN;x < GRID_END;x++) {
+					ui32 best = FAR_DISTANCE;
+					for (ui32 q = 0;q < GRID_SIZE;q++) {
+						best = std::min(best, Combine(y > q ? y - q : q - y, passX[GridIndex(x, q, z)], metric));
+					}
+					passY[GridIndex(x, y, z)] = static_cast<ui8>(best);
+				}
+			}
+		}
+
+		distances.fill(0);
+		for (ui32 z = GRID_BEGIN;z < GRID_END;z++) {
+			for (ui32 y = GRID_BEGIN;y < GRID_END;y++) {
+				for (ui32 x = GRID_BEGIN;x < GRID_END;x++) {
+					ui32 best = FAR_DISTANCE;
+					for (ui32 q = 0;q < GRID_SIZE;q++) {
+						best = std::min(best, Combine(z > q ? z - q : q - z, passY[GridIndex(x, y, q)], metric));
+					}
+					ui32 brick = (x - GRID_BEGIN) + ((y - GRID_BEGIN) + (z - GRID_BEGIN) * BRICKS_PER_AXIS) * BRICKS_PER_AXIS;
+					distances[brick >> 2] |= std::min(best, static_cast<ui32>(DISTANCE_FIELD_MAX)) << ((brick & 3) * 8);
+				}
+			}
+		}
+	}
+}
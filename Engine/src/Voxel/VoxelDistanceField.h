@@ -0,0 +1,80 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+
+// distances are in bricks and clamped to one chunk, so a chunk's field only depends on its 26 neighbors.
+#define DISTANCE_FIELD_MAX BRICKS_PER_AXIS
+// four 8 bit distances per word, brick b sits in word b / 4 at bits (b % 4) * 8.
+#define DISTANCE_FIELD_WORDS (BRICK_COUNT / 4)
+
+namespace Luxel
+{
+	enum class DistanceMetric
+	{
+		// every brick within distance - 1 on all axes is empty, the natural fit for box steps.
+		Chebyshev,
+		Manhattan
+	};
+
+	using PackedBrickDistances = std::array<ui32, DISTANCE_FIELD_WORDS>;
+
+	// per brick distance to the nearest solid brick, kept for every allocated chunk.
+	// chunks that are not allocated are empty as a whole and are skipped by traversal directly.
+	class LUXEL_API VoxelDistanceField
+	{
+	public:
+		VoxelDistanceField(VoxelWorld* const w, DistanceMetric m = DistanceMetric::Chebyshev);
+		~VoxelDistanceField();
+		VoxelDistanceField(const VoxelDistanceField&) = delete;
+		void operator=(const VoxelDistanceField&) = delete;
+
+		// recomputes chunks whose brick occupancy changed, and their neighbors, on the workers.
+		// returns the number of chunks recomputed.
+		ui32 Update();
+
+		// brickPosition is the world voxel position >> BRICK_SIZE_LOG2.
+		// returns false when the brick's chunk is not allocated.
+		bool GetBrickDistance(const glm::ivec3& brickPosition, ui32& distance) const;
+		// voxel box [minVoxel, maxVoxel) around the brick that holds no solid voxel.
+		// returns false when the brick itself is solid or its chunk is not allocated.
+		bool GetEmptyBox(const glm::ivec3& brickPosition, glm::ivec3& minVoxel, glm::ivec3& maxVoxel) const;
+
+		// nullptr for chunks that are not allocated.
+		const PackedBrickDistances* GetPacked(const ChunkCoord& coord) const;
+
+		// bumped on every Update that changes a chunk, stamped on the changed chunks.
+		ui64 GetRevision() const;
+		std::vector<ChunkCoord> GetModifiedChunks(ui64 sinceRevision) const;
+
+		DistanceMetric GetMetric() const;
+
+		static ui32 Unpack(const PackedBrickDistances& packed, ui32 brick);
+		// half size in bricks of the empty box a distance guarantees under metric.
+		static ui32 BoxRadius(ui32 distance, DistanceMetric metric);
+
+	private:
+		struct ChunkField
+		{
+			ui64 brickMask = 0;
+			ui64 revision = 0;
+			PackedBrickDistances distances{};
+		};
+
+		void Compute(const ChunkCoord& coord, PackedBrickDistances& distances) const;
+
+		VoxelWorld* const world;
+		DistanceMetric metric;
+
+		std::unordered_map<ChunkCoord, ChunkField, ChunkCoordHash> chunks;
+		ui64 syncedRevision;
+		ui64 revision;
+	};
+}
@@ -0,0 +1,168 @@
+#include "pch.h"
+
+#include "VoxelEditor.h"
+
+namespace Luxel
+{
+	VoxelBrush VoxelBrush::Sphere(int radius)
+	{
+		VoxelBrush brush;
+		int extent = radius * 2 + 1;
+		brush.size = glm::ivec3(extent);
+		brush.pivot = glm::ivec3(radius);
+		brush.mask.assign(static_cast<size_t>(extent) * extent * extent, 0);
+		float limit = (radius + 0.5f) * (radius + 0.5f);
+		for (int z = 0;z < extent;z++) {
+			for (int y = 0;y < extent;y++) {
+				for (int x = 0;x < extent;x++) {
+					float dx = static_cast<float>(x - radius);
+					float dy = static_cast<float>(y - radius);
+					float dz = static_cast<float>(z - radius);
+					brush.mask[x + y * extent + z * extent * extent] = dx * dx + dy * dy + dz * dz <= limit ? 1 : 0;
+				}
+			}
+		}
+		return brush;
+	}
+
+	VoxelBrush VoxelBrush::Cube(int extent)
+	{
+		VoxelBrush brush;
+		brush.size = glm::ivec3(extent);
+		brush.pivot = glm::ivec3(extent / 2);
+		brush.mask.assign(static_cast<size_t>(extent) * extent * extent, 1);
+		return brush;
+	}
+
+	VoxelEditor::VoxelEditor(VoxelWorld* const w) : world{ w }
+	{
+
+	}
+
+	VoxelEditor::~VoxelEditor()
+	{
+
+	}
+
+	EditStats VoxelEditor::Point(const glm::ivec3& position, const Voxel& voxel, EditMode mode)
+	{
+		return ApplyShape(position, position, [](const glm::ivec3&) { return true; }, voxel, mode);
+	}
+
+	EditStats VoxelEditor::Box(const glm::ivec3& min, const glm::ivec3& max, const Voxel& voxel, EditMode mode)
+	{
+		return ApplyShape(glm::min(min, max), glm::max(min, max), [](const glm::ivec3&) { return true; }, voxel, mode);
+	}
+
+	EditStats VoxelEditor::Sphere(const glm::vec3& center, float radius, const Voxel& voxel, EditMode mode)
+	{
+		glm::ivec3 min = glm::ivec3(glm::floor(center - glm::vec3(radius)));
+		glm::ivec3 max = glm::ivec3(glm::floor(center + glm::vec3(radius)));
+		float radius2 = radius * radius;
+		return ApplyShape(min, max, [&](const glm::ivec3& p) {
+			glm::vec3 d = glm::vec3(p) + glm::vec3(0.5f) - center;
+			return d.x * d.x + d.y * d.y + d.z * d.z <= radius2;
+		}, voxel, mode);
+	}
+
+	EditStats VoxelEditor::Brush(const VoxelBrush& brush, const glm::ivec3& position, const Voxel& voxel, EditMode mode)
+	{
+		glm::ivec3 min = position - brush.pivot;
+		glm::ivec3 max = min + brush.size - glm::ivec3(1);
+		return ApplyShape(min, max, [&](const glm::ivec3& p) {
+			return brush.Contains(p - min);
+		}, voxel, mode);
+	}
+
+	template<typename Shape>
+	EditStats VoxelEditor::ApplyShape(const glm::ivec3& min, const glm::ivec3& max, const Shape& inside, const Voxel& voxel, EditMode mode)
+	{
+		EditStats stats;
+		bool writesSolid = (mode == EditMode::Replace || mode == EditMode::Add) && !voxel.IsEmpty();
+		if (mode == EditMode::Add && voxel.IsEmpty()) {
+			return stats;
+		}
+
+		// chunks are looked up and created serially up front, the guard keeps them alive for the workers
+		EpochGuard guard;
+		struct ChunkEdit
+		{
+			ChunkCoord coord;
+			Chunk* chunk;
+			ui64 modifiedBricks;
+			ui32 changed;
+		};
+		std::vector<ChunkEdit> edits;
+		ChunkCoord minChunk = ToChunkCoord(min);
+		ChunkCoord maxChunk = ToChunkCoord(max);
+		for (int cz = minChunk.z;cz <= maxChunk.z;cz++) {
+			for (int cy = minChunk.y;cy <= maxChunk.y;cy++) {
+				for (int cx = minChunk.x;cx <= maxChunk.x;cx++) {
+					ChunkCoord coord(cx, cy, cz);
+					Chunk* chunk = writesSolid ? world->GetOrCreateChunk(coord) : world->GetChunk(coord);
+					if (chunk != nullptr) {
+						edits.push_back({ coord, chunk, 0, 0 });
+					}
+				}
+			}
+		}
+
+		// every chunk is edited by exactly one job, so no locking is needed inside
+		JobSystem::ParallelFor(static_cast<ui32>(edits.size()), 1, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				ChunkEdit& edit = edits[i];
+				glm::ivec3 origin = ChunkOrigin(edit.coord);
+				glm::ivec3 lo = glm::max(min - origin, glm::ivec3(0));
+				glm::ivec3 hi = glm::min(max - origin, glm::ivec3(CHUNK_SIZE - 1));
+				for (int z = lo.z;z <= hi.z;z++) {
+					for (int y = lo.y;y <= hi.y;y++) {
+						for (int x = lo.x;x <= hi.x;x++) {
+							if (!inside(origin + glm::ivec3(x, y, z))) {
+								continue;
+							}
+							Voxel current = edit.chunk->Get(x, y, z);
+							Voxel next = current;
+							switch (mode) {
+							case EditMode::Replace:
+								next = voxel;
+								break;
+							case EditMode::Add:
+								if (current.IsEmpty()) {
+									next = voxel;
+								}
+								break;
+							case EditMode::Remove:
+								next = Voxel{};
+								break;
+							case EditMode::Paint:
+								if (!current.IsEmpty()) {
+									next.color = voxel.color;
+								}
+								break;
+							}
+							if (next != current) {
+								edit.chunk->Set(x, y, z, next);
+								edit.modifiedBricks |= 1ull << Chunk::BrickIndex(x, y, z);
+								edit.changed++;
+							}
+						}
+					}
+				}
+			}
+		});
+
+		for (const auto& edit : edits) {
+			if (edit.chunk->IsEmpty()) {
+				world->RemoveChunk(edit.coord);
+			}
+			else if (edit.modifiedBricks != 0) {
+				world->MarkModified(edit.coord, edit.modifiedBricks);
+			}
+			if (edit.changed != 0) {
+				stats.voxelsChanged += edit.changed;
+				stats.chunksTouched++;
+			}
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+
+namespace Luxel
+{
+	enum class EditMode
+	{
+		// writes the voxel everywhere inside the shape, air included.
+		Replace,
+		// fills only empty voxels.
+		Add,
+		// clears solid voxels.
+		Remove,
+		// recolors solid voxels, keeping their material.
+		Paint
+	};
+
+	// a small occupancy stamp, placed with its pivot on the edit position.
+	struct VoxelBrush
+	{
+		glm::ivec3 size = glm::ivec3(1);
+		glm::ivec3 pivot = glm::ivec3(0);
+		std::vector<ui8> mask = std::vector<ui8>(1, 1);
+
+		bool Contains(const glm::ivec3& p) const
+		{
+			return mask[p.x + p.y * size.x + p.z * size.x * size.y] != 0;
+		}
+
+		static VoxelBrush Sphere(int radius);
+		static VoxelBrush Cube(int extent);
+	};
+
+	struct EditStats
+	{
+		ui64 voxelsChanged = 0;
+		ui32 chunksTouched = 0;
+	};
+
+	// edits chunks in place and stamps the touched bricks, so renderers and other
+	// consumers of VoxelWorld revisions only rebuild what actually changed.
+	class LUXEL_API VoxelEditor
+	{
+	public:
+		VoxelEditor(VoxelWorld* const w);
+		~VoxelEditor();
+		VoxelEditor(const VoxelEditor&) = delete;
+		void operator=(const VoxelEditor&) = delete;
+
+		EditStats Point(const glm::ivec3& position, const Voxel& voxel, EditMode mode = EditMode::Replace);
+		// inclusive bounds
+		EditStats Box(const glm::ivec3& min, const glm::ivec3& max, const Voxel& voxel, EditMode mode = EditMode::Replace);
+		EditStats Sphere(const glm::vec3& center, float radius, const Voxel& voxel, EditMode mode = EditMode::Replace);
+		EditStats Brush(const VoxelBrush& brush, const glm::ivec3& position, const Voxel& voxel, EditMode mode = EditMode::Replace);
+
+	private:
+		template<typename Shape>
+		EditStats ApplyShape(const glm::ivec3& min, const glm::ivec3& max, const Shape& inside, const Voxel& voxel, EditMode mode);
+
+		VoxelWorld* const world;
+	};
+}
@@ -0,0 +1,250 @@
+#include "pch.h"
+
+#include "VoxelLod.h"
+
+namespace Luxel
+{
+	VoxelLod::VoxelLod(VoxelWorld* const w, LodFilter f) : world{ w }, filter{ f }, syncedRevision{ 0 }
+	{
+
+	}
+
+	VoxelLod::~VoxelLod()
+	{
+		chunks.clear();
+	}
+
+	ui32 VoxelLod::Update()
+	{
+		ui64 revision = world->GetRevision();
+		if (revision == syncedRevision) {
+			return 0;
+		}
+
+		// keeps the chunks alive for the workers too
+		EpochGuard guard;
+		for (auto it = chunks.begin();it != chunks.end();) {
+			if (world->GetChunk(it->first) == nullptr) {
+				it = chunks.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		// pyramids are created serially, the bricks are downsampled on the workers
+		struct LodJob
+		{
+			const Chunk* chunk;
+			ChunkLod* lod;
+			ui64 dirtyBricks;
+		};
+		std::vector<LodJob> jobs;
+		for (const auto& coord : world->GetModifiedChunks(syncedRevision)) {
+			const Chunk* chunk = world->GetChunk(coord);
+			if (chunk == nullptr) {
+				continue;
+			}
+			auto& lod = chunks[coord];
+			ui64 dirtyBricks = chunk->GetModifiedBricks(syncedRevision);
+			if (lod == nullptr) {
+				lod = std::make_unique<ChunkLod>();
+				lod->voxels.resize(LevelOffset(LOD_LEVEL_COUNT));
+				dirtyBricks = ~0ull;
+			}
+			jobs.push_back({ chunk, lod.get(), dirtyBricks });
+		}
+		syncedRevision = revision;
+
+		JobSystem::ParallelFor(static_cast<ui32>(jobs.size()), 1, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				ui64 dirtyBricks = jobs[i].dirtyBricks;
+				while (dirtyBricks != 0) {
+					ui32 brick = static_cast<ui32>(std::countr_zero(dirtyBricks));
+					dirtyBricks &= dirtyBricks - 1;
+					RebuildBrick(*jobs[i].chunk, *jobs[i].lod, brick);
+				}
+				RebuildTop(*jobs[i].lod);
+			}
+		});
+		return static_cast<ui32>(jobs.size());
+	}
+
+	Voxel VoxelLod::Get(const glm::ivec3& position, ui32 level) const
+	{
+		if (level == 0) {
+			return world->GetVoxel(position);
+		}
+		ui32 shift = CHUNK_SIZE_LOG2 - level;
+		ChunkCoord coord(position.x >> shift, position.y >> shift, position.z >> shift);
+		const Voxel* data = GetLevelData(coord, level);
+		if (data == nullptr) {
+			return Voxel{};
+		}
+		ui32 size = LevelSize(level);
+		ui32 x = position.x & (size - 1);
+		ui32 y = position.y & (size - 1);
+		ui32 z = position.z & (size - 1);
+		return data[x + (y + z * size) * size];
+	}
+
+	const Voxel* VoxelLod::GetLevelData(const ChunkCoord& coord, ui32 level) const
+	{
+		if (level == 0 || level >= LOD_LEVEL_COUNT) {
+			return nullptr;
+		}
+		auto it = chunks.find(coord);
+		if (it == chunks.end()) {
+			return nullptr;
+		}
+		return it->second->voxels.data() + LevelOffset(level);
+	}
+
+	ui32 VoxelLod::LevelSize(ui32 level)
+	{
+		return CHUNK_SIZE >> level;
+	}
+
+	float VoxelLod::ProjectedVoxelSize(float voxelSize, float distance, float fovY, ui32 viewportHeight)
+	{
+		float viewHeight = 2.f * std::max(distance, 1e-4f) * std::tan(fovY * 0.5f);
+		return voxelSize / viewHeight * static_cast<float>(viewportHeight);
+	}
+
+	ui32 VoxelLod::SelectLevel(float voxelSize, float distance, float fovY, ui32 viewportHeight, float pixelThreshold)
+	{
+		float size = ProjectedVoxelSize(voxelSize, distance, fovY, viewportHeight);
+		ui32 level = 0;
+		while (level + 1 < LOD_LEVEL_COUNT && size * 2.f <= pixelThreshold) {
+			size *= 2.f;
+			level++;
+		}
+		return level;
+	}
+
+	LodFilter VoxelLod::GetFilter() const
+	{
+		return filter;
+	}
+
+	size_t VoxelLod::GetMemoryUsage() const
+	{
+		return chunks.size() * (sizeof(ChunkLod) + LevelOffset(LOD_LEVEL_COUNT) * sizeof(Voxel));
+	}
+
+	ui32 VoxelLod::LevelOffset(ui32 level)
+	{
+		ui32 offset = 0;
+		for (ui32 l = 1;l < level;l++) {
+			ui32 size = LevelSize(l);
+			offset += size * size * size;
+		}
+		return offset;
+	}
+
+	Voxel VoxelLod::Reduce(const Voxel* children, LodFilter filter)
+	{
+		ui16 materials[8];
+		ui32 counts[8];
+		ui32 firstChild[8];
+		ui32 distinct = 0;
+		ui32 solid = 0;
+		ui32 r = 0, g = 0, b = 0;
+		for (ui32 i = 0;i < 8;i++) {
+			const Voxel& child = children[i];
+			if (child.IsEmpty()) {
+				continue;
+			}
+			solid++;
+			r += (child.color >> 11) & 31;
+			g += (child.color >> 5) & 63;
+			b += child.color & 31;
+
+			ui32 m = 0;
+			while (m < distinct && materials[m] != child.material) {
+				m++;
+			}
+			if (m == distinct) {
+				materials[m] = child.material;
+				counts[m] = 0;
+				firstChild[m] = i;
+				distinct++;
+			}
+			counts[m]++;
+		}
+
+		if (solid == 0 || (filter == LodFilter::Majority && solid < 4)) {
+			return Voxel{};
+		}
+
+		ui32 best = 0;
+		for (ui32 m = 1;m < distinct;m++) {
+			if (counts[m] > counts[best]) {
+				best = m;
+			}
+		}
+
+		Voxel result = children[firstChild[best]];
+		if (filter == LodFilter::Average) {
+			result.color = static_cast<ui16>(((r / solid) << 11) | ((g / solid) << 5) | (b / solid));
+		}
+		return result;
+	}
+
+	void VoxelLod::RebuildBrick(const Chunk& chunk, ChunkLod& lod, ui32 brick) const
+	{
+		ui32 bx = brick % BRICKS_PER_AXIS;
+		ui32 by = brick / BRICKS_PER_AXIS % BRICKS_PER_AXIS;
+		ui32 bz = brick / (BRICKS_PER_AXIS * BRICKS_PER_AXIS);
+
+		// a brick only reaches the levels where it still covers at least one cell
+		for (ui32 level = 1;level <= BRICK_SIZE_LOG2;level++) {
+			ui32 size = LevelSize(level);
+			ui32 extent = BRICK_SIZE >> level;
+			Voxel* dst = lod.voxels.data() + LevelOffset(level);
+			const Voxel* src = level > 1 ? lod.voxels.data() + LevelOffset(level - 1) : nullptr;
+			ui32 srcSize = size * 2;
+
+			Voxel children[8];
+			for (ui32 z = bz * extent;z < (bz + 1) * extent;z++) {
+				for (ui32 y = by * extent;y < (by + 1) * extent;y++) {
+					for (ui32 x = bx * extent;x < (bx + 1) * extent;x++) {
+						for (ui32 c = 0;c < 8;c++) {
+							ui32 cx = x * 2 + (c & 1);
+							ui32 cy = y * 2 + ((c >> 1) & 1);
+							ui32 cz = z * 2 + (c >> 2);
+							children[c] = src != nullptr ? src[cx + (cy + cz * srcSize) * srcSize] : chunk.Get(cx, cy, cz);
+						}
+						dst[x + (y + z * size) * size] = Reduce(children, filter);
+					}
+				}
+			}
+		}
+	}
+
+	void VoxelLod::RebuildTop(ChunkLod& lod) const
+	{
+		// the coarsest levels span several bricks and are cheap enough to redo whole
+		for (ui32 level = BRICK_SIZE_LOG2 + 1;level < LOD_LEVEL_COUNT;level++) {
+			ui32 size = LevelSize(level);
+			ui32 srcSize = size * 2;
+			Voxel* dst = lod.voxels.data() + LevelOffset(level);
+			const Voxel* src = lod.voxels.data() + LevelOffset(level - 1);
+
+			Voxel children[8];
+			for (ui32 z = 0;z < size;z++) {
+				for (ui32 y = 0;y < size;y++) {
+					for (ui32 x = 0;x < size;x++) {
+						for (ui32 c = 0;c < 8;c++) {
+							ui32 cx = x * 2 + (c & 1);
+							ui32 cy = y * 2 + ((c >> 1) & 1);
+							ui32 cz = z * 2 + (c >> 2);
+							children[c] = src[cx + (cy + cz * srcSize) * srcSize];
+						}
+						dst[x + (y + z * size) * size] = Reduce(children, filter);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+
+// level 0 is the chunk itself, the last level stores a single voxel per chunk.
+#define LOD_LEVEL_COUNT (CHUNK_SIZE_LOG2 + 1)
+
+namespace Luxel
+{
+	enum class LodFilter
+	{
+		// a cell is solid when at least half of its children are, and takes the most common material.
+		Majority,
+		// a cell is solid when any child is; it takes the most common material and the average color.
+		// keeps thin features alive at a distance.
+		Average
+	};
+
+	// mip pyramid of every chunk in a VoxelWorld, rebuilt per dirty brick after edits.
+	// Update must not run while other threads read the pyramid.
+	class LUXEL_API VoxelLod
+	{
+	public:
+		VoxelLod(VoxelWorld* const w, LodFilter f = LodFilter::Majority);
+		~VoxelLod();
+		VoxelLod(const VoxelLod&) = delete;
+		void operator=(const VoxelLod&) = delete;
+
+		// returns the number of chunks whose pyramid was touched.
+		ui32 Update();
+
+		// position is in voxels of the given level, i.e. world voxel position >> level.
+		Voxel Get(const glm::ivec3& position, ui32 level) const;
+		// dense x-y-z data of a level >= 1, LevelSize(level)^3 voxels; nullptr for unknown chunks.
+		const Voxel* GetLevelData(const ChunkCoord& coord, ui32 level) const;
+
+		static ui32 LevelSize(ui32 level);
+
+		// size in pixels of a voxel of voxelSize world units seen at distance.
+		static float ProjectedVoxelSize(float voxelSize, float distance, float fovY, ui32 viewportHeight);
+		// coarsest level whose voxels still cover at most pixelThreshold pixels.
+		static ui32 SelectLevel(float voxelSize, float distance, float fovY, ui32 viewportHeight, float pixelThreshold = 1.f);
+
+		LodFilter GetFilter() const;
+		size_t GetMemoryUsage() const;
+
+	private:
+		struct ChunkLod
+		{
+			// levels 1..LOD_LEVEL_COUNT-1 back to back
+			std::vector<Voxel> voxels;
+		};
+
+		static ui32 LevelOffset(ui32 level);
+		static Voxel Reduce(const Voxel* children, LodFilter filter);
+
+		void RebuildBrick(const Chunk& chunk, ChunkLod& lod, ui32 brick) const;
+		void RebuildTop(ChunkLod& lod) const;
+
+		VoxelWorld* const world;
+		LodFilter filter;
+
+		std::unordered_map<ChunkCoord, std::unique_ptr<ChunkLod>, ChunkCoordHash> chunks;
+		ui64 syncedRevision;
+	};
+}
@@ -0,0 +1,296 @@
+#include "pch.h"
+
+#include "VoxelQuery.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// same cap as VoxelRaycast::Trace
+		constexpr ui32 MAX_STEPS = 1 << 16;
+		constexpr ui32 PACKETS_PER_JOB = 16;
+
+		// the rays of one packet as planes, so positions and box exits of every lane are one set of vector ops.
+		struct Packet
+		{
+			alignas(32) float originX[RAY_PACKET_SIZE], originY[RAY_PACKET_SIZE], originZ[RAY_PACKET_SIZE];
+			alignas(32) float directionX[RAY_PACKET_SIZE], directionY[RAY_PACKET_SIZE], directionZ[RAY_PACKET_SIZE];
+			alignas(32) float invX[RAY_PACKET_SIZE], invY[RAY_PACKET_SIZE], invZ[RAY_PACKET_SIZE];
+			alignas(32) float t[RAY_PACKET_SIZE], entry[RAY_PACKET_SIZE];
+			// box around the current position that the next step leaves
+			alignas(32) float minX[RAY_PACKET_SIZE], minY[RAY_PACKET_SIZE], minZ[RAY_PACKET_SIZE];
+			alignas(32) float maxX[RAY_PACKET_SIZE], maxY[RAY_PACKET_SIZE], maxZ[RAY_PACKET_SIZE];
+			alignas(32) int voxelX[RAY_PACKET_SIZE], voxelY[RAY_PACKET_SIZE], voxelZ[RAY_PACKET_SIZE];
+			alignas(32) int entryAxis[RAY_PACKET_SIZE];
+		};
+
+		inline float Inverse(float d)
+		{
+			return d != 0.f ? 1.f / d : 0.f;
+		}
+
+		// voxel holding origin + direction * t, for every lane
+		inline void Positions(Packet& p)
+		{
+#ifdef LUXEL_SIMD_AVX2
+			__m256 t = _mm256_load_ps(p.t);
+			__m256 x = _mm256_add_ps(_mm256_load_ps(p.originX), _mm256_mul_ps(_mm256_load_ps(p.directionX), t));
+			__m256 y = _mm256_add_ps(_mm256_load_ps(p.originY), _mm256_mul_ps(_mm256_load_ps(p.directionY), t));
+			__m256 z = _mm256_add_ps(_mm256_load_ps(p.originZ), _mm256_mul_ps(_mm256_load_ps(p.directionZ), t));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(p.voxelX), _mm256_cvttps_epi32(_mm256_floor_ps(x)));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(p.voxelY), _mm256_cvttps_epi32(_mm256_floor_ps(y)));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(p.voxelZ), _mm256_cvttps_epi32(_mm256_floor_ps(z)));
+#else
+			for (ui32 lane = 0;lane < RAY_PACKET_SIZE;lane++) {
+				p.voxelX[lane] = static_cast<int>(std::floor(p.originX[lane] + p.directionX[lane] * p.t[lane]));
+				p.voxelY[lane] = static_cast<int>(std::floor(p.originY[lane] + p.directionY[lane] * p.t[lane]));
+				p.voxelZ[lane] = static_cast<int>(std::floor(p.originZ[lane] + p.directionZ[lane] * p.t[lane]));
+			}
+#endif
+		}
+
+#ifdef LUXEL_SIMD_AVX2
+		// distance to where the ray leaves the box along one axis, never for axes the ray does not move along
+		inline __m256 AxisExit(const float* origin, const float* direction, const float* inv, const float* boxMin, const float* boxMax)
+		{
+			__m256 d = _mm256_load_ps(direction);
+			__m256 bound = _mm256_blendv_ps(_mm256_load_ps(boxMin), _mm256_load_ps(boxMax), _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GT_OQ));
+			__m256 t = _mm256_mul_ps(_mm256_sub_ps(bound, _mm256_load_ps(origin)), _mm256_load_ps(inv));
+			return _mm256_blendv_ps(t, _mm256_set1_ps(std::numeric_limits<float>::max()), _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_EQ_OQ));
+		}
+#endif
+
+		// leaves the box of every lane: entry distance and axis of the next cell, t nudged past it
+		inline void Advance(Packet& p)
+		{
+#ifdef LUXEL_SIMD_AVX2
+			__m256 tx = AxisExit(p.originX, p.directionX, p.invX, p.minX, p.maxX);
+			__m256 ty = AxisExit(p.originY, p.directionY, p.invY, p.minY, p.maxY);
+			__m256 tz = AxisExit(p.originZ, p.directionZ, p.invZ, p.minZ, p.maxZ);
+			__m256 exit = _mm256_min_ps(tx, _mm256_min_ps(ty, tz));
+			// ties go to the lowest axis like in VoxelRaycast
+			__m256i isX = _mm256_castps_si256(_mm256_cmp_ps(tx, exit, _CMP_EQ_OQ));
+			__m256i isY = _mm256_castps_si256(_mm256_cmp_ps(ty, exit, _CMP_EQ_OQ));
+			__m256i axis = _mm256_blendv_epi8(_mm256_blendv_epi8(_mm256_set1_epi32(2), _mm256_set1_epi32(1), isY), _mm256_setzero_si256(), isX);
+			__m256 nudge = _mm256_mul_ps(_mm256_set1_ps(1e-4f), _mm256_max_ps(_mm256_set1_ps(1.f), exit));
+			_mm256_store_ps(p.entry, exit);
+			_mm256_store_ps(p.t, _mm256_add_ps(exit, nudge));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(p.entryAxis), axis);
+#else
+			for (ui32 lane = 0;lane < RAY_PACKET_SIZE;lane++) {
+				const float origin[3] = { p.originX[lane], p.originY[lane], p.originZ[lane] };
+				const float direction[3] = { p.directionX[lane], p.directionY[lane], p.directionZ[lane] };
+				const float inv[3] = { p.invX[lane], p.invY[lane], p.invZ[lane] };
+				const float boxMin[3] = { p.minX[lane], p.minY[lane], p.minZ[lane] };
+				const float boxMax[3] = { p.maxX[lane], p.maxY[lane], p.maxZ[lane] };
+				float exit = std::numeric_limits<float>::max();
+				int axis = 0;
+				for (int i = 0;i < 3;i++) {
+					if (direction[i] == 0.f) {
+						continue;
+					}
+					float t = ((direction[i] > 0.f ? boxMax[i] : boxMin[i]) - origin[i]) * inv[i];
+					if (t < exit) {
+						exit = t;
+						axis = i;
+					}
+				}
+				p.entry[lane] = exit;
+				p.t[lane] = exit + 1e-4f * std::max(1.f, exit);
+				p.entryAxis[lane] = axis;
+			}
+#endif
+		}
+
+		inline void SetBox(Packet& p, ui32 lane, const glm::ivec3& boxMin, const glm::ivec3& boxMax)
+		{
+			p.minX[lane] = static_cast<float>(boxMin.x);
+			p.minY[lane] = static_cast<float>(boxMin.y);
+			p.minZ[lane] = static_cast<float>(boxMin.z);
+			p.maxX[lane] = static_cast<float>(boxMax.x);
+			p.maxY[lane] = static_cast<float>(boxMax.y);
+			p.maxZ[lane] = static_cast<float>(boxMax.z);
+		}
+	}
+
+	ui32 VoxelQuery::Trace(const VoxelWorld& world, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, RayHit* hits)
+	{
+		return TraceAll(world, field, rays, count, hits);
+	}
+
+	ui32 VoxelQuery::Trace(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, RayHit* hits)
+	{
+		return TraceAll(snapshot, field, rays, count, hits);
+	}
+
+	ui32 VoxelQuery::Occluded(const VoxelWorld& world, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, bool* occluded)
+	{
+		return OccludedAll(world, field, rays, count, occluded);
+	}
+
+	ui32 VoxelQuery::Occluded(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, bool* occluded)
+	{
+		return OccludedAll(snapshot, field, rays, count, occluded);
+	}
+
+	void VoxelQuery::TracePacket(const VoxelWorld& world, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, RayQueryMode mode, RayHit* hits)
+	{
+		TraceLanes(world, field, rays, count, mode, hits);
+	}
+
+	void VoxelQuery::TracePacket(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, RayQueryMode mode, RayHit* hits)
+	{
+		TraceLanes(snapshot, field, rays, count, mode, hits);
+	}
+
+	template<typename Source>
+	ui32 VoxelQuery::TraceAll(const Source& source, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, RayHit* hits)
+	{
+		std::atomic<ui32> hitCount{ 0 };
+		ui32 packetCount = (count + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE;
+		JobSystem::ParallelFor(packetCount, PACKETS_PER_JOB, [&](ui32 begin, ui32 end) {
+			ui32 jobHits = 0;
+			for (ui32 packet = begin;packet < end;packet++) {
+				ui32 first = packet * RAY_PACKET_SIZE;
+				ui32 size = std::min(count - first, static_cast<ui32>(RAY_PACKET_SIZE));
+				TraceLanes(source, field, rays + first, size, RayQueryMode::FirstHit, hits + first);
+				for (ui32 i = 0;i < size;i++) {
+					jobHits += hits[first + i].hit ? 1 : 0;
+				}
+			}
+			hitCount.fetch_add(jobHits, std::memory_order_relaxed);
+		});
+		return hitCount.load();
+	}
+
+	template<typename Source>
+	ui32 VoxelQuery::OccludedAll(const Source& source, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, bool* occluded)
+	{
+		std::atomic<ui32> hitCount{ 0 };
+		ui32 packetCount = (count + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE;
+		JobSystem::ParallelFor(packetCount, PACKETS_PER_JOB, [&](ui32 begin, ui32 end) {
+			ui32 jobHits = 0;
+			RayHit packetHits[RAY_PACKET_SIZE];
+			for (ui32 packet = begin;packet < end;packet++) {
+				ui32 first = packet * RAY_PACKET_SIZE;
+				ui32 size = std::min(count - first, static_cast<ui32>(RAY_PACKET_SIZE));
+				TraceLanes(source, field, rays + first, size, RayQueryMode::AnyHit, packetHits);
+				for (ui32 i = 0;i < size;i++) {
+					occluded[first + i] = packetHits[i].hit;
+					jobHits += packetHits[i].hit ? 1 : 0;
+				}
+			}
+			hitCount.fetch_add(jobHits, std::memory_order_relaxed);
+		});
+		return hitCount.load();
+	}
+
+	template<typename Source>
+	void VoxelQuery::TraceLanes(const Source& source, const VoxelDistanceField* field,
+		const RayQuery* rays, ui32 count, RayQueryMode mode, RayHit* hits)
+	{
+		count = std::min(count, static_cast<ui32>(RAY_PACKET_SIZE));
+		Packet p{};
+		// lanes past count stay still and are never active
+		ui32 active = 0;
+		for (ui32 lane = 0;lane < count;lane++) {
+			const RayQuery& ray = rays[lane];
+			p.originX[lane] = ray.origin.x;
+			p.originY[lane] = ray.origin.y;
+			p.originZ[lane] = ray.origin.z;
+			p.directionX[lane] = ray.direction.x;
+			p.directionY[lane] = ray.direction.y;
+			p.directionZ[lane] = ray.direction.z;
+			p.invX[lane] = Inverse(ray.direction.x);
+			p.invY[lane] = Inverse(ray.direction.y);
+			p.invZ[lane] = Inverse(ray.direction.z);
+			p.entryAxis[lane] = -1;
+			hits[lane] = RayHit{};
+			active |= 1u << lane;
+		}
+
+		// neighboring rays mostly stay in the same chunk, so each lane keeps the last one it looked up
+		// and only looks again when it crosses into another. the guard keeps cached world chunks alive
+		// through edits on other threads until the packet is done, a snapshot holds its own
+		EpochGuard guard;
+		ChunkCoord cachedCoord[RAY_PACKET_SIZE];
+		const Chunk* cachedChunk[RAY_PACKET_SIZE] = {};
+		ui32 cached = 0;
+
+		while (active != 0) {
+			Positions(p);
+			ui32 lanes = active;
+			while (lanes != 0) {
+				ui32 lane = static_cast<ui32>(std::countr_zero(lanes));
+				lanes &= lanes - 1;
+				RayHit& result = hits[lane];
+				if (!(p.entry[lane] <= rays[lane].maxDistance) || result.steps >= MAX_STEPS) {
+					active &= ~(1u << lane);
+					continue;
+				}
+
+				glm::ivec3 voxel(p.voxelX[lane], p.voxelY[lane], p.voxelZ[lane]);
+				ChunkCoord coord = ToChunkCoord(voxel);
+				if ((cached & (1u << lane)) == 0 || cachedCoord[lane] != coord) {
+					cachedCoord[lane] = coord;
+					cachedChunk[lane] = source.GetChunk(coord);
+					cached |= 1u << lane;
+				}
+				const Chunk* chunk = cachedChunk[lane];
+
+				if (chunk == nullptr) {
+					glm::ivec3 origin = ChunkOrigin(coord);
+					SetBox(p, lane, origin, origin + glm::ivec3(CHUNK_SIZE));
+					continue;
+				}
+				glm::ivec3 local = ToLocalCoord(voxel);
+				glm::ivec3 brickPosition(voxel.x >> BRICK_SIZE_LOG2, voxel.y >> BRICK_SIZE_LOG2, voxel.z >> BRICK_SIZE_LOG2);
+				glm::ivec3 boxMin, boxMax;
+				if (!chunk->IsBrickEmpty(Chunk::BrickIndex(local.x, local.y, local.z))) {
+					Voxel value = chunk->Get(local);
+					if (!value.IsEmpty()) {
+						result.hit = true;
+						result.distance = p.entry[lane];
+						if (mode == RayQueryMode::FirstHit) {
+							result.voxel = voxel;
+							result.value = value;
+							int axis = p.entryAxis[lane];
+							if (axis >= 0) {
+								result.normal[axis] = rays[lane].direction[axis] > 0.f ? -1 : 1;
+							}
+						}
+						active &= ~(1u << lane);
+						continue;
+					}
+					boxMin = voxel;
+					boxMax = voxel + glm::ivec3(1);
+				}
+				else if (field == nullptr || !field->GetEmptyBox(brickPosition, boxMin, boxMax)) {
+					boxMin = brickPosition * BRICK_SIZE;
+					boxMax = boxMin + glm::ivec3(BRICK_SIZE);
+				}
+				SetBox(p, lane, boxMin, boxMax);
+			}
+			if (active == 0) {
+				break;
+			}
+
+			// finished lanes are advanced too, their results are already written
+			Advance(p);
+			ui32 stepped = active;
+			while (stepped != 0) {
+				ui32 lane = static_cast<ui32>(std::countr_zero(stepped));
+				stepped &= stepped - 1;
+				hits[lane].steps++;
+			}
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "VoxelRaycast.h"
+
+// rays traced side by side by one packet, one per AVX2 lane.
+#define RAY_PACKET_SIZE 8
+
+namespace Luxel
+{
+	struct RayQuery
+	{
+		glm::vec3 origin;
+		// the ray only reports solids closer than this, in voxels.
+		float maxDistance;
+		// normalized.
+		glm::vec3 direction;
+		ui32 padding;
+	};
+
+	enum class RayQueryMode
+	{
+		// the closest solid with its face normal and value.
+		FirstHit,
+		// only whether any solid lies within maxDistance, for line of sight.
+		AnyHit
+	};
+
+	// batched raycasts for gameplay: picking, line of sight and projectiles.
+	// each job walks RAY_PACKET_SIZE rays at once, same hits as VoxelRaycast::Trace ray by ray.
+	// queries only read the world and keep no state, so any number may run beside each other
+	// and beside the renderer. chunks removed or replaced meanwhile stay alive until each packet is
+	// done, edits in place to a chunk still have to wait for them like for a frame. queries against a
+	// VoxelSnapshot never wait: editors commit new versions beside them.
+	class LUXEL_API VoxelQuery
+	{
+	public:
+		// fills hits[i] for rays[i], returns how many hit.
+		static ui32 Trace(const VoxelWorld& world, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, RayHit* hits);
+		// sets occluded[i] when a solid lies on rays[i] within its max distance, returns how many are.
+		static ui32 Occluded(const VoxelWorld& world, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, bool* occluded);
+
+		// up to RAY_PACKET_SIZE rays on the calling thread. with AnyHit only hit and distance are filled.
+		static void TracePacket(const VoxelWorld& world, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, RayQueryMode mode, RayHit* hits);
+
+		// the same against a pinned version, a field has to be built from that version.
+		static ui32 Trace(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, RayHit* hits);
+		static ui32 Occluded(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, bool* occluded);
+		static void TracePacket(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, RayQueryMode mode, RayHit* hits);
+
+	private:
+		template<typename Source>
+		static ui32 TraceAll(const Source& source, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, RayHit* hits);
+		template<typename Source>
+		static ui32 OccludedAll(const Source& source, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, bool* occluded);
+		template<typename Source>
+		static void TraceLanes(const Source& source, const VoxelDistanceField* field,
+			const RayQuery* rays, ui32 count, RayQueryMode mode, RayHit* hits);
+	};
+}
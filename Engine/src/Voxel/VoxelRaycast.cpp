@@ -0,0 +1,100 @@
+#include "pch.h"
+
+#include "VoxelRaycast.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		constexpr ui32 MAX_STEPS = 1 << 16;
+
+		// distance along the ray to where it leaves [minCorner, maxCorner), and the axis it leaves through.
+		float ExitDistance(const glm::vec3& origin, const glm::vec3& invDirection, const glm::vec3& direction,
+			const glm::ivec3& minCorner, const glm::ivec3& maxCorner, int& axis)
+		{
+			float exit = std::numeric_limits<float>::max();
+			axis = 0;
+			for (int i = 0;i < 3;i++) {
+				if (direction[i] == 0.f) {
+					continue;
+				}
+				float bound = static_cast<float>(direction[i] > 0.f ? maxCorner[i] : minCorner[i]);
+				float t = (bound - origin[i]) * invDirection[i];
+				if (t < exit) {
+					exit = t;
+					axis = i;
+				}
+			}
+			return exit;
+		}
+	}
+
+	RayHit VoxelRaycast::Trace(const VoxelWorld& world, const VoxelDistanceField* field,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+	{
+		EpochGuard guard;
+		return TraceChunks(world, field, origin, direction, maxDistance);
+	}
+
+	RayHit VoxelRaycast::Trace(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+	{
+		return TraceChunks(snapshot, field, origin, direction, maxDistance);
+	}
+
+	template<typename Source>
+	RayHit VoxelRaycast::TraceChunks(const Source& source, const VoxelDistanceField* field,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+	{
+		RayHit result;
+		glm::vec3 invDirection(
+			direction.x != 0.f ? 1.f / direction.x : 0.f,
+			direction.y != 0.f ? 1.f / direction.y : 0.f,
+			direction.z != 0.f ? 1.f / direction.z : 0.f);
+
+		float t = 0.f;
+		float entry = 0.f;
+		int entryAxis = -1;
+		// the cell is judged by where the ray enters it, t is only nudged past that to look it up
+		while (entry <= maxDistance && result.steps < MAX_STEPS) {
+			glm::ivec3 voxel = glm::ivec3(glm::floor(origin + direction * t));
+			ChunkCoord coord = ToChunkCoord(voxel);
+
+			glm::ivec3 boxMin, boxMax;
+			const Chunk* chunk = source.GetChunk(coord);
+			if (chunk == nullptr) {
+				boxMin = ChunkOrigin(coord);
+				boxMax = boxMin + glm::ivec3(CHUNK_SIZE);
+			}
+			else {
+				glm::ivec3 local = ToLocalCoord(voxel);
+				glm::ivec3 brickPosition(voxel.x >> BRICK_SIZE_LOG2, voxel.y >> BRICK_SIZE_LOG2, voxel.z >> BRICK_SIZE_LOG2);
+				if (!chunk->IsBrickEmpty(Chunk::BrickIndex(local.x, local.y, local.z))) {
+					Voxel value = chunk->Get(local);
+					if (!value.IsEmpty()) {
+						result.hit = true;
+						result.voxel = voxel;
+						result.distance = entry;
+						result.value = value;
+						if (entryAxis >= 0) {
+							result.normal[entryAxis] = direction[entryAxis] > 0.f ? -1 : 1;
+						}
+						return result;
+					}
+					boxMin = voxel;
+					boxMax = voxel + glm::ivec3(1);
+				}
+				else if (field == nullptr || !field->GetEmptyBox(brickPosition, boxMin, boxMax)) {
+					boxMin = brickPosition * BRICK_SIZE;
+					boxMax = boxMin + glm::ivec3(BRICK_SIZE);
+				}
+			}
+
+			entry = ExitDistance(origin, invDirection, direction, boxMin, boxMax, entryAxis);
+			// nudge past the boundary so the next lookup lands in the neighboring cell
+			t = entry + 1e-4f * std::max(1.f, entry);
+			result.steps++;
+		}
+		return result;
+	}
+}
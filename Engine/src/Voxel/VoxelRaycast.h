@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+#include "VoxelSnapshots.h"
+#include "VoxelDistanceField.h"
+
+namespace Luxel
+{
+	struct RayHit
+	{
+		bool hit = false;
+		glm::ivec3 voxel = glm::ivec3(0);
+		// face that was entered, zero when the ray starts inside a solid voxel.
+		glm::ivec3 normal = glm::ivec3(0);
+		float distance = 0.f;
+		Voxel value;
+		// empty boxes crossed before the hit, the cost measure for traversal.
+		ui32 steps = 0;
+	};
+
+	// CPU reference traversal, mirrored by sceneTrace in shaders/voxel_scene.glsl.
+	class LUXEL_API VoxelRaycast
+	{
+	public:
+		// direction must be normalized, distances are in voxels.
+		// without a field, unallocated chunks and empty bricks are still skipped whole;
+		// with one, each step jumps over the empty box around the current brick.
+		static RayHit Trace(const VoxelWorld& world, const VoxelDistanceField* field,
+			const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+		// reads a pinned version, unaffected by commits meanwhile. a field has to be built from the same version.
+		static RayHit Trace(const VoxelSnapshot& snapshot, const VoxelDistanceField* field,
+			const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+
+	private:
+		template<typename Source>
+		static RayHit TraceChunks(const Source& source, const VoxelDistanceField* field,
+			const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+	};
+}
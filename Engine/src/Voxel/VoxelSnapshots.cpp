@@ -0,0 +1,438 @@
+#include "pch.h"
+
+#include "VoxelSnapshots.h"
+
+namespace Luxel
+{
+	VoxelSnapshot::VoxelSnapshot() : version{ nullptr }
+	{
+
+	}
+
+	VoxelSnapshot::~VoxelSnapshot()
+	{
+		Release(version);
+	}
+
+	VoxelSnapshot::VoxelSnapshot(const VoxelSnapshot& other) : version{ other.version }
+	{
+		if (version != nullptr) {
+			version->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	VoxelSnapshot::VoxelSnapshot(VoxelSnapshot&& other) noexcept : version{ other.version }
+	{
+		other.version = nullptr;
+	}
+
+	VoxelSnapshot& VoxelSnapshot::operator=(VoxelSnapshot other) noexcept
+	{
+		std::swap(version, other.version);
+		return *this;
+	}
+
+	bool VoxelSnapshot::IsValid() const
+	{
+		return version != nullptr;
+	}
+
+	ui64 VoxelSnapshot::GetVersion() const
+	{
+		return version == nullptr ? 0 : version->number;
+	}
+
+	const Chunk* VoxelSnapshot::GetChunk(const ChunkCoord& coord) const
+	{
+		if (version == nullptr) {
+			return nullptr;
+		}
+		const Shard* shard = version->shards[ShardIndex(coord)].get();
+		if (shard == nullptr) {
+			return nullptr;
+		}
+		auto it = shard->chunks.find(coord);
+		return it == shard->chunks.end() ? nullptr : it->second.get();
+	}
+
+	std::shared_ptr<const Chunk> VoxelSnapshot::ShareChunk(const ChunkCoord& coord) const
+	{
+		if (version == nullptr) {
+			return nullptr;
+		}
+		const Shard* shard = version->shards[ShardIndex(coord)].get();
+		if (shard == nullptr) {
+			return nullptr;
+		}
+		auto it = shard->chunks.find(coord);
+		return it == shard->chunks.end() ? nullptr : it->second;
+	}
+
+	Voxel VoxelSnapshot::GetVoxel(const glm::ivec3& position) const
+	{
+		const Chunk* chunk = GetChunk(ToChunkCoord(position));
+		if (chunk == nullptr) {
+			return Voxel{};
+		}
+		return chunk->Get(ToLocalCoord(position));
+	}
+
+	size_t VoxelSnapshot::GetChunkCount() const
+	{
+		return version == nullptr ? 0 : version->chunkCount;
+	}
+
+	std::vector<ChunkCoord> VoxelSnapshot::GetChunkCoords() const
+	{
+		std::vector<ChunkCoord> coords;
+		coords.reserve(GetChunkCount());
+		ForEachChunk([&coords](const ChunkCoord& coord, const Chunk&) { coords.push_back(coord); });
+		return coords;
+	}
+
+	void VoxelSnapshot::ForEachChunk(const std::function<void(const ChunkCoord&, const Chunk&)>& func) const
+	{
+		if (version == nullptr) {
+			return;
+		}
+		for (const auto& shard : version->shards) {
+			if (shard == nullptr) {
+				continue;
+			}
+			for (const auto& [coord, chunk] : shard->chunks) {
+				func(coord, *chunk);
+			}
+		}
+	}
+
+	std::vector<ChunkCoord> VoxelSnapshot::Diff(const VoxelSnapshot& other) const
+	{
+		std::vector<ChunkCoord> coords;
+		for (ui32 i = 0;i < SNAPSHOT_SHARDS;i++) {
+			const Shard* a = version == nullptr ? nullptr : version->shards[i].get();
+			const Shard* b = other.version == nullptr ? nullptr : other.version->shards[i].get();
+			if (a == b) {
+				continue;
+			}
+			if (a != nullptr) {
+				for (const auto& [coord, chunk] : a->chunks) {
+					if (b == nullptr) {
+						coords.push_back(coord);
+						continue;
+					}
+					auto it = b->chunks.find(coord);
+					if (it == b->chunks.end() || it->second != chunk) {
+						coords.push_back(coord);
+					}
+				}
+			}
+			if (b != nullptr) {
+				for (const auto& [coord, chunk] : b->chunks) {
+					if (a == nullptr || a->chunks.find(coord) == a->chunks.end()) {
+						coords.push_back(coord);
+					}
+				}
+			}
+		}
+		return coords;
+	}
+
+	void VoxelSnapshot::Release(Version* version)
+	{
+		if (version != nullptr && version->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete version;
+		}
+	}
+
+	VoxelTransaction::VoxelTransaction(VoxelSnapshot base) : base{ std::move(base) }
+	{
+
+	}
+
+	Chunk& VoxelTransaction::Edit(const ChunkCoord& coord)
+	{
+		auto it = touched.find(coord);
+		if (it != touched.end()) {
+			// a chunk removed in this transaction starts over empty
+			if (it->second == nullptr) {
+				it->second = std::make_shared<Chunk>();
+			}
+			return *it->second;
+		}
+		const Chunk* original = base.GetChunk(coord);
+		auto& chunk = touched[coord];
+		chunk = original != nullptr ? std::make_shared<Chunk>(*original) : std::make_shared<Chunk>();
+		return *chunk;
+	}
+
+	const Chunk* VoxelTransaction::GetChunk(const ChunkCoord& coord) const
+	{
+		auto it = touched.find(coord);
+		if (it != touched.end()) {
+			return it->second.get();
+		}
+		return base.GetChunk(coord);
+	}
+
+	Voxel VoxelTransaction::GetVoxel(const glm::ivec3& position) const
+	{
+		const Chunk* chunk = GetChunk(ToChunkCoord(position));
+		if (chunk == nullptr) {
+			return Voxel{};
+		}
+		return chunk->Get(ToLocalCoord(position));
+	}
+
+	void VoxelTransaction::SetVoxel(const glm::ivec3& position, const Voxel& voxel)
+	{
+		ChunkCoord coord = ToChunkCoord(position);
+		if (voxel.IsEmpty() && GetChunk(coord) == nullptr) {
+			return;
+		}
+		Edit(coord).Set(ToLocalCoord(position), voxel);
+	}
+
+	void VoxelTransaction::InsertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+	{
+		touched[coord] = std::move(chunk);
+	}
+
+	void VoxelTransaction::RemoveChunk(const ChunkCoord& coord)
+	{
+		touched[coord] = nullptr;
+	}
+
+	bool VoxelTransaction::IsEmpty() const
+	{
+		return touched.empty();
+	}
+
+	size_t VoxelTransaction::GetTouchedCount() const
+	{
+		return touched.size();
+	}
+
+	const VoxelSnapshot& VoxelTransaction::GetBase() const
+	{
+		return base;
+	}
+
+	VoxelSnapshots::VoxelSnapshots(ui32 maxHistory) : head{ new VoxelSnapshot::Version() }, versionCount{ 0 }, maxHistory{ maxHistory }
+	{
+
+	}
+
+	VoxelSnapshots::~VoxelSnapshots()
+	{
+		undoStack.clear();
+		redoStack.clear();
+		VoxelSnapshot::Release(head.load());
+		Epoch::Collect();
+	}
+
+	VoxelSnapshot VoxelSnapshots::Acquire() const
+	{
+		// the head keeps its reference until every thread that could have loaded it left its guard
+		EpochGuard guard;
+		VoxelSnapshot::Version* version = head.load(std::memory_order_acquire);
+		version->refs.fetch_add(1, std::memory_order_relaxed);
+		return VoxelSnapshot(version);
+	}
+
+	VoxelTransaction VoxelSnapshots::Begin() const
+	{
+		return VoxelTransaction(Acquire());
+	}
+
+	ui64 VoxelSnapshots::Commit(VoxelTransaction&& transaction)
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		auto start = std::chrono::high_resolution_clock::now();
+		if (transaction.IsEmpty()) {
+			return head.load()->number;
+		}
+
+		VoxelSnapshot current = Acquire();
+		auto next = std::make_unique<VoxelSnapshot::Version>();
+		next->shards = current.version->shards;
+		next->chunkCount = current.version->chunkCount;
+		next->number = ++versionCount;
+
+		// one copy per touched shard, the chunks in it stay shared
+		std::array<std::shared_ptr<VoxelSnapshot::Shard>, SNAPSHOT_SHARDS> copies;
+		ui32 shardsCopied = 0;
+		ui32 chunksRebased = 0;
+		for (auto& [coord, chunk] : transaction.touched) {
+			// a commit since the base replaced this chunk, keep its edits and apply only the voxels changed here
+			std::shared_ptr<const Chunk> original = transaction.base.ShareChunk(coord);
+			std::shared_ptr<const Chunk> latest = current.ShareChunk(coord);
+			if (original != latest) {
+				chunk = Rebase(original.get(), chunk.get(), latest.get());
+				chunksRebased++;
+			}
+
+			ui32 index = VoxelSnapshot::ShardIndex(coord);
+			auto& shard = copies[index];
+			if (shard == nullptr) {
+				const auto& original = next->shards[index];
+				shard = original != nullptr ? std::make_shared<VoxelSnapshot::Shard>(*original) : std::make_shared<VoxelSnapshot::Shard>();
+				shardsCopied++;
+			}
+			size_t before = shard->chunks.size();
+			if (chunk == nullptr || chunk->IsEmpty()) {
+				shard->chunks.erase(coord);
+			}
+			else {
+				chunk->SetRevision(next->number);
+				shard->chunks[coord] = std::move(chunk);
+			}
+			next->chunkCount = next->chunkCount + shard->chunks.size() - before;
+		}
+		for (ui32 i = 0;i < SNAPSHOT_SHARDS;i++) {
+			if (copies[i] != nullptr) {
+				next->shards[i] = copies[i]->chunks.empty() ? nullptr : std::move(copies[i]);
+			}
+		}
+
+		stats.commits++;
+		stats.chunksCopied = static_cast<ui32>(transaction.touched.size());
+		stats.shardsCopied = shardsCopied;
+		stats.chunksRebased = chunksRebased;
+		transaction.touched.clear();
+
+		PushUndo(std::move(current));
+		redoStack.clear();
+		Publish(VoxelSnapshot(next.release()));
+		stats.commitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return versionCount;
+	}
+
+	ui64 VoxelSnapshots::Import(const VoxelWorld& world)
+	{
+		VoxelTransaction transaction = Begin();
+		VoxelSnapshot base = transaction.GetBase();
+		// chunks only the snapshot has go as well
+		base.ForEachChunk([&transaction](const ChunkCoord& coord, const Chunk&) { transaction.RemoveChunk(coord); });
+		for (const ChunkCoord& coord : world.GetChunkCoords()) {
+			EpochGuard guard;
+			const Chunk* chunk = world.GetChunk(coord);
+			if (chunk != nullptr) {
+				transaction.InsertChunk(coord, std::make_unique<Chunk>(*chunk));
+			}
+		}
+		return Commit(std::move(transaction));
+	}
+
+	VoxelSnapshot VoxelSnapshots::Sync(VoxelWorld& world, const VoxelSnapshot& previous) const
+	{
+		VoxelSnapshot current = Acquire();
+		for (const ChunkCoord& coord : current.Diff(previous)) {
+			const Chunk* chunk = current.GetChunk(coord);
+			if (chunk != nullptr) {
+				world.InsertChunk(coord, std::make_unique<Chunk>(*chunk));
+			}
+			else {
+				world.RemoveChunk(coord);
+			}
+		}
+		return current;
+	}
+
+	bool VoxelSnapshots::Undo()
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		if (undoStack.empty()) {
+			return false;
+		}
+		redoStack.push_back(Acquire());
+		VoxelSnapshot previous = std::move(undoStack.back());
+		undoStack.pop_back();
+		Publish(std::move(previous));
+		return true;
+	}
+
+	bool VoxelSnapshots::Redo()
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		if (redoStack.empty()) {
+			return false;
+		}
+		PushUndo(Acquire());
+		VoxelSnapshot next = std::move(redoStack.back());
+		redoStack.pop_back();
+		Publish(std::move(next));
+		return true;
+	}
+
+	bool VoxelSnapshots::CanUndo() const
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		return !undoStack.empty();
+	}
+
+	bool VoxelSnapshots::CanRedo() const
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		return !redoStack.empty();
+	}
+
+	void VoxelSnapshots::ClearHistory()
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		undoStack.clear();
+		redoStack.clear();
+	}
+
+	SnapshotStats VoxelSnapshots::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		SnapshotStats result = stats;
+		result.undoDepth = static_cast<ui32>(undoStack.size());
+		result.redoDepth = static_cast<ui32>(redoStack.size());
+		return result;
+	}
+
+	std::shared_ptr<Chunk> VoxelSnapshots::Rebase(const Chunk* original, const Chunk* edited, const Chunk* latest)
+	{
+		// missing chunks read as air, so inserts and removals merge like any other edit
+		std::vector<ui32> before(CHUNK_VOLUME, 0);
+		std::vector<ui32> after(CHUNK_VOLUME, 0);
+		std::vector<ui32> merged(CHUNK_VOLUME, 0);
+		if (original != nullptr) {
+			original->Decode(before.data());
+		}
+		if (edited != nullptr) {
+			edited->Decode(after.data());
+		}
+		if (latest != nullptr) {
+			latest->Decode(merged.data());
+		}
+		for (ui32 i = 0;i < CHUNK_VOLUME;i++) {
+			if (after[i] != before[i]) {
+				merged[i] = after[i];
+			}
+		}
+		auto chunk = std::make_shared<Chunk>();
+		chunk->Load(merged.data());
+		return chunk;
+	}
+
+	void VoxelSnapshots::Publish(VoxelSnapshot next)
+	{
+		VoxelSnapshot::Version* version = next.version;
+		next.version = nullptr;
+		VoxelSnapshot::Version* previous = head.exchange(version);
+		Epoch::Retire(previous, [](void* p) { VoxelSnapshot::Release(static_cast<VoxelSnapshot::Version*>(p)); });
+	}
+
+	void VoxelSnapshots::PushUndo(VoxelSnapshot snapshot)
+	{
+		if (maxHistory == 0) {
+			return;
+		}
+		if (undoStack.size() >= maxHistory) {
+			undoStack.pop_front();
+		}
+		undoStack.push_back(std::move(snapshot));
+	}
+}
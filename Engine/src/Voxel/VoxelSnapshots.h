@@ -0,0 +1,166 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/Epoch.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+
+// a version is this many shards of chunks, a commit copies only the shards it touches.
+#define SNAPSHOT_SHARDS 256
+#define SNAPSHOT_HISTORY 64
+
+namespace Luxel
+{
+	// one immutable version of the world. chunks are shared between every version that did not
+	// touch them and live as long as the last snapshot holding them. copies are cheap, take one at
+	// the start of a frame and read from it without locks while editors commit new versions.
+	class LUXEL_API VoxelSnapshot
+	{
+	public:
+		// holds no version, reads as an empty world.
+		VoxelSnapshot();
+		~VoxelSnapshot();
+		VoxelSnapshot(const VoxelSnapshot& other);
+		VoxelSnapshot(VoxelSnapshot&& other) noexcept;
+		VoxelSnapshot& operator=(VoxelSnapshot other) noexcept;
+
+		bool IsValid() const;
+		ui64 GetVersion() const;
+
+		const Chunk* GetChunk(const ChunkCoord& coord) const;
+		std::shared_ptr<const Chunk> ShareChunk(const ChunkCoord& coord) const;
+		Voxel GetVoxel(const glm::ivec3& position) const;
+
+		size_t GetChunkCount() const;
+		std::vector<ChunkCoord> GetChunkCoords() const;
+		void ForEachChunk(const std::function<void(const ChunkCoord&, const Chunk&)>& func) const;
+
+		// coords whose chunk is not the same in both, shards the versions share are skipped unread.
+		std::vector<ChunkCoord> Diff(const VoxelSnapshot& other) const;
+
+		static ui32 ShardIndex(const ChunkCoord& coord)
+		{
+			return static_cast<ui32>(ChunkCoordHash()(coord) >> 24) & (SNAPSHOT_SHARDS - 1);
+		}
+
+	private:
+		struct Shard
+		{
+			std::unordered_map<ChunkCoord, std::shared_ptr<const Chunk>, ChunkCoordHash> chunks;
+		};
+
+		struct Version
+		{
+			std::array<std::shared_ptr<const Shard>, SNAPSHOT_SHARDS> shards;
+			ui64 number = 0;
+			size_t chunkCount = 0;
+			std::atomic<ui32> refs{ 1 };
+		};
+
+		// adopts a reference to version.
+		explicit VoxelSnapshot(Version* version) : version{ version } { }
+		static void Release(Version* version);
+
+		Version* version;
+
+		friend class VoxelSnapshots;
+	};
+
+	// edits against a snapshot. a chunk is copied the first time it is edited, everything else stays
+	// shared with the base until VoxelSnapshots::Commit publishes the result.
+	class LUXEL_API VoxelTransaction
+	{
+	public:
+		explicit VoxelTransaction(VoxelSnapshot base);
+		VoxelTransaction(const VoxelTransaction&) = delete;
+		void operator=(const VoxelTransaction&) = delete;
+		VoxelTransaction(VoxelTransaction&&) = default;
+
+		// the private copy of the chunk at coord, made on the first call; an empty chunk if there is none.
+		Chunk& Edit(const ChunkCoord& coord);
+		// sees the edits of this transaction.
+		const Chunk* GetChunk(const ChunkCoord& coord) const;
+		Voxel GetVoxel(const glm::ivec3& position) const;
+		void SetVoxel(const glm::ivec3& position, const Voxel& voxel);
+		void InsertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+		void RemoveChunk(const ChunkCoord& coord);
+
+		bool IsEmpty() const;
+		size_t GetTouchedCount() const;
+		const VoxelSnapshot& GetBase() const;
+
+	private:
+		VoxelSnapshot base;
+		// nullptr marks a removed chunk
+		std::unordered_map<ChunkCoord, std::shared_ptr<Chunk>, ChunkCoordHash> touched;
+
+		friend class VoxelSnapshots;
+	};
+
+	struct SnapshotStats
+	{
+		ui64 commits = 0;
+		// of the last commit
+		ui32 chunksCopied = 0;
+		ui32 shardsCopied = 0;
+		// touched chunks that another commit had replaced since the transaction began
+		ui32 chunksRebased = 0;
+		double commitMilliseconds = 0.0;
+		ui32 undoDepth = 0;
+		ui32 redoDepth = 0;
+	};
+
+	// versioned world: readers Acquire the head without locks, one writer at a time commits
+	// transactions on top of it. replaced heads are kept as undo history up to maxHistory versions,
+	// and a version is freed once neither the history nor any reader holds it.
+	class LUXEL_API VoxelSnapshots
+	{
+	public:
+		VoxelSnapshots(ui32 maxHistory = SNAPSHOT_HISTORY);
+		~VoxelSnapshots();
+		VoxelSnapshots(const VoxelSnapshots&) = delete;
+		void operator=(const VoxelSnapshots&) = delete;
+
+		VoxelSnapshot Acquire() const;
+		VoxelTransaction Begin() const;
+
+		// applies the touched chunks over the current head. where another commit replaced a chunk since
+		// the base, only the voxels this transaction changed are written into the newer one, so edits to
+		// different voxels of a chunk all survive and the last commit wins only per voxel.
+		// returns the new version number.
+		ui64 Commit(VoxelTransaction&& transaction);
+		// copies every chunk of world into a new head.
+		ui64 Import(const VoxelWorld& world);
+		// brings world from previous, the snapshot it was last synced to, up to the head by copying
+		// only the chunks that differ. returns the head it synced to.
+		VoxelSnapshot Sync(VoxelWorld& world, const VoxelSnapshot& previous) const;
+
+		bool Undo();
+		bool Redo();
+		bool CanUndo() const;
+		bool CanRedo() const;
+		void ClearHistory();
+
+		SnapshotStats GetStats() const;
+
+	private:
+		// takes the reference of next and retires the one the old head held.
+		void Publish(VoxelSnapshot next);
+		void PushUndo(VoxelSnapshot snapshot);
+		// latest with the voxels that differ between original and edited taken from edited, any may be nullptr.
+		static std::shared_ptr<Chunk> Rebase(const Chunk* original, const Chunk* edited, const Chunk* latest);
+
+		std::atomic<VoxelSnapshot::Version*> head;
+		mutable std::mutex writeMutex;
+		std::deque<VoxelSnapshot> undoStack;
+		std::deque<VoxelSnapshot> redoStack;
+		ui64 versionCount;
+		ui32 maxHistory;
+		SnapshotStats stats;
+	};
+}
@@ -0,0 +1,171 @@
+#include "pch.h"
+
+#include "VoxelWorld.h"
+
+namespace Luxel
+{
+	VoxelWorld::VoxelWorld() : revision{ 0 }
+	{
+
+	}
+
+	VoxelWorld::~VoxelWorld()
+	{
+
+	}
+
+	Voxel VoxelWorld::GetVoxel(const glm::ivec3& position) const
+	{
+		EpochGuard guard;
+		const Chunk* chunk = GetChunk(ToChunkCoord(position));
+		if (chunk == nullptr) {
+			return Voxel{};
+		}
+		return chunk->Get(ToLocalCoord(position));
+	}
+
+	void VoxelWorld::SetVoxel(const glm::ivec3& position, const Voxel& voxel)
+	{
+		EpochGuard guard;
+		ChunkCoord coord = ToChunkCoord(position);
+		if (voxel.IsEmpty()) {
+			Chunk* chunk = GetChunk(coord);
+			if (chunk == nullptr) {
+				return;
+			}
+			glm::ivec3 local = ToLocalCoord(position);
+			chunk->Set(local, voxel);
+			if (chunk->IsEmpty()) {
+				RemoveChunk(coord);
+			}
+			else {
+				chunk->SetRevision(++revision, 1ull << Chunk::BrickIndex(local.x, local.y, local.z));
+			}
+			return;
+		}
+		glm::ivec3 local = ToLocalCoord(position);
+		Chunk* chunk = GetOrCreateChunk(coord);
+		chunk->Set(local, voxel);
+		chunk->SetRevision(++revision, 1ull << Chunk::BrickIndex(local.x, local.y, local.z));
+	}
+
+	Chunk* VoxelWorld::GetChunk(const ChunkCoord& coord)
+	{
+		return chunks.Find(coord);
+	}
+
+	const Chunk* VoxelWorld::GetChunk(const ChunkCoord& coord) const
+	{
+		return chunks.Find(coord);
+	}
+
+	Chunk* VoxelWorld::GetOrCreateChunk(const ChunkCoord& coord)
+	{
+		Chunk* chunk = GetChunk(coord);
+		if (chunk != nullptr) {
+			return chunk;
+		}
+		auto [stored, inserted] = chunks.Insert(coord, std::make_unique<Chunk>());
+		if (inserted) {
+			stored->SetRevision(++revision);
+		}
+		return stored;
+	}
+
+	void VoxelWorld::InsertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+	{
+		chunk->SetRevision(++revision);
+		chunks.Replace(coord, std::move(chunk));
+	}
+
+	Chunk* VoxelWorld::TryInsertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+	{
+		chunk->SetRevision(++revision);
+		auto [stored, inserted] = chunks.Insert(coord, std::move(chunk));
+		return inserted ? stored : nullptr;
+	}
+
+	void VoxelWorld::MergeChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk, bool keepExisting)
+	{
+		EpochGuard guard;
+		Chunk* merged = chunks.Merge(coord, std::move(chunk), [keepExisting](Chunk& existing, const Chunk& source) {
+			if (keepExisting) {
+				existing.MergeUnder(source);
+			}
+			else {
+				existing.Merge(source);
+			}
+		});
+		merged->SetRevision(++revision);
+	}
+
+	void VoxelWorld::RemoveChunk(const ChunkCoord& coord)
+	{
+		if (chunks.Erase(coord)) {
+			++revision;
+		}
+	}
+
+	void VoxelWorld::Clear()
+	{
+		chunks.Clear();
+		++revision;
+	}
+
+	void VoxelWorld::MarkModified(const ChunkCoord& coord, ui64 modifiedBricks)
+	{
+		EpochGuard guard;
+		Chunk* chunk = GetChunk(coord);
+		if (chunk != nullptr) {
+			chunk->SetRevision(++revision, modifiedBricks);
+		}
+		else {
+			++revision;
+		}
+	}
+
+	ui64 VoxelWorld::GetRevision() const
+	{
+		return revision.load();
+	}
+
+	std::vector<ChunkCoord> VoxelWorld::GetModifiedChunks(ui64 sinceRevision) const
+	{
+		EpochGuard guard;
+		std::vector<ChunkCoord> coords;
+		chunks.ForEach([&](const ChunkCoord& coord, Chunk& chunk) {
+			if (chunk.GetRevision() > sinceRevision) {
+				coords.push_back(coord);
+			}
+		});
+		return coords;
+	}
+
+	size_t VoxelWorld::GetChunkCount() const
+	{
+		return chunks.GetCount();
+	}
+
+	size_t VoxelWorld::GetMemoryUsage() const
+	{
+		EpochGuard guard;
+		size_t bytes = 0;
+		chunks.ForEach([&bytes](const ChunkCoord&, Chunk& chunk) { bytes += chunk.GetMemoryUsage(); });
+		return bytes;
+	}
+
+	std::vector<ChunkCoord> VoxelWorld::GetChunkCoords() const
+	{
+		EpochGuard guard;
+		std::vector<ChunkCoord> coords;
+		coords.reserve(chunks.GetCount());
+		chunks.ForEach([&coords](const ChunkCoord& coord, Chunk&) { coords.push_back(coord); });
+		return coords;
+	}
+
+	void VoxelWorld::ForEachChunk(const std::function<void(const ChunkCoord&, Chunk&)>& func)
+	{
+		EpochGuard guard;
+		chunks.ForEach(func);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "ChunkMap.h"
+
+namespace Luxel
+{
+	// sparse voxel storage: only chunks holding solid voxels are allocated. chunk lookups never lock,
+	// a chunk removed or replaced by another thread stays alive while this thread is in an EpochGuard.
+	class LUXEL_API VoxelWorld
+	{
+	public:
+		VoxelWorld();
+		~VoxelWorld();
+		VoxelWorld(const VoxelWorld&) = delete;
+		void operator=(const VoxelWorld&) = delete;
+
+		Voxel GetVoxel(const glm::ivec3& position) const;
+		void SetVoxel(const glm::ivec3& position, const Voxel& voxel);
+
+		// the returned chunk is only safe to use while the caller holds an EpochGuard.
+		Chunk* GetChunk(const ChunkCoord& coord);
+		const Chunk* GetChunk(const ChunkCoord& coord) const;
+		Chunk* GetOrCreateChunk(const ChunkCoord& coord);
+
+		// takes ownership; an existing chunk at coord is replaced.
+		void InsertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+		// takes ownership unless coord already holds a chunk, which is kept and chunk dropped.
+		// returns the stored chunk, nullptr when it was dropped; use it inside an EpochGuard.
+		Chunk* TryInsertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+		// merges the solid voxels of chunk into whatever is stored at coord. with keepExisting the stored
+		// voxels win and chunk only fills the empty ones.
+		void MergeChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk, bool keepExisting = false);
+		void RemoveChunk(const ChunkCoord& coord);
+		void Clear();
+
+		// bumps the world revision and stamps it on the chunk; call after editing a chunk in place.
+		void MarkModified(const ChunkCoord& coord, ui64 modifiedBricks = ~0ull);
+		ui64 GetRevision() const;
+		std::vector<ChunkCoord> GetModifiedChunks(ui64 sinceRevision) const;
+
+		size_t GetChunkCount() const;
+		// bytes held by the chunks, see Chunk::GetMemoryUsage.
+		size_t GetMemoryUsage() const;
+		std::vector<ChunkCoord> GetChunkCoords() const;
+		void ForEachChunk(const std::function<void(const ChunkCoord&, Chunk&)>& func);
+
+	private:
+		std::atomic<ui64> revision;
+		ChunkMap chunks;
+	};
+}
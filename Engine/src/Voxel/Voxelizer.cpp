@@ -0,0 +1,319 @@
+#include "pch.h"
+
+#include "Voxelizer.h"
+
+namespace Luxel
+{
+	namespace
+	{
+		// triangle normal + 9 edge/box cross products; the 3 box normals are covered by the aabb clip.
+		constexpr ui32 SEPARATING_AXIS_COUNT = 10;
+
+		// separating-axis form of the triangle/box test: a box centered at c (half size 0.5)
+		// overlaps the triangle iff lo[i] <= dot(axis[i], c) <= hi[i] for every axis.
+		struct TriangleSetup
+		{
+			alignas(32) float ax[SEPARATING_AXIS_COUNT];
+			alignas(32) float ay[SEPARATING_AXIS_COUNT];
+			alignas(32) float az[SEPARATING_AXIS_COUNT];
+			alignas(32) float lo[SEPARATING_AXIS_COUNT];
+			alignas(32) float hi[SEPARATING_AXIS_COUNT];
+
+			glm::vec3 v0, e1, e2;
+			float d00, d01, d11, invDenom;
+			glm::ivec3 minVoxel, maxVoxel;
+		};
+
+		bool SetupTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, VoxelizeMode mode, TriangleSetup& setup)
+		{
+			const float halfSize = 0.5f;
+			const float epsilon = 1e-5f;
+
+			glm::vec3 edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+			glm::vec3 normal = glm::cross(edges[0], v2 - v0);
+			if (glm::dot(normal, normal) < 1e-12f) {
+				return false;
+			}
+
+			// plane axis; surface mode only keeps the dominant normal component for a thin shell.
+			glm::vec3 absNormal = glm::abs(normal);
+			float planeRadius = mode == VoxelizeMode::Surface
+				? halfSize * std::max(absNormal.x, std::max(absNormal.y, absNormal.z))
+				: halfSize * (absNormal.x + absNormal.y + absNormal.z);
+			float planeDistance = glm::dot(normal, v0);
+			setup.ax[0] = normal.x;
+			setup.ay[0] = normal.y;
+			setup.az[0] = normal.z;
+			setup.lo[0] = planeDistance - planeRadius - epsilon;
+			setup.hi[0] = planeDistance + planeRadius + epsilon;
+
+			// edge cross box axes
+			ui32 axis = 1;
+			for (ui32 i = 0;i < 3;i++) {
+				for (ui32 j = 0;j < 3;j++) {
+					glm::vec3 boxAxis(0.f);
+					boxAxis[i] = 1.f;
+					glm::vec3 a = glm::cross(boxAxis, edges[j]);
+
+					float p0 = glm::dot(a, v0);
+					float p1 = glm::dot(a, v1);
+					float p2 = glm::dot(a, v2);
+					float radius = halfSize * (std::abs(a.x) + std::abs(a.y) + std::abs(a.z));
+
+					setup.ax[axis] = a.x;
+					setup.ay[axis] = a.y;
+					setup.az[axis] = a.z;
+					setup.lo[axis] = std::min(p0, std::min(p1, p2)) - radius - epsilon;
+					setup.hi[axis] = std::max(p0, std::max(p1, p2)) + radius + epsilon;
+					axis++;
+				}
+			}
+
+			// barycentric setup for attribute interpolation
+			setup.v0 = v0;
+			setup.e1 = v1 - v0;
+			setup.e2 = v2 - v0;
+			setup.d00 = glm::dot(setup.e1, setup.e1);
+			setup.d01 = glm::dot(setup.e1, setup.e2);
+			setup.d11 = glm::dot(setup.e2, setup.e2);
+			setup.invDenom = 1.f / (setup.d00 * setup.d11 - setup.d01 * setup.d01);
+
+			glm::vec3 minV = glm::min(v0, glm::min(v1, v2));
+			glm::vec3 maxV = glm::max(v0, glm::max(v1, v2));
+			setup.minVoxel = glm::ivec3(glm::floor(minV));
+			setup.maxVoxel = glm::ivec3(glm::floor(maxV));
+			return true;
+		}
+
+		// tests a row of boxes starting at center (cx, cy, cz), one per lane along +x.
+#ifdef LUXEL_SIMD_AVX2
+		constexpr ui32 ROW_LANES = 8;
+
+		ui32 OverlapRow(const TriangleSetup& setup, float cx, float cy, float cz)
+		{
+			const __m256 cxs = _mm256_add_ps(_mm256_set1_ps(cx), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f));
+			__m256 pass = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (ui32 i = 0;i < SEPARATING_AXIS_COUNT;i++) {
+				float rowBase = setup.ay[i] * cy + setup.az[i] * cz;
+				__m256 d = _mm256_fmadd_ps(_mm256_set1_ps(setup.ax[i]), cxs, _mm256_set1_ps(rowBase));
+				pass = _mm256_and_ps(pass, _mm256_cmp_ps(d, _mm256_set1_ps(setup.lo[i]), _CMP_GE_OQ));
+				pass = _mm256_and_ps(pass, _mm256_cmp_ps(d, _mm256_set1_ps(setup.hi[i]), _CMP_LE_OQ));
+			}
+			return static_cast<ui32>(_mm256_movemask_ps(pass));
+		}
+#else
+		constexpr ui32 ROW_LANES = 4;
+
+		ui32 OverlapRow(const TriangleSetup& setup, float cx, float cy, float cz)
+		{
+			const __m128 cxs = _mm_add_ps(_mm_set1_ps(cx), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+			__m128 pass = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (ui32 i = 0;i < SEPARATING_AXIS_COUNT;i++) {
+				float rowBase = setup.ay[i] * cy + setup.az[i] * cz;
+				__m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(setup.ax[i]), cxs), _mm_set1_ps(rowBase));
+				pass = _mm_and_ps(pass, _mm_cmpge_ps(d, _mm_set1_ps(setup.lo[i])));
+				pass = _mm_and_ps(pass, _mm_cmple_ps(d, _mm_set1_ps(setup.hi[i])));
+			}
+			return static_cast<ui32>(_mm_movemask_ps(pass));
+		}
+#endif
+
+		glm::vec3 InterpolateColor(const TriangleSetup& setup, const glm::vec3& p, const glm::vec3& c0, const glm::vec3& c1, const glm::vec3& c2)
+		{
+			glm::vec3 v = p - setup.v0;
+			float d20 = glm::dot(v, setup.e1);
+			float d21 = glm::dot(v, setup.e2);
+			float b1 = std::max((setup.d11 * d20 - setup.d01 * d21) * setup.invDenom, 0.f);
+			float b2 = std::max((setup.d00 * d21 - setup.d01 * d20) * setup.invDenom, 0.f);
+			float b0 = std::max(1.f - b1 - b2, 0.f);
+			float sum = b0 + b1 + b2;
+			return (c0 * b0 + c1 * b1 + c2 * b2) / sum;
+		}
+
+		// 21 bits per axis, offset so that sorting keeps negative coords valid.
+		ui64 PackTileKey(const ChunkCoord& c)
+		{
+			const int offset = 1 << 20;
+			return (static_cast<ui64>(c.x + offset) << 42) | (static_cast<ui64>(c.y + offset) << 21) | static_cast<ui64>(c.z + offset);
+		}
+
+		ChunkCoord UnpackTileKey(ui64 key)
+		{
+			const int offset = 1 << 20;
+			const ui64 mask = (1ull << 21) - 1;
+			return ChunkCoord(
+				static_cast<int>((key >> 42) & mask) - offset,
+				static_cast<int>((key >> 21) & mask) - offset,
+				static_cast<int>(key & mask) - offset);
+		}
+
+		struct TileEntry
+		{
+			ui64 tile;
+			ui32 triangle;
+
+			bool operator<(const TileEntry& other) const
+			{
+				return tile != other.tile ? tile < other.tile : triangle < other.triangle;
+			}
+		};
+	}
+
+	Voxelizer::Voxelizer()
+	{
+
+	}
+
+	Voxelizer::~Voxelizer()
+	{
+
+	}
+
+	VoxelizeStats Voxelizer::Voxelize(const TriangleMesh& mesh, const VoxelizeSettings& settings, VoxelWorld& world)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		VoxelizeStats stats{};
+		stats.triangleCount = mesh.GetTriangleCount();
+		if (stats.triangleCount == 0) {
+			Warning("Voxelize: mesh has no triangles.");
+			return stats;
+		}
+		if (settings.voxelSize <= 0.f) {
+			Error("Voxelize: voxel size must be positive.");
+			throw std::runtime_error("Voxelize: voxel size must be positive.");
+		}
+
+		// move vertices into voxel space, where voxel (i, j, k) spans [i, i + 1)
+		float invVoxelSize = 1.f / settings.voxelSize;
+		std::vector<glm::vec3> voxelPositions(mesh.positions.size());
+		JobSystem::ParallelFor(static_cast<ui32>(mesh.positions.size()), 16384, [&](ui32 begin, ui32 end) {
+			for (ui32 i = begin;i < end;i++) {
+				voxelPositions[i] = (mesh.positions[i] - settings.origin) * invVoxelSize;
+			}
+		});
+
+		// bin triangles into every tile their bounds touch
+		const ui32 binGroupSize = 4096;
+		ui32 binGroupCount = (stats.triangleCount + binGroupSize - 1) / binGroupSize;
+		std::vector<std::vector<TileEntry>> groupEntries(binGroupCount);
+		JobSystem::ParallelFor(stats.triangleCount, binGroupSize, [&](ui32 begin, ui32 end) {
+			std::vector<TileEntry>& entries = groupEntries[begin / binGroupSize];
+			for (ui32 t = begin;t < end;t++) {
+				const glm::vec3& v0 = voxelPositions[mesh.indices[t * 3 + 0]];
+				const glm::vec3& v1 = voxelPositions[mesh.indices[t * 3 + 1]];
+				const glm::vec3& v2 = voxelPositions[mesh.indices[t * 3 + 2]];
+				ChunkCoord minTile = ToChunkCoord(glm::ivec3(glm::floor(glm::min(v0, glm::min(v1, v2)))));
+				ChunkCoord maxTile = ToChunkCoord(glm::ivec3(glm::floor(glm::max(v0, glm::max(v1, v2)))));
+				for (int z = minTile.z;z <= maxTile.z;z++) {
+					for (int y = minTile.y;y <= maxTile.y;y++) {
+						for (int x = minTile.x;x <= maxTile.x;x++) {
+							entries.push_back({ PackTileKey(ChunkCoord(x, y, z)), t });
+						}
+					}
+				}
+			}
+		});
+
+		std::vector<TileEntry> entries;
+		size_t entryCount = 0;
+		for (const auto& group : groupEntries) {
+			entryCount += group.size();
+		}
+		entries.reserve(entryCount);
+		for (auto& group : groupEntries) {
+			entries.insert(entries.end(), group.begin(), group.end());
+			std::vector<TileEntry>().swap(group);
+		}
+		std::sort(entries.begin(), entries.end());
+
+		std::vector<ui32> tileStarts;
+		for (ui32 i = 0;i < entries.size();i++) {
+			if (i == 0 || entries[i].tile != entries[i - 1].tile) {
+				tileStarts.push_back(i);
+			}
+		}
+		stats.tileCount = static_cast<ui32>(tileStarts.size());
+		tileStarts.push_back(static_cast<ui32>(entries.size()));
+
+		// voxelize each tile into its own chunk, which goes directly into the world
+		std::atomic<ui64> voxelCount{ 0 };
+		JobSystem::ParallelFor(stats.tileCount, 1, [&](ui32 begin, ui32 end) {
+			for (ui32 tile = begin;tile < end;tile++) {
+				ChunkCoord coord = UnpackTileKey(entries[tileStarts[tile]].tile);
+				glm::ivec3 tileMin = ChunkOrigin(coord);
+				glm::ivec3 tileMax = tileMin + glm::ivec3(CHUNK_SIZE - 1);
+
+				auto chunk = std::make_unique<Chunk>();
+				TriangleSetup setup;
+
+				for (ui32 e = tileStarts[tile];e < tileStarts[tile + 1];e++) {
+					ui32 t = entries[e].triangle;
+					ui32 i0 = mesh.indices[t * 3 + 0];
+					ui32 i1 = mesh.indices[t * 3 + 1];
+					ui32 i2 = mesh.indices[t * 3 + 2];
+					if (!SetupTriangle(voxelPositions[i0], voxelPositions[i1], voxelPositions[i2], settings.mode, setup)) {
+						continue;
+					}
+
+					glm::ivec3 lo = glm::max(setup.minVoxel, tileMin);
+					glm::ivec3 hi = glm::min(setup.maxVoxel, tileMax);
+					if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) {
+						continue;
+					}
+
+					ui16 material = settings.materialBase;
+					if (!mesh.triangleMaterials.empty()) {
+						material = static_cast<ui16>(material + mesh.triangleMaterials[t]);
+					}
+					ui16 flatColor = Voxel::PackColor(settings.defaultColor);
+
+					for (int z = lo.z;z <= hi.z;z++) {
+						for (int y = lo.y;y <= hi.y;y++) {
+							for (int x = lo.x;x <= hi.x;x += ROW_LANES) {
+								ui32 mask = OverlapRow(setup, x + 0.5f, y + 0.5f, z + 0.5f);
+								ui32 lanes = static_cast<ui32>(std::min<int>(ROW_LANES, hi.x - x + 1));
+								mask &= (1u << lanes) - 1;
+
+								while (mask != 0) {
+									ui32 lane = static_cast<ui32>(std::countr_zero(mask));
+									mask &= mask - 1;
+
+									glm::ivec3 p(x + static_cast<int>(lane), y, z);
+									Voxel voxel{ material, flatColor };
+									if (mesh.HasColors()) {
+										glm::vec3 center = glm::vec3(p) + glm::vec3(0.5f);
+										voxel.color = Voxel::PackColor(InterpolateColor(setup, center, mesh.colors[i0], mesh.colors[i1], mesh.colors[i2]));
+									}
+									chunk->Set(p - tileMin, voxel);
+								}
+							}
+						}
+					}
+				}
+
+				if (chunk->IsEmpty()) {
+					continue;
+				}
+				voxelCount.fetch_add(chunk->GetSolidCount(), std::memory_order_relaxed);
+				if (settings.mergeWithExisting) {
+					world.MergeChunk(coord, std::move(chunk));
+				}
+				else {
+					world.InsertChunk(coord, std::move(chunk));
+				}
+			}
+		});
+
+		stats.voxelCount = voxelCount.load();
+		stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		Info("Voxelize [", "Triangles:", stats.triangleCount, "Tiles:", stats.tileCount, "Voxels:", stats.voxelCount, "Time:", stats.milliseconds, "ms ]");
+		return stats;
+	}
+
+	VoxelizeStats Voxelizer::VoxelizeFile(const std::string& filePath, const VoxelizeSettings& settings, VoxelWorld& world)
+	{
+		TriangleMesh mesh = MeshLoader::Load(filePath);
+		return Voxelize(mesh, settings, world);
+	}
+}
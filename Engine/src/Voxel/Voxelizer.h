@@ -0,0 +1,60 @@
+#pragma once
+
+#include "pch.h"
+
+#include "EngineCore/Core.h"
+
+#include "EngineCore/log.h"
+#include "EngineCore/JobSystem.h"
+#include "Voxel.h"
+#include "Chunk.h"
+#include "VoxelWorld.h"
+#include "MeshLoader.h"
+
+namespace Luxel
+{
+	enum class VoxelizeMode
+	{
+		// every voxel the triangle touches (26-separating, watertight).
+		Conservative,
+		// thin shell, only voxels the plane crosses along its dominant axis (6-separating).
+		Surface
+	};
+
+	struct VoxelizeSettings
+	{
+		float voxelSize = 1.f;
+		// world position of the corner of voxel (0, 0, 0).
+		glm::vec3 origin = glm::vec3(0.f);
+		VoxelizeMode mode = VoxelizeMode::Conservative;
+		// mesh material i is written as materialBase + i.
+		ui16 materialBase = 1;
+		glm::vec3 defaultColor = glm::vec3(1.f);
+		// false replaces touched chunks instead of merging into them.
+		bool mergeWithExisting = true;
+	};
+
+	struct VoxelizeStats
+	{
+		ui32 triangleCount = 0;
+		ui32 tileCount = 0;
+		ui64 voxelCount = 0;
+		double milliseconds = 0.0;
+	};
+
+	// bins triangles into chunk-sized tiles and voxelizes the tiles in parallel,
+	// writing each finished tile straight into the world.
+	class LUXEL_API Voxelizer
+	{
+	public:
+		Voxelizer(const Voxelizer&) = delete;
+		Voxelizer operator=(const Voxelizer&) = delete;
+
+		static VoxelizeStats Voxelize(const TriangleMesh& mesh, const VoxelizeSettings& settings, VoxelWorld& world);
+		static VoxelizeStats VoxelizeFile(const std::string& filePath, const VoxelizeSettings& settings, VoxelWorld& world);
+
+	private:
+		Voxelizer();
+		~Voxelizer();
+	};
+}
@@ -10,8 +10,26 @@
 #include <limits>
 #include <algorithm>
 #include <array>
+#include <memory>
+#include <functional>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <chrono>
+#include <bit>
+
+#include <immintrin.h>
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 #include <glm/mat4x4.hpp>
-#include <glm/vec4.hpp>
\ No newline at end of file
+#include <glm/vec4.hpp>
+#include <glm/glm.hpp>
\ No newline at end of file